@@ -0,0 +1,473 @@
+#ifndef ZOP_CLIPPING_H
+#define ZOP_CLIPPING_H
+
+/**
+ *  \file Clipping.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains clipping against convex windows and boolean
+ *  operations between simple polygons.
+ */
+
+#include <map>
+#include <set>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include <Polygon.h>
+#include <Parallel.h>
+
+namespace zop {
+
+enum class BooleanOperation { Intersection, Union, Difference, Xor };
+
+namespace detail {
+
+/**
+ * Copy the vertices of P to x and y in counter-clockwise order.
+ */
+inline void counterClockwise(const SimplePolygon &P, std::vector<double> &x, std::vector<double> &y) {
+    x = P.xs();
+    y = P.ys();
+    if (ringSignedArea(x.data(), y.data(), x.size()) < 0.0) {
+        std::reverse(x.begin(), x.end());
+        std::reverse(y.begin(), y.end());
+    }
+}
+
+/**
+ * Clip the ring (x, y) against the half-planes to the left of the edges of
+ * the convex, counter-clockwise window (wx, wy) with the Sutherland-Hodgman
+ * algorithm. The result replaces x and y, and nx and ny are scratch space.
+ */
+inline void clipRing(std::vector<double> &x, std::vector<double> &y,
+                     const std::vector<double> &wx, const std::vector<double> &wy,
+                     std::vector<double> &nx, std::vector<double> &ny) {
+    int m = wx.size();
+    for (int k = 0; k < m && !x.empty(); k++) {
+        int l = k + 1 == m ? 0: k + 1;
+        double ax = wx[k], ay = wy[k], ex = wx[l] - ax, ey = wy[l] - ay;
+        nx.clear();
+        ny.clear();
+        int n = x.size();
+        double si = ex * (y[n - 1] - ay) - ey * (x[n - 1] - ax);
+        for (int i = n - 1, j = 0; j < n; i = j++) {
+            double sj = ex * (y[j] - ay) - ey * (x[j] - ax);
+            if ((si < 0.0 && sj > 0.0) || (si > 0.0 && sj < 0.0)) {
+                double t = si / (si - sj);
+                nx.push_back(x[i] + t * (x[j] - x[i]));
+                ny.push_back(y[i] + t * (y[j] - y[i]));
+            }
+            if (sj >= 0.0) {
+                nx.push_back(x[j]);
+                ny.push_back(y[j]);
+            }
+            si = sj;
+        }
+        std::swap(x, nx);
+        std::swap(y, ny);
+    }
+}
+
+/**
+ * Remove repeated vertices and vertices in the middle of straight runs from
+ * the ring (x, y).
+ */
+inline void simplifyRing(std::vector<double> &x, std::vector<double> &y) {
+    bool changed = true;
+    while (changed && x.size() >= 3) {
+        changed = false;
+        int n = x.size(), m = 0;
+        for (int k = 0; k < n; k++) {
+            // Vertices before k are already compacted, those after it not.
+            double px = m > 0 ? x[m - 1]: x[n - 1], py = m > 0 ? y[m - 1]: y[n - 1];
+            int j = k + 1 == n ? 0: k + 1;
+            double c = (x[k] - px) * (y[j] - py) - (y[k] - py) * (x[j] - px);
+            if (c == 0.0) {
+                changed = true;
+                continue;
+            }
+            x[m] = x[k];
+            y[m] = y[k];
+            m++;
+        }
+        x.resize(m);
+        y.resize(m);
+    }
+    if (x.size() < 3) {
+        x.clear();
+        y.clear();
+    }
+}
+
+/**
+ * The overlay of two simple polygons A and B: the edges of both, split at
+ * every point where they meet the other polygon, and classified by whether
+ * they lie inside, outside or on the boundary of the other polygon.
+ *
+ * Points where the boundaries meet are computed once and shared by the
+ * edges of both polygons, so the pieces of the two boundaries meet at
+ * exactly the same nodes. Candidate pairs of edges are found with a sweep
+ * over their x extents.
+ */
+class Overlay {
+public:
+    enum Status : char { Inside, Outside, Same, Opposite };
+
+    struct Edge {
+        int from, to;
+        Status status;
+    };
+
+    std::vector<double> nodeX, nodeY;
+    std::vector<Edge> edges[2];
+
+private:
+    std::vector<double> x_[2], y_[2];
+    std::map<std::pair<double, double>, int> nodes_;
+    std::vector<char> onBoth_;
+    struct Split { double t; int node; };
+    std::vector<std::vector<Split>> splits_[2];
+
+    int node(double px, double py) {
+        auto [it, inserted] = nodes_.emplace(std::make_pair(px, py), (int) nodeX.size());
+        if (inserted) {
+            nodeX.push_back(px);
+            nodeY.push_back(py);
+            onBoth_.push_back(0);
+        }
+        return it->second;
+    }
+
+    int size(int r) const {
+        return x_[r].size();
+    }
+
+    int next(int r, int k) const {
+        return k + 1 == size(r) ? 0: k + 1;
+    }
+
+    /**
+     * Record where edge i of A and edge j of B meet.
+     */
+    void intersect(int i, int j) {
+        constexpr double eps = 1e-12;
+        int i1 = next(0, i), j1 = next(1, j);
+        double px = x_[0][i], py = y_[0][i], ax = x_[0][i1] - px, ay = y_[0][i1] - py;
+        double qx = x_[1][j], qy = y_[1][j], bx = x_[1][j1] - qx, by = y_[1][j1] - qy;
+        double wx = qx - px, wy = qy - py;
+        double d = ax * by - ay * bx;
+        double la = std::hypot(ax, ay), lb = std::hypot(bx, by);
+
+        if (std::abs(d) > eps * la * lb) {
+            double t = (wx * by - wy * bx) / d;
+            double s = (wx * ay - wy * ax) / d;
+            if (t < -eps || t > 1 + eps || s < -eps || s > 1 + eps) return;
+            int v;
+            if (t <= eps) v = node(px, py);
+            else if (t >= 1 - eps) v = node(x_[0][i1], y_[0][i1]);
+            else if (s <= eps) v = node(qx, qy);
+            else if (s >= 1 - eps) v = node(x_[1][j1], y_[1][j1]);
+            else v = node(px + t * ax, py + t * ay);
+            onBoth_[v] = 1;
+            splits_[0][i].push_back({t, v});
+            splits_[1][j].push_back({s, v});
+            return;
+        }
+
+        // Parallel edges only meet if they are collinear, and then every
+        // endpoint of one that lies on the other splits it.
+        if (std::abs(wx * ay - wy * ax) > eps * la * (la + lb)) return;
+        auto overlap = [&](int r, int k, double ox, double oy, double dx, double dy, double len) {
+            double u = ((x_[r][k] - ox) * dx + (y_[r][k] - oy) * dy) / (len * len);
+            if (u < -eps || u > 1 + eps) return;
+            int v = node(x_[r][k], y_[r][k]);
+            onBoth_[v] = 1;
+            // The other polygon is split at this endpoint.
+            if (r == 1) splits_[0][i].push_back({u, v});
+            else splits_[1][j].push_back({u, v});
+        };
+        overlap(1, j, px, py, ax, ay, la);
+        overlap(1, j1, px, py, ax, ay, la);
+        overlap(0, i, qx, qy, bx, by, lb);
+        overlap(0, i1, qx, qy, bx, by, lb);
+    }
+
+    void findIntersections() {
+        struct Event { double minX; int ring, edge; };
+        std::vector<Event> events;
+        events.reserve(size(0) + size(1));
+        for (int r = 0; r < 2; r++) {
+            for (int k = 0; k < size(r); k++) {
+                events.push_back({std::min(x_[r][k], x_[r][next(r, k)]), r, k});
+            }
+        }
+        std::sort(events.begin(), events.end(), [](const Event &a, const Event &b) { return a.minX < b.minX; });
+        auto maxX = [&](int r, int k) { return std::max(x_[r][k], x_[r][next(r, k)]); };
+        auto minY = [&](int r, int k) { return std::min(y_[r][k], y_[r][next(r, k)]); };
+        auto maxY = [&](int r, int k) { return std::max(y_[r][k], y_[r][next(r, k)]); };
+
+        std::vector<int> active[2];
+        for (const Event &e: events) {
+            int o = 1 - e.ring;
+            std::vector<int> &other = active[o];
+            for (size_t a = 0; a < other.size();) {
+                int k = other[a];
+                if (maxX(o, k) < e.minX) {
+                    other[a] = other.back();
+                    other.pop_back();
+                    continue;
+                }
+                if (minY(o, k) <= maxY(e.ring, e.edge) && minY(e.ring, e.edge) <= maxY(o, k)) {
+                    if (e.ring == 0) intersect(e.edge, k);
+                    else intersect(k, e.edge);
+                }
+                a++;
+            }
+            active[e.ring].push_back(e.edge);
+        }
+    }
+
+    void buildEdges(int r) {
+        for (int k = 0; k < size(r); k++) {
+            std::vector<Split> &s = splits_[r][k];
+            std::sort(s.begin(), s.end(), [](const Split &a, const Split &b) { return a.t < b.t; });
+            int from = node(x_[r][k], y_[r][k]);
+            int last = node(x_[r][next(r, k)], y_[r][next(r, k)]);
+            for (const Split &p: s) {
+                if (p.node == from || p.node == last) continue;
+                edges[r].push_back({from, p.node, Outside});
+                from = p.node;
+            }
+            edges[r].push_back({from, last, Outside});
+        }
+    }
+
+    void classify(int r) {
+        int o = 1 - r;
+        std::set<std::pair<int, int>> other;
+        for (const Edge &e: edges[o]) other.insert({e.from, e.to});
+        bool known = false;
+        Status previous = Outside;
+        for (Edge &e: edges[r]) {
+            if (other.count({e.from, e.to})) {
+                e.status = Same;
+                known = false;
+            } else if (other.count({e.to, e.from})) {
+                e.status = Opposite;
+                known = false;
+            } else if (known && !onBoth_[e.from]) {
+                // The status can only change where the boundaries meet.
+                e.status = previous;
+            } else {
+                double mx = 0.5 * (nodeX[e.from] + nodeX[e.to]);
+                double my = 0.5 * (nodeY[e.from] + nodeY[e.to]);
+                bool inside = ringContains(x_[o].data(), y_[o].data(), size(o), mx, my);
+                e.status = inside ? Inside: Outside;
+                previous = e.status;
+                known = true;
+            }
+        }
+    }
+
+public:
+
+    Overlay(const SimplePolygon &A, const SimplePolygon &B) {
+        counterClockwise(A, x_[0], y_[0]);
+        counterClockwise(B, x_[1], y_[1]);
+        for (int r = 0; r < 2; r++) {
+            splits_[r].resize(size(r));
+            for (int k = 0; k < size(r); k++) node(x_[r][k], y_[r][k]);
+        }
+        findIntersections();
+        for (int r = 0; r < 2; r++) buildEdges(r);
+        for (int r = 0; r < 2; r++) classify(r);
+    }
+
+    /**
+     * Return the rings formed by the directed edges (from[k], to[k]). At a
+     * node with several outgoing edges the ring turns left as sharply as
+     * possible, so rings that only touch at a node are kept apart.
+     * Counter-clockwise rings bound regions and clockwise rings bound holes.
+     * The rings are appended to out. Every node has as many selected edges
+     * leaving it as entering it, so a trace that runs into a node without
+     * outgoing edges means the classification is inconsistent, and throws.
+     */
+    void rings(const std::vector<std::pair<int, int>> &selected, PolygonCollection &out) const {
+        int n = nodeX.size();
+        std::vector<int> offsets(n + 1, 0), targets(selected.size());
+        for (auto [a, b]: selected) offsets[a + 1]++;
+        for (int k = 0; k < n; k++) offsets[k + 1] += offsets[k];
+        std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+        for (auto [a, b]: selected) targets[fill[a]++] = b;
+
+        auto angle = [&](int from, int to) {
+            return std::atan2(nodeY[to] - nodeY[from], nodeX[to] - nodeX[from]);
+        };
+        auto follow = [&](int u, int w) {
+            double back = angle(w, u);
+            int best = -1;
+            double bestTurn = 0.0;
+            for (int h = offsets[w]; h < offsets[w + 1]; h++) {
+                double turn = back - angle(w, targets[h]);
+                while (turn <= 0.0) turn += 2 * M_PI;
+                while (turn > 2 * M_PI) turn -= 2 * M_PI;
+                if (best < 0 || turn < bestTurn) {
+                    best = h;
+                    bestTurn = turn;
+                }
+            }
+            return best;
+        };
+
+        std::vector<char> used(targets.size(), 0);
+        std::vector<double> x, y;
+        for (int v = 0; v < n; v++) {
+            for (int h = offsets[v]; h < offsets[v + 1]; h++) {
+                if (used[h]) continue;
+                x.clear();
+                y.clear();
+                int u = v, e = h;
+                while (e >= 0 && !used[e]) {
+                    used[e] = 1;
+                    x.push_back(nodeX[u]);
+                    y.push_back(nodeY[u]);
+                    int w = targets[e];
+                    e = follow(u, w);
+                    u = w;
+                }
+                if (e < 0) throw std::runtime_error("boundary pieces do not form closed rings");
+                simplifyRing(x, y);
+                if (!x.empty() && ringSignedArea(x.data(), y.data(), x.size()) != 0.0) out.add(x.data(), y.data(), x.size());
+            }
+        }
+    }
+};
+
+}
+
+/**
+ * Return the part of subject inside the convex polygon window, with the
+ * Sutherland-Hodgman algorithm in O(nm) time for n and m vertices. If the
+ * subject is not convex and the result falls apart into several pieces,
+ * they are returned as one polygon joined along the boundary of the
+ * window. The result is empty if the two do not overlap.
+ */
+inline SimplePolygon clipConvex(const SimplePolygon &subject, const SimplePolygon &window) {
+    if (!window.isConvex()) throw std::runtime_error("clip window must be convex");
+    std::vector<double> wx, wy, nx, ny;
+    detail::counterClockwise(window, wx, wy);
+    std::vector<double> x = subject.xs(), y = subject.ys();
+    detail::clipRing(x, y, wx, wy, nx, ny);
+    return SimplePolygon(x, y);
+}
+
+/**
+ * Clip every polygon of P against the convex polygon window in parallel,
+ * replacing the contents of out. Polygon p of out is the part of polygon p
+ * of P inside the window, which is empty if they do not overlap. Every
+ * thread clips a block of polygons into a collection of its own, and the
+ * blocks are then appended to out in order, so the storage of out is reused
+ * and the number of allocations does not grow with the number of polygons.
+ */
+inline void clipConvex(const PolygonCollection &P, const SimplePolygon &window, PolygonCollection &out) {
+    if (!window.isConvex()) throw std::runtime_error("clip window must be convex");
+    if (&out == &P) throw std::runtime_error("output aliases input");
+    std::vector<double> wx, wy;
+    detail::counterClockwise(window, wx, wy);
+    std::vector<PolygonCollection> parts(parallel::threadCount());
+    parallel::forEachThread([&](int t, int n) {
+        auto [a, b] = parallel::balancedRange(P.offsets().data(), P.size(), t, n);
+        std::vector<double> x, y, nx, ny;
+        for (int p = a; p < b; p++) {
+            int first = P.offsets()[p], last = P.offsets()[p + 1];
+            x.assign(P.xs().begin() + first, P.xs().begin() + last);
+            y.assign(P.ys().begin() + first, P.ys().begin() + last);
+            detail::clipRing(x, y, wx, wy, nx, ny);
+            parts[t].add(x.data(), y.data(), x.size());
+        }
+    });
+    int vertices = 0;
+    for (const PolygonCollection &part: parts) vertices += part.vertexCount();
+    out.clear();
+    out.reserve(P.size(), vertices);
+    for (const PolygonCollection &part: parts) out.append(part);
+}
+
+/**
+ * Clip every polygon of P against the convex polygon window in parallel.
+ * Polygon p of the result is the part of polygon p of P inside the window,
+ * which is empty if they do not overlap.
+ */
+inline PolygonCollection clipConvex(const PolygonCollection &P, const SimplePolygon &window) {
+    PolygonCollection res;
+    clipConvex(P, window, res);
+    return res;
+}
+
+/**
+ * Append the result of a boolean operation between the simple polygons A
+ * and B to out, as rings: regions in counter-clockwise order and the holes
+ * inside them in clockwise order.
+ *
+ * The boundaries are split wherever they meet, including overlapping
+ * edges and vertices that touch the other boundary, and each piece is kept
+ * or dropped depending on the operation and on whether it lies inside,
+ * outside or on the boundary of the other polygon (as in the algorithm of
+ * Martinez et al., without its sweep for connecting the pieces). The kept
+ * pieces are then linked into rings. Finding where the boundaries meet
+ * takes O((n + m) log(n + m) + k) time, where k is the number of pairs of
+ * edges of A and B whose x-extents overlap: the sweep visits every such
+ * pair, and only intersects those whose y-extents overlap as well.
+ */
+inline void booleanOperation(const SimplePolygon &A, const SimplePolygon &B, BooleanOperation op,
+                             PolygonCollection &out) {
+    if (op == BooleanOperation::Xor) {
+        booleanOperation(A, B, BooleanOperation::Difference, out);
+        booleanOperation(B, A, BooleanOperation::Difference, out);
+        return;
+    }
+    using Overlay = detail::Overlay;
+    Overlay overlay(A, B);
+    std::vector<std::pair<int, int>> selected;
+    for (int r = 0; r < 2; r++) {
+        for (const Overlay::Edge &e: overlay.edges[r]) {
+            bool keep = false, reverse = false;
+            switch (op) {
+            case BooleanOperation::Intersection:
+                keep = e.status == Overlay::Inside || (r == 0 && e.status == Overlay::Same);
+                break;
+            case BooleanOperation::Union:
+                keep = e.status == Overlay::Outside || (r == 0 && e.status == Overlay::Same);
+                break;
+            default:
+                keep = r == 0 ? e.status == Overlay::Outside || e.status == Overlay::Opposite
+                              : e.status == Overlay::Inside;
+                reverse = r == 1;
+                break;
+            }
+            if (keep) selected.push_back(reverse ? std::make_pair(e.to, e.from): std::make_pair(e.from, e.to));
+        }
+    }
+    overlay.rings(selected, out);
+}
+
+/**
+ * Return the result of a boolean operation between the simple polygons A
+ * and B as a list of rings, as described above.
+ */
+inline std::vector<SimplePolygon> booleanOperation(const SimplePolygon &A, const SimplePolygon &B,
+                                                   BooleanOperation op) {
+    PolygonCollection rings;
+    booleanOperation(A, B, op, rings);
+    std::vector<SimplePolygon> res;
+    res.reserve(rings.size());
+    for (int p = 0; p < rings.size(); p++) res.push_back(rings.polygon(p));
+    return res;
+}
+
+}
+
+#endif /* ZOP_CLIPPING_H */
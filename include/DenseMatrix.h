@@ -53,6 +53,7 @@ public:
     }
 
     DenseMatrix transposed() const {
+        ZOP_INSTRUMENT("transposed", 0, 16.0 * nRows() * nCols());
         DenseMatrix res{nCols(), nRows()};
         for (int i = 0; i < nRows(); i++) {
             for (int j = 0; j < nCols(); j++) {
@@ -0,0 +1,661 @@
+#ifndef ZOP_DISTRIBUTED_MATRIX_H
+#define ZOP_DISTRIBUTED_MATRIX_H
+
+/**
+ *  \file DistributedMatrix.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains a row-partitioned sparse matrix that is distributed
+ *  across several processes, together with the halo exchange used to
+ *  multiply it with a distributed vector.
+ */
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <new>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <Vector.h>
+#include <Parallel.h>
+#include <SparseMatrix.h>
+
+namespace zop::distributed {
+
+/**
+ * This class describes how the rows of a square sparse matrix are split
+ * between a number of ranks, and which values have to be exchanged between
+ * them during a matrix-vector multiplication.
+ *
+ * Every rank owns a contiguous block of rows, chosen so that every block
+ * holds roughly the same number of non-zero entries, and the matching block
+ * of entries of the input and output vectors. The ghost (or halo) columns of
+ * a rank are the columns referenced by its rows that are owned by another
+ * rank. They are stored sorted, which also groups them by owner since
+ * ownership is contiguous.
+ *
+ * A partition built from a matrix knows the ghosts of every rank. A
+ * partition built from row bounds alone, for matrices that no single
+ * process holds, only knows who owns what; the ranks then find their ghosts
+ * from their own rows and exchange them when the distributed matrix is
+ * built.
+ */
+class RowPartition {
+private:
+    int n_ = 0;
+    std::vector<int> bounds_;
+    std::vector<std::vector<int>> ghosts_;
+    std::vector<std::vector<int>> ghostOffsets_;
+
+public:
+
+    /**
+     * Create a partition in which rank r owns the rows [bounds[r],
+     * bounds[r + 1]), without ghost information.
+     */
+    explicit RowPartition(std::vector<int> bounds): bounds_{std::move(bounds)} {
+        if (bounds_.size() < 2 || bounds_.front() != 0) {
+            throw std::runtime_error("row bounds must start at 0 and contain a part");
+        }
+        if (!std::is_sorted(bounds_.begin(), bounds_.end())) {
+            throw std::runtime_error("row bounds must not decrease");
+        }
+        n_ = bounds_.back();
+    }
+
+    RowPartition(const CSRSparseMatrix &A, int parts) {
+        if (A.nRows() != A.nCols()) {
+            throw std::runtime_error("matrix must be square");
+        }
+        if (parts <= 0) {
+            throw std::runtime_error("number of parts must be positive");
+        }
+
+        n_ = A.nRows();
+        bounds_.resize(parts + 1);
+        for (int r = 0; r < parts; r++) {
+            bounds_[r] = parallel::balancedRange(A.rowIndices().data(), n_, r, parts).first;
+        }
+        bounds_[parts] = n_;
+
+        const auto &rows = A.rowIndices();
+        const auto &cols = A.columnIndices();
+        std::vector<int> seen(n_, -1);
+        ghosts_.resize(parts);
+        ghostOffsets_.resize(parts);
+        for (int r = 0; r < parts; r++) {
+            for (int k = rows[bounds_[r]]; k < rows[bounds_[r + 1]]; k++) {
+                int j = cols[k];
+                if ((j < bounds_[r] || j >= bounds_[r + 1]) && seen[j] != r) {
+                    seen[j] = r;
+                    ghosts_[r].push_back(j);
+                }
+            }
+            std::sort(ghosts_[r].begin(), ghosts_[r].end());
+
+            ghostOffsets_[r].resize(parts + 1);
+            for (int s = 0; s <= parts; s++) {
+                auto it = std::lower_bound(ghosts_[r].begin(), ghosts_[r].end(), s < parts ? bounds_[s]: n_);
+                ghostOffsets_[r][s] = it - ghosts_[r].begin();
+            }
+        }
+    }
+
+    int size() const { return n_; }
+    int parts() const { return (int) bounds_.size() - 1; }
+    int begin(int rank) const { return bounds_[rank]; }
+    int end(int rank) const { return bounds_[rank + 1]; }
+
+    /**
+     * Return whether the ghosts of every rank are known, that is whether the
+     * partition was built from the matrix.
+     */
+    bool hasGhosts() const { return !ghosts_.empty(); }
+
+    /**
+     * Return the rank that owns the given row (and vector entry).
+     */
+    int owner(int i) const {
+        return (int) (std::upper_bound(bounds_.begin(), bounds_.end(), i) - bounds_.begin()) - 1;
+    }
+
+    /**
+     * Return the sorted global indices of the ghost columns of a rank.
+     */
+    const std::vector<int>& ghosts(int rank) const {
+        if (!hasGhosts()) throw std::runtime_error("partition has no ghost information");
+        return ghosts_[rank];
+    }
+
+    /**
+     * Return the range of `ghosts(dst)` that is owned by src, and thus has
+     * to be sent from src to dst during every exchange.
+     */
+    std::pair<int, int> ghostRange(int dst, int src) const {
+        if (!hasGhosts()) throw std::runtime_error("partition has no ghost information");
+        return {ghostOffsets_[dst][src], ghostOffsets_[dst][src + 1]};
+    }
+
+    /**
+     * Return the number of values sent from src to dst in every exchange.
+     */
+    int messageSize(int src, int dst) const {
+        auto [a, b] = ghostRange(dst, src);
+        return b - a;
+    }
+
+    /**
+     * Return the largest message from src to dst a transport has to carry:
+     * the halo values sent from src, and for
+     * DistributedCSRSparseMatrix::fromLocalRows() a count and the ghost
+     * indices src requests from dst. With ghost information these are
+     * messageSize(src, dst) and messageSize(dst, src); without it, both are
+     * bounded by the rows of either rank.
+     */
+    int mailboxCapacity(int src, int dst) const {
+        if (hasGhosts()) return std::max({1, messageSize(src, dst), messageSize(dst, src)});
+        return std::max({1, end(src) - begin(src), end(dst) - begin(dst)});
+    }
+
+    /**
+     * Return the block of x owned by a rank.
+     */
+    Vector localSegment(const Vector &x, int rank) const {
+        Vector res(end(rank) - begin(rank));
+        for (int i = begin(rank); i < end(rank); i++) {
+            res[i - begin(rank)] = x[i];
+        }
+        return res;
+    }
+};
+
+/**
+ * The interface used by a distributed matrix to exchange halo values with
+ * the other ranks. An exchange is split into four phases so that the
+ * caller can overlap computation with communication:
+ *
+ * 1. `send` is called once for every peer that needs values from this rank.
+ * 2. `publish` marks the sends of the current exchange as complete.
+ * 3. `receive` is called once for every peer that this rank needs values
+ *    from, and blocks until that peer has published.
+ * 4. `finish` marks the end of the exchange.
+ */
+class HaloTransport {
+public:
+    virtual ~HaloTransport() = default;
+    virtual int rank() const = 0;
+    virtual int size() const = 0;
+    virtual void send(int peer, const double *values, int count) = 0;
+    virtual void publish() = 0;
+    virtual void receive(int peer, double *values, int count) = 0;
+    virtual void finish() = 0;
+};
+
+/**
+ * A POSIX shared memory segment holding the mailboxes of every pair of
+ * ranks on a single host. The segment is created once, sized from a row
+ * partition, and is then either inherited by forked worker processes or
+ * attached to by name.
+ *
+ * Every mailbox is double buffered by exchange parity, and every rank
+ * publishes a counter of completed exchanges, so a sender only has to wait
+ * for a receiver that is more than one exchange behind. Both halves of a
+ * mailbox hold its full capacity, so consecutive exchanges may carry
+ * messages of different sizes. The pages of a segment are only backed by
+ * memory once written, so the capacities of a partition without ghost
+ * information cost address space rather than memory.
+ */
+class SharedMemorySegment {
+private:
+    std::string name_;
+    bool owner_ = false;
+    pid_t creator_ = 0;
+    size_t bytes_ = 0;
+    void *base_ = nullptr;
+
+    struct Header {
+        long bytes;
+        int ranks;
+    };
+
+    void map(int fd) {
+        base_ = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base_ == MAP_FAILED) {
+            base_ = nullptr;
+            if (owner_) shm_unlink(name_.c_str());
+            throw std::runtime_error("unable to map shared memory segment");
+        }
+    }
+
+    long* mailboxOffsets() const {
+        return reinterpret_cast<long *>(static_cast<char *>(base_) + sizeof(Header));
+    }
+
+    long* mailboxCapacities() const {
+        return mailboxOffsets() + ranks() * ranks();
+    }
+
+    static size_t align(size_t bytes) {
+        return (bytes + 63) / 64 * 64;
+    }
+
+public:
+
+    /**
+     * Create a new segment with mailboxes sized for the given partition.
+     * The segment is unlinked when this object is destroyed by the process
+     * that created it.
+     */
+    SharedMemorySegment(const std::string &name, const RowPartition &partition):
+        name_{name},
+        owner_{true},
+        creator_{getpid()} {
+        int P = partition.parts();
+        size_t header = align(sizeof(Header) + 2 * sizeof(long) * P * P);
+        size_t counters = align(sizeof(std::atomic<long>) * P);
+        size_t payload = 0;
+        std::vector<long> offsets(P * P), capacities(P * P);
+        for (int src = 0; src < P; src++) {
+            for (int dst = 0; dst < P; dst++) {
+                offsets[src * P + dst] = header + counters + payload;
+                capacities[src * P + dst] = src == dst ? 0: partition.mailboxCapacity(src, dst);
+                payload += align(2 * sizeof(double) * capacities[src * P + dst]);
+            }
+        }
+        bytes_ = header + counters + payload;
+
+        int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd == -1) {
+            throw std::runtime_error("unable to create shared memory segment");
+        }
+        if (ftruncate(fd, bytes_) == -1) {
+            close(fd);
+            shm_unlink(name_.c_str());
+            throw std::runtime_error("unable to size shared memory segment");
+        }
+        map(fd);
+
+        Header *h = static_cast<Header *>(base_);
+        h->bytes = bytes_;
+        h->ranks = P;
+        std::copy(offsets.begin(), offsets.end(), mailboxOffsets());
+        std::copy(capacities.begin(), capacities.end(), mailboxCapacities());
+        for (int r = 0; r < P; r++) {
+            new (&counter(r)) std::atomic<long>(0);
+        }
+    }
+
+    /**
+     * Attach to a segment created by another process.
+     */
+    explicit SharedMemorySegment(const std::string &name): name_{name} {
+        int fd = shm_open(name_.c_str(), O_RDWR, 0600);
+        if (fd == -1) {
+            throw std::runtime_error("unable to open shared memory segment");
+        }
+        Header h;
+        if (pread(fd, &h, sizeof(h), 0) != (ssize_t) sizeof(h)) {
+            close(fd);
+            throw std::runtime_error("unable to read shared memory segment");
+        }
+        bytes_ = h.bytes;
+        map(fd);
+    }
+
+    SharedMemorySegment(const SharedMemorySegment &) = delete;
+    SharedMemorySegment& operator=(const SharedMemorySegment &) = delete;
+
+    ~SharedMemorySegment() {
+        if (base_) munmap(base_, bytes_);
+        if (owner_ && getpid() == creator_) shm_unlink(name_.c_str());
+    }
+
+    int ranks() const {
+        return static_cast<Header *>(base_)->ranks;
+    }
+
+    /**
+     * Return the number of exchanges published by a rank.
+     */
+    std::atomic<long>& counter(int rank) const {
+        size_t header = align(sizeof(Header) + 2 * sizeof(long) * ranks() * ranks());
+        return reinterpret_cast<std::atomic<long> *>(static_cast<char *>(base_) + header)[rank];
+    }
+
+    /**
+     * Return the mailbox for messages from src to dst in the given
+     * exchange. Throws if a message of count values does not fit.
+     */
+    double* mailbox(int src, int dst, long exchange, int count) const {
+        long capacity = mailboxCapacities()[src * ranks() + dst];
+        if (count > capacity) throw std::runtime_error("message exceeds mailbox capacity");
+        double *box = reinterpret_cast<double *>(static_cast<char *>(base_) + mailboxOffsets()[src * ranks() + dst]);
+        return box + (exchange % 2) * capacity;
+    }
+};
+
+/**
+ * The default halo transport, which exchanges values through the mailboxes
+ * of a shared memory segment. Waiting is done by spinning on the published
+ * exchange counters, yielding the processor between checks.
+ */
+class SharedMemoryTransport: public HaloTransport {
+private:
+    SharedMemorySegment *segment_;
+    int rank_;
+    long exchange_ = 1;
+
+    void waitFor(int peer, long exchange) const {
+        auto &counter = segment_->counter(peer);
+        while (counter.load(std::memory_order_acquire) < exchange) {
+            std::this_thread::yield();
+        }
+    }
+
+public:
+
+    SharedMemoryTransport(SharedMemorySegment &segment, int rank): segment_{&segment}, rank_{rank} {
+        if (rank < 0 || rank >= segment.ranks()) {
+            throw std::runtime_error("invalid rank");
+        }
+    }
+
+    int rank() const override { return rank_; }
+    int size() const override { return segment_->ranks(); }
+
+    void send(int peer, const double *values, int count) override {
+        // The mailbox for this exchange was last used two exchanges ago,
+        // and is free once the peer has moved past the previous exchange.
+        waitFor(peer, exchange_ - 1);
+        std::memcpy(segment_->mailbox(rank_, peer, exchange_, count), values, sizeof(double) * count);
+    }
+
+    void publish() override {
+        segment_->counter(rank_).store(exchange_, std::memory_order_release);
+    }
+
+    void receive(int peer, double *values, int count) override {
+        waitFor(peer, exchange_);
+        std::memcpy(values, segment_->mailbox(peer, rank_, exchange_, count), sizeof(double) * count);
+    }
+
+    void finish() override {
+        exchange_ += 1;
+    }
+};
+
+/**
+ * The rows of a CSRSparseMatrix owned by a single rank of a RowPartition.
+ *
+ * The local rows are stored as a CSR matrix whose columns are renumbered so
+ * that the owned entries of the input vector come first, followed by the
+ * ghost entries grouped by owner. Rows that only reference owned columns
+ * are interior rows and can be computed while the halo exchange is still
+ * in flight; the remaining boundary rows are computed once it completes.
+ *
+ * A rank can be built from the global matrix, or from its own rows only
+ * with fromLocalRows(), so that no process ever holds the whole matrix.
+ */
+class DistributedCSRSparseMatrix {
+private:
+    const RowPartition *partition_;
+    HaloTransport *transport_;
+    int rank_;
+    int nLocal_;
+    std::vector<int> ghosts_;
+    std::vector<int> ghostOffsets_;
+    CSRSparseMatrix local_;
+    std::vector<int> interior_;
+    std::vector<int> boundary_;
+    std::vector<std::vector<int>> sendIndices_;
+    std::vector<double> sendBuffer_;
+    Vector extended_;
+
+    /**
+     * Return the rows [a, b) of A, keeping their global column indices.
+     */
+    static CSRSparseMatrix sliceRows(const CSRSparseMatrix &A, int a, int b) {
+        const auto &rows = A.rowIndices();
+        std::vector<int> row_indices(b - a + 1);
+        for (int i = a; i <= b; i++) {
+            row_indices[i - a] = rows[i] - rows[a];
+        }
+        std::vector<int> column_indices(A.columnIndices().begin() + rows[a], A.columnIndices().begin() + rows[b]);
+        std::vector<double> values(A.values().begin() + rows[a], A.values().begin() + rows[b]);
+        return CSRSparseMatrix(b - a, A.nCols(), std::move(row_indices), std::move(column_indices), std::move(values));
+    }
+
+    /**
+     * Return the sorted columns of the local rows outside of [a, b).
+     */
+    static std::vector<int> findGhosts(const CSRSparseMatrix &rows, int a, int b) {
+        std::vector<int> ghosts;
+        for (int j: rows.columnIndices()) {
+            if (j < a || j >= b) ghosts.push_back(j);
+        }
+        std::sort(ghosts.begin(), ghosts.end());
+        ghosts.erase(std::unique(ghosts.begin(), ghosts.end()), ghosts.end());
+        return ghosts;
+    }
+
+    /**
+     * Renumber the global columns of the local rows [a, b): owned columns
+     * become 0 to b - a, and ghost columns follow in the order of ghosts.
+     */
+    static CSRSparseMatrix renumber(CSRSparseMatrix rows, int a, int b, const std::vector<int> &ghosts) {
+        std::vector<int> row_indices = rows.rowIndices();
+        std::vector<int> column_indices = rows.columnIndices();
+        std::vector<double> values = rows.values();
+        for (int &j: column_indices) {
+            if (a <= j && j < b) {
+                j -= a;
+            } else {
+                j = (b - a) + (std::lower_bound(ghosts.begin(), ghosts.end(), j) - ghosts.begin());
+            }
+        }
+
+        // Ghost columns to the left of the owned block are moved to the end
+        // of their rows, so the rows have to be sorted again.
+        std::vector<std::pair<int, double>> buffer;
+        for (int i = 0; i < b - a; i++) {
+            buffer.clear();
+            for (int k = row_indices[i]; k < row_indices[i + 1]; k++) {
+                buffer.push_back({column_indices[k], values[k]});
+            }
+            std::sort(buffer.begin(), buffer.end());
+            for (int k = row_indices[i]; k < row_indices[i + 1]; k++) {
+                column_indices[k] = buffer[k - row_indices[i]].first;
+                values[k] = buffer[k - row_indices[i]].second;
+            }
+        }
+        return CSRSparseMatrix(b - a, (b - a) + ghosts.size(), std::move(row_indices), std::move(column_indices), std::move(values));
+    }
+
+    /**
+     * Set up everything but the send lists from the local rows, which hold
+     * global column indices, and the sorted ghosts of this rank.
+     */
+    DistributedCSRSparseMatrix(CSRSparseMatrix rows, std::vector<int> ghosts,
+                               const RowPartition &partition, HaloTransport &transport):
+        partition_{&partition},
+        transport_{&transport},
+        rank_{transport.rank()},
+        nLocal_{partition.end(transport.rank()) - partition.begin(transport.rank())},
+        ghosts_{std::move(ghosts)},
+        local_{renumber(std::move(rows), partition.begin(rank_), partition.end(rank_), ghosts_)},
+        extended_(local_.nCols()) {
+
+        int P = partition.parts();
+        if (transport.size() != P) {
+            throw std::runtime_error("transport and partition sizes differ");
+        }
+
+        for (int i = 0; i < local_.nRows(); i++) {
+            auto row = local_.row(i);
+            bool interior = row.count() == 0 || row.indices(row.count() - 1) < nLocal_;
+            (interior ? interior_: boundary_).push_back(i);
+        }
+
+        ghostOffsets_.resize(P + 1);
+        for (int s = 0; s <= P; s++) {
+            auto it = std::lower_bound(ghosts_.begin(), ghosts_.end(), s < P ? partition.begin(s): partition.size());
+            ghostOffsets_[s] = it - ghosts_.begin();
+        }
+        sendIndices_.resize(P);
+    }
+
+    void allocateSendBuffer() {
+        std::size_t maxMessage = 0;
+        for (auto &indices: sendIndices_) maxMessage = std::max(maxMessage, indices.size());
+        sendBuffer_.resize(maxMessage);
+    }
+
+public:
+
+    /**
+     * Take the rows of this rank from the global matrix A. The send lists
+     * come from the ghosts of the other ranks in the partition, so no
+     * communication is needed.
+     */
+    DistributedCSRSparseMatrix(const CSRSparseMatrix &A, const RowPartition &partition, HaloTransport &transport):
+        DistributedCSRSparseMatrix(sliceRows(A, partition.begin(transport.rank()), partition.end(transport.rank())),
+                                   partition.ghosts(transport.rank()), partition, transport) {
+        int offset = partition.begin(rank_);
+        for (int peer = 0; peer < partition.parts(); peer++) {
+            if (peer == rank_) continue;
+            auto [a, b] = partition.ghostRange(peer, rank_);
+            for (int k = a; k < b; k++) {
+                sendIndices_[peer].push_back(partition.ghosts(peer)[k] - offset);
+            }
+        }
+        allocateSendBuffer();
+    }
+
+    /**
+     * Build the rank from its own rows: a CSR matrix with one row for every
+     * row the rank owns in the partition and the global column indices. The
+     * partition only needs the row bounds; one built from the same matrix
+     * works as well. Every rank calls this
+     * collectively: the ghosts are found from the local columns, and each
+     * rank tells every peer which of its entries it needs in two exchanges
+     * over the transport, first the counts and then the indices.
+     */
+    static DistributedCSRSparseMatrix fromLocalRows(CSRSparseMatrix rows, const RowPartition &partition,
+                                                    HaloTransport &transport) {
+        int rank = transport.rank();
+        int a = partition.begin(rank), b = partition.end(rank);
+        if (rows.nRows() != b - a || rows.nCols() != partition.size()) throw DimensionMismatchException{};
+        std::vector<int> ghosts = findGhosts(rows, a, b);
+        DistributedCSRSparseMatrix res{std::move(rows), std::move(ghosts), partition, transport};
+
+        int P = partition.parts();
+        std::vector<double> counts(P, 0.0);
+        for (int peer = 0; peer < P; peer++) {
+            if (peer == rank) continue;
+            double count = res.ghostOffsets_[peer + 1] - res.ghostOffsets_[peer];
+            transport.send(peer, &count, 1);
+        }
+        transport.publish();
+        for (int peer = 0; peer < P; peer++) {
+            if (peer != rank) transport.receive(peer, &counts[peer], 1);
+        }
+        transport.finish();
+
+        // Indices are sent as doubles, which hold every int exactly.
+        std::vector<double> buffer;
+        for (int peer = 0; peer < P; peer++) {
+            int first = res.ghostOffsets_[peer], last = res.ghostOffsets_[peer + 1];
+            if (peer == rank || first == last) continue;
+            buffer.assign(res.ghosts_.begin() + first, res.ghosts_.begin() + last);
+            transport.send(peer, buffer.data(), last - first);
+        }
+        transport.publish();
+        for (int peer = 0; peer < P; peer++) {
+            int count = (int) counts[peer];
+            if (peer == rank || count == 0) continue;
+            buffer.resize(count);
+            transport.receive(peer, buffer.data(), count);
+            for (double j: buffer) res.sendIndices_[peer].push_back((int) j - a);
+        }
+        transport.finish();
+        res.allocateSendBuffer();
+        return res;
+    }
+
+    int nRows() const { return partition_->size(); }
+    int nCols() const { return partition_->size(); }
+    int rank() const { return rank_; }
+    int localRowCount() const { return nLocal_; }
+    int ghostCount() const { return local_.nCols() - nLocal_; }
+
+    /**
+     * Return the sorted global indices of the ghost columns of this rank.
+     */
+    const std::vector<int>& ghosts() const { return ghosts_; }
+
+    int interiorRowCount() const { return interior_.size(); }
+    int boundaryRowCount() const { return boundary_.size(); }
+
+    /**
+     * Return the local rows of this rank with renumbered columns.
+     */
+    const CSRSparseMatrix& localMatrix() const {
+        return local_;
+    }
+
+    /**
+     * Multiply the distributed matrix with a distributed vector. Every rank
+     * calls this collectively with its own block of x, and receives its own
+     * block of the result.
+     *
+     * The owned values needed by other ranks are sent first, then the
+     * interior rows are computed while the exchange is in progress, and the
+     * boundary rows are computed after the ghost values have arrived.
+     */
+    Vector operator*(const Vector &x) {
+        if (x.dim() != nLocal_) throw DimensionMismatchException{};
+        std::copy(x.data(), x.data() + nLocal_, extended_.data());
+
+        int P = partition_->parts();
+        for (int peer = 0; peer < P; peer++) {
+            if (sendIndices_[peer].empty()) continue;
+            int count = sendIndices_[peer].size();
+            for (int k = 0; k < count; k++) {
+                sendBuffer_[k] = x[sendIndices_[peer][k]];
+            }
+            transport_->send(peer, sendBuffer_.data(), count);
+        }
+        transport_->publish();
+
+        Vector y(nLocal_);
+        for (int i: interior_) {
+            y[i] = local_.row(i).dot(extended_);
+        }
+
+        for (int peer = 0; peer < P; peer++) {
+            int a = ghostOffsets_[peer], b = ghostOffsets_[peer + 1];
+            if (a == b) continue;
+            transport_->receive(peer, extended_.data() + nLocal_ + a, b - a);
+        }
+
+        for (int i: boundary_) {
+            y[i] = local_.row(i).dot(extended_);
+        }
+
+        transport_->finish();
+        return y;
+    }
+};
+
+}
+
+#endif /* ZOP_DISTRIBUTED_MATRIX_H */
@@ -0,0 +1,353 @@
+#ifndef ZOP_DYNAMIC_SPARSE_MATRIX_H
+#define ZOP_DYNAMIC_SPARSE_MATRIX_H
+
+/**
+ *  \file DynamicSparseMatrix.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains a sparse matrix that supports updates of single
+ *  entries while keeping most of its entries in CSR form.
+ */
+
+#include <map>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <vector>
+#include <cassert>
+#include <algorithm>
+
+#include <Vector.h>
+#include <Kernels.h>
+#include <SparseMatrix.h>
+
+namespace zop {
+
+/**
+ * A sparse matrix that combines a compacted CSR base with a small sorted
+ * delta of recent changes, in the manner of a log-structured merge tree.
+ *
+ * Setting or removing an entry only touches the delta, in O(log d) time for
+ * a delta of d entries. Lookups, row iteration and products see the base
+ * and the delta together, with the delta taking precedence. Once the delta
+ * grows past the merge threshold, it is frozen and merged with the base
+ * into a new base by a background task, while a fresh delta collects
+ * further changes. Until the merge is done, reads consult the fresh delta,
+ * then the frozen one, then the old base; the new base is installed by the
+ * first operation that finds the merge finished. Readers never wait for a
+ * merge, and only compact() blocks on one.
+ *
+ * The base and frozen delta are immutable and shared with the merge task,
+ * so the matrix needs no locks. As with the standard containers, calls on
+ * one matrix from several threads must be synchronized by the caller.
+ */
+class DynamicSparseMatrix {
+private:
+    // A change to an entry: its new value, or its removal.
+    struct Update {
+        double value;
+        bool removed;
+    };
+    using Delta = std::map<std::pair<int, int>, Update>;
+
+    int nRows_ = 0;
+    int nCols_ = 0;
+    int nnz_ = 0;
+    int mergeThreshold_;
+    int merges_ = 0;
+    std::shared_ptr<const CSRSparseMatrix> base_;
+    std::shared_ptr<const Delta> frozen_;
+    Delta delta_;
+    std::future<std::shared_ptr<const CSRSparseMatrix>> merge_;
+
+    static int defaultThreshold(int nnz) {
+        return std::max(1024, nnz / 16);
+    }
+
+    /**
+     * Return the position of (i, j) among the stored entries of the base,
+     * or -1 if it is not stored.
+     */
+    int find(int i, int j) const {
+        const int *cols = base_->columnIndices().data();
+        const int *first = cols + base_->rowIndices()[i], *last = cols + base_->rowIndices()[i + 1];
+        const int *it = std::lower_bound(first, last, j);
+        return it != last && *it == j ? it - cols: -1;
+    }
+
+    /**
+     * Look up (i, j) in the frozen delta and the base, ignoring the current
+     * delta. Returns whether the entry is stored, and its value.
+     */
+    bool lookupBelow(int i, int j, double &value) const {
+        if (frozen_) {
+            auto it = frozen_->find({i, j});
+            if (it != frozen_->end()) {
+                value = it->second.removed ? 0.0: it->second.value;
+                return !it->second.removed;
+            }
+        }
+        int k = find(i, j);
+        value = k >= 0 ? base_->values()[k]: 0.0;
+        return k >= 0;
+    }
+
+    bool lookup(int i, int j, double &value) const {
+        auto it = delta_.find({i, j});
+        if (it != delta_.end()) {
+            value = it->second.removed ? 0.0: it->second.value;
+            return !it->second.removed;
+        }
+        return lookupBelow(i, j, value);
+    }
+
+    /**
+     * Return the matrix holding the entries of the base with the changes of
+     * the delta applied. This reads both in order, in O(nnz + d) time.
+     */
+    static std::shared_ptr<const CSRSparseMatrix> merged(const CSRSparseMatrix &base, const Delta &delta) {
+        int M = base.nRows();
+        std::vector<int> rows(M + 1, 0), cols;
+        std::vector<double> vals;
+        cols.reserve(base.nnz() + delta.size());
+        vals.reserve(base.nnz() + delta.size());
+        const int *br = base.rowIndices().data(), *bc = base.columnIndices().data();
+        const double *bv = base.values().data();
+        auto it = delta.begin();
+        for (int i = 0; i < M; i++) {
+            int k = br[i];
+            while (k < br[i + 1] || (it != delta.end() && it->first.first == i)) {
+                bool fromDelta = it != delta.end() && it->first.first == i
+                                 && (k == br[i + 1] || it->first.second <= bc[k]);
+                if (!fromDelta) {
+                    cols.push_back(bc[k]);
+                    vals.push_back(bv[k++]);
+                    continue;
+                }
+                if (k < br[i + 1] && bc[k] == it->first.second) k++;
+                if (!it->second.removed) {
+                    cols.push_back(it->first.second);
+                    vals.push_back(it->second.value);
+                }
+                ++it;
+            }
+            rows[i + 1] = cols.size();
+        }
+        return std::make_shared<const CSRSparseMatrix>(base.nRows(), base.nCols(), std::move(rows),
+                                                       std::move(cols), std::move(vals));
+    }
+
+    /**
+     * Install the result of a finished merge. If wait is true, wait for a
+     * running merge first.
+     */
+    void collect(bool wait) {
+        if (!merge_.valid()) return;
+        if (!wait && merge_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+        base_ = merge_.get();
+        frozen_.reset();
+        merges_++;
+    }
+
+    void update(int i, int j, Update u) {
+        assert(0 <= i && i < nRows_);
+        assert(0 <= j && j < nCols_);
+        collect(false);
+        double old;
+        nnz_ += (int) !u.removed - (int) lookup(i, j, old);
+        delta_[{i, j}] = u;
+        if ((int) delta_.size() >= mergeThreshold_ && !merge_.valid()) merge();
+    }
+
+public:
+
+    DynamicSparseMatrix(int nRows, int nCols):
+        DynamicSparseMatrix(CSRSparseMatrix(nRows, nCols, std::vector<int>(nRows + 1, 0), {}, {})) {}
+
+    explicit DynamicSparseMatrix(CSRSparseMatrix base):
+        nRows_{base.nRows()},
+        nCols_{base.nCols()},
+        nnz_{base.nnz()},
+        mergeThreshold_{defaultThreshold(base.nnz())},
+        base_{std::make_shared<const CSRSparseMatrix>(std::move(base))} {}
+
+    DynamicSparseMatrix(DynamicSparseMatrix &&) = default;
+    DynamicSparseMatrix& operator=(DynamicSparseMatrix &&) = default;
+
+    ~DynamicSparseMatrix() {
+        if (merge_.valid()) merge_.wait();
+    }
+
+    int nRows() const { return nRows_; }
+    int nCols() const { return nCols_; }
+    int nnz() const { return nnz_; }
+
+    /**
+     * Return the number of merges installed so far.
+     */
+    int merges() const { return merges_; }
+
+    /**
+     * Return the number of changes that are not part of the base.
+     */
+    int pendingUpdates() const {
+        return delta_.size() + (frozen_ ? frozen_->size(): 0);
+    }
+
+    /**
+     * Set the number of changes after which the delta is merged into the
+     * base. By default this is 1/16 of the entries, and at least 1024.
+     */
+    void setMergeThreshold(int threshold) {
+        mergeThreshold_ = std::max(1, threshold);
+    }
+
+    /**
+     * Set the entry (i, j). Setting an entry to zero removes it.
+     */
+    void setEntry(int i, int j, double v) {
+        update(i, j, {v, v == 0.0});
+    }
+
+    void removeEntry(int i, int j) {
+        update(i, j, {0.0, true});
+    }
+
+    double getEntry(int i, int j) const {
+        assert(0 <= i && i < nRows_);
+        assert(0 <= j && j < nCols_);
+        double value;
+        lookup(i, j, value);
+        return value;
+    }
+
+    /**
+     * Call f(j, v) for the stored entries of row i in increasing order of
+     * column, merging the base with the frozen and current deltas.
+     */
+    template <class F>
+    void forEachInRow(int i, F &&f) const {
+        assert(0 <= i && i < nRows_);
+        const int *cols = base_->columnIndices().data();
+        const double *vals = base_->values().data();
+        int k = base_->rowIndices()[i], end = base_->rowIndices()[i + 1];
+        Delta::const_iterator fi, fe, di = delta_.lower_bound({i, 0}), de = delta_.lower_bound({i + 1, 0});
+        if (frozen_) {
+            fi = frozen_->lower_bound({i, 0});
+            fe = frozen_->lower_bound({i + 1, 0});
+        }
+        bool hasFrozen = (bool) frozen_;
+        const int none = nCols_;
+        while (true) {
+            int cb = k < end ? cols[k]: none;
+            int cf = hasFrozen && fi != fe ? fi->first.second: none;
+            int cd = di != de ? di->first.second: none;
+            int j = std::min(cb, std::min(cf, cd));
+            if (j == none) return;
+            // The newest layer that holds column j decides.
+            if (cd == j) {
+                if (!di->second.removed) f(j, di->second.value);
+            } else if (cf == j) {
+                if (!fi->second.removed) f(j, fi->second.value);
+            } else {
+                f(j, vals[k]);
+            }
+            if (cb == j) k++;
+            if (cf == j) ++fi;
+            if (cd == j) ++di;
+        }
+    }
+
+    /**
+     * Start merging the current delta into the base in the background, if
+     * there are changes and no merge is running.
+     */
+    void merge() {
+        collect(false);
+        if (merge_.valid() || delta_.empty()) return;
+        frozen_ = std::make_shared<const Delta>(std::move(delta_));
+        delta_.clear();
+        std::shared_ptr<const CSRSparseMatrix> base = base_;
+        std::shared_ptr<const Delta> frozen = frozen_;
+        merge_ = std::async(std::launch::async, [base, frozen] { return merged(*base, *frozen); });
+    }
+
+    /**
+     * Merge all changes into the base, waiting for a running merge.
+     */
+    void compact() {
+        collect(true);
+        if (delta_.empty()) return;
+        base_ = merged(*base_, delta_);
+        delta_.clear();
+        merges_++;
+    }
+
+    /**
+     * Return the current contents as a CSR matrix.
+     */
+    CSRSparseMatrix toCSR() const {
+        std::vector<int> rows(nRows_ + 1, 0), cols;
+        std::vector<double> vals;
+        cols.reserve(nnz_);
+        vals.reserve(nnz_);
+        for (int i = 0; i < nRows_; i++) {
+            forEachInRow(i, [&](int j, double v) {
+                cols.push_back(j);
+                vals.push_back(v);
+            });
+            rows[i + 1] = cols.size();
+        }
+        return CSRSparseMatrix(nRows_, nCols_, std::move(rows), std::move(cols), std::move(vals));
+    }
+
+    /**
+     * y = αAx + βy. Rows are split across threads as in the CSR kernel.
+     * A row without pending changes is read from the base alone, and a row
+     * with changes is merged with them as by forEachInRow, so every entry
+     * is applied with its current value and each row costs one lookup in
+     * the deltas to find the next changed row.
+     */
+    void multiply(const Vector &x, Vector &y, double alpha = 1.0, double beta = 0.0) const {
+        detail::checkOutput(x, y, nCols_, nRows_);
+        ZOP_INSTRUMENT("spmv.dynamic", 2.0 * nnz_, 12.0 * base_->nnz() + 4.0 * nRows_ + 8.0 * (x.dim() + y.dim()));
+        const int *offsets = base_->rowIndices().data();
+        const int *cols = base_->columnIndices().data();
+        const double *vals = base_->values().data();
+        const double *px = x.data();
+        double *py = y.data();
+
+        // Return the first row at or after i with a change in the delta.
+        auto nextChanged = [&](const Delta *delta, int i) {
+            if (!delta) return nRows_;
+            auto it = delta->lower_bound({i, 0});
+            return it == delta->end() ? nRows_: it->first.first;
+        };
+        parallel::forEachThread([&](int t, int n) {
+            auto [a, b] = parallel::balancedRange(offsets, nRows_, t, n);
+            int nextDelta = nextChanged(&delta_, a), nextFrozen = nextChanged(frozen_.get(), a);
+            for (int i = a; i < b; i++) {
+                double acc = 0.0;
+                if (i == nextDelta || i == nextFrozen) {
+                    forEachInRow(i, [&](int j, double v) { acc += v * px[j]; });
+                    if (i == nextDelta) nextDelta = nextChanged(&delta_, i + 1);
+                    if (i == nextFrozen) nextFrozen = nextChanged(frozen_.get(), i + 1);
+                } else {
+                    for (int k = offsets[i]; k < offsets[i + 1]; k++) acc += vals[k] * px[cols[k]];
+                }
+                py[i] = detail::scaled(acc, alpha, beta, py[i]);
+            }
+        });
+    }
+
+    Vector operator*(const Vector &x) const {
+        if (x.dim() != nCols_) throw DimensionMismatchException{};
+        Vector y(nRows_);
+        multiply(x, y);
+        return y;
+    }
+};
+
+}
+
+#endif /* ZOP_DYNAMIC_SPARSE_MATRIX_H */
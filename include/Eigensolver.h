@@ -0,0 +1,929 @@
+#ifndef ZOP_EIGENSOLVER_H
+#define ZOP_EIGENSOLVER_H
+
+/**
+ *  \file Eigensolver.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains Krylov subspace eigensolvers for sparse matrices.
+ */
+
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <random>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+
+#include <Vector.h>
+#include <SparseMatrix.h>
+#include <Parallel.h>
+#include <QR.h>
+
+namespace zop::eigen {
+
+/**
+ * The part of the spectrum that is computed. Algebraic orderings compare
+ * the real parts of complex eigenvalues.
+ */
+enum class Spectrum { LargestMagnitude, LargestAlgebraic, SmallestAlgebraic };
+
+struct Options {
+    Spectrum which = Spectrum::LargestAlgebraic;
+
+    /**
+     * The maximum dimension of the Krylov subspace, or zero to choose it
+     * from the number of requested eigenvalues.
+     */
+    int subspace = 0;
+
+    /**
+     * The number of vectors multiplied by the matrix at once. Only the
+     * Lanczos solver has a block variant; arnoldi() throws for a block
+     * size above 1.
+     */
+    int blockSize = 1;
+
+    /**
+     * A Ritz pair (θ, x) is accepted once ||Ax - θx|| <= tolerance * |θ|.
+     */
+    double tolerance = 1e-10;
+    int maxRestarts = 1000;
+    unsigned seed = 1;
+};
+
+struct SymmetricEigenpairs {
+    std::vector<double> values;
+    std::vector<Vector> vectors;
+    int restarts = 0;
+};
+
+/**
+ * The eigenpairs of a non-symmetric matrix. As in LAPACK, the eigenvectors
+ * of a complex conjugate pair λ, conj(λ) are stored in two consecutive
+ * real vectors: the real part at the position of the eigenvalue with a
+ * positive imaginary part, followed by the imaginary part.
+ */
+struct Eigenpairs {
+    std::vector<std::complex<double>> values;
+    std::vector<Vector> vectors;
+    int restarts = 0;
+};
+
+namespace detail {
+
+    using Complex = std::complex<double>;
+
+    /**
+     * Y = AX, where X and Y hold b column-major vectors. For b > 1, X is
+     * first packed in row-major order so that every nonzero of A is read
+     * once and applied to all b vectors.
+     */
+    inline void multiply(const CSRSparseMatrix &A, const double *X, double *Y, int b) {
+        int n = A.nRows();
+        const int *rows = A.rowIndices().data();
+        const int *cols = A.columnIndices().data();
+        const double *values = A.values().data();
+        if (b == 1) {
+            parallel::forEachThread([&](int t, int nThreads) {
+                auto [lo, hi] = parallel::balancedRange(rows, n, t, nThreads);
+                for (int i = lo; i < hi; i++) {
+                    double acc = 0.0;
+                    for (int k = rows[i]; k < rows[i + 1]; k++) {
+                        acc += values[k] * X[cols[k]];
+                    }
+                    Y[i] = acc;
+                }
+            });
+            return;
+        }
+
+        std::vector<double> packed((size_t) A.nCols() * b);
+        parallel::parallelForRange(0, A.nCols(), [&](int lo, int hi) {
+            for (int j = lo; j < hi; j++) {
+                for (int c = 0; c < b; c++) packed[(size_t) j * b + c] = X[j + (size_t) c * A.nCols()];
+            }
+        });
+        parallel::forEachThread([&](int t, int nThreads) {
+            auto [lo, hi] = parallel::balancedRange(rows, n, t, nThreads);
+            std::vector<double> acc(b);
+            for (int i = lo; i < hi; i++) {
+                std::fill(acc.begin(), acc.end(), 0.0);
+                for (int k = rows[i]; k < rows[i + 1]; k++) {
+                    const double *x = packed.data() + (size_t) cols[k] * b;
+                    for (int c = 0; c < b; c++) acc[c] += values[k] * x[c];
+                }
+                for (int c = 0; c < b; c++) Y[i + (size_t) c * n] = acc[c];
+            }
+        });
+    }
+
+    /**
+     * h = Vᵀw, where V holds `cols` column-major vectors of length n.
+     */
+    inline void project(const double *V, int n, int cols, const double *w, double *h) {
+        int T = parallel::threadCount();
+        std::vector<double> partial((size_t) T * cols, 0.0);
+        parallel::forEachThread([&](int t, int nThreads) {
+            auto [lo, hi] = parallel::blockRange(0, n, t, nThreads);
+            double *out = partial.data() + (size_t) t * cols;
+            for (int j = 0; j < cols; j++) {
+                const double *v = V + (size_t) j * n;
+                double acc = 0.0;
+                for (int i = lo; i < hi; i++) acc += v[i] * w[i];
+                out[j] = acc;
+            }
+        });
+        for (int j = 0; j < cols; j++) {
+            double acc = 0.0;
+            for (int t = 0; t < T; t++) acc += partial[(size_t) t * cols + j];
+            h[j] = acc;
+        }
+    }
+
+    /**
+     * w -= Vh
+     */
+    inline void subtract(const double *V, int n, int cols, const double *h, double *w) {
+        parallel::parallelForRange(0, n, [&](int lo, int hi) {
+            for (int j = 0; j < cols; j++) {
+                const double *v = V + (size_t) j * n;
+                for (int i = lo; i < hi; i++) w[i] -= v[i] * h[j];
+            }
+        });
+    }
+
+    inline double norm(const double *w, int n) {
+        double res;
+        project(w, n, 1, w, &res);
+        return std::sqrt(res);
+    }
+
+    /**
+     * Orthogonalize w against the first `cols` columns of V with two passes
+     * of classical Gram-Schmidt, which is as accurate as modified
+     * Gram-Schmidt but parallelizes as two matrix-vector products per pass.
+     * The coefficients are accumulated in h. Returns the norm of w.
+     */
+    inline double orthogonalize(const double *V, int n, int cols, double *w, double *h) {
+        std::fill(h, h + cols, 0.0);
+        std::vector<double> g(cols);
+        for (int pass = 0; pass < 2 && cols > 0; pass++) {
+            project(V, n, cols, w, g.data());
+            subtract(V, n, cols, g.data(), w);
+            for (int j = 0; j < cols; j++) h[j] += g[j];
+        }
+        return norm(w, n);
+    }
+
+    /**
+     * Store a random unit vector orthogonal to the first `cols` columns of
+     * V in w. Returns false if these columns already span the whole space.
+     */
+    inline bool randomDirection(const double *V, int n, int cols, double *w, std::mt19937 &gen) {
+        std::normal_distribution<double> dist;
+        std::vector<double> h(cols);
+        for (int attempt = 0; attempt < 3 && cols < n; attempt++) {
+            for (int i = 0; i < n; i++) w[i] = dist(gen);
+            double before = norm(w, n);
+            double after = orthogonalize(V, n, cols, w, h.data());
+            if (after > 1e-8 * before) {
+                for (int i = 0; i < n; i++) w[i] /= after;
+                return true;
+            }
+        }
+        std::fill(w, w + n, 0.0);
+        return false;
+    }
+
+    /**
+     * Y = VS(:, cols), a linear combination of the basis vectors for every
+     * selected column of the m x m column-major matrix S.
+     */
+    inline std::vector<double> combine(const double *V, int n, int m, const double *S, int ldS,
+                                       const std::vector<int> &cols) {
+        int l = cols.size();
+        std::vector<double> Y((size_t) n * l, 0.0);
+        parallel::parallelForRange(0, n, [&](int lo, int hi) {
+            for (int c = 0; c < l; c++) {
+                double *y = Y.data() + (size_t) c * n;
+                for (int q = 0; q < m; q++) {
+                    double s = S[q + (size_t) cols[c] * ldS];
+                    if (s == 0.0) continue;
+                    const double *v = V + (size_t) q * n;
+                    for (int i = lo; i < hi; i++) y[i] += v[i] * s;
+                }
+            }
+        });
+        return Y;
+    }
+
+    /**
+     * Compute the eigenvalues d and eigenvectors Z of the symmetric
+     * tridiagonal matrix with diagonal d and off-diagonal e, where e[i]
+     * couples i and i + 1, using the implicit QL algorithm with Wilkinson
+     * shifts. Z must hold an m x m orthogonal matrix Q on entry, and holds
+     * QZ on exit.
+     */
+    inline void tridiagonalEigen(std::vector<double> &d, std::vector<double> &e, std::vector<double> &Z, int m) {
+        const double eps = std::numeric_limits<double>::epsilon();
+        if (m > 0) e[m - 1] = 0.0;
+        for (int l = 0; l < m; l++) {
+            int iterations = 0;
+            int s;
+            do {
+                for (s = l; s < m - 1; s++) {
+                    double dd = std::abs(d[s]) + std::abs(d[s + 1]);
+                    if (std::abs(e[s]) <= eps * dd) break;
+                }
+                if (s == l) break;
+                if (iterations++ == 60) {
+                    throw std::runtime_error("tridiagonal eigensolver did not converge");
+                }
+                double g = (d[l + 1] - d[l]) / (2.0 * e[l]);
+                double r = std::hypot(g, 1.0);
+                g = d[s] - d[l] + e[l] / (g + std::copysign(r, g));
+                double sn = 1.0, c = 1.0, p = 0.0;
+                int i;
+                for (i = s - 1; i >= l; i--) {
+                    double f = sn * e[i];
+                    double b = c * e[i];
+                    r = std::hypot(f, g);
+                    e[i + 1] = r;
+                    if (r == 0.0) {
+                        d[i + 1] -= p;
+                        e[s] = 0.0;
+                        break;
+                    }
+                    sn = f / r;
+                    c = g / r;
+                    g = d[i + 1] - p;
+                    r = (d[i] - g) * sn + 2.0 * c * b;
+                    p = sn * r;
+                    d[i + 1] = g + p;
+                    g = c * r - b;
+                    for (int k = 0; k < m; k++) {
+                        double *zi = &Z[k + (size_t) i * m];
+                        double *zj = &Z[k + (size_t) (i + 1) * m];
+                        f = *zj;
+                        *zj = sn * *zi + c * f;
+                        *zi = c * *zi - sn * f;
+                    }
+                }
+                if (r == 0.0 && i >= l) continue;
+                d[l] -= p;
+                e[l] = g;
+                e[s] = 0.0;
+            } while (true);
+        }
+    }
+
+    /**
+     * Compute the eigenvalues and eigenvectors of the symmetric m x m
+     * column-major matrix A. A is reduced to tridiagonal form with
+     * Householder reflections, which are accumulated and then overwritten
+     * with the eigenvectors.
+     */
+    inline std::vector<double> symmetricEigen(std::vector<double> &A, int m) {
+        auto a = [&](int i, int j) -> double& { return A[i + (size_t) j * m]; };
+        std::vector<double> Q((size_t) m * m, 0.0);
+        for (int i = 0; i < m; i++) Q[i + (size_t) i * m] = 1.0;
+        std::vector<double> v(m), p(m);
+
+        for (int k = 0; k + 2 < m; k++) {
+            double alpha = a(k + 1, k);
+            double sigma = 0.0;
+            for (int i = k + 2; i < m; i++) sigma += a(i, k) * a(i, k);
+            if (sigma == 0.0) continue;
+            double beta = -std::copysign(std::sqrt(alpha * alpha + sigma), alpha);
+            double tau = (beta - alpha) / beta;
+            v[k + 1] = 1.0;
+            for (int i = k + 2; i < m; i++) v[i] = a(i, k) / (alpha - beta);
+
+            // A := HAH with H = I - τvvᵀ on the trailing block.
+            double K = 0.0;
+            for (int i = k + 1; i < m; i++) {
+                double acc = 0.0;
+                for (int j = k + 1; j < m; j++) acc += a(i, j) * v[j];
+                p[i] = tau * acc;
+                K += p[i] * v[i];
+            }
+            K *= 0.5 * tau;
+            for (int i = k + 1; i < m; i++) p[i] -= K * v[i];
+            for (int j = k + 1; j < m; j++) {
+                for (int i = k + 1; i < m; i++) {
+                    a(i, j) -= v[i] * p[j] + p[i] * v[j];
+                }
+            }
+            a(k + 1, k) = a(k, k + 1) = beta;
+            for (int i = k + 2; i < m; i++) a(i, k) = a(k, i) = 0.0;
+
+            for (int r = 0; r < m; r++) {
+                double acc = 0.0;
+                for (int i = k + 1; i < m; i++) acc += Q[r + (size_t) i * m] * v[i];
+                acc *= tau;
+                for (int i = k + 1; i < m; i++) Q[r + (size_t) i * m] -= acc * v[i];
+            }
+        }
+
+        std::vector<double> d(m), e(m, 0.0);
+        for (int i = 0; i < m; i++) {
+            d[i] = a(i, i);
+            if (i + 1 < m) e[i] = a(i + 1, i);
+        }
+        tridiagonalEigen(d, e, Q, m);
+        A = std::move(Q);
+        return d;
+    }
+
+    /**
+     * Compute the eigenvalues of the upper Hessenberg m x m column-major
+     * matrix H (which is destroyed) with the Francis double-shift QR
+     * algorithm. Complex conjugate pairs are returned next to each other.
+     */
+    inline std::vector<Complex> hessenbergEigenvalues(std::vector<double> H, int m) {
+        auto a = [&](int i, int j) -> double& { return H[i + (size_t) j * m]; };
+        std::vector<Complex> res(m);
+        double anorm = 0.0;
+        for (int i = 0; i < m; i++) {
+            for (int j = std::max(i - 1, 0); j < m; j++) anorm += std::abs(a(i, j));
+        }
+
+        int nn = m - 1;
+        double t = 0.0;
+        while (nn >= 0) {
+            int iterations = 0;
+            int l;
+            do {
+                for (l = nn; l >= 1; l--) {
+                    double s = std::abs(a(l - 1, l - 1)) + std::abs(a(l, l));
+                    if (s == 0.0) s = anorm;
+                    if (std::abs(a(l, l - 1)) + s == s) {
+                        a(l, l - 1) = 0.0;
+                        break;
+                    }
+                }
+                double x = a(nn, nn);
+                if (l == nn) {
+                    res[nn--] = x + t;
+                    break;
+                }
+                double y = a(nn - 1, nn - 1);
+                double w = a(nn, nn - 1) * a(nn - 1, nn);
+                if (l == nn - 1) {
+                    double p = 0.5 * (y - x);
+                    double q = p * p + w;
+                    double z = std::sqrt(std::abs(q));
+                    x += t;
+                    if (q >= 0.0) {
+                        z = p + std::copysign(z, p);
+                        res[nn - 1] = res[nn] = x + z;
+                        if (z != 0.0) res[nn] = x - w / z;
+                    } else {
+                        res[nn - 1] = Complex(x + p, z);
+                        res[nn] = Complex(x + p, -z);
+                    }
+                    nn -= 2;
+                    break;
+                }
+
+                if (iterations == 60) {
+                    throw std::runtime_error("hessenberg eigensolver did not converge");
+                }
+                if (iterations == 10 || iterations == 20) {
+                    // exceptional shift
+                    t += x;
+                    for (int i = 0; i <= nn; i++) a(i, i) -= x;
+                    double s = std::abs(a(nn, nn - 1)) + std::abs(a(nn - 1, nn - 2));
+                    y = x = 0.75 * s;
+                    w = -0.4375 * s * s;
+                }
+                iterations++;
+
+                int r0;
+                double p = 0, q = 0, r = 0, z;
+                for (r0 = nn - 2; r0 >= l; r0--) {
+                    z = a(r0, r0);
+                    r = x - z;
+                    double s = y - z;
+                    p = (r * s - w) / a(r0 + 1, r0) + a(r0, r0 + 1);
+                    q = a(r0 + 1, r0 + 1) - z - r - s;
+                    r = a(r0 + 2, r0 + 1);
+                    s = std::abs(p) + std::abs(q) + std::abs(r);
+                    p /= s;
+                    q /= s;
+                    r /= s;
+                    if (r0 == l) break;
+                    double u = std::abs(a(r0, r0 - 1)) * (std::abs(q) + std::abs(r));
+                    double v = std::abs(p) * (std::abs(a(r0 - 1, r0 - 1)) + std::abs(z) + std::abs(a(r0 + 1, r0 + 1)));
+                    if (u + v == v) break;
+                }
+                for (int i = r0 + 2; i <= nn; i++) {
+                    a(i, i - 2) = 0.0;
+                    if (i != r0 + 2) a(i, i - 3) = 0.0;
+                }
+                for (int k = r0; k <= nn - 1; k++) {
+                    if (k != r0) {
+                        p = a(k, k - 1);
+                        q = a(k + 1, k - 1);
+                        r = 0.0;
+                        if (k != nn - 1) r = a(k + 2, k - 1);
+                        x = std::abs(p) + std::abs(q) + std::abs(r);
+                        if (x != 0.0) {
+                            p /= x;
+                            q /= x;
+                            r /= x;
+                        }
+                    }
+                    double s = std::copysign(std::sqrt(p * p + q * q + r * r), p);
+                    if (s == 0.0) continue;
+                    if (k == r0) {
+                        if (l != r0) a(k, k - 1) = -a(k, k - 1);
+                    } else {
+                        a(k, k - 1) = -s * x;
+                    }
+                    p += s;
+                    x = p / s;
+                    y = q / s;
+                    z = r / s;
+                    q /= p;
+                    r /= p;
+                    for (int j = k; j <= nn; j++) {
+                        p = a(k, j) + q * a(k + 1, j);
+                        if (k != nn - 1) {
+                            p += r * a(k + 2, j);
+                            a(k + 2, j) -= p * z;
+                        }
+                        a(k + 1, j) -= p * y;
+                        a(k, j) -= p * x;
+                    }
+                    int last = std::min(nn, k + 3);
+                    for (int i = l; i <= last; i++) {
+                        p = x * a(i, k) + y * a(i, k + 1);
+                        if (k != nn - 1) {
+                            p += z * a(i, k + 2);
+                            a(i, k + 2) -= p * r;
+                        }
+                        a(i, k + 1) -= p * q;
+                        a(i, k) -= p;
+                    }
+                }
+            } while (l < nn - 1);
+        }
+        return res;
+    }
+
+    /**
+     * Compute a unit eigenvector of the m x m column-major matrix H for the
+     * eigenvalue λ with two steps of inverse iteration.
+     */
+    inline std::vector<Complex> eigenvector(const std::vector<double> &H, int m, Complex lambda) {
+        double scale = 0.0;
+        for (double h: H) scale = std::max(scale, std::abs(h));
+        double delta = std::max(scale, 1.0) * 1e3 * std::numeric_limits<double>::epsilon();
+        lambda += delta;
+
+        std::vector<Complex> M((size_t) m * m);
+        for (int j = 0; j < m; j++) {
+            for (int i = 0; i < m; i++) M[i + (size_t) j * m] = H[i + (size_t) j * m];
+            M[j + (size_t) j * m] -= lambda;
+        }
+        auto at = [&](int i, int j) -> Complex& { return M[i + (size_t) j * m]; };
+
+        // LU with partial pivoting.
+        std::vector<int> pivot(m);
+        for (int k = 0; k < m; k++) {
+            int p = k;
+            for (int i = k + 1; i < m; i++) {
+                if (std::abs(at(i, k)) > std::abs(at(p, k))) p = i;
+            }
+            pivot[k] = p;
+            if (p != k) {
+                for (int j = 0; j < m; j++) std::swap(at(k, j), at(p, j));
+            }
+            if (at(k, k) == 0.0) at(k, k) = delta;
+            for (int i = k + 1; i < m; i++) {
+                at(i, k) /= at(k, k);
+                for (int j = k + 1; j < m; j++) at(i, j) -= at(i, k) * at(k, j);
+            }
+        }
+
+        std::vector<Complex> y(m, 1.0);
+        for (int iteration = 0; iteration < 2; iteration++) {
+            for (int k = 0; k < m; k++) {
+                std::swap(y[k], y[pivot[k]]);
+                for (int i = k + 1; i < m; i++) y[i] -= at(i, k) * y[k];
+            }
+            for (int k = m - 1; k >= 0; k--) {
+                for (int j = k + 1; j < m; j++) y[k] -= at(k, j) * y[j];
+                y[k] /= at(k, k);
+            }
+            double norm = 0.0;
+            for (auto c: y) norm += std::norm(c);
+            norm = std::sqrt(norm);
+            for (auto &c: y) c /= norm;
+        }
+        return y;
+    }
+
+    inline double key(double value, Spectrum which) {
+        switch (which) {
+        case Spectrum::LargestMagnitude: return std::abs(value);
+        case Spectrum::LargestAlgebraic: return value;
+        default: return -value;
+        }
+    }
+
+    inline double key(Complex value, Spectrum which) {
+        switch (which) {
+        case Spectrum::LargestMagnitude: return std::abs(value);
+        case Spectrum::LargestAlgebraic: return value.real();
+        default: return -value.real();
+        }
+    }
+
+    /**
+     * Return the indices of the values ordered from most to least wanted.
+     * Ties are broken by decreasing imaginary part, which places the member
+     * of a conjugate pair with positive imaginary part first.
+     */
+    template <class T>
+    std::vector<int> order(const std::vector<T> &values, Spectrum which) {
+        std::vector<int> res(values.size());
+        std::iota(res.begin(), res.end(), 0);
+        std::stable_sort(res.begin(), res.end(), [&](int a, int b) {
+            double ka = key(values[a], which);
+            double kb = key(values[b], which);
+            if (ka != kb) return ka > kb;
+            return std::imag(Complex(values[a])) > std::imag(Complex(values[b]));
+        });
+        return res;
+    }
+
+    inline bool accepted(double residual, double value, const Options &opts) {
+        const double floor = std::pow(std::numeric_limits<double>::epsilon(), 2.0 / 3.0);
+        return residual <= opts.tolerance * std::max(floor, std::abs(value));
+    }
+
+}
+
+/**
+ * Compute k eigenpairs of a symmetric sparse matrix at one end of its
+ * spectrum with the restarted (block) Lanczos method.
+ *
+ * The Krylov basis is fully reorthogonalized, so it stays orthonormal even
+ * after many eigenvalues have converged. When the basis reaches its
+ * maximum size, the method is restarted by keeping the wanted Ritz vectors
+ * and the residual block (a thick restart), which for symmetric matrices is
+ * equivalent to an implicit restart with the unwanted Ritz values as exact
+ * shifts, but needs no shifted QR steps and is numerically more robust.
+ *
+ * With a block size b > 1, b vectors are multiplied by the matrix at once,
+ * so that every nonzero is read once per block. Block methods also find
+ * multiple eigenvalues, which a single-vector Krylov space cannot resolve.
+ *
+ * Small problems, for which the basis would span the whole space, are
+ * solved exactly by the same iteration. Throws if the iteration does not
+ * converge within `maxRestarts` restarts.
+ */
+inline SymmetricEigenpairs lanczos(const CSRSparseMatrix &A, int k, const Options &opts = {}) {
+    if (A.nRows() != A.nCols() || !A.isSymmetric()) {
+        throw std::runtime_error("matrix must by symmetric");
+    }
+    int n = A.nRows();
+    if (k < 1 || k > n) {
+        throw std::runtime_error("invalid number of eigenvalues");
+    }
+    int b = std::max(1, opts.blockSize);
+    int m = opts.subspace > 0 ? opts.subspace: std::max(2 * k + 2 * b, 20);
+    m = std::max(m, k + b);
+    if (m + b >= n) m = n;
+
+    int capacity = std::min(m + b, n);
+    std::vector<double> V((size_t) n * capacity, 0.0);
+    std::vector<double> T((size_t) capacity * capacity, 0.0);
+    auto t = [&](int i, int j) -> double& { return T[i + (size_t) j * capacity]; };
+    std::vector<double> W, h(capacity);
+    std::mt19937 gen(opts.seed);
+
+    int cols = 0;
+    while (cols < b && detail::randomDirection(V.data(), n, cols, V.data() + (size_t) cols * n, gen)) {
+        cols++;
+    }
+
+    SymmetricEigenpairs res;
+    int active = 0;
+    while (true) {
+        // Multiply the pending block and extend the basis with its
+        // orthonormalized images.
+        while (active < cols && cols <= m) {
+            int p = cols - active;
+            W.resize((size_t) n * p);
+            detail::multiply(A, V.data() + (size_t) active * n, W.data(), p);
+            for (int c = 0; c < p; c++) {
+                int j = active + c;
+                double *w = W.data() + (size_t) c * n;
+                double before = detail::norm(w, n);
+                double beta = detail::orthogonalize(V.data(), n, cols, w, h.data());
+                for (int i = 0; i < cols; i++) t(i, j) = t(j, i) = h[i];
+                if (cols == capacity) continue;
+
+                double *v = V.data() + (size_t) cols * n;
+                for (int i = 0; i < capacity; i++) t(i, cols) = t(cols, i) = 0.0;
+                if (beta > 1e-10 * before) {
+                    for (int i = 0; i < n; i++) v[i] = w[i] / beta;
+                    t(cols, j) = t(j, cols) = beta;
+                    cols++;
+                } else if (detail::randomDirection(V.data(), n, cols, v, gen)) {
+                    cols++;
+                }
+            }
+            active += p;
+        }
+
+        // Rayleigh-Ritz on the multiplied part of the basis.
+        std::vector<double> S((size_t) active * active);
+        for (int j = 0; j < active; j++) {
+            for (int i = 0; i < active; i++) S[i + (size_t) j * active] = t(i, j);
+        }
+        std::vector<double> theta = detail::symmetricEigen(S, active);
+        std::vector<int> wanted = detail::order(theta, opts.which);
+
+        bool converged = true;
+        for (int i = 0; i < k && converged; i++) {
+            double residual = 0.0;
+            for (int r = active; r < cols; r++) {
+                double acc = 0.0;
+                for (int q = 0; q < active; q++) acc += t(r, q) * S[q + (size_t) wanted[i] * active];
+                residual += acc * acc;
+            }
+            converged = detail::accepted(std::sqrt(residual), theta[wanted[i]], opts);
+        }
+
+        if (converged || res.restarts == opts.maxRestarts) {
+            if (!converged) {
+                throw std::runtime_error("eigensolver did not converge");
+            }
+            wanted.resize(k);
+            std::vector<double> X = detail::combine(V.data(), n, active, S.data(), active, wanted);
+            for (int i = 0; i < k; i++) {
+                res.values.push_back(theta[wanted[i]]);
+                Vector x(n);
+                std::copy_n(X.data() + (size_t) i * n, n, x.data());
+                res.vectors.push_back(std::move(x));
+            }
+            return res;
+        }
+
+        // Thick restart: keep the most wanted Ritz vectors followed by the
+        // residual block, whose products with A are still pending.
+        int l = std::min(k + (active - k) / 2, m - b);
+        wanted.resize(l);
+        std::vector<double> Y = detail::combine(V.data(), n, active, S.data(), active, wanted);
+        int pending = cols - active;
+        std::copy_n(V.data() + (size_t) active * n, (size_t) pending * n, V.data() + (size_t) l * n);
+        std::copy(Y.begin(), Y.end(), V.begin());
+        std::fill(T.begin(), T.end(), 0.0);
+        for (int i = 0; i < l; i++) t(i, i) = theta[wanted[i]];
+        active = l;
+        cols = l + pending;
+        res.restarts++;
+    }
+}
+
+/**
+ * Compute k eigenpairs of a non-symmetric sparse matrix at one end of its
+ * spectrum with the implicitly restarted Arnoldi method of Sorensen.
+ *
+ * An Arnoldi factorization AV = VH + feᵀ of size m is built with full
+ * reorthogonalization. At every restart, the m - k unwanted Ritz values
+ * are applied as shifts to H with QR steps: real shifts with a single
+ * Givens sweep and complex conjugate pairs with one double-shift step in
+ * real arithmetic. This compresses the factorization to size k while
+ * filtering the unwanted directions out of the starting vector, without
+ * any further products with A.
+ *
+ * If the k-th wanted eigenvalue is a member of a complex conjugate pair,
+ * its partner is returned as well, so k + 1 eigenpairs may be returned.
+ * Throws if the iteration does not converge within `maxRestarts` restarts.
+ *
+ * The shifted QR steps of the implicit restart act on a Hessenberg
+ * matrix, which a block Arnoldi factorization does not produce, so there
+ * is no block variant and a block size above 1 throws rather than being
+ * ignored.
+ */
+inline Eigenpairs arnoldi(const CSRSparseMatrix &A, int k, const Options &opts = {}) {
+    using detail::Complex;
+    if (A.nRows() != A.nCols()) {
+        throw std::runtime_error("matrix must be square");
+    }
+    if (opts.blockSize > 1) {
+        throw std::runtime_error("arnoldi has no block variant");
+    }
+    int n = A.nRows();
+    if (k < 1 || k > n) {
+        throw std::runtime_error("invalid number of eigenvalues");
+    }
+    int m = opts.subspace > 0 ? opts.subspace: std::max(2 * k + 1, 20);
+    m = std::max(m, k + 2);
+    if (m + 1 >= n) m = n;
+
+    // V holds m + 1 basis vectors and H is (m + 1) x m.
+    int ld = m + 1;
+    std::vector<double> V((size_t) n * (m + 1), 0.0);
+    std::vector<double> H((size_t) ld * m, 0.0);
+    auto hAt = [&](int i, int j) -> double& { return H[i + (size_t) j * ld]; };
+    std::vector<double> h(m + 1);
+    std::mt19937 gen(opts.seed);
+    detail::randomDirection(V.data(), n, 0, V.data(), gen);
+
+    Eigenpairs res;
+    int start = 0;
+    while (true) {
+        for (int j = start; j < m; j++) {
+            double *w = V.data() + (size_t) (j + 1) * n;
+            detail::multiply(A, V.data() + (size_t) j * n, w, 1);
+            double before = detail::norm(w, n);
+            double beta = detail::orthogonalize(V.data(), n, j + 1, w, h.data());
+            for (int i = 0; i <= j; i++) hAt(i, j) = h[i];
+            hAt(j + 1, j) = 0.0;
+            if (j + 1 == n) {
+                std::fill(w, w + n, 0.0);
+            } else if (beta > 1e-10 * before) {
+                for (int i = 0; i < n; i++) w[i] /= beta;
+                hAt(j + 1, j) = beta;
+            } else {
+                detail::randomDirection(V.data(), n, j + 1, w, gen);
+            }
+        }
+
+        std::vector<double> Hm((size_t) m * m);
+        for (int j = 0; j < m; j++) {
+            for (int i = 0; i < m; i++) Hm[i + (size_t) j * m] = hAt(i, j);
+        }
+        std::vector<Complex> theta = detail::hessenbergEigenvalues(Hm, m);
+        std::vector<int> wanted = detail::order(theta, opts.which);
+        int kk = k;
+        if (kk < m && theta[wanted[kk - 1]].imag() > 0.0) kk++;
+
+        double beta = hAt(m, m - 1);
+        std::vector<std::vector<Complex>> Y;
+        bool converged = true;
+        for (int i = 0; i < kk && converged; i++) {
+            Y.push_back(detail::eigenvector(Hm, m, theta[wanted[i]]));
+            double residual = std::abs(beta) * std::abs(Y.back()[m - 1]);
+            converged = detail::accepted(residual, std::abs(theta[wanted[i]]), opts);
+        }
+
+        if (converged || res.restarts == opts.maxRestarts) {
+            if (!converged) {
+                throw std::runtime_error("eigensolver did not converge");
+            }
+            // Ritz vectors: the real and imaginary parts of VY.
+            std::vector<double> parts((size_t) m * 2 * kk);
+            std::vector<int> cols(2 * kk);
+            for (int i = 0; i < kk; i++) {
+                for (int q = 0; q < m; q++) {
+                    parts[q + (size_t) (2 * i) * m] = Y[i][q].real();
+                    parts[q + (size_t) (2 * i + 1) * m] = Y[i][q].imag();
+                }
+                cols[2 * i] = 2 * i;
+                cols[2 * i + 1] = 2 * i + 1;
+            }
+            std::vector<double> X = detail::combine(V.data(), n, m, parts.data(), m, cols);
+            for (int i = 0; i < kk; i++) {
+                Complex lambda = theta[wanted[i]];
+                res.values.push_back(lambda);
+                int part = 2 * i;
+                if (lambda.imag() < 0.0) {
+                    // the imaginary part of the partner's eigenvector
+                    part = 2 * (i - 1) + 1;
+                }
+                Vector x(n);
+                std::copy_n(X.data() + (size_t) part * n, n, x.data());
+                res.vectors.push_back(std::move(x));
+            }
+            return res;
+        }
+
+        // Apply the unwanted Ritz values as shifts. Q accumulates the
+        // orthogonal transformations.
+        std::vector<double> Q((size_t) m * m, 0.0);
+        for (int i = 0; i < m; i++) Q[i + (size_t) i * m] = 1.0;
+        auto q = [&](int i, int j) -> double& { return Q[i + (size_t) j * m]; };
+        auto hm = [&](int i, int j) -> double& { return Hm[i + (size_t) j * m]; };
+        for (int j = 0; j < m; j++) {
+            for (int i = 0; i < m; i++) hm(i, j) = hAt(i, j);
+        }
+
+        for (int s = kk; s < m; s++) {
+            Complex mu = theta[wanted[s]];
+            if (mu.imag() < 0.0) continue;
+            if (mu.imag() == 0.0) {
+                // H - μI = QR, H := RQ + μI with Givens rotations.
+                std::vector<double> cs(m - 1), sn(m - 1);
+                for (int i = 0; i < m; i++) hm(i, i) -= mu.real();
+                for (int i = 0; i + 1 < m; i++) {
+                    double a = hm(i, i), c = hm(i + 1, i);
+                    double r = std::hypot(a, c);
+                    cs[i] = r == 0.0 ? 1.0: a / r;
+                    sn[i] = r == 0.0 ? 0.0: c / r;
+                    for (int j = 0; j < m; j++) {
+                        double t1 = hm(i, j), t2 = hm(i + 1, j);
+                        hm(i, j) = cs[i] * t1 + sn[i] * t2;
+                        hm(i + 1, j) = -sn[i] * t1 + cs[i] * t2;
+                    }
+                }
+                for (int i = 0; i + 1 < m; i++) {
+                    for (int r = 0; r < m; r++) {
+                        double t1 = hm(r, i), t2 = hm(r, i + 1);
+                        hm(r, i) = cs[i] * t1 + sn[i] * t2;
+                        hm(r, i + 1) = -sn[i] * t1 + cs[i] * t2;
+                        t1 = q(r, i);
+                        t2 = q(r, i + 1);
+                        q(r, i) = cs[i] * t1 + sn[i] * t2;
+                        q(r, i + 1) = -sn[i] * t1 + cs[i] * t2;
+                    }
+                }
+                for (int i = 0; i < m; i++) hm(i, i) += mu.real();
+            } else {
+                // (H - μI)(H - conj(μ)I) = H² - 2Re(μ)H + |μ|²I = QR,
+                // H := QᵀHQ.
+                std::vector<double> M((size_t) m * m, 0.0);
+                for (int j = 0; j < m; j++) {
+                    for (int l = 0; l < m; l++) {
+                        double hlj = hm(l, j);
+                        if (hlj == 0.0) continue;
+                        for (int i = 0; i < m; i++) M[i + (size_t) j * m] += hm(i, l) * hlj;
+                    }
+                    for (int i = 0; i < m; i++) M[i + (size_t) j * m] -= 2.0 * mu.real() * hm(i, j);
+                    M[j + (size_t) j * m] += std::norm(mu);
+                }
+                HouseholderQR qr(m, m, std::move(M));
+                std::vector<double> Qs((size_t) m * m);
+                for (int j = 0; j < m; j++) {
+                    Vector e(m);
+                    e[j] = 1.0;
+                    Vector col = qr.applyQ(e);
+                    std::copy_n(col.data(), m, Qs.data() + (size_t) j * m);
+                }
+                auto product = [&](const std::vector<double> &X, const std::vector<double> &Y, bool transposeX) {
+                    std::vector<double> Z((size_t) m * m, 0.0);
+                    for (int j = 0; j < m; j++) {
+                        for (int l = 0; l < m; l++) {
+                            double y = Y[l + (size_t) j * m];
+                            if (y == 0.0) continue;
+                            for (int i = 0; i < m; i++) {
+                                double x = transposeX ? X[l + (size_t) i * m]: X[i + (size_t) l * m];
+                                Z[i + (size_t) j * m] += x * y;
+                            }
+                        }
+                    }
+                    return Z;
+                };
+                Hm = product(Qs, product(Hm, Qs, false), true);
+                Q = product(Q, Qs, false);
+                for (int j = 0; j < m; j++) {
+                    for (int i = j + 2; i < m; i++) hm(i, j) = 0.0;
+                }
+            }
+        }
+
+        // Compress the factorization to size kk: V := VQ(:, 0:kk) and
+        // f := v_kk h(kk, kk - 1) + f σ.
+        std::vector<int> cols(kk + 1);
+        std::iota(cols.begin(), cols.end(), 0);
+        std::vector<double> X = detail::combine(V.data(), n, m, Q.data(), m, cols);
+        double sigma = q(m - 1, kk - 1);
+        double *f = X.data() + (size_t) kk * n;
+        const double *residual = V.data() + (size_t) m * n;
+        for (int i = 0; i < n; i++) {
+            f[i] = f[i] * hm(kk, kk - 1) + residual[i] * beta * sigma;
+        }
+        std::copy_n(X.data(), (size_t) kk * n, V.data());
+
+        std::fill(H.begin(), H.end(), 0.0);
+        for (int j = 0; j < kk; j++) {
+            for (int i = 0; i <= std::min(j + 1, kk - 1); i++) hAt(i, j) = hm(i, j);
+        }
+        double *v = V.data() + (size_t) kk * n;
+        std::copy_n(f, n, v);
+        double before = detail::norm(v, n);
+        double fnorm = detail::orthogonalize(V.data(), n, kk, v, h.data());
+        for (int i = 0; i < kk; i++) hAt(i, kk - 1) += h[i];
+        if (fnorm > 1e-10 * before) {
+            for (int i = 0; i < n; i++) v[i] /= fnorm;
+            hAt(kk, kk - 1) = fnorm;
+        } else {
+            detail::randomDirection(V.data(), n, kk, v, gen);
+        }
+        start = kk;
+        res.restarts++;
+    }
+}
+
+}
+
+#endif /* ZOP_EIGENSOLVER_H */
@@ -0,0 +1,218 @@
+#ifndef ZOP_GRAPH_H
+#define ZOP_GRAPH_H
+
+/**
+ *  \file Graph.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains graph algorithms on adjacency matrices, written as
+ *  sequences of semiring products.
+ */
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <stdexcept>
+
+#include <Semiring.h>
+#include <SparseMatrix.h>
+
+namespace zop {
+
+/**
+ * A directed graph given by its adjacency matrix A, in which the stored
+ * entry Aᵢⱼ is the weight of the edge from i to j. The graph keeps A for
+ * pushing along the out-edges of a few vertices and Aᵀ for pulling along
+ * the in-edges of many.
+ */
+class Graph {
+private:
+    CSRSparseMatrix out_;
+    CSRSparseMatrix in_;
+
+public:
+
+    explicit Graph(CSRSparseMatrix adjacency):
+        out_{std::move(adjacency)}, in_{out_.transposed()} {
+        if (out_.nRows() != out_.nCols()) throw DimensionMismatchException{};
+    }
+
+    int nVertices() const {
+        return out_.nRows();
+    }
+
+    int nEdges() const {
+        return out_.nnz();
+    }
+
+    const CSRSparseMatrix& out() const { return out_; }
+    const CSRSparseMatrix& in() const { return in_; }
+
+    int outDegree(int v) const {
+        return out_.rowIndices()[v + 1] - out_.rowIndices()[v];
+    }
+
+    /**
+     * Return the number of out-edges of the given vertices.
+     */
+    long outDegree(const std::vector<int> &vertices) const {
+        long res = 0;
+        for (int v: vertices) res += outDegree(v);
+        return res;
+    }
+};
+
+namespace detail {
+
+    // A sparse frontier is pushed along its out-edges while they number
+    // fewer than 1 / pushFraction of all edges; larger frontiers pull
+    // along the in-edges of every vertex (Beamer et al., SC 2012).
+    constexpr long pushFraction = 14;
+
+    inline bool pushes(const Graph &G, const std::vector<int> &frontier) {
+        return G.outDegree(frontier) * pushFraction < G.nEdges();
+    }
+
+}
+
+/**
+ * Return the breadth-first search levels of all vertices from the source:
+ * 0 for the source, the number of edges on a shortest path for the
+ * vertices it reaches, and -1 for the others.
+ *
+ * Every level is one product over the (or, and) semiring. Small frontiers
+ * push along their out-edges; large frontiers switch to pulling, where
+ * each unvisited vertex scans its in-edges and stops at the first one
+ * from the frontier.
+ */
+inline std::vector<int> breadthFirstSearch(const Graph &G, int source) {
+    using S = semiring::OrAnd;
+    int n = G.nVertices();
+    if (source < 0 || source >= n) throw std::runtime_error("source vertex out of range");
+    std::vector<int> levels(n, -1);
+    levels[source] = 0;
+
+    SparseVector<char> frontier{n, {source}, {1}}, next;
+    SparseAccumulator<S> work(n);
+    std::vector<char> dense, unvisited, reached;
+    for (int level = 1; frontier.nnz() > 0; level++) {
+        if (detail::pushes(G, frontier.indices)) {
+            multiplyTransposed<S>(G.out(), frontier, next, work);
+        } else {
+            dense.assign(n, 0);
+            for (int v: frontier.indices) dense[v] = 1;
+            unvisited.resize(n);
+            for (int v = 0; v < n; v++) unvisited[v] = levels[v] < 0;
+            reached.assign(n, 0);
+            multiply<S>(G.in(), dense.data(), reached.data(), unvisited.data());
+            next.indices.clear();
+            for (int v = 0; v < n; v++) {
+                if (reached[v]) next.indices.push_back(v);
+            }
+        }
+        frontier.indices.clear();
+        for (int v: next.indices) {
+            if (levels[v] >= 0) continue;
+            levels[v] = level;
+            frontier.indices.push_back(v);
+        }
+        frontier.values.assign(frontier.indices.size(), 1);
+    }
+    return levels;
+}
+
+/**
+ * Return the lengths of the shortest paths from the source to all
+ * vertices, with the stored entries of the adjacency matrix as edge
+ * lengths, and infinity for the vertices that cannot be reached.
+ *
+ * This is the Bellman-Ford algorithm over the (min, +) semiring: each round
+ * relaxes the out-edges of the vertices whose distance changed in the
+ * previous round, pushing from few of them or pulling into every vertex
+ * from many. Negative lengths are allowed, but a negative cycle reachable
+ * from the source throws.
+ */
+inline std::vector<double> shortestPaths(const Graph &G, int source) {
+    using S = semiring::MinPlus;
+    int n = G.nVertices();
+    if (source < 0 || source >= n) throw std::runtime_error("source vertex out of range");
+    std::vector<double> dist(n, S::zero());
+    dist[source] = 0.0;
+
+    SparseVector<double> frontier{n, {source}, {0.0}}, next;
+    SparseAccumulator<S> work(n);
+    std::vector<double> dense, relaxed(n);
+    for (int round = 0; frontier.nnz() > 0; round++) {
+        if (round == n) throw std::runtime_error("negative cycle");
+        if (detail::pushes(G, frontier.indices)) {
+            multiplyTransposed<S>(G.out(), frontier, next, work);
+        } else {
+            dense.assign(n, S::zero());
+            for (int e = 0; e < frontier.nnz(); e++) dense[frontier.indices[e]] = frontier.values[e];
+            multiply<S>(G.in(), dense.data(), relaxed.data());
+            next.indices.clear();
+            next.values.clear();
+            for (int v = 0; v < n; v++) {
+                if (relaxed[v] < dist[v]) {
+                    next.indices.push_back(v);
+                    next.values.push_back(relaxed[v]);
+                }
+            }
+        }
+        frontier.indices.clear();
+        frontier.values.clear();
+        for (int e = 0; e < next.nnz(); e++) {
+            int v = next.indices[e];
+            if (next.values[e] >= dist[v]) continue;
+            dist[v] = next.values[e];
+            frontier.indices.push_back(v);
+            frontier.values.push_back(dist[v]);
+        }
+    }
+    return dist;
+}
+
+/**
+ * Return the PageRank of every vertex: the stationary distribution of a
+ * walk that follows an out-edge with probability damping, chosen in
+ * proportion to the edge weights, and otherwise jumps to a uniformly random
+ * vertex, as it also does from vertices without out-edges. The weights must
+ * not be negative.
+ *
+ * Each power iteration is one pull product over the (+, ×) semiring with
+ * the in-edges, and the iteration stops when the ranks change by less than
+ * the tolerance in the 1-norm.
+ */
+inline std::vector<double> pageRank(const Graph &G, double damping = 0.85, double tolerance = 1e-10,
+                                    int maxIterations = 100) {
+    int n = G.nVertices();
+    if (n == 0) return {};
+    std::vector<double> weight(n, 0.0);
+    const std::vector<double> &vals = G.out().values();
+    const std::vector<int> &rows = G.out().rowIndices();
+    parallel::parallelFor(0, n, [&](int u) {
+        for (int k = rows[u]; k < rows[u + 1]; k++) weight[u] += vals[k];
+    });
+
+    std::vector<double> rank(n, 1.0 / n), scaled(n), next(n);
+    for (int iteration = 0; iteration < maxIterations; iteration++) {
+        double dangling = 0.0;
+        for (int u = 0; u < n; u++) {
+            scaled[u] = weight[u] > 0.0 ? rank[u] / weight[u]: 0.0;
+            if (weight[u] <= 0.0) dangling += rank[u];
+        }
+        multiply<semiring::PlusTimes>(G.in(), scaled.data(), next.data());
+        double jump = (1.0 - damping + damping * dangling) / n, change = 0.0;
+        for (int v = 0; v < n; v++) {
+            next[v] = jump + damping * next[v];
+            change += std::abs(next[v] - rank[v]);
+        }
+        std::swap(rank, next);
+        if (change < tolerance) break;
+    }
+    return rank;
+}
+
+}
+
+#endif /* ZOP_GRAPH_H */
@@ -0,0 +1,415 @@
+#ifndef ZOP_INSTRUMENTATION_H
+#define ZOP_INSTRUMENTATION_H
+
+/**
+ *  \file Instrumentation.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains an optional instrumentation layer for the hot paths
+ *  of the library. It is enabled by compiling with
+ *  `-DZOP_ENABLE_INSTRUMENTATION`. Every instrumented operation then records
+ *  its call count, a histogram of its wall time, an estimate of the FLOPs it
+ *  performed and the bytes it moved, and the heap allocations made while it
+ *  ran. Without the define, `ZOP_INSTRUMENT` expands to nothing and its
+ *  arguments are never evaluated, so instrumentation costs nothing.
+ *
+ *  Operations that exist for several storage formats are named after the
+ *  operation and the format, such as "spmv.csr" and "spmv.sell", since
+ *  their FLOP and byte estimates differ.
+ *
+ *  Allocations are counted by replacing the global `operator new`. Since
+ *  the replacement may only be defined once per program, it is emitted only
+ *  in the translation unit that defines `ZOP_DEFINE_ALLOCATION_HOOKS` before
+ *  including this file. The hooks work with or without instrumentation, so
+ *  tests can count the allocations of any code.
+ */
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace zop {
+
+namespace instrumentation {
+
+#ifdef ZOP_ENABLE_INSTRUMENTATION
+constexpr bool enabled = true;
+#else
+constexpr bool enabled = false;
+#endif
+
+/**
+ * The number of buckets of the wall time histograms. Bucket b counts the
+ * calls that took between 2^(b-1) and 2^b nanoseconds, and the last bucket
+ * also counts all longer calls.
+ */
+constexpr int histogramBuckets = 40;
+
+/**
+ * The statistics of a single operation at the time of a snapshot.
+ */
+struct OperationStats {
+    std::string name;
+    std::uint64_t calls = 0;
+    std::uint64_t nanoseconds = 0;
+    double flops = 0.0;
+    double bytes = 0.0;
+    std::uint64_t allocations = 0;
+    std::uint64_t allocatedBytes = 0;
+    std::array<std::uint64_t, histogramBuckets> histogram{};
+};
+
+/**
+ * The live counters of a single operation. They are updated with relaxed
+ * atomics, so operations can be recorded from any thread.
+ */
+class Counter {
+private:
+    std::string name_;
+    std::atomic<std::uint64_t> calls_{0};
+    std::atomic<std::uint64_t> nanoseconds_{0};
+    std::atomic<double> flops_{0.0};
+    std::atomic<double> bytes_{0.0};
+    std::atomic<std::uint64_t> allocations_{0};
+    std::atomic<std::uint64_t> allocatedBytes_{0};
+    std::array<std::atomic<std::uint64_t>, histogramBuckets> histogram_{};
+
+    static void add(std::atomic<double> &target, double v) {
+        double current = target.load(std::memory_order_relaxed);
+        while (!target.compare_exchange_weak(current, current + v, std::memory_order_relaxed)) {}
+    }
+
+public:
+    explicit Counter(std::string name): name_{std::move(name)} {}
+
+    const std::string& name() const {
+        return name_;
+    }
+
+    void record(std::uint64_t ns, double flops, double bytes, std::uint64_t allocations,
+                std::uint64_t allocatedBytes) {
+        constexpr auto relaxed = std::memory_order_relaxed;
+        calls_.fetch_add(1, relaxed);
+        nanoseconds_.fetch_add(ns, relaxed);
+        add(flops_, flops);
+        add(bytes_, bytes);
+        allocations_.fetch_add(allocations, relaxed);
+        allocatedBytes_.fetch_add(allocatedBytes, relaxed);
+        int bucket = 0;
+        while (bucket < histogramBuckets - 1 && (std::uint64_t{1} << bucket) <= ns) bucket++;
+        histogram_[bucket].fetch_add(1, relaxed);
+    }
+
+    OperationStats stats() const {
+        constexpr auto relaxed = std::memory_order_relaxed;
+        OperationStats res;
+        res.name = name_;
+        res.calls = calls_.load(relaxed);
+        res.nanoseconds = nanoseconds_.load(relaxed);
+        res.flops = flops_.load(relaxed);
+        res.bytes = bytes_.load(relaxed);
+        res.allocations = allocations_.load(relaxed);
+        res.allocatedBytes = allocatedBytes_.load(relaxed);
+        for (int b = 0; b < histogramBuckets; b++) res.histogram[b] = histogram_[b].load(relaxed);
+        return res;
+    }
+
+    void reset() {
+        constexpr auto relaxed = std::memory_order_relaxed;
+        calls_.store(0, relaxed);
+        nanoseconds_.store(0, relaxed);
+        flops_.store(0.0, relaxed);
+        bytes_.store(0.0, relaxed);
+        allocations_.store(0, relaxed);
+        allocatedBytes_.store(0, relaxed);
+        for (auto &h: histogram_) h.store(0, relaxed);
+    }
+};
+
+namespace detail {
+
+    struct Registry {
+        std::mutex mutex;
+        std::map<std::string, std::unique_ptr<Counter>> counters;
+    };
+
+    inline Registry& registry() {
+        static Registry instance;
+        return instance;
+    }
+
+    inline std::atomic<std::uint64_t>& allocationCount() {
+        static std::atomic<std::uint64_t> count{0};
+        return count;
+    }
+
+    inline std::atomic<std::uint64_t>& allocatedBytes() {
+        static std::atomic<std::uint64_t> count{0};
+        return count;
+    }
+
+    /**
+     * Return the number of stored entries of A if it has a notion of them,
+     * and its number of entries otherwise.
+     */
+    template <class M>
+    auto entryCount(const M &A, int) -> decltype((double) A.nnz()) {
+        return (double) A.nnz();
+    }
+
+    template <class M>
+    double entryCount(const M &A, long) {
+        return (double) A.nRows() * A.nCols();
+    }
+
+}
+
+/**
+ * Return the counter of the named operation, creating it on first use. The
+ * reference stays valid for the lifetime of the program.
+ */
+inline Counter& counter(const std::string &name) {
+    auto &registry = detail::registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    auto &slot = registry.counters[name];
+    if (!slot) slot = std::make_unique<Counter>(name);
+    return *slot;
+}
+
+/**
+ * Record a heap allocation of the given size. This is called by the
+ * allocation hooks, but custom allocators may call it as well.
+ */
+inline void recordAllocation(std::size_t size) {
+    detail::allocationCount().fetch_add(1, std::memory_order_relaxed);
+    detail::allocatedBytes().fetch_add(size, std::memory_order_relaxed);
+}
+
+/**
+ * Return the number of heap allocations made by any thread since the start
+ * of the program. This is always zero unless the allocation hooks are
+ * installed.
+ */
+inline std::uint64_t allocationCount() {
+    return detail::allocationCount().load(std::memory_order_relaxed);
+}
+
+inline std::uint64_t allocatedBytes() {
+    return detail::allocatedBytes().load(std::memory_order_relaxed);
+}
+
+/**
+ * Return true if the global allocation hooks are installed in this program.
+ */
+inline bool allocationHooksInstalled() {
+    std::uint64_t before = allocationCount();
+    ::operator delete(::operator new(1));
+    return allocationCount() != before;
+}
+
+template <class M>
+double entryCount(const M &A) {
+    return detail::entryCount(A, 0);
+}
+
+/**
+ * Records one call of an operation when it goes out of scope. Allocations
+ * are counted across all threads, so they include the work of the thread
+ * pool, as well as any unrelated allocations made concurrently. Nested
+ * operations are included in the counts of the enclosing operation.
+ */
+class Scope {
+private:
+    Counter &counter_;
+    double flops_;
+    const double *countedFlops_ = nullptr;
+    double bytes_;
+    std::uint64_t allocations_;
+    std::uint64_t allocatedBytes_;
+    std::chrono::steady_clock::time_point start_;
+
+public:
+    Scope(Counter &counter, double flops, double bytes):
+        counter_{counter},
+        flops_{flops},
+        bytes_{bytes},
+        allocations_{allocationCount()},
+        allocatedBytes_{instrumentation::allocatedBytes()},
+        start_{std::chrono::steady_clock::now()} {}
+
+    /**
+     * Record an operation whose FLOPs are only known once it has run. They
+     * are read from `flops` when the scope ends.
+     */
+    Scope(Counter &counter, const double *flops, double bytes): Scope(counter, 0.0, bytes) {
+        countedFlops_ = flops;
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    ~Scope() {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_).count();
+        counter_.record((std::uint64_t) ns, countedFlops_ ? *countedFlops_: flops_, bytes_, allocationCount() - allocations_,
+                        instrumentation::allocatedBytes() - allocatedBytes_);
+    }
+};
+
+/**
+ * Return the statistics of every operation that has been called at least
+ * once, ordered by name.
+ */
+inline std::vector<OperationStats> snapshot() {
+    auto &registry = detail::registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    std::vector<OperationStats> res;
+    for (auto &[name, c]: registry.counters) {
+        OperationStats stats = c->stats();
+        if (stats.calls > 0) res.push_back(std::move(stats));
+    }
+    return res;
+}
+
+/**
+ * Return the statistics of the named operation. All counts are zero if it
+ * has never been called.
+ */
+inline OperationStats snapshot(const std::string &name) {
+    auto &registry = detail::registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    auto it = registry.counters.find(name);
+    if (it == registry.counters.end()) {
+        OperationStats res;
+        res.name = name;
+        return res;
+    }
+    return it->second->stats();
+}
+
+/**
+ * Reset the counters of all operations. The global allocation count is
+ * not affected.
+ */
+inline void reset() {
+    auto &registry = detail::registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (auto &[name, c]: registry.counters) c->reset();
+}
+
+/**
+ * Return a snapshot as a JSON document of the form
+ *
+ *     {"operations": [{"name": ..., "calls": ..., "seconds": ..., "flops": ...,
+ *                      "bytes": ..., "allocations": ..., "allocatedBytes": ...,
+ *                      "histogram": [...]}, ...]}
+ *
+ * Operation names never contain characters that need escaping.
+ */
+inline std::string toJSON(const std::vector<OperationStats> &stats) {
+    std::ostringstream out;
+    out.precision(17);
+    out << "{\"operations\": [";
+    for (size_t k = 0; k < stats.size(); k++) {
+        const OperationStats &s = stats[k];
+        if (k > 0) out << ", ";
+        out << "{\"name\": \"" << s.name << "\""
+            << ", \"calls\": " << s.calls
+            << ", \"seconds\": " << s.nanoseconds * 1e-9
+            << ", \"flops\": " << s.flops
+            << ", \"bytes\": " << s.bytes
+            << ", \"allocations\": " << s.allocations
+            << ", \"allocatedBytes\": " << s.allocatedBytes
+            << ", \"histogram\": [";
+        for (int b = 0; b < histogramBuckets; b++) {
+            out << (b > 0 ? ", ": "") << s.histogram[b];
+        }
+        out << "]}";
+    }
+    out << "]}";
+    return out.str();
+}
+
+}
+
+}
+
+#define ZOP_CONCAT_IMPL(a, b) a##b
+#define ZOP_CONCAT(a, b) ZOP_CONCAT_IMPL(a, b)
+
+/**
+ * Record the enclosing scope as one call of the named operation with the
+ * given estimated FLOPs and bytes. The counter is looked up once per call
+ * site.
+ */
+#ifdef ZOP_ENABLE_INSTRUMENTATION
+#define ZOP_INSTRUMENT(name, flops, bytes) \
+    static ::zop::instrumentation::Counter &ZOP_CONCAT(zop_counter_, __LINE__) = \
+        ::zop::instrumentation::counter(name); \
+    ::zop::instrumentation::Scope ZOP_CONCAT(zop_scope_, __LINE__){ \
+        ZOP_CONCAT(zop_counter_, __LINE__), (double) (flops), (double) (bytes)}
+
+/**
+ * Like ZOP_INSTRUMENT, but the FLOPs are counted by the operation itself:
+ * `flops` names a double that holds the count when the scope ends.
+ */
+#define ZOP_INSTRUMENT_COUNTED(name, flops, bytes) \
+    static ::zop::instrumentation::Counter &ZOP_CONCAT(zop_counter_, __LINE__) = \
+        ::zop::instrumentation::counter(name); \
+    ::zop::instrumentation::Scope ZOP_CONCAT(zop_scope_, __LINE__){ \
+        ZOP_CONCAT(zop_counter_, __LINE__), &(flops), (double) (bytes)}
+#else
+#define ZOP_INSTRUMENT(name, flops, bytes) ((void) 0)
+#define ZOP_INSTRUMENT_COUNTED(name, flops, bytes) ((void) 0)
+#endif
+
+#ifdef ZOP_DEFINE_ALLOCATION_HOOKS
+
+// GCC cannot tell that the replaced operator new returns memory from malloc.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size) {
+    ::zop::instrumentation::recordAllocation(size);
+    if (void *p = std::malloc(size == 0 ? 1: size)) return p;
+    throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
+
+#endif /* ZOP_INSTRUMENTATION_H */
@@ -0,0 +1,456 @@
+#ifndef ZOP_KERNELS_H
+#define ZOP_KERNELS_H
+
+/**
+ *  \file Kernels.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains matrix-vector and matrix-matrix products that write
+ *  into storage provided by the caller, in the style of the BLAS:
+ *
+ *      y = αAx + βy,    y = αAᵀx + βy,    C = αAB + βC
+ *
+ *  The outputs must already have the right shape. The kernels never resize
+ *  them and allocate no memory, so a loop that calls them repeatedly with
+ *  the same outputs performs no heap allocations in steady state. As in the
+ *  BLAS, when β = 0 the output is overwritten and its previous contents,
+ *  even NaNs, are ignored.
+ */
+
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+#include <Simd.h>
+#include <Matrix.h>
+#include <Vector.h>
+#include <DenseMatrix.h>
+#include <SparseMatrix.h>
+#include <Parallel.h>
+#include <Instrumentation.h>
+
+namespace zop {
+
+namespace detail {
+
+inline double scaled(double acc, double alpha, double beta, double y) {
+    return beta == 0.0 ? alpha * acc: alpha * acc + beta * y;
+}
+
+inline void checkOutput(const Vector &x, const Vector &y, int nIn, int nOut) {
+    if (x.dim() != nIn || y.dim() != nOut) throw DimensionMismatchException{};
+    if (&x == &y) throw std::runtime_error("output aliases input");
+}
+
+#if defined(ZOP_SIMD_X86)
+/**
+ * Sum the products of the first n - n % 8 values with two AVX2 accumulators
+ * of four lanes each, and set k to the number of values summed.
+ */
+ZOP_TARGET("avx2")
+inline double dotAVX2(const double *a, const double *b, int n, int &k) {
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+    for (; k + 8 <= n; k += 8) {
+        s0 = _mm256_add_pd(s0, _mm256_mul_pd(_mm256_loadu_pd(a + k), _mm256_loadu_pd(b + k)));
+        s1 = _mm256_add_pd(s1, _mm256_mul_pd(_mm256_loadu_pd(a + k + 4), _mm256_loadu_pd(b + k + 4)));
+    }
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, _mm256_add_pd(s0, s1));
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+#endif
+
+/**
+ * Return the dot product of two arrays of n values, with four independent
+ * accumulators (or four AVX2 lanes each, if the CPU supports AVX2) so that
+ * the loop is not bound by the latency of the additions.
+ */
+inline double dot(const double *a, const double *b, int n) {
+    int k = 0;
+    double acc = 0.0;
+#if defined(ZOP_SIMD_X86)
+    if (simd::hasAVX2()) {
+        acc = dotAVX2(a, b, n, k);
+        for (; k < n; k++) acc += a[k] * b[k];
+        return acc;
+    }
+#endif
+    double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+    for (; k + 4 <= n; k += 4) {
+        s0 += a[k] * b[k];
+        s1 += a[k + 1] * b[k + 1];
+        s2 += a[k + 2] * b[k + 2];
+        s3 += a[k + 3] * b[k + 3];
+    }
+    acc = (s0 + s1) + (s2 + s3);
+    for (; k < n; k++) acc += a[k] * b[k];
+    return acc;
+}
+
+/**
+ * Buffers for the partial results of the threads of a kernel, owned by the
+ * thread that calls the kernel and kept between calls, so a kernel that
+ * needs them only allocates the first time it sees a larger problem. The
+ * buffers must not be used by two kernels that are nested on one thread.
+ */
+struct Scratch {
+    std::vector<double> values;
+    std::vector<int> bounds;
+
+    static Scratch& local() {
+        static thread_local Scratch scratch;
+        return scratch;
+    }
+};
+
+}
+
+/**
+ * y = αAx + βy for any matrix type. This falls back to the rows of A.
+ */
+template <class M>
+void multiply(const AbstractMatrix<M> &A, const Vector &x, Vector &y, double alpha = 1.0, double beta = 0.0) {
+    const M &self = static_cast<const M &>(A);
+    detail::checkOutput(x, y, self.nCols(), self.nRows());
+    ZOP_INSTRUMENT("gemv", 2.0 * instrumentation::entryCount(self),
+                   8.0 * (instrumentation::entryCount(self) + x.dim() + y.dim()));
+    for (int i = 0; i < self.nRows(); i++) {
+        y[i] = detail::scaled(self.row(i).dot(x), alpha, beta, y[i]);
+    }
+}
+
+/**
+ * y = αAx + βy for a dense matrix. The rows are split across threads.
+ */
+inline void multiply(const DenseMatrix &A, const Vector &x, Vector &y, double alpha = 1.0, double beta = 0.0) {
+    detail::checkOutput(x, y, A.nCols(), A.nRows());
+    ZOP_INSTRUMENT("gemv", 2.0 * A.nRows() * A.nCols(), 8.0 * ((double) A.nRows() * A.nCols() + x.dim() + y.dim()));
+    const double *px = x.data();
+    double *py = y.data();
+    parallel::parallelForRange(0, A.nRows(), [&](int a, int b) {
+        for (int i = a; i < b; i++) {
+            const double *row = A.row(i).data();
+            double acc = 0.0;
+            for (int j = 0; j < A.nCols(); j++) acc += row[j] * px[j];
+            py[i] = detail::scaled(acc, alpha, beta, py[i]);
+        }
+    });
+}
+
+/**
+ * y = αAx + βy for a CSR matrix. Each thread is assigned a block of rows
+ * holding roughly the same number of stored entries.
+ */
+inline void multiply(const CSRSparseMatrix &A, const Vector &x, Vector &y, double alpha = 1.0, double beta = 0.0) {
+    detail::checkOutput(x, y, A.nCols(), A.nRows());
+    ZOP_INSTRUMENT("spmv.csr", 2.0 * A.nnz(), 12.0 * A.nnz() + 4.0 * A.nRows() + 8.0 * (x.dim() + y.dim()));
+    const int *offsets = A.rowIndices().data();
+    const int *cols = A.columnIndices().data();
+    const double *vals = A.values().data();
+    const double *px = x.data();
+    double *py = y.data();
+    parallel::forEachThread([&](int t, int n) {
+        auto [a, b] = parallel::balancedRange(offsets, A.nRows(), t, n);
+        for (int i = a; i < b; i++) {
+            double acc = 0.0;
+            for (int k = offsets[i]; k < offsets[i + 1]; k++) acc += vals[k] * px[cols[k]];
+            py[i] = detail::scaled(acc, alpha, beta, py[i]);
+        }
+    });
+}
+
+/**
+ * y = αAx + βy for a DOK matrix, visiting the stored entries in order.
+ */
+inline void multiply(const DOKSparseMatrix &A, const Vector &x, Vector &y, double alpha = 1.0, double beta = 0.0) {
+    detail::checkOutput(x, y, A.nCols(), A.nRows());
+    ZOP_INSTRUMENT("spmv.dok", 2.0 * A.nnz(), 48.0 * A.nnz() + 8.0 * (x.dim() + y.dim()));
+    for (int i = 0; i < y.dim(); i++) y[i] = beta == 0.0 ? 0.0: beta * y[i];
+    for (const auto &[loc, v]: A) {
+        y[loc.first] += alpha * v * x[loc.second];
+    }
+}
+
+/**
+ * y = αAᵀx + βy for a dense matrix. Each thread owns a range of entries of
+ * y and accumulates the rows of A into it in storage order.
+ */
+inline void multiplyTransposed(const DenseMatrix &A, const Vector &x, Vector &y,
+                               double alpha = 1.0, double beta = 0.0) {
+    detail::checkOutput(x, y, A.nRows(), A.nCols());
+    ZOP_INSTRUMENT("gemvTransposed", 2.0 * A.nRows() * A.nCols(), 8.0 * ((double) A.nRows() * A.nCols() + x.dim() + y.dim()));
+    const double *px = x.data();
+    double *py = y.data();
+    parallel::parallelForRange(0, A.nCols(), [&](int a, int b) {
+        for (int j = a; j < b; j++) py[j] = beta == 0.0 ? 0.0: beta * py[j];
+        for (int i = 0; i < A.nRows(); i++) {
+            const double *row = A.row(i).data();
+            double s = alpha * px[i];
+            if (s == 0.0) continue;
+            for (int j = a; j < b; j++) py[j] += row[j] * s;
+        }
+    });
+}
+
+/**
+ * y = αAᵀx + βy for a CSR matrix. Each thread scatters a balanced range of
+ * rows into a private buffer that spans the columns those rows reach, and
+ * the buffers are then added to y by ranges of columns in a fixed order.
+ * Every entry is read once, and the result only depends on the number of
+ * threads, not on their scheduling. The buffers are reused between calls.
+ */
+inline void multiplyTransposed(const CSRSparseMatrix &A, const Vector &x, Vector &y,
+                               double alpha = 1.0, double beta = 0.0) {
+    detail::checkOutput(x, y, A.nRows(), A.nCols());
+    ZOP_INSTRUMENT("spmvTransposed", 2.0 * A.nnz(), 12.0 * A.nnz() + 4.0 * A.nRows() + 8.0 * (x.dim() + y.dim()));
+    const int m = A.nRows(), n = A.nCols();
+    const int *offsets = A.rowIndices().data();
+    const int *cols = A.columnIndices().data();
+    const double *vals = A.values().data();
+    const double *px = x.data();
+    double *py = y.data();
+
+    auto scatter = [&](int a, int b, double *out) {
+        for (int i = a; i < b; i++) {
+            double s = alpha * px[i];
+            if (s == 0.0) continue;
+            for (int k = offsets[i]; k < offsets[i + 1]; k++) out[cols[k]] += vals[k] * s;
+        }
+    };
+
+    const int threads = parallel::threadCount();
+    if (threads == 1) {
+        for (int j = 0; j < n; j++) py[j] = beta == 0.0 ? 0.0: beta * py[j];
+        scatter(0, m, py);
+        return;
+    }
+
+    auto &scratch = detail::Scratch::local();
+    if (scratch.values.size() < (size_t) threads * n) scratch.values.resize((size_t) threads * n);
+    if (scratch.bounds.size() < 2 * (size_t) threads) scratch.bounds.resize(2 * threads);
+    int *bounds = scratch.bounds.data();
+    int used = 0;
+    parallel::forEachThread([&](int t, int nThreads) {
+        if (nThreads == 1) {
+            for (int j = 0; j < n; j++) py[j] = beta == 0.0 ? 0.0: beta * py[j];
+            scatter(0, m, py);
+            return;
+        }
+        if (t == 0) used = nThreads;
+
+        // Rows are sorted, so the first and last entries of the rows bound
+        // the columns the block reaches.
+        auto [a, b] = parallel::balancedRange(offsets, m, t, nThreads);
+        int lo = n, hi = 0;
+        for (int i = a; i < b; i++) {
+            if (offsets[i] == offsets[i + 1]) continue;
+            lo = std::min(lo, cols[offsets[i]]);
+            hi = std::max(hi, cols[offsets[i + 1] - 1] + 1);
+        }
+        hi = std::max(lo, hi);
+        bounds[2 * t] = lo;
+        bounds[2 * t + 1] = hi;
+        double *out = scratch.values.data() + (size_t) t * n;
+        std::fill(out + lo, out + hi, 0.0);
+        scatter(a, b, out);
+    });
+    if (used == 0) return;
+
+    parallel::parallelForRange(0, n, [&](int a, int b) {
+        for (int j = a; j < b; j++) py[j] = beta == 0.0 ? 0.0: beta * py[j];
+        for (int t = 0; t < used; t++) {
+            const double *out = scratch.values.data() + (size_t) t * n;
+            for (int j = std::max(a, bounds[2 * t]); j < std::min(b, bounds[2 * t + 1]); j++) py[j] += out[j];
+        }
+    });
+}
+
+/**
+ * C = αAB + βC for dense matrices. The rows of C are split across threads,
+ * and every row of C is accumulated from the rows of B in column tiles so
+ * that the tile of C stays in cache.
+ */
+inline void multiply(const DenseMatrix &A, const DenseMatrix &B, DenseMatrix &C,
+                     double alpha = 1.0, double beta = 0.0) {
+    if (A.nCols() != B.nRows() || C.nRows() != A.nRows() || C.nCols() != B.nCols()) {
+        throw DimensionMismatchException{};
+    }
+    if (&C == &A || &C == &B) throw std::runtime_error("output aliases input");
+    ZOP_INSTRUMENT("gemm", 2.0 * A.nRows() * A.nCols() * B.nCols(),
+                   8.0 * ((double) A.nRows() * A.nCols() + (double) B.nRows() * B.nCols() + 2.0 * C.nRows() * C.nCols()));
+
+    constexpr int tile = 512;
+    const int n = C.nCols();
+    parallel::parallelForRange(0, C.nRows(), [&](int a, int b) {
+        for (int i = a; i < b; i++) {
+            double *c = C.row(i).data();
+            const double *arow = A.row(i).data();
+            for (int j = 0; j < n; j++) c[j] = beta == 0.0 ? 0.0: beta * c[j];
+            for (int j0 = 0; j0 < n; j0 += tile) {
+                int j1 = std::min(n, j0 + tile);
+                for (int p = 0; p < A.nCols(); p++) {
+                    double s = alpha * arow[p];
+                    if (s == 0.0) continue;
+                    const double *brow = B.row(p).data();
+                    for (int j = j0; j < j1; j++) c[j] += s * brow[j];
+                }
+            }
+        }
+    });
+}
+
+/**
+ * Y = αAX + βY for a CSR matrix A and dense matrices X and Y with the same
+ * number of columns, such as a block of vectors. Every stored entry of A
+ * is read once and applied to a whole row of X, so the inner loop runs
+ * along contiguous rows and vectorizes across the columns of X.
+ *
+ * The rows of Y are split across threads by the number of stored entries.
+ * Four entries of a row of A are applied at a time to halve the traffic on
+ * the row of Y, and wide blocks are processed in column tiles that keep
+ * the tile of Y in cache.
+ */
+inline void multiply(const CSRSparseMatrix &A, const DenseMatrix &X, DenseMatrix &Y,
+                     double alpha = 1.0, double beta = 0.0) {
+    if (A.nCols() != X.nRows() || Y.nRows() != A.nRows() || Y.nCols() != X.nCols()) {
+        throw DimensionMismatchException{};
+    }
+    if (&X == &Y) throw std::runtime_error("output aliases input");
+    ZOP_INSTRUMENT("spmm", 2.0 * A.nnz() * X.nCols(),
+                   12.0 * A.nnz() + 8.0 * ((double) X.nRows() * X.nCols() + 2.0 * Y.nRows() * Y.nCols()));
+
+    constexpr int tile = 512;
+    const int n = Y.nCols();
+    const int *offsets = A.rowIndices().data();
+    const int *cols = A.columnIndices().data();
+    const double *vals = A.values().data();
+    parallel::forEachThread([&](int t, int nThreads) {
+        auto [a, b] = parallel::balancedRange(offsets, A.nRows(), t, nThreads);
+        for (int i = a; i < b; i++) {
+            double *y = Y.row(i).data();
+            for (int j = 0; j < n; j++) y[j] = beta == 0.0 ? 0.0: beta * y[j];
+            for (int j0 = 0; j0 < n; j0 += tile) {
+                int j1 = std::min(n, j0 + tile);
+                int k = offsets[i];
+                for (; k + 4 <= offsets[i + 1]; k += 4) {
+                    double s0 = alpha * vals[k], s1 = alpha * vals[k + 1];
+                    double s2 = alpha * vals[k + 2], s3 = alpha * vals[k + 3];
+                    const double *x0 = X.row(cols[k]).data(), *x1 = X.row(cols[k + 1]).data();
+                    const double *x2 = X.row(cols[k + 2]).data(), *x3 = X.row(cols[k + 3]).data();
+                    for (int j = j0; j < j1; j++) {
+                        y[j] += s0 * x0[j] + s1 * x1[j] + s2 * x2[j] + s3 * x3[j];
+                    }
+                }
+                for (; k < offsets[i + 1]; k++) {
+                    double s = alpha * vals[k];
+                    const double *x = X.row(cols[k]).data();
+                    for (int j = j0; j < j1; j++) y[j] += s * x[j];
+                }
+            }
+        }
+    });
+}
+
+/**
+ * Sampled dense-dense product: write Mᵢⱼ (ABᵀ)ᵢⱼ for every stored entry
+ * (i, j) of M to out, in the order of the stored entries of M. Only these
+ * entries of ABᵀ are computed, each as a dot product between row i of A
+ * and row j of B over their common inner dimension.
+ */
+inline void sampledMultiply(const CSRSparseMatrix &M, const DenseMatrix &A, const DenseMatrix &B, double *out) {
+    if (M.nRows() != A.nRows() || M.nCols() != B.nRows() || A.nCols() != B.nCols()) {
+        throw DimensionMismatchException{};
+    }
+    ZOP_INSTRUMENT("sddmm", 2.0 * M.nnz() * A.nCols(), 12.0 * M.nnz() + 8.0 * M.nnz() * A.nCols());
+    const int *offsets = M.rowIndices().data();
+    const int *cols = M.columnIndices().data();
+    const double *vals = M.values().data();
+    const int n = A.nCols();
+    parallel::forEachThread([&](int t, int nThreads) {
+        auto [a, b] = parallel::balancedRange(offsets, M.nRows(), t, nThreads);
+        for (int i = a; i < b; i++) {
+            const double *arow = A.row(i).data();
+            for (int k = offsets[i]; k < offsets[i + 1]; k++) {
+                out[k] = vals[k] * detail::dot(arow, B.row(cols[k]).data(), n);
+            }
+        }
+    });
+}
+
+/**
+ * Return M ∘ ABᵀ, the sampled dense-dense product, as a matrix with the
+ * structure of M.
+ */
+inline CSRSparseMatrix sampledMultiply(const CSRSparseMatrix &M, const DenseMatrix &A, const DenseMatrix &B) {
+    std::vector<double> values(M.nnz());
+    sampledMultiply(M, A, B, values.data());
+    return CSRSparseMatrix(M.nRows(), M.nCols(), M.rowIndices(), M.columnIndices(), std::move(values));
+}
+
+/**
+ * Masked sparse product: write (AB)ᵢⱼ for every stored entry (i, j) of M
+ * to out, in the order of the stored entries of M. The values of M are
+ * ignored, only its structure matters.
+ *
+ * Each row is computed as in Gustavson's algorithm, scattering the rows of
+ * B selected by row i of A, but only into the columns of row i of M, which
+ * a per-thread lookup table maps to their positions in out. Products that
+ * fall outside the mask are discarded without being accumulated.
+ */
+inline void maskedMultiply(const CSRSparseMatrix &M, const CSRSparseMatrix &A, const CSRSparseMatrix &B, double *out) {
+    if (M.nRows() != A.nRows() || M.nCols() != B.nCols() || A.nCols() != B.nRows()) {
+        throw DimensionMismatchException{};
+    }
+    // Only the products that fall inside the mask are accumulated, and
+    // they are only known once the rows have been scattered, so the FLOPs
+    // are counted as the kernel runs.
+    [[maybe_unused]] double flops = 0.0;
+    std::atomic<long> products{0};
+    ZOP_INSTRUMENT_COUNTED("maskedSpgemm", flops, 12.0 * (M.nnz() + A.nnz() + B.nnz()));
+    const int *mr = M.rowIndices().data(), *mc = M.columnIndices().data();
+    const int *ar = A.rowIndices().data(), *ac = A.columnIndices().data();
+    const int *br = B.rowIndices().data(), *bc = B.columnIndices().data();
+    const double *av = A.values().data(), *bv = B.values().data();
+    parallel::forEachThread([&](int t, int nThreads) {
+        auto [a, b] = parallel::balancedRange(mr, M.nRows(), t, nThreads);
+        if (a == b) return;
+        std::vector<int> position(M.nCols(), -1);
+        long accumulated = 0;
+        for (int i = a; i < b; i++) {
+            if (mr[i] == mr[i + 1]) continue;
+            for (int k = mr[i]; k < mr[i + 1]; k++) {
+                position[mc[k]] = k;
+                out[k] = 0.0;
+            }
+            for (int p = ar[i]; p < ar[i + 1]; p++) {
+                int row = ac[p];
+                double s = av[p];
+                for (int q = br[row]; q < br[row + 1]; q++) {
+                    int k = position[bc[q]];
+                    if (k >= 0) {
+                        out[k] += s * bv[q];
+                        if constexpr (instrumentation::enabled) accumulated += 1;
+                    }
+                }
+            }
+            for (int k = mr[i]; k < mr[i + 1]; k++) position[mc[k]] = -1;
+        }
+        if constexpr (instrumentation::enabled) products += accumulated;
+    });
+    flops = 2.0 * products;
+}
+
+/**
+ * Return AB restricted to the structure of M, which also gives the
+ * structure of the result.
+ */
+inline CSRSparseMatrix maskedMultiply(const CSRSparseMatrix &M, const CSRSparseMatrix &A, const CSRSparseMatrix &B) {
+    std::vector<double> values(M.nnz());
+    maskedMultiply(M, A, B, values.data());
+    return CSRSparseMatrix(M.nRows(), M.nCols(), M.rowIndices(), M.columnIndices(), std::move(values));
+}
+
+}
+
+#endif /* ZOP_KERNELS_H */
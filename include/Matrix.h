@@ -2,8 +2,10 @@
 #define MATRIX_H
 
 #include <type_traits>
+#include <algorithm>
 #include <cmath>
 #include <Vector.h>
+#include <Instrumentation.h>
 
 namespace zop {
 
@@ -151,10 +153,95 @@ public:
         return true;
     }
 
+    /**
+     * Return the lower bandwidth of the matrix, which is the largest
+     * distance i - j of a non-zero entry below the diagonal.
+     */
+    int lowerBandwidth() const {
+        const Derived *self = static_cast<const Derived *>(this);
+        int res = 0;
+        for (int i = 0; i < self->nRows(); i++) {
+            for (int j = 0; j < i && j < self->nCols(); j++) {
+                if (self->getEntry(i, j) != 0) {
+                    res = std::max(res, i - j);
+                    break;
+                }
+            }
+        }
+        return res;
+    }
+
+    /**
+     * Return the upper bandwidth of the matrix, which is the largest
+     * distance j - i of a non-zero entry above the diagonal.
+     */
+    int upperBandwidth() const {
+        const Derived *self = static_cast<const Derived *>(this);
+        int res = 0;
+        for (int i = 0; i < self->nRows(); i++) {
+            for (int j = self->nCols() - 1; j > i; j--) {
+                if (self->getEntry(i, j) != 0) {
+                    res = std::max(res, j - i);
+                    break;
+                }
+            }
+        }
+        return res;
+    }
+
+    /**
+     * Return the bandwidth of the matrix, which is the larger of the lower
+     * and upper bandwidths.
+     */
+    int bandwidth() const {
+        const Derived *self = static_cast<const Derived *>(this);
+        return std::max(self->lowerBandwidth(), self->upperBandwidth());
+    }
+
+    /**
+     * Return the profile (or envelope size) of the matrix. This is the sum
+     * over all rows of the distance between the diagonal and the first
+     * non-zero entry of the row to the left of it. The profile determines
+     * the storage required by skyline factorizations.
+     */
+    long profile() const {
+        const Derived *self = static_cast<const Derived *>(this);
+        long res = 0;
+        for (int i = 0; i < self->nRows(); i++) {
+            for (int j = 0; j < i && j < self->nCols(); j++) {
+                if (self->getEntry(i, j) != 0) {
+                    res += i - j;
+                    break;
+                }
+            }
+        }
+        return res;
+    }
+
+    /**
+     * Return true if the magnitude of every diagonal entry is at least the
+     * sum of the magnitudes of the other entries in its row. If `strict` is
+     * set, the diagonal must be strictly larger.
+     */
+    bool isDiagonallyDominant(bool strict = false) const {
+        const Derived *self = static_cast<const Derived *>(this);
+        if (self->nRows() != self->nCols()) return false;
+        for (int i = 0; i < self->nRows(); i++) {
+            double acc = 0.0;
+            for (int j = 0; j < self->nCols(); j++) {
+                if (j != i) acc += std::abs(self->getEntry(i, j));
+            }
+            double d = std::abs(self->getEntry(i, i));
+            if (strict ? d <= acc: d < acc) return false;
+        }
+        return true;
+    }
+
     Derived cholesky() const {
         const Derived *self = static_cast<const Derived *>(this);
         int M = self->nRows();
         int N = self->nCols();
+        ZOP_INSTRUMENT("cholesky", (double) M * M * M / 3.0, 16.0 * M * N);
 
         typename Derived::Builder L{M, N};
 
@@ -190,6 +277,7 @@ public:
         if (M != N) {
             throw std::runtime_error("matrix must be square");
         }
+        ZOP_INSTRUMENT("LU", 2.0 * N * N * N / 3.0, 24.0 * N * N);
 
         typename Derived::Builder lower{N, N};
         typename Derived::Builder upper{N, N};
@@ -228,7 +316,9 @@ public:
     Vector operator*(const Vector &v) const {
         const Derived *self = static_cast<const Derived *>(this);
         if (v.dim() != self->nCols()) throw DimensionMismatchException{};
-        Vector res(v.dim());
+        ZOP_INSTRUMENT("operator*(Vector)", 2.0 * instrumentation::entryCount(*self),
+                       8.0 * (instrumentation::entryCount(*self) + self->nRows() + self->nCols()));
+        Vector res(self->nRows());
         for (int i = 0; i < self->nRows(); i++) {
            res[i] = self->row(i).dot(v);
         }
@@ -241,6 +331,8 @@ public:
         if (self->nCols() != B.nRows()) {
             throw std::runtime_error("error: dimension mismatch");
         }
+        ZOP_INSTRUMENT("operator*(Matrix)", 2.0 * self->nRows() * self->nCols() * B.nCols(),
+                       8.0 * (instrumentation::entryCount(*self) + instrumentation::entryCount(B)));
 
         Derived B_T = B.transposed();
         typename Derived::Builder res{self->nRows(), B.nCols()};
@@ -253,11 +345,11 @@ public:
         return Derived(std::move(res));
     }
 
-    Derived operator+(const Derived &B) {
+    Derived operator+(const Derived &B) const {
         const Derived *self = static_cast<const Derived *>(this);
 
-        if (self->nCols() != B.nRows()) {
-            throw std::runtime_error("error: dimension mismatch");
+        if (self->nRows() != B.nRows() || self->nCols() != B.nCols()) {
+            throw DimensionMismatchException{};
         }
 
         typename Derived::Builder res{self->nRows(), B.nCols()};
@@ -270,11 +362,11 @@ public:
         return Derived(std::move(res));
     }
 
-    Derived operator-(const Derived &B) {
+    Derived operator-(const Derived &B) const {
         const Derived *self = static_cast<const Derived *>(this);
 
-        if (self->nCols() != B.nRows()) {
-            throw std::runtime_error("error: dimension mismatch");
+        if (self->nRows() != B.nRows() || self->nCols() != B.nCols()) {
+            throw DimensionMismatchException{};
         }
 
         typename Derived::Builder res{self->nRows(), B.nCols()};
@@ -287,13 +379,19 @@ public:
         return Derived(std::move(res));
     }
 
-    friend bool operator==(const Derived &A, const Derived &B) {
-        if (A.nRows() != B.nRows() || A.nCols() != B.nCols()) {
+    /**
+     * Return true if both matrices have the same dimensions and entries.
+     * This is the implementation of `operator==`, and can be overridden by
+     * a subclass with a sparsity-aware comparison.
+     */
+    bool equals(const Derived &B) const {
+        const Derived *self = static_cast<const Derived *>(this);
+        if (self->nRows() != B.nRows() || self->nCols() != B.nCols()) {
             return false;
         }
-        for (int i = 0; i < A.nRows(); i++) {
-            for (int j = 0; j < A.nCols(); j++) {
-                if(A.getEntry(i, j) != B.getEntry(i, j)) {
+        for (int i = 0; i < self->nRows(); i++) {
+            for (int j = 0; j < self->nCols(); j++) {
+                if(self->getEntry(i, j) != B.getEntry(i, j)) {
                     return false;
                 }
             }
@@ -301,6 +399,10 @@ public:
         return true;
     }
 
+    friend bool operator==(const Derived &A, const Derived &B) {
+        return A.equals(B);
+    }
+
     friend bool operator!=(const Derived &A, const Derived &B) {
         return !(A == B);
     }
@@ -0,0 +1,467 @@
+#ifndef ZOP_MATRIX_VIEW_H
+#define ZOP_MATRIX_VIEW_H
+
+/**
+ *  \file MatrixView.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains non-owning views of matrices: the transpose of a
+ *  matrix, a contiguous block of rows and columns, and a strided selection
+ *  of rows and columns. Views never copy the entries of the underlying
+ *  matrix, which must outlive them.
+ */
+
+#include <vector>
+#include <cassert>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+#include <Matrix.h>
+#include <Vector.h>
+#include <DenseMatrix.h>
+#include <SparseMatrix.h>
+#include <Kernels.h>
+#include <Parallel.h>
+
+namespace zop {
+
+namespace detail {
+
+/**
+ * Return the sum of A(i, c0 + k * stride) x[k] for k < x.dim(). The
+ * overloads for the concrete formats read the row in place, while the
+ * generic version falls back to `getEntry`.
+ */
+template <class M>
+double stridedRowDot(const M &A, int i, int c0, int stride, const Vector &x) {
+    double res = 0.0;
+    for (int k = 0; k < x.dim(); k++) {
+        res += A.getEntry(i, c0 + k * stride) * x[k];
+    }
+    return res;
+}
+
+inline double stridedRowDot(const DenseMatrix &A, int i, int c0, int stride, const Vector &x) {
+    const double *row = A.row(i).data() + c0;
+    double res = 0.0;
+    if (stride == 1) {
+        for (int k = 0; k < x.dim(); k++) res += row[k] * x[k];
+    } else {
+        for (int k = 0; k < x.dim(); k++) res += row[(size_t) k * stride] * x[k];
+    }
+    return res;
+}
+
+/**
+ * The column indices of a row are sorted, so the entries inside the column
+ * range are found with a binary search and visited once.
+ */
+inline double stridedRowDot(const CSRSparseMatrix &A, int i, int c0, int stride, const Vector &x) {
+    if (x.dim() == 0) return 0.0;
+    const int *cols = A.columnIndices().data();
+    const double *vals = A.values().data();
+    const int *end = cols + A.rowIndices()[i + 1];
+    const int last = c0 + (x.dim() - 1) * stride;
+    double res = 0.0;
+    for (const int *c = std::lower_bound(cols + A.rowIndices()[i], end, c0); c != end && *c <= last; c++) {
+        int offset = *c - c0;
+        if (stride == 1) {
+            res += vals[c - cols] * x[offset];
+        } else if (offset % stride == 0) {
+            res += vals[c - cols] * x[offset / stride];
+        }
+    }
+    return res;
+}
+
+/**
+ * Return Aᵀx without forming Aᵀ.
+ */
+template <class M>
+Vector transposedMultiply(const M &A, const Vector &x) {
+    Vector res(A.nCols());
+    parallel::parallelFor(0, A.nCols(), [&](int j) {
+        double acc = 0.0;
+        for (int i = 0; i < A.nRows(); i++) acc += A.getEntry(i, j) * x[i];
+        res[j] = acc;
+    });
+    return res;
+}
+
+/**
+ * Each thread owns a range of columns of the result and accumulates the
+ * rows of A into it, so the rows are read in storage order.
+ */
+inline Vector transposedMultiply(const DenseMatrix &A, const Vector &x) {
+    Vector res(A.nCols());
+    parallel::parallelForRange(0, A.nCols(), [&](int a, int b) {
+        double *y = res.data();
+        for (int i = 0; i < A.nRows(); i++) {
+            const double *row = A.row(i).data();
+            double s = x[i];
+            if (s == 0.0) continue;
+            for (int j = a; j < b; j++) y[j] += row[j] * s;
+        }
+    });
+    return res;
+}
+
+/**
+ * The CSR kernel scatters balanced ranges of rows into per-thread buffers
+ * that are kept between calls, so only the result is allocated.
+ */
+inline Vector transposedMultiply(const CSRSparseMatrix &A, const Vector &x) {
+    Vector res(A.nCols());
+    multiplyTransposed(A, x, res);
+    return res;
+}
+
+inline Vector transposedMultiply(const DOKSparseMatrix &A, const Vector &x) {
+    Vector res(A.nCols());
+    for (const auto &[loc, v]: A) {
+        res[loc.second] += v * x[loc.first];
+    }
+    return res;
+}
+
+/**
+ * Return the sum of A(k, j) x[k] over the rows k, the dot product of
+ * column j of A with x. The generic version falls back to `getEntry`.
+ */
+template <class M>
+double columnDot(const M &A, int j, const Vector &x) {
+    double res = 0.0;
+    for (int k = 0; k < x.dim(); k++) res += A.getEntry(k, j) * x[k];
+    return res;
+}
+
+inline double columnDot(const DenseMatrix &A, int j, const Vector &x) {
+    double res = 0.0;
+    for (int k = 0; k < x.dim(); k++) res += A.row(k).data()[j] * x[k];
+    return res;
+}
+
+/**
+ * A row is only searched if its first and last columns enclose j, so for a
+ * banded matrix all but a few rows are skipped in constant time.
+ */
+inline double columnDot(const CSRSparseMatrix &A, int j, const Vector &x) {
+    const int *offsets = A.rowIndices().data();
+    const int *cols = A.columnIndices().data();
+    const double *vals = A.values().data();
+    double res = 0.0;
+    for (int k = 0; k < x.dim(); k++) {
+        const int *first = cols + offsets[k], *last = cols + offsets[k + 1];
+        if (first == last || j < *first || j > last[-1]) continue;
+        const int *c = std::lower_bound(first, last, j);
+        if (*c == j) res += vals[c - cols] * x[k];
+    }
+    return res;
+}
+
+/**
+ * A row of a view, which forwards to the `rowDot` kernel of the view.
+ */
+template <class View>
+class ViewRow {
+private:
+    const View *view_;
+    int i_;
+
+public:
+    ViewRow(const View *view, int i): view_{view}, i_{i} {}
+
+    double operator[](int j) const {
+        return view_->getEntry(i_, j);
+    }
+
+    double dot(const Vector &v) const {
+        if (v.dim() != view_->nCols()) throw DimensionMismatchException{};
+        return view_->rowDot(i_, v);
+    }
+};
+
+/**
+ * The base of the views. The operations of AbstractMatrix that build a new
+ * matrix cannot return a view, which owns no entries, so here they return
+ * a matrix of the underlying type M instead, computed from a copy of the
+ * view. The factories of AbstractMatrix, which have no matrix to view,
+ * are deleted.
+ */
+template <class View, class M>
+class MatrixViewBase: public AbstractMatrix<View> {
+private:
+    const View& self() const {
+        return static_cast<const View &>(*this);
+    }
+
+public:
+    using Materialized = std::remove_const_t<M>;
+
+    /**
+     * Return a copy of the entries of the view.
+     */
+    Materialized materialized() const {
+        const View &V = self();
+        typename Materialized::Builder res{V.nRows(), V.nCols()};
+        for (int i = 0; i < V.nRows(); i++) {
+            for (int j = 0; j < V.nCols(); j++) {
+                double v = V.getEntry(i, j);
+                if (v != 0.0) res.setEntry(i, j, v);
+            }
+        }
+        return Materialized(std::move(res));
+    }
+
+    Materialized operator+(const View &B) const {
+        return self().materialized() + B.materialized();
+    }
+
+    Materialized operator-(const View &B) const {
+        return self().materialized() - B.materialized();
+    }
+
+    Materialized operator*(const View &B) const {
+        return self().materialized() * B.materialized();
+    }
+
+    Materialized cholesky() const {
+        return self().materialized().cholesky();
+    }
+
+    std::pair<Materialized, Materialized> LU() const {
+        return self().materialized().LU();
+    }
+
+    static View Identity(int rows, int cols) = delete;
+    static View AffineScale(double r) = delete;
+    static View AffineTranslation(double x, double y, double z) = delete;
+    static View AffineRotationX(double r) = delete;
+    static View AffineRotationY(double r) = delete;
+    static View AffineRotationZ(double r) = delete;
+};
+
+}
+
+/**
+ * A view of the transpose of a matrix. Entry (i, j) of the view is entry
+ * (j, i) of the matrix. Multiplying the view with a vector runs a
+ * transposed kernel on the matrix instead of materializing it.
+ *
+ * If M is not const, entries can also be written through the view.
+ */
+template <class M>
+class TransposeView: public detail::MatrixViewBase<TransposeView<M>, M> {
+private:
+    M *mat_;
+
+public:
+    using Builder = typename std::remove_const_t<M>::Builder;
+    using Row = detail::ViewRow<TransposeView>;
+    using detail::MatrixViewBase<TransposeView, M>::operator*;
+
+    explicit TransposeView(M &A): mat_{&A} {}
+
+    int nRows() const { return mat_->nCols(); }
+    int nCols() const { return mat_->nRows(); }
+
+    double getEntry(int i, int j) const {
+        assert(0 <= i && i < nRows() && 0 <= j && j < nCols());
+        return mat_->getEntry(j, i);
+    }
+
+    void setEntry(int i, int j, double v) {
+        assert(0 <= i && i < nRows() && 0 <= j && j < nCols());
+        mat_->setEntry(j, i, v);
+    }
+
+    Row row(int i) const {
+        assert(0 <= i && i < nRows());
+        return Row{this, i};
+    }
+
+    /**
+     * Return the dot product of row i of the view, which is column i of the
+     * matrix, with x.
+     */
+    double rowDot(int i, const Vector &x) const {
+        return detail::columnDot(*mat_, i, x);
+    }
+
+    /**
+     * The transpose of the view is the underlying matrix.
+     */
+    M& transposed() const {
+        return *mat_;
+    }
+
+    /**
+     * Return a copy of the view, which is the transpose of the matrix.
+     */
+    std::remove_const_t<M> materialized() const {
+        return mat_->transposed();
+    }
+
+    Vector operator*(const Vector &v) const {
+        if (v.dim() != nCols()) throw DimensionMismatchException{};
+        return detail::transposedMultiply(*mat_, v);
+    }
+};
+
+/**
+ * A view of the block of a matrix made of the rows [r0, r0 + nRows) and
+ * the columns [c0, c0 + nCols). Rows of dense and CSR matrices are read in
+ * place, so multiplying the block with a vector costs no more than the
+ * entries of the block.
+ */
+template <class M>
+class BlockView: public detail::MatrixViewBase<BlockView<M>, M> {
+private:
+    M *mat_;
+    int r0_;
+    int c0_;
+    int nRows_;
+    int nCols_;
+
+public:
+    using Builder = typename std::remove_const_t<M>::Builder;
+    using Row = detail::ViewRow<BlockView>;
+    using detail::MatrixViewBase<BlockView, M>::operator*;
+
+    BlockView(M &A, int r0, int nRows, int c0, int nCols):
+        mat_{&A}, r0_{r0}, c0_{c0}, nRows_{nRows}, nCols_{nCols} {
+        if (r0 < 0 || c0 < 0 || nRows < 0 || nCols < 0 ||
+            r0 + nRows > A.nRows() || c0 + nCols > A.nCols()) {
+            throw std::runtime_error("block out of range");
+        }
+    }
+
+    int nRows() const { return nRows_; }
+    int nCols() const { return nCols_; }
+    int firstRow() const { return r0_; }
+    int firstColumn() const { return c0_; }
+
+    double getEntry(int i, int j) const {
+        assert(0 <= i && i < nRows_ && 0 <= j && j < nCols_);
+        return mat_->getEntry(r0_ + i, c0_ + j);
+    }
+
+    void setEntry(int i, int j, double v) {
+        assert(0 <= i && i < nRows_ && 0 <= j && j < nCols_);
+        mat_->setEntry(r0_ + i, c0_ + j, v);
+    }
+
+    Row row(int i) const {
+        assert(0 <= i && i < nRows_);
+        return Row{this, i};
+    }
+
+    double rowDot(int i, const Vector &x) const {
+        return detail::stridedRowDot(*mat_, r0_ + i, c0_, 1, x);
+    }
+
+    Vector operator*(const Vector &v) const {
+        if (v.dim() != nCols_) throw DimensionMismatchException{};
+        Vector res(nRows_);
+        parallel::parallelFor(0, nRows_, [&](int i) {
+            res[i] = rowDot(i, v);
+        });
+        return res;
+    }
+};
+
+/**
+ * A view of the rows r0 + i * rowStride for i < nRows and the columns
+ * c0 + j * colStride for j < nCols of a matrix, for example every other
+ * row of a grid or one color of a red-black ordering.
+ */
+template <class M>
+class StridedView: public detail::MatrixViewBase<StridedView<M>, M> {
+private:
+    M *mat_;
+    int r0_;
+    int c0_;
+    int nRows_;
+    int nCols_;
+    int rowStride_;
+    int colStride_;
+
+public:
+    using Builder = typename std::remove_const_t<M>::Builder;
+    using Row = detail::ViewRow<StridedView>;
+    using detail::MatrixViewBase<StridedView, M>::operator*;
+
+    StridedView(M &A, int r0, int nRows, int rowStride, int c0, int nCols, int colStride):
+        mat_{&A}, r0_{r0}, c0_{c0}, nRows_{nRows}, nCols_{nCols},
+        rowStride_{rowStride}, colStride_{colStride} {
+        if (rowStride < 1 || colStride < 1 || r0 < 0 || c0 < 0 || nRows < 0 || nCols < 0 ||
+            (nRows > 0 && r0 + (nRows - 1) * rowStride >= A.nRows()) ||
+            (nCols > 0 && c0 + (nCols - 1) * colStride >= A.nCols())) {
+            throw std::runtime_error("strided view out of range");
+        }
+    }
+
+    int nRows() const { return nRows_; }
+    int nCols() const { return nCols_; }
+    int rowStride() const { return rowStride_; }
+    int columnStride() const { return colStride_; }
+
+    double getEntry(int i, int j) const {
+        assert(0 <= i && i < nRows_ && 0 <= j && j < nCols_);
+        return mat_->getEntry(r0_ + i * rowStride_, c0_ + j * colStride_);
+    }
+
+    void setEntry(int i, int j, double v) {
+        assert(0 <= i && i < nRows_ && 0 <= j && j < nCols_);
+        mat_->setEntry(r0_ + i * rowStride_, c0_ + j * colStride_, v);
+    }
+
+    Row row(int i) const {
+        assert(0 <= i && i < nRows_);
+        return Row{this, i};
+    }
+
+    double rowDot(int i, const Vector &x) const {
+        return detail::stridedRowDot(*mat_, r0_ + i * rowStride_, c0_, colStride_, x);
+    }
+
+    Vector operator*(const Vector &v) const {
+        if (v.dim() != nCols_) throw DimensionMismatchException{};
+        Vector res(nRows_);
+        parallel::parallelFor(0, nRows_, [&](int i) {
+            res[i] = rowDot(i, v);
+        });
+        return res;
+    }
+};
+
+/**
+ * Return a view of the transpose of A.
+ */
+template <class M>
+TransposeView<M> transposeView(M &A) {
+    return TransposeView<M>{A};
+}
+
+/**
+ * Return a view of the rows [r0, r0 + nRows) and the columns
+ * [c0, c0 + nCols) of A.
+ */
+template <class M>
+BlockView<M> blockView(M &A, int r0, int nRows, int c0, int nCols) {
+    return BlockView<M>{A, r0, nRows, c0, nCols};
+}
+
+/**
+ * Return a view of every rowStride-th row starting at r0 and every
+ * colStride-th column starting at c0 of A.
+ */
+template <class M>
+StridedView<M> stridedView(M &A, int r0, int nRows, int rowStride, int c0, int nCols, int colStride) {
+    return StridedView<M>{A, r0, nRows, rowStride, c0, nCols, colStride};
+}
+
+}
+
+#endif /* ZOP_MATRIX_VIEW_H */
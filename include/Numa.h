@@ -0,0 +1,442 @@
+#ifndef ZOP_NUMA_H
+#define ZOP_NUMA_H
+
+/**
+ *  \file Numa.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains controls for running the parallel kernels on machines
+ *  with several NUMA nodes: the node topology, pinning of the pool threads,
+ *  placement of matrix and vector storage next to the threads that use it,
+ *  and vectors replicated on every node.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <algorithm>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+#include <Vector.h>
+#include <Kernels.h>
+#include <SparseMatrix.h>
+#include <Parallel.h>
+#include <Instrumentation.h>
+
+namespace zop::numa {
+
+/**
+ * The NUMA nodes of the machine, each with the CPUs this process may run
+ * on, and the system's number for it in ids. Machines without NUMA
+ * information have a single node holding every CPU.
+ */
+struct Topology {
+    std::vector<std::vector<int>> nodes;
+    std::vector<int> ids;
+
+    int nNodes() const {
+        return nodes.size();
+    }
+
+    /**
+     * Return the node of the given CPU, or 0 if it is unknown.
+     */
+    int nodeOf(int cpu) const {
+        for (int k = 0; k < nNodes(); k++) {
+            if (std::binary_search(nodes[k].begin(), nodes[k].end(), cpu)) return k;
+        }
+        return 0;
+    }
+};
+
+namespace detail {
+
+    /**
+     * Parse a Linux CPU list such as "0-3,8,10-11".
+     */
+    inline std::vector<int> parseCpuList(const std::string &list) {
+        std::vector<int> cpus;
+        std::size_t pos = 0;
+        while (pos < list.size()) {
+            std::size_t end = list.find(',', pos);
+            if (end == std::string::npos) end = list.size();
+            std::string range = list.substr(pos, end - pos);
+            std::size_t dash = range.find('-');
+            if (range.find_first_of("0123456789") != std::string::npos) {
+                int a = std::stoi(range.substr(0, dash));
+                int b = dash == std::string::npos ? a: std::stoi(range.substr(dash + 1));
+                for (int c = a; c <= b; c++) cpus.push_back(c);
+            }
+            pos = end + 1;
+        }
+        return cpus;
+    }
+
+    /**
+     * Return the CPUs this process may run on.
+     */
+    inline std::vector<int> allowedCpus() {
+        std::vector<int> cpus;
+#if defined(__linux__)
+        cpu_set_t set;
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int c = 0; c < CPU_SETSIZE; c++) {
+                if (CPU_ISSET(c, &set)) cpus.push_back(c);
+            }
+        }
+#endif
+        if (cpus.empty()) {
+            for (int c = 0; c < (int) std::max(1u, std::thread::hardware_concurrency()); c++) cpus.push_back(c);
+        }
+        return cpus;
+    }
+
+    inline std::string readLine(const std::string &path) {
+        std::ifstream in(path);
+        std::string line;
+        std::getline(in, line);
+        return line;
+    }
+
+    /**
+     * Read the online nodes from /sys/devices/system/node, keeping the
+     * allowed CPUs and the nodes that have any.
+     */
+    inline Topology readTopology() {
+        const std::string root = "/sys/devices/system/node/";
+        std::vector<int> allowed = allowedCpus();
+        Topology topology;
+        for (int id: parseCpuList(readLine(root + "online"))) {
+            std::vector<int> cpus;
+            for (int c: parseCpuList(readLine(root + "node" + std::to_string(id) + "/cpulist"))) {
+                if (std::binary_search(allowed.begin(), allowed.end(), c)) cpus.push_back(c);
+            }
+            if (cpus.empty()) continue;
+            topology.nodes.push_back(cpus);
+            topology.ids.push_back(id);
+        }
+        if (topology.nodes.empty()) {
+            topology.nodes.push_back(allowed);
+            topology.ids.push_back(0);
+        }
+        return topology;
+    }
+
+    // The CPUs of the process before any pinning, for unpinThreads(). They
+    // are read during static initialization, and again by pinThreads()
+    // before it pins anything in case that runs first: read lazily on a
+    // pinned thread, they would hold a single CPU.
+    inline const std::vector<int>& initialCpus() {
+        static const std::vector<int> cpus = allowedCpus();
+        return cpus;
+    }
+
+    inline const std::vector<int> &startupCpus = initialCpus();
+
+    inline bool pinToCpus(const std::vector<int> &cpus) {
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int c: cpus) CPU_SET(c, &set);
+        return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+        (void) cpus;
+        return false;
+#endif
+    }
+
+    /**
+     * Move the pages holding [begin, begin + bytes) to the node with the
+     * given system number. This is best effort: pages that cannot be moved
+     * stay where they are.
+     */
+    inline void movePages(const void *begin, std::size_t bytes, int node) {
+#if defined(__linux__) && defined(SYS_move_pages)
+        if (bytes == 0) return;
+        const std::uintptr_t page = sysconf(_SC_PAGESIZE);
+        std::uintptr_t first = (std::uintptr_t) begin / page * page;
+        std::uintptr_t last = (std::uintptr_t) begin + bytes;
+        std::vector<void *> pages;
+        for (std::uintptr_t p = first; p < last; p += page) pages.push_back((void *) p);
+        std::vector<int> nodes(pages.size(), node), status(pages.size());
+        const int moveOwnPages = 1 << 1;
+        syscall(SYS_move_pages, 0, pages.size(), pages.data(), nodes.data(), status.data(), moveOwnPages);
+#else
+        (void) begin;
+        (void) bytes;
+        (void) node;
+#endif
+    }
+
+    /**
+     * Call f(t, n) on every thread of the global pool, or return false
+     * without calling it when the pool cannot be used: parallel::run()
+     * falls back to a single call on the calling thread when the pool is
+     * busy, from inside a task or after a fork, and pinning or placing from
+     * that call alone would apply the share of every thread to one.
+     */
+    template <class F>
+    bool onEveryThread(F &&f) {
+        const int expected = parallel::threadCount();
+        std::atomic<bool> ran{true};
+        parallel::forEachThread([&](int t, int n) {
+            if (n != expected) {
+                ran = false;
+                return;
+            }
+            f(t, n);
+        });
+        return ran;
+    }
+
+    template <class T>
+    void moveRange(const std::vector<T> &v, int a, int b, int node) {
+        if (a < b) movePages(v.data() + a, sizeof(T) * (b - a), node);
+    }
+
+}
+
+/**
+ * Return the topology of the machine, read once on first use.
+ */
+inline const Topology& topology() {
+    static const Topology topology = detail::readTopology();
+    return topology;
+}
+
+/**
+ * Return the CPU the calling thread runs on, or -1 if it is unknown.
+ */
+inline int currentCpu() {
+#if defined(__linux__)
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+/**
+ * Return the node the calling thread runs on. Unless the thread is pinned,
+ * the scheduler may move it to another node at any time.
+ */
+inline int currentNode() {
+    return topology().nNodes() == 1 ? 0: topology().nodeOf(currentCpu());
+}
+
+/**
+ * How pinThreads() assigns CPUs to the threads of the pool: Compact fills
+ * the CPUs of one node before moving to the next, while Scatter deals the
+ * threads out to the nodes in turn, so that few threads use the memory
+ * bandwidth of every node.
+ */
+enum class Placement { Compact, Scatter };
+
+/**
+ * Return the CPU that pinThreads() assigns to thread t of the pool.
+ */
+inline int pinnedCpu(int t, Placement placement) {
+    const auto &nodes = topology().nodes;
+    std::vector<int> order;
+    if (placement == Placement::Compact) {
+        for (auto &cpus: nodes) order.insert(order.end(), cpus.begin(), cpus.end());
+    } else {
+        std::size_t longest = 0;
+        for (auto &cpus: nodes) longest = std::max(longest, cpus.size());
+        for (std::size_t i = 0; i < longest; i++) {
+            for (auto &cpus: nodes) {
+                if (i < cpus.size()) order.push_back(cpus[i]);
+            }
+        }
+    }
+    return order[t % order.size()];
+}
+
+/**
+ * Pin every thread of the global pool to one CPU, including the calling
+ * thread, which runs the share of thread 0. Threads beyond the number of
+ * CPUs wrap around. Returns whether every thread was pinned, which is not
+ * the case when affinity is unavailable or the pool is busy, as from
+ * inside a parallel task; then no thread is pinned. Pinning is lost when
+ * the pool is replaced by parallel::setThreadCount().
+ */
+inline bool pinThreads(Placement placement = Placement::Scatter) {
+    detail::initialCpus();
+    std::atomic<bool> pinned{true};
+    bool ran = detail::onEveryThread([&](int t, int) {
+        if (!detail::pinToCpus({pinnedCpu(t, placement)})) pinned = false;
+    });
+    return ran && pinned;
+}
+
+/**
+ * Let every thread of the global pool run on all the CPUs the process
+ * started with. Returns false if the pool is busy and nothing was done.
+ */
+inline bool unpinThreads() {
+    return detail::onEveryThread([&](int, int) { detail::pinToCpus(detail::initialCpus()); });
+}
+
+/**
+ * Pins the threads of the global pool for the lifetime of the object, and
+ * unpins them when it is destroyed.
+ */
+class ScopedPinning {
+private:
+    bool pinned_;
+
+public:
+
+    explicit ScopedPinning(Placement placement = Placement::Scatter):
+        pinned_{pinThreads(placement)} {}
+
+    ScopedPinning(const ScopedPinning &) = delete;
+    ScopedPinning& operator=(const ScopedPinning &) = delete;
+
+    ~ScopedPinning() {
+        unpinThreads();
+    }
+
+    /**
+     * Return whether every thread was pinned.
+     */
+    bool pinned() const {
+        return pinned_;
+    }
+};
+
+/**
+ * Move the storage of A to the nodes of the threads that read it: every
+ * thread moves the rows that the CSR kernels assign to it to its own node,
+ * as if it had written them first. This is best effort and only useful
+ * with pinned threads; on a machine with one node it has no effect.
+ * Returns false without moving anything if the pool is busy, as from
+ * inside a parallel task.
+ */
+inline bool place(const CSRSparseMatrix &A) {
+    const std::vector<int> &offsets = A.rowIndices();
+    return detail::onEveryThread([&](int t, int n) {
+        auto [a, b] = parallel::balancedRange(offsets.data(), A.nRows(), t, n);
+        int node = topology().ids[currentNode()];
+        detail::moveRange(offsets, a, b + 1, node);
+        detail::moveRange(A.columnIndices(), offsets[a], offsets[b], node);
+        detail::moveRange(A.values(), offsets[a], offsets[b], node);
+    });
+}
+
+/**
+ * Move the entries of y to the nodes of the threads that write them in a
+ * product with A, or return false as place(A) does.
+ */
+inline bool place(const Vector &y, const CSRSparseMatrix &A) {
+    if (y.dim() != A.nRows()) throw DimensionMismatchException{};
+    return detail::onEveryThread([&](int t, int n) {
+        auto [a, b] = parallel::balancedRange(A.rowIndices().data(), A.nRows(), t, n);
+        if (a < b) detail::movePages(y.data() + a, sizeof(double) * (b - a), topology().ids[currentNode()]);
+    });
+}
+
+/**
+ * Move the entries of x to the nodes of the threads that own them in
+ * parallel::parallelFor(), which the vector operations use, or return
+ * false as place(A) does.
+ */
+inline bool place(const Vector &x) {
+    return detail::onEveryThread([&](int t, int n) {
+        auto [a, b] = parallel::blockRange(0, x.dim(), t, n);
+        if (a < b) detail::movePages(x.data() + a, sizeof(double) * (b - a), topology().ids[currentNode()]);
+    });
+}
+
+/**
+ * A read-mostly vector with one copy on every node, so that the gathers of
+ * a sparse product read local memory on every socket. Each copy is
+ * allocated and first written by a pool thread on its node, which places
+ * its pages there; copies of nodes without pool threads are written by the
+ * calling thread.
+ */
+class ReplicatedVector {
+private:
+    int dim_ = 0;
+    std::vector<std::vector<double>> copies_;
+
+public:
+
+    explicit ReplicatedVector(const Vector &x):
+        copies_(topology().nNodes()) {
+        assign(x);
+    }
+
+    int dim() const {
+        return dim_;
+    }
+
+    int nCopies() const {
+        return copies_.size();
+    }
+
+    /**
+     * Overwrite every copy with x. The copies keep their pages, so the
+     * placement of the first call stays in effect.
+     */
+    void assign(const Vector &x) {
+        dim_ = x.dim();
+        std::unique_ptr<std::atomic<bool>[]> claimed(new std::atomic<bool>[copies_.size()]);
+        for (std::size_t k = 0; k < copies_.size(); k++) claimed[k] = false;
+        parallel::forEachThread([&](int, int) {
+            int node = currentNode();
+            if (claimed[node].exchange(true)) return;
+            copies_[node].assign(x.data(), x.data() + x.dim());
+        });
+        for (std::size_t k = 0; k < copies_.size(); k++) {
+            if (!claimed[k]) copies_[k].assign(x.data(), x.data() + x.dim());
+        }
+    }
+
+    const double* data(int node) const {
+        return copies_[node].data();
+    }
+
+    /**
+     * Return the copy on the node of the calling thread.
+     */
+    const double* local() const {
+        return data(currentNode());
+    }
+};
+
+/**
+ * y = αAx + βy, where every thread gathers from the copy of x on its own
+ * node. The rows are split across threads as in zop::multiply, so the
+ * result is the same.
+ */
+inline void multiply(const CSRSparseMatrix &A, const ReplicatedVector &x, Vector &y,
+                     double alpha = 1.0, double beta = 0.0) {
+    if (x.dim() != A.nCols() || y.dim() != A.nRows()) throw DimensionMismatchException{};
+    ZOP_INSTRUMENT("spmv.numa", 2.0 * A.nnz(), 12.0 * A.nnz() + 4.0 * A.nRows() + 8.0 * (x.dim() + y.dim()));
+    const int *offsets = A.rowIndices().data();
+    const int *cols = A.columnIndices().data();
+    const double *vals = A.values().data();
+    double *py = y.data();
+    parallel::forEachThread([&](int t, int n) {
+        auto [a, b] = parallel::balancedRange(offsets, A.nRows(), t, n);
+        const double *px = x.local();
+        for (int i = a; i < b; i++) {
+            double acc = 0.0;
+            for (int k = offsets[i]; k < offsets[i + 1]; k++) acc += vals[k] * px[cols[k]];
+            py[i] = zop::detail::scaled(acc, alpha, beta, py[i]);
+        }
+    });
+}
+
+}
+
+#endif /* ZOP_NUMA_H */
@@ -0,0 +1,349 @@
+#ifndef ZOP_ORDERING_H
+#define ZOP_ORDERING_H
+
+/**
+ *  \file Ordering.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains fill-reducing and bandwidth-reducing orderings of
+ *  sparse matrices.
+ */
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include <SparseMatrix.h>
+#include <Permutation.h>
+
+namespace zop::ordering {
+
+/**
+ * The adjacency graph of a square sparse matrix. There is an edge between i
+ * and j if either a_ij or a_ji is stored and i != j, so the graph of a
+ * non-symmetric matrix is the graph of A + Aᵀ.
+ */
+class Graph {
+private:
+    std::vector<int> offsets_;
+    std::vector<int> adjacency_;
+
+public:
+
+    explicit Graph(const CSRSparseMatrix &A) {
+        if (A.nRows() != A.nCols()) {
+            throw std::runtime_error("matrix must be square");
+        }
+        int n = A.nRows();
+        const auto &rows = A.rowIndices();
+        const auto &cols = A.columnIndices();
+
+        std::vector<int> counts(n + 1, 0);
+        for (int i = 0; i < n; i++) {
+            for (int k = rows[i]; k < rows[i + 1]; k++) {
+                if (cols[k] == i) continue;
+                counts[i + 1] += 1;
+                counts[cols[k] + 1] += 1;
+            }
+        }
+        for (int i = 0; i < n; i++) {
+            counts[i + 1] += counts[i];
+        }
+
+        std::vector<int> adjacency(counts[n]);
+        std::vector<int> next(counts.begin(), counts.end() - 1);
+        for (int i = 0; i < n; i++) {
+            for (int k = rows[i]; k < rows[i + 1]; k++) {
+                int j = cols[k];
+                if (j == i) continue;
+                adjacency[next[i]++] = j;
+                adjacency[next[j]++] = i;
+            }
+        }
+
+        // Entries stored in both triangles produce every edge twice.
+        offsets_.resize(n + 1);
+        offsets_[0] = 0;
+        for (int i = 0; i < n; i++) {
+            auto begin = adjacency.begin() + counts[i];
+            auto end = adjacency.begin() + counts[i + 1];
+            std::sort(begin, end);
+            end = std::unique(begin, end);
+            adjacency_.insert(adjacency_.end(), begin, end);
+            offsets_[i + 1] = adjacency_.size();
+        }
+    }
+
+    int size() const {
+        return (int) offsets_.size() - 1;
+    }
+
+    int degree(int i) const {
+        return offsets_[i + 1] - offsets_[i];
+    }
+
+    const int* begin(int i) const {
+        return adjacency_.data() + offsets_[i];
+    }
+
+    const int* end(int i) const {
+        return adjacency_.data() + offsets_[i + 1];
+    }
+};
+
+namespace detail {
+
+    /**
+     * Perform a breadth-first search from root over the nodes that have not
+     * been ordered yet. Returns the eccentricity of the root and stores the
+     * nodes of the last level in `last`.
+     */
+    inline int levelStructure(const Graph &g, int root, const std::vector<char> &ordered,
+                              std::vector<int> &level, std::vector<int> &queue, std::vector<int> &last) {
+        queue.clear();
+        queue.push_back(root);
+        level[root] = 0;
+        for (size_t h = 0; h < queue.size(); h++) {
+            int v = queue[h];
+            for (const int *u = g.begin(v); u != g.end(v); u++) {
+                if (!ordered[*u] && level[*u] == -1) {
+                    level[*u] = level[v] + 1;
+                    queue.push_back(*u);
+                }
+            }
+        }
+        int eccentricity = level[queue.back()];
+        last.clear();
+        for (int v: queue) {
+            if (level[v] == eccentricity) last.push_back(v);
+            level[v] = -1;
+        }
+        return eccentricity;
+    }
+
+    /**
+     * Find a pseudo-peripheral node of the component containing start using
+     * the algorithm of George and Liu: repeatedly move to a node of minimum
+     * degree in the last level of the current level structure for as long
+     * as the eccentricity keeps increasing.
+     */
+    inline int pseudoPeripheralNode(const Graph &g, int start, const std::vector<char> &ordered,
+                                    std::vector<int> &level, std::vector<int> &queue) {
+        std::vector<int> last;
+        int root = start;
+        int eccentricity = levelStructure(g, root, ordered, level, queue, last);
+        while (true) {
+            int candidate = *std::min_element(last.begin(), last.end(), [&](int a, int b) {
+                return g.degree(a) < g.degree(b);
+            });
+            int e = levelStructure(g, candidate, ordered, level, queue, last);
+            if (e <= eccentricity) return root;
+            root = candidate;
+            eccentricity = e;
+        }
+    }
+
+}
+
+/**
+ * Compute the reverse Cuthill-McKee ordering of a square sparse matrix.
+ *
+ * Each connected component of the adjacency graph is traversed breadth
+ * first from a pseudo-peripheral node, visiting the neighbours of every
+ * node in order of increasing degree, and the resulting order is reversed.
+ * This clusters the non-zero entries around the diagonal, which reduces the
+ * bandwidth and profile of the matrix and improves the cache reuse of the
+ * input vector during matrix-vector multiplication.
+ *
+ * The returned permutation should be applied with
+ * `CSRSparseMatrix::symmetricPermuted`.
+ */
+inline Permutation reverseCuthillMcKee(const CSRSparseMatrix &A) {
+    Graph g{A};
+    int n = g.size();
+
+    std::vector<int> order;
+    order.reserve(n);
+    std::vector<char> ordered(n, 0);
+    std::vector<int> level(n, -1);
+    std::vector<int> queue;
+    std::vector<int> neighbours;
+
+    // Start each component from its node of minimum degree.
+    std::vector<int> starts(n);
+    for (int i = 0; i < n; i++) starts[i] = i;
+    std::stable_sort(starts.begin(), starts.end(), [&](int a, int b) {
+        return g.degree(a) < g.degree(b);
+    });
+
+    for (int start: starts) {
+        if (ordered[start]) continue;
+        int root = detail::pseudoPeripheralNode(g, start, ordered, level, queue);
+
+        size_t head = order.size();
+        order.push_back(root);
+        ordered[root] = 1;
+        for (; head < order.size(); head++) {
+            int v = order[head];
+            neighbours.clear();
+            for (const int *u = g.begin(v); u != g.end(v); u++) {
+                if (!ordered[*u]) {
+                    ordered[*u] = 1;
+                    neighbours.push_back(*u);
+                }
+            }
+            std::stable_sort(neighbours.begin(), neighbours.end(), [&](int a, int b) {
+                return g.degree(a) < g.degree(b);
+            });
+            order.insert(order.end(), neighbours.begin(), neighbours.end());
+        }
+    }
+
+    std::reverse(order.begin(), order.end());
+    return Permutation(std::move(order));
+}
+
+/**
+ * Compute an approximate minimum degree (AMD) ordering of a square sparse
+ * matrix, which reduces the fill-in of Cholesky and LU factorizations.
+ *
+ * The elimination is simulated on a quotient graph. When a variable p is
+ * eliminated it becomes an element whose boundary Lp is the set of its
+ * uneliminated neighbours, and every element adjacent to p is absorbed into
+ * it, so the graph never grows. Instead of computing the exact external
+ * degree of every variable in Lp, which is expensive, the bound of Amestoy,
+ * Davis and Duff is used:
+ *
+ *     d(i) = min(n - k, d'(i) + |Lp \ i|, |Ai| + |Lp \ i| + Σ |Le \ Lp|)
+ *
+ * where d'(i) is the previous degree of i, Ai its remaining variable
+ * neighbours, and the sum ranges over the other elements adjacent to i.
+ * Elements whose boundary is a subset of Lp are absorbed as well.
+ * Supervariable detection is not performed.
+ *
+ * The returned permutation should be applied with
+ * `CSRSparseMatrix::symmetricPermuted`.
+ */
+inline Permutation approximateMinimumDegree(const CSRSparseMatrix &A) {
+    Graph g{A};
+    int n = g.size();
+
+    std::vector<std::vector<int>> variables(n);
+    std::vector<std::vector<int>> elements(n);
+    std::vector<std::vector<int>> boundary(n);
+    std::vector<int> degree(n);
+    for (int i = 0; i < n; i++) {
+        variables[i].assign(g.begin(i), g.end(i));
+        degree[i] = g.degree(i);
+    }
+
+    std::vector<char> eliminated(n, 0);
+    std::vector<char> absorbed(n, 0);
+    std::vector<int> mark(n, -1);
+    std::vector<int> w(n, -1);
+
+    // Variables are kept in doubly linked lists bucketed by degree.
+    std::vector<int> head(n + 1, -1), next(n, -1), prev(n, -1);
+    int minDegree = n;
+    auto insert = [&](int i) {
+        int d = degree[i];
+        prev[i] = -1;
+        next[i] = head[d];
+        if (head[d] != -1) prev[head[d]] = i;
+        head[d] = i;
+        minDegree = std::min(minDegree, d);
+    };
+    auto remove = [&](int i) {
+        if (prev[i] != -1) next[prev[i]] = next[i];
+        else head[degree[i]] = next[i];
+        if (next[i] != -1) prev[next[i]] = prev[i];
+    };
+    for (int i = 0; i < n; i++) {
+        insert(i);
+    }
+
+    std::vector<int> order;
+    order.reserve(n);
+    std::vector<int> touched;
+
+    for (int k = 0; k < n; k++) {
+        while (head[minDegree] == -1) minDegree++;
+        int p = head[minDegree];
+        remove(p);
+        order.push_back(p);
+        eliminated[p] = 1;
+
+        // Form the boundary of the new element p, absorbing the elements
+        // adjacent to p.
+        std::vector<int> Lp;
+        for (int j: variables[p]) {
+            if (!eliminated[j] && mark[j] != p) {
+                mark[j] = p;
+                Lp.push_back(j);
+            }
+        }
+        for (int e: elements[p]) {
+            if (absorbed[e]) continue;
+            for (int j: boundary[e]) {
+                if (!eliminated[j] && mark[j] != p) {
+                    mark[j] = p;
+                    Lp.push_back(j);
+                }
+            }
+            absorbed[e] = 1;
+            std::vector<int>().swap(boundary[e]);
+        }
+        std::vector<int>().swap(variables[p]);
+        std::vector<int>().swap(elements[p]);
+
+        // Compute |Le \ Lp| for every element adjacent to Lp.
+        touched.clear();
+        for (int i: Lp) {
+            for (int e: elements[i]) {
+                if (absorbed[e]) continue;
+                if (w[e] < 0) {
+                    w[e] = boundary[e].size();
+                    touched.push_back(e);
+                }
+                w[e] -= 1;
+            }
+        }
+
+        int remaining = n - k - 1;
+        int external = (int) Lp.size() - 1;
+        for (int i: Lp) {
+            auto &Ei = elements[i];
+            Ei.erase(std::remove_if(Ei.begin(), Ei.end(), [&](int e) {
+                if (!absorbed[e] && w[e] == 0) absorbed[e] = 1;
+                return absorbed[e];
+            }), Ei.end());
+
+            // Edges to other members of Lp are now represented by p.
+            auto &Ai = variables[i];
+            Ai.erase(std::remove_if(Ai.begin(), Ai.end(), [&](int j) {
+                return eliminated[j] || mark[j] == p;
+            }), Ai.end());
+
+            long bound = (long) Ai.size() + external;
+            for (int e: Ei) {
+                bound += w[e];
+            }
+            Ei.push_back(p);
+
+            remove(i);
+            degree[i] = (int) std::min<long>({(long) remaining, (long) degree[i] + external, bound});
+            insert(i);
+        }
+
+        for (int e: touched) {
+            w[e] = -1;
+        }
+        boundary[p] = std::move(Lp);
+    }
+
+    return Permutation(std::move(order));
+}
+
+}
+
+#endif /* ZOP_ORDERING_H */
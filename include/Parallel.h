@@ -0,0 +1,310 @@
+#ifndef ZOP_PARALLEL_H
+#define ZOP_PARALLEL_H
+
+/**
+ *  \file Parallel.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains the shared-memory parallel primitives used by the
+ *  matrix kernels.
+ */
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <type_traits>
+#include <cstdlib>
+#include <unistd.h>
+
+namespace zop::parallel {
+
+/**
+ * A fixed-size pool of worker threads. The pool runs one task at a time on
+ * every thread, including the calling thread, which keeps dispatch cheap and
+ * allocation-free: a task is handed to the workers as a function pointer and
+ * a context pointer rather than a `std::function`.
+ *
+ * Calls made while a task is already running (from a worker, from a second
+ * application thread, or from a forked child process) are executed serially
+ * on the calling thread instead of blocking.
+ */
+class ThreadPool {
+private:
+    int size_ = 1;
+    pid_t pid_ = 0;
+    std::vector<std::thread> workers_;
+
+    std::mutex dispatch_;
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    unsigned long generation_ = 0;
+    int pending_ = 0;
+    bool stop_ = false;
+    void (*task_)(void *, int, int) = nullptr;
+    void *context_ = nullptr;
+    std::exception_ptr error_;
+
+    static bool& insideTask() {
+        static thread_local bool inside = false;
+        return inside;
+    }
+
+    template <class F>
+    static void trampoline(void *context, int tid, int nThreads) {
+        (*static_cast<F *>(context))(tid, nThreads);
+    }
+
+    void work(int tid) {
+        unsigned long seen = 0;
+        while (true) {
+            void (*task)(void *, int, int);
+            void *context;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                start_.wait(lock, [&] { return generation_ != seen; });
+                seen = generation_;
+                if (stop_) return;
+                task = task_;
+                context = context_;
+            }
+
+            insideTask() = true;
+            try {
+                task(context, tid, size_);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!error_) error_ = std::current_exception();
+            }
+            insideTask() = false;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--pending_ == 0) done_.notify_one();
+        }
+    }
+
+public:
+
+    explicit ThreadPool(int size): size_{std::max(size, 1)}, pid_{getpid()} {
+        for (int tid = 1; tid < size_; tid++) {
+            workers_.emplace_back([this, tid] { work(tid); });
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool& operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+            generation_ += 1;
+        }
+        start_.notify_all();
+        for (auto &worker: workers_) {
+            worker.join();
+        }
+    }
+
+    int size() const {
+        return size_;
+    }
+
+    /**
+     * Run `f(tid, nThreads)` once on every thread of the pool and wait for
+     * all of them to finish. If the pool cannot be used, `f(0, 1)` is called
+     * on the calling thread instead, so callers must always partition their
+     * work using the `nThreads` argument. The first exception thrown by any
+     * thread is rethrown to the caller.
+     */
+    template <class F>
+    void run(F &&f) {
+        std::unique_lock<std::mutex> dispatch(dispatch_, std::try_to_lock);
+        if (size_ == 1 || !dispatch.owns_lock() || insideTask() || getpid() != pid_) {
+            f(0, 1);
+            return;
+        }
+
+        using Task = std::remove_reference_t<F>;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            task_ = &trampoline<Task>;
+            context_ = const_cast<void *>(static_cast<const void *>(&f));
+            pending_ = size_ - 1;
+            error_ = nullptr;
+            generation_ += 1;
+        }
+        start_.notify_all();
+
+        std::exception_ptr error;
+        insideTask() = true;
+        try {
+            f(0, size_);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        insideTask() = false;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [&] { return pending_ == 0; });
+        if (!error) error = error_;
+        error_ = nullptr;
+        lock.unlock();
+
+        if (error) std::rethrow_exception(error);
+    }
+};
+
+namespace detail {
+
+    inline int defaultThreadCount() {
+        if (const char *env = std::getenv("ZOP_NUM_THREADS")) {
+            int n = std::atoi(env);
+            if (n > 0) return n;
+        }
+        int n = (int) std::thread::hardware_concurrency();
+        return n > 0 ? n : 1;
+    }
+
+    inline std::unique_ptr<ThreadPool>& poolInstance() {
+        static std::unique_ptr<ThreadPool> pool;
+        return pool;
+    }
+
+    // Serializes the creation and replacement of the global pool.
+    inline std::mutex& poolMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+}
+
+/**
+ * Return the global thread pool used by the parallel kernels. The pool is
+ * created on first use with `ZOP_NUM_THREADS` threads, or one thread per
+ * hardware thread if the variable is not set. Creation is thread-safe, so
+ * several application threads may reach their first kernel at once.
+ */
+inline ThreadPool& pool() {
+    static std::once_flag created;
+    auto &instance = detail::poolInstance();
+    std::call_once(created, [&] {
+        std::lock_guard<std::mutex> lock(detail::poolMutex());
+        if (!instance) instance = std::make_unique<ThreadPool>(detail::defaultThreadCount());
+    });
+    return *instance;
+}
+
+/**
+ * Return the number of threads used by the parallel kernels.
+ */
+inline int threadCount() {
+    return pool().size();
+}
+
+/**
+ * Set the number of threads used by the parallel kernels. This replaces the
+ * global thread pool. Concurrent calls are serialized, but the function is
+ * not safe to call while a kernel runs on another thread: that kernel would
+ * use the pool as it is destroyed.
+ */
+inline void setThreadCount(int n) {
+    std::lock_guard<std::mutex> lock(detail::poolMutex());
+    auto &instance = detail::poolInstance();
+    instance.reset();
+    instance = std::make_unique<ThreadPool>(n);
+}
+
+/**
+ * Sets the number of threads for the lifetime of the object and restores
+ * the previous number when it is destroyed, including on an exception.
+ */
+class ScopedThreadCount {
+private:
+    int previous_;
+
+public:
+
+    explicit ScopedThreadCount(int n): previous_{threadCount()} {
+        setThreadCount(n);
+    }
+
+    ScopedThreadCount(const ScopedThreadCount &) = delete;
+    ScopedThreadCount& operator=(const ScopedThreadCount &) = delete;
+
+    ~ScopedThreadCount() {
+        setThreadCount(previous_);
+    }
+};
+
+/**
+ * Return the bounds of the tth of n equally sized blocks of [begin, end).
+ */
+inline std::pair<int, int> blockRange(int begin, int end, int t, int n) {
+    long len = end - begin;
+    int a = begin + (int) (len * t / n);
+    int b = begin + (int) (len * (t + 1) / n);
+    return {a, b};
+}
+
+/**
+ * Return the bounds of the tth of n blocks of rows such that every block
+ * holds roughly the same number of entries. `offsets` is a prefix sum with
+ * one more element than there are rows, such as the row start indices of a
+ * CSR matrix.
+ */
+inline std::pair<int, int> balancedRange(const int *offsets, int nRows, int t, int n) {
+    auto find = [&](int k) {
+        if (k == 0) return 0;
+        if (k == n) return nRows;
+        long target = offsets[0] + (long) (offsets[nRows] - offsets[0]) * k / n;
+        return (int) (std::lower_bound(offsets, offsets + nRows + 1, target) - offsets);
+    };
+    return {find(t), find(t + 1)};
+}
+
+/**
+ * Call `f(tid, nThreads)` on every thread of the global pool.
+ */
+template <class F>
+void forEachThread(F &&f) {
+    pool().run(f);
+}
+
+/**
+ * Call `f(a, b)` once per thread, where [a, b) is a contiguous block of
+ * [begin, end). Blocks are assigned to threads in order.
+ */
+template <class F>
+void parallelForRange(int begin, int end, F &&f) {
+    if (end - begin <= 1) {
+        if (end > begin) f(begin, end);
+        return;
+    }
+    pool().run([&](int t, int n) {
+        auto [a, b] = blockRange(begin, end, t, n);
+        if (a < b) f(a, b);
+    });
+}
+
+/**
+ * Call `f(i)` for every i in [begin, end), distributing contiguous blocks
+ * of indices across the threads of the global pool.
+ */
+template <class F>
+void parallelFor(int begin, int end, F &&f) {
+    parallelForRange(begin, end, [&](int a, int b) {
+        for (int i = a; i < b; i++) {
+            f(i);
+        }
+    });
+}
+
+}
+
+#endif /* ZOP_PARALLEL_H */
@@ -0,0 +1,144 @@
+#ifndef ZOP_PERMUTATION_H
+#define ZOP_PERMUTATION_H
+
+/**
+ *  \file Permutation.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains a permutation type used to reorder the rows and
+ *  columns of matrices and the elements of vectors.
+ */
+
+#include <vector>
+#include <numeric>
+#include <stdexcept>
+
+#include <Vector.h>
+
+namespace zop {
+
+/**
+ * This class represents a permutation of the integers [0, N).
+ *
+ * A permutation is stored in "new to old" form: the element at position k
+ * of a permuted object is the element at position `p[k]` of the original
+ * object. The inverse mapping is stored as well, since most operations
+ * need both directions.
+ */
+class Permutation {
+private:
+    std::vector<int> perm_;
+    std::vector<int> inverse_;
+
+public:
+
+    /**
+     * Construct a permutation from its "new to old" indices. Throws if the
+     * indices are not a permutation of [0, N).
+     */
+    explicit Permutation(std::vector<int> perm): perm_{std::move(perm)} {
+        int n = perm_.size();
+        inverse_.assign(n, -1);
+        for (int k = 0; k < n; k++) {
+            int i = perm_[k];
+            if (i < 0 || i >= n || inverse_[i] != -1) {
+                throw std::runtime_error("invalid permutation");
+            }
+            inverse_[i] = k;
+        }
+    }
+
+    static Permutation Identity(int n) {
+        std::vector<int> perm(n);
+        std::iota(perm.begin(), perm.end(), 0);
+        return Permutation(std::move(perm));
+    }
+
+    int size() const {
+        return perm_.size();
+    }
+
+    /**
+     * Return the original index of the element at new position k.
+     */
+    int operator[](int k) const {
+        return perm_[k];
+    }
+
+    /**
+     * Return the new position of the element at original index i.
+     */
+    int inverse(int i) const {
+        return inverse_[i];
+    }
+
+    const std::vector<int>& indices() const {
+        return perm_;
+    }
+
+    const std::vector<int>& inverseIndices() const {
+        return inverse_;
+    }
+
+    /**
+     * Return the inverse permutation.
+     */
+    Permutation inverted() const {
+        return Permutation(inverse_);
+    }
+
+    /**
+     * Return the permutation that applies `q` first and then this
+     * permutation, so that `p.compose(q).apply(x) == p.apply(q.apply(x))`.
+     */
+    Permutation compose(const Permutation &q) const {
+        if (q.size() != size()) {
+            throw std::runtime_error("permutation size mismatch");
+        }
+        std::vector<int> perm(size());
+        for (int k = 0; k < size(); k++) {
+            perm[k] = q.perm_[perm_[k]];
+        }
+        return Permutation(std::move(perm));
+    }
+
+    /**
+     * Return the permuted vector y, where y[k] = x[p[k]].
+     */
+    Vector apply(const Vector &x) const {
+        if (x.dim() != size()) {
+            throw std::runtime_error("permutation size mismatch");
+        }
+        Vector y(x.dim());
+        for (int k = 0; k < size(); k++) {
+            y[k] = x[perm_[k]];
+        }
+        return y;
+    }
+
+    /**
+     * Undo the permutation of a vector, returning x where x[p[k]] = y[k].
+     */
+    Vector applyInverse(const Vector &y) const {
+        if (y.dim() != size()) {
+            throw std::runtime_error("permutation size mismatch");
+        }
+        Vector x(y.dim());
+        for (int k = 0; k < size(); k++) {
+            x[perm_[k]] = y[k];
+        }
+        return x;
+    }
+
+    friend bool operator==(const Permutation &a, const Permutation &b) {
+        return a.perm_ == b.perm_;
+    }
+
+    friend bool operator!=(const Permutation &a, const Permutation &b) {
+        return !(a == b);
+    }
+};
+
+}
+
+#endif /* ZOP_PERMUTATION_H */
@@ -1,52 +1,514 @@
 #ifndef POLYGON_H
 #define POLYGON_H
 
+/**
+ *  \file Polygon.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains simple polygons in the plane, and a collection type
+ *  that stores the vertices of many polygons in contiguous arrays so that
+ *  their measures can be computed in batches.
+ */
+
 #include <array>
 #include <vector>
 #include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <initializer_list>
+
+#include <Simd.h>
+#include <Matrix.h>
 #include <Vector.h>
+#include <Parallel.h>
 
 namespace zop {
 
+namespace detail {
+
+/**
+ * The kernels below operate on a single closed ring of n vertices given by
+ * their coordinate arrays. Edge k joins vertex k to vertex k + 1, and the
+ * closing edge joins vertex n - 1 to vertex 0. The open edges are processed
+ * in a branch-free loop, four at a time if the CPU supports AVX2, and the
+ * closing edge is added separately.
+ */
+#if defined(ZOP_SIMD_X86)
+/**
+ * Sum the lengths of the open edges four at a time, starting at edge k,
+ * and advance k past the edges that were summed.
+ */
+ZOP_TARGET("avx2")
+inline double ringPerimeterAVX2(const double *x, const double *y, int n, int &k) {
+    __m256d sum = _mm256_setzero_pd();
+    for (; k + 4 < n; k += 4) {
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + k + 1), _mm256_loadu_pd(x + k));
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + k + 1), _mm256_loadu_pd(y + k));
+        __m256d sq = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+        sum = _mm256_add_pd(sum, _mm256_sqrt_pd(sq));
+    }
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, sum);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+/**
+ * Accumulate the moments of the open edges four at a time, starting at
+ * edge k, and advance k past the edges that were accumulated.
+ */
+ZOP_TARGET("avx2")
+inline double ringMomentsAVX2(const double *x, const double *y, int n, int &k, double &mx, double &my) {
+    __m256d vx0 = _mm256_set1_pd(x[0]);
+    __m256d vy0 = _mm256_set1_pd(y[0]);
+    __m256d va = _mm256_setzero_pd();
+    __m256d vmx = _mm256_setzero_pd();
+    __m256d vmy = _mm256_setzero_pd();
+    for (; k + 4 < n; k += 4) {
+        __m256d ax = _mm256_sub_pd(_mm256_loadu_pd(x + k), vx0);
+        __m256d ay = _mm256_sub_pd(_mm256_loadu_pd(y + k), vy0);
+        __m256d bx = _mm256_sub_pd(_mm256_loadu_pd(x + k + 1), vx0);
+        __m256d by = _mm256_sub_pd(_mm256_loadu_pd(y + k + 1), vy0);
+        __m256d c = _mm256_sub_pd(_mm256_mul_pd(ax, by), _mm256_mul_pd(bx, ay));
+        va = _mm256_add_pd(va, c);
+        vmx = _mm256_add_pd(vmx, _mm256_mul_pd(_mm256_add_pd(ax, bx), c));
+        vmy = _mm256_add_pd(vmy, _mm256_mul_pd(_mm256_add_pd(ay, by), c));
+    }
+    alignas(32) double lanes[3][4];
+    _mm256_store_pd(lanes[0], va);
+    _mm256_store_pd(lanes[1], vmx);
+    _mm256_store_pd(lanes[2], vmy);
+    mx = (lanes[1][0] + lanes[1][1]) + (lanes[1][2] + lanes[1][3]);
+    my = (lanes[2][0] + lanes[2][1]) + (lanes[2][2] + lanes[2][3]);
+    return (lanes[0][0] + lanes[0][1]) + (lanes[0][2] + lanes[0][3]);
+}
+#endif
+
+inline double ringPerimeter(const double *x, const double *y, int n) {
+    if (n < 2) return 0.0;
+    double acc = 0.0;
+    int k = 0;
+#if defined(ZOP_SIMD_X86)
+    if (simd::hasAVX2()) acc = ringPerimeterAVX2(x, y, n, k);
+#endif
+    for (; k < n - 1; k++) {
+        acc += std::hypot(x[k + 1] - x[k], y[k + 1] - y[k]);
+    }
+    return acc + std::hypot(x[0] - x[n - 1], y[0] - y[n - 1]);
+}
+
+/**
+ * Return twice the signed area of the ring, and accumulate the first
+ * moments needed for the centroid into mx and my. Coordinates are taken
+ * relative to the first vertex, which avoids cancellation for polygons far
+ * from the origin.
+ */
+inline double ringMoments(const double *x, const double *y, int n, double &mx, double &my) {
+    mx = my = 0.0;
+    if (n < 3) return 0.0;
+    const double x0 = x[0];
+    const double y0 = y[0];
+    double area = 0.0;
+    int k = 1;
+#if defined(ZOP_SIMD_X86)
+    if (simd::hasAVX2()) area = ringMomentsAVX2(x, y, n, k, mx, my);
+#endif
+    // The edges touching vertex 0 contribute nothing relative to it.
+    for (; k < n - 1; k++) {
+        double ax = x[k] - x0, ay = y[k] - y0;
+        double bx = x[k + 1] - x0, by = y[k + 1] - y0;
+        double c = ax * by - bx * ay;
+        area += c;
+        mx += (ax + bx) * c;
+        my += (ay + by) * c;
+    }
+    return area;
+}
+
+inline double ringSignedArea(const double *x, const double *y, int n) {
+    double mx, my;
+    return 0.5 * ringMoments(x, y, n, mx, my);
+}
+
+/**
+ * Return the centroid of the region enclosed by the ring. For degenerate
+ * rings with no area, the mean of the vertices is returned instead.
+ */
+inline std::array<double, 2> ringCentroid(const double *x, const double *y, int n) {
+    if (n == 0) return {0.0, 0.0};
+    double mx, my;
+    double twiceArea = ringMoments(x, y, n, mx, my);
+    if (twiceArea == 0.0) {
+        double sx = 0.0, sy = 0.0;
+        for (int k = 0; k < n; k++) {
+            sx += x[k];
+            sy += y[k];
+        }
+        return {sx / n, sy / n};
+    }
+    return {x[0] + mx / (3.0 * twiceArea), y[0] + my / (3.0 * twiceArea)};
+}
+
+/**
+ * Return true if the ring is a convex polygon (collinear vertices allowed).
+ * Every turn must have the same sign, ignoring collinear vertices, and the
+ * edge directions must wind around exactly once, which rules out
+ * self-intersecting stars whose turns all agree. Winding once is tested by
+ * counting the sign changes of the x and y components of the edges around
+ * the ring, which is at most two each for a single turn.
+ */
+inline bool ringConvex(const double *x, const double *y, int n) {
+    if (n < 3) return false;
+    int positive = 0;
+    int negative = 0;
+    int xFlips = 0, yFlips = 0;
+    int xFirst = 0, yFirst = 0, xLast = 0, yLast = 0;
+    auto count = [](double d, int &first, int &last, int &flips) {
+        int sign = (d > 0.0) - (d < 0.0);
+        if (sign == 0) return;
+        if (first == 0) first = sign;
+        flips += last != 0 && sign != last;
+        last = sign;
+    };
+    for (int k = 0; k < n; k++) {
+        int p = k == 0 ? n - 1: k - 1;
+        int q = k == n - 1 ? 0: k + 1;
+        double ex = x[k] - x[p], ey = y[k] - y[p];
+        double fx = x[q] - x[k], fy = y[q] - y[k];
+        double c = ex * fy - ey * fx;
+        positive += c > 0.0;
+        negative += c < 0.0;
+        // An edge that doubles back on the previous one does not turn.
+        if (c == 0.0 && ex * fx + ey * fy < 0.0) return false;
+        count(fx, xFirst, xLast, xFlips);
+        count(fy, yFirst, yLast, yFlips);
+    }
+    if (positive > 0 && negative > 0) return false;
+    if (positive == 0 && negative == 0) return false;
+    xFlips += xLast != xFirst;
+    yFlips += yLast != yFirst;
+    return xFlips <= 2 && yFlips <= 2;
+}
+
+inline int ringOrientation(const double *x, const double *y, int n) {
+    double area = ringSignedArea(x, y, n);
+    return (area > 0.0) - (area < 0.0);
+}
+
+/**
+ * Return true if the point (px, py) lies inside the ring, by counting the
+ * crossings of a horizontal ray with its edges (the even-odd rule). Each
+ * edge is treated as half-open in y, so a ray through a vertex is counted
+ * exactly once.
+ */
+inline bool ringContains(const double *x, const double *y, int n, double px, double py) {
+    bool inside = false;
+    for (int k = 0, j = n - 1; k < n; j = k++) {
+        bool straddles = (y[k] > py) != (y[j] > py);
+        if (straddles) {
+            double xCross = x[k] + (py - y[k]) * (x[j] - x[k]) / (y[j] - y[k]);
+            inside ^= px < xCross;
+        }
+    }
+    return inside;
+}
+
+}
+
+/**
+ * A simple polygon in the plane, given by its vertices in order. The
+ * coordinates are stored in two contiguous arrays rather than as one Vector
+ * per vertex. Vertex indices wrap around, so vertex(-1) is the last vertex
+ * and vertex(n) is the first. Accessing a vertex or an edge of a polygon
+ * without vertices throws, while its measures are all zero.
+ */
 class SimplePolygon {
-    std::vector<Vector> vertices_;
+private:
+    std::vector<double> x_;
+    std::vector<double> y_;
+
+    int wrap(int i) const {
+        int n = vertexCount();
+        if (n == 0) throw std::runtime_error("polygon has no vertices");
+        int k = i % n;
+        return k < 0 ? k + n: k;
+    }
+
 public:
 
-    const Vector& vertex(int i) const {
-        return vertices_.at(i % vertexCount());
+    SimplePolygon() = default;
+
+    /**
+     * Construct a polygon from the coordinate arrays of its vertices.
+     */
+    SimplePolygon(std::vector<double> x, std::vector<double> y): x_{std::move(x)}, y_{std::move(y)} {
+        if (x_.size() != y_.size()) throw DimensionMismatchException{};
     }
 
-    bool isConvex() const {
-        for (int  i = 0; i < )
-        Vector a = (vertex(i + 1) - vertex(i)).normalize();
-        Vector b = (vertex(i) - vertex(i - 1)).normalize();
+    /**
+     * Construct a polygon from its vertices, which must be two dimensional.
+     */
+    SimplePolygon(const std::vector<Vector> &vertices) {
+        x_.reserve(vertices.size());
+        y_.reserve(vertices.size());
+        for (const Vector &v: vertices) {
+            if (v.dim() != 2) throw DimensionMismatchException{};
+            x_.push_back(v[0]);
+            y_.push_back(v[1]);
+        }
     }
 
+    SimplePolygon(std::initializer_list<Vector> vertices): SimplePolygon(std::vector<Vector>(vertices)) {}
+
     int vertexCount() const {
-        return vertices_.size();
+        return x_.size();
+    }
+
+    Vector vertex(int i) const {
+        int k = wrap(i);
+        return Vector{x_[k], y_[k]};
     }
 
+    const std::vector<double>& xs() const { return x_; }
+    const std::vector<double>& ys() const { return y_; }
+
     double edgeLength(int i) const {
-        const Vector &a = vertex(i);
-        const Vector &b = vertex(i + 1);
-        return (b - a).norm();
+        int a = wrap(i);
+        int b = wrap(i + 1);
+        return std::hypot(x_[b] - x_[a], y_[b] - y_[a]);
     }
 
     double perimeter() const {
-        double acc = 0.0;
-        for (int i = 0; i < vertexCount(); i++) {
-            acc += edgeLength(i);
-        }
-        return acc;
+        return detail::ringPerimeter(x_.data(), y_.data(), vertexCount());
     }
 
+    /**
+     * Return the signed area of the polygon, which is positive if the
+     * vertices are in counter-clockwise order.
+     */
+    double signedArea() const {
+        return detail::ringSignedArea(x_.data(), y_.data(), vertexCount());
+    }
+
+    double area() const {
+        return std::abs(signedArea());
+    }
+
+    /**
+     * Return 1 if the vertices are in counter-clockwise order, -1 if they
+     * are in clockwise order, and 0 if the polygon has no area.
+     */
+    int orientation() const {
+        return detail::ringOrientation(x_.data(), y_.data(), vertexCount());
+    }
+
+    Vector centroid() const {
+        auto [cx, cy] = detail::ringCentroid(x_.data(), y_.data(), vertexCount());
+        return Vector{cx, cy};
+    }
+
+    bool isConvex() const {
+        return detail::ringConvex(x_.data(), y_.data(), vertexCount());
+    }
+
+    /**
+     * Return true if the point lies inside the polygon. Points on the
+     * boundary may be classified either way.
+     */
+    bool contains(const Vector &point) const {
+        if (point.dim() != 2) throw DimensionMismatchException{};
+        return detail::ringContains(x_.data(), y_.data(), vertexCount(), point[0], point[1]);
+    }
+
+    /**
+     * Return the interior angle at vertex i in radians. The angles of a
+     * simple polygon with n vertices sum to (n - 2)π, and an angle greater
+     * than π marks a reflex vertex.
+     */
     double interiorAngle(int i) const {
-        Vector a = (vertex(i + 1) - vertex(i)).normalize();
-        Vector b = (vertex(i) - vertex(i - 1)).normalize();
-        double angle = acos(a.dot(b));
+        int p = wrap(i - 1), k = wrap(i), q = wrap(i + 1);
+        double ex = x_[k] - x_[p], ey = y_[k] - y_[p];
+        double fx = x_[q] - x_[k], fy = y_[q] - y_[k];
+        double turn = std::atan2(ex * fy - ey * fx, ex * fx + ey * fy);
+        return orientation() < 0 ? M_PI + turn: M_PI - turn;
     }
 };
 
+/**
+ * A collection of polygons that stores the vertices of all polygons in
+ * structure-of-arrays form: one array of x coordinates, one of y
+ * coordinates, and an array of offsets such that the vertices of polygon p
+ * occupy [offsets[p], offsets[p + 1]). Adding a polygon appends to the
+ * arrays, so a collection of millions of polygons needs only a handful of
+ * allocations.
+ *
+ * The batch kernels process the polygons in parallel. Each thread is
+ * assigned a block of polygons with roughly the same number of vertices,
+ * and the measures of a single polygon are computed with the SIMD kernels
+ * used by SimplePolygon.
+ */
+class PolygonCollection {
+private:
+    std::vector<double> x_;
+    std::vector<double> y_;
+    std::vector<int> offsets_{0};
+
+    template <class F>
+    void forEachPolygon(F &&f) const {
+        parallel::forEachThread([&](int t, int n) {
+            auto [a, b] = parallel::balancedRange(offsets_.data(), size(), t, n);
+            for (int p = a; p < b; p++) {
+                int first = offsets_[p];
+                f(p, x_.data() + first, y_.data() + first, offsets_[p + 1] - first);
+            }
+        });
+    }
+
+public:
+
+    PolygonCollection() = default;
+
+    void reserve(int polygons, int vertices) {
+        offsets_.reserve(polygons + 1);
+        x_.reserve(vertices);
+        y_.reserve(vertices);
+    }
+
+    /**
+     * Append a polygon with n vertices given by their coordinate arrays.
+     */
+    void add(const double *x, const double *y, int n) {
+        x_.insert(x_.end(), x, x + n);
+        y_.insert(y_.end(), y, y + n);
+        offsets_.push_back(offsets_.back() + n);
+    }
+
+    void add(const SimplePolygon &P) {
+        add(P.xs().data(), P.ys().data(), P.vertexCount());
+    }
+
+    /**
+     * Append all polygons of another collection.
+     */
+    void append(const PolygonCollection &other) {
+        x_.insert(x_.end(), other.x_.begin(), other.x_.end());
+        y_.insert(y_.end(), other.y_.begin(), other.y_.end());
+        int shift = offsets_.back();
+        for (int p = 0; p < other.size(); p++) offsets_.push_back(shift + other.offsets_[p + 1]);
+    }
+
+    /**
+     * Remove all polygons, keeping the allocated storage for reuse.
+     */
+    void clear() {
+        x_.clear();
+        y_.clear();
+        offsets_.assign(1, 0);
+    }
+
+    /**
+     * Return the number of polygons.
+     */
+    int size() const {
+        return offsets_.size() - 1;
+    }
+
+    int vertexCount() const {
+        return x_.size();
+    }
+
+    int vertexCount(int p) const {
+        return offsets_[p + 1] - offsets_[p];
+    }
+
+    const std::vector<double>& xs() const { return x_; }
+    const std::vector<double>& ys() const { return y_; }
+    const std::vector<int>& offsets() const { return offsets_; }
+
+    /**
+     * Return true if the point (px, py) lies inside polygon p.
+     */
+    bool contains(int p, double px, double py) const {
+        int first = offsets_[p];
+        return detail::ringContains(x_.data() + first, y_.data() + first, offsets_[p + 1] - first, px, py);
+    }
+
+    SimplePolygon polygon(int p) const {
+        auto first = offsets_[p], last = offsets_[p + 1];
+        return SimplePolygon(std::vector<double>(x_.begin() + first, x_.begin() + last),
+                             std::vector<double>(y_.begin() + first, y_.begin() + last));
+    }
+
+    /**
+     * Write the perimeter of every polygon to out, which must hold size()
+     * values.
+     */
+    void perimeters(double *out) const {
+        forEachPolygon([&](int p, const double *x, const double *y, int n) {
+            out[p] = detail::ringPerimeter(x, y, n);
+        });
+    }
+
+    void signedAreas(double *out) const {
+        forEachPolygon([&](int p, const double *x, const double *y, int n) {
+            out[p] = detail::ringSignedArea(x, y, n);
+        });
+    }
+
+    void orientations(int *out) const {
+        forEachPolygon([&](int p, const double *x, const double *y, int n) {
+            out[p] = detail::ringOrientation(x, y, n);
+        });
+    }
+
+    void convexity(char *out) const {
+        forEachPolygon([&](int p, const double *x, const double *y, int n) {
+            out[p] = detail::ringConvex(x, y, n);
+        });
+    }
+
+    /**
+     * Write the x and y coordinates of the centroid of every polygon to cx
+     * and cy, which must each hold size() values.
+     */
+    void centroids(double *cx, double *cy) const {
+        forEachPolygon([&](int p, const double *x, const double *y, int n) {
+            auto c = detail::ringCentroid(x, y, n);
+            cx[p] = c[0];
+            cy[p] = c[1];
+        });
+    }
+
+    std::vector<double> perimeters() const {
+        std::vector<double> res(size());
+        perimeters(res.data());
+        return res;
+    }
+
+    std::vector<double> signedAreas() const {
+        std::vector<double> res(size());
+        signedAreas(res.data());
+        return res;
+    }
+
+    std::vector<int> orientations() const {
+        std::vector<int> res(size());
+        orientations(res.data());
+        return res;
+    }
+
+    std::vector<char> convexity() const {
+        std::vector<char> res(size());
+        convexity(res.data());
+        return res;
+    }
+
+    std::pair<std::vector<double>, std::vector<double>> centroids() const {
+        std::vector<double> cx(size()), cy(size());
+        centroids(cx.data(), cy.data());
+        return {std::move(cx), std::move(cy)};
+    }
 };
 
-#endif /* POLYGON_H */
\ No newline at end of file
+}
+
+#endif /* POLYGON_H */
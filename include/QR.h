@@ -0,0 +1,416 @@
+#ifndef ZOP_QR_H
+#define ZOP_QR_H
+
+/**
+ *  \file QR.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains Householder QR factorizations of dense matrices and
+ *  least-squares solvers built on them.
+ */
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
+
+#include <Vector.h>
+#include <DenseMatrix.h>
+#include <Parallel.h>
+
+namespace zop {
+
+/**
+ * The QR factorization A = QR of an M x N matrix with M >= N, computed with
+ * blocked Householder reflections.
+ *
+ * The columns are processed in panels of `blockSize` columns. Each panel is
+ * factored one reflector at a time, and the product of its reflectors is
+ * accumulated in the compact WY form
+ *
+ *     H_0 H_1 ... H_{b-1} = I - V T Vᵀ
+ *
+ * where V holds the Householder vectors and T is a small upper triangular
+ * matrix. The trailing columns are then updated with two matrix products
+ * instead of b rank-one updates, which touches the trailing matrix once per
+ * panel rather than once per column. Trailing columns are updated in
+ * parallel.
+ *
+ * Q is never formed. The Householder vectors are stored below the diagonal
+ * of R, and Q or Qᵀ are applied to vectors with the same block reflectors.
+ */
+class HouseholderQR {
+private:
+    int m_ = 0;
+    int n_ = 0;
+    int nb_ = 0;
+    std::vector<double> a_;
+    std::vector<double> tau_;
+    std::vector<double> T_;
+
+    double& at(int i, int j) { return a_[i + (size_t) j * m_]; }
+    double at(int i, int j) const { return a_[i + (size_t) j * m_]; }
+
+    double& t(int jb, int i, int k) { return T_[(size_t) jb * nb_ + i + (size_t) k * nb_]; }
+    double t(int jb, int i, int k) const { return T_[(size_t) jb * nb_ + i + (size_t) k * nb_]; }
+
+    /**
+     * Compute the reflector H = I - τvvᵀ that maps column j onto a multiple
+     * of e_j, storing v below the diagonal and the multiple on it.
+     */
+    void reflector(int j) {
+        double alpha = at(j, j);
+        double sigma = 0.0;
+        for (int i = j + 1; i < m_; i++) {
+            sigma += at(i, j) * at(i, j);
+        }
+        if (sigma == 0.0) {
+            tau_[j] = 0.0;
+            return;
+        }
+        double beta = -std::copysign(std::sqrt(alpha * alpha + sigma), alpha);
+        tau_[j] = (beta - alpha) / beta;
+        double scale = 1.0 / (alpha - beta);
+        for (int i = j + 1; i < m_; i++) {
+            at(i, j) *= scale;
+        }
+        at(j, j) = beta;
+    }
+
+    /**
+     * Apply I - V T Vᵀ (or its transpose) of the panel starting at column
+     * jb to the vector x of length M.
+     */
+    void applyBlock(int jb, double *x, bool transpose, std::vector<double> &w) const {
+        int b = std::min(nb_, n_ - jb);
+        w.assign(b, 0.0);
+        for (int k = 0; k < b; k++) {
+            int j = jb + k;
+            double acc = x[j];
+            for (int i = j + 1; i < m_; i++) {
+                acc += at(i, j) * x[i];
+            }
+            w[k] = acc;
+        }
+        if (transpose) {
+            for (int i = b - 1; i >= 0; i--) {
+                double acc = 0.0;
+                for (int k = 0; k <= i; k++) acc += t(jb, k, i) * w[k];
+                w[i] = acc;
+            }
+        } else {
+            for (int i = 0; i < b; i++) {
+                double acc = 0.0;
+                for (int k = i; k < b; k++) acc += t(jb, i, k) * w[k];
+                w[i] = acc;
+            }
+        }
+        for (int k = 0; k < b; k++) {
+            int j = jb + k;
+            x[j] -= w[k];
+            for (int i = j + 1; i < m_; i++) {
+                x[i] -= at(i, j) * w[k];
+            }
+        }
+    }
+
+    void factor() {
+        tau_.assign(n_, 0.0);
+        T_.assign((size_t) nb_ * n_, 0.0);
+        for (int jb = 0; jb < n_; jb += nb_) {
+            int b = std::min(nb_, n_ - jb);
+
+            // Factor the panel with unblocked reflections.
+            for (int k = 0; k < b; k++) {
+                int j = jb + k;
+                reflector(j);
+                if (tau_[j] == 0.0) continue;
+                for (int c = j + 1; c < jb + b; c++) {
+                    double w = at(j, c);
+                    for (int i = j + 1; i < m_; i++) w += at(i, j) * at(i, c);
+                    w *= tau_[j];
+                    at(j, c) -= w;
+                    for (int i = j + 1; i < m_; i++) at(i, c) -= w * at(i, j);
+                }
+            }
+
+            // Accumulate T: T(0:k, k) = -τ_k T(0:k, 0:k) V(:, 0:k)ᵀ v_k.
+            std::vector<double> z(b);
+            for (int k = 0; k < b; k++) {
+                int j = jb + k;
+                t(jb, k, k) = tau_[j];
+                for (int p = 0; p < k; p++) {
+                    double acc = at(j, jb + p);
+                    for (int i = j + 1; i < m_; i++) acc += at(i, jb + p) * at(i, j);
+                    z[p] = acc;
+                }
+                for (int p = 0; p < k; p++) {
+                    double acc = 0.0;
+                    for (int q = p; q < k; q++) acc += t(jb, p, q) * z[q];
+                    t(jb, p, k) = -tau_[j] * acc;
+                }
+            }
+
+            // Update the trailing columns with Qᵀ = I - V Tᵀ Vᵀ.
+            if (jb + b < n_) {
+                parallel::parallelForRange(jb + b, n_, [&](int c0, int c1) {
+                    std::vector<double> w;
+                    for (int c = c0; c < c1; c++) {
+                        applyBlock(jb, &at(0, c), true, w);
+                    }
+                });
+            }
+        }
+    }
+
+public:
+
+    HouseholderQR() = default;
+
+    /**
+     * Factor an M x N matrix given in column-major order.
+     */
+    HouseholderQR(int m, int n, std::vector<double> columnMajor, int blockSize = 32):
+        m_{m},
+        n_{n},
+        nb_{std::max(1, std::min(blockSize, n))},
+        a_{std::move(columnMajor)} {
+        if (m < n) {
+            throw std::runtime_error("matrix must have at least as many rows as columns");
+        }
+        if ((size_t) m * n != a_.size()) {
+            throw DimensionMismatchException{};
+        }
+        factor();
+    }
+
+    explicit HouseholderQR(const DenseMatrix &A, int blockSize = 32):
+        m_{A.nRows()},
+        n_{A.nCols()},
+        nb_{std::max(1, std::min(blockSize, A.nCols()))} {
+        if (m_ < n_) {
+            throw std::runtime_error("matrix must have at least as many rows as columns");
+        }
+        a_.resize((size_t) m_ * n_);
+        for (int i = 0; i < m_; i++) {
+            for (int j = 0; j < n_; j++) {
+                at(i, j) = A.getEntry(i, j);
+            }
+        }
+        factor();
+    }
+
+    int nRows() const { return m_; }
+    int nCols() const { return n_; }
+
+    /**
+     * Return the N x N upper triangular factor.
+     */
+    DenseMatrix R() const {
+        DenseMatrix res{n_, n_};
+        for (int i = 0; i < n_; i++) {
+            for (int j = i; j < n_; j++) {
+                res.setEntry(i, j, at(i, j));
+            }
+        }
+        return res;
+    }
+
+    double rEntry(int i, int j) const {
+        return j < i ? 0.0: at(i, j);
+    }
+
+    /**
+     * Return Qᵀb, where Q is the full M x M orthogonal factor.
+     */
+    Vector applyQT(const Vector &b) const {
+        if (b.dim() != m_) throw DimensionMismatchException{};
+        Vector x = b;
+        std::vector<double> w;
+        for (int jb = 0; jb < n_; jb += nb_) {
+            applyBlock(jb, x.data(), true, w);
+        }
+        return x;
+    }
+
+    /**
+     * Return Qx, where Q is the full M x M orthogonal factor.
+     */
+    Vector applyQ(const Vector &x) const {
+        if (x.dim() != m_) throw DimensionMismatchException{};
+        Vector y = x;
+        std::vector<double> w;
+        for (int jb = ((n_ - 1) / nb_) * nb_; jb >= 0; jb -= nb_) {
+            applyBlock(jb, y.data(), false, w);
+        }
+        return y;
+    }
+
+    /**
+     * Solve Rx = c using the first N entries of c. Throws if R is
+     * numerically singular.
+     */
+    Vector solveR(const double *c) const {
+        double largest = 0.0;
+        for (int i = 0; i < n_; i++) largest = std::max(largest, std::abs(at(i, i)));
+        double tolerance = largest * std::max(m_, n_) * std::numeric_limits<double>::epsilon();
+        Vector x(n_);
+        for (int i = n_ - 1; i >= 0; i--) {
+            if (std::abs(at(i, i)) <= tolerance) {
+                throw std::runtime_error("matrix is rank deficient");
+            }
+            double acc = c[i];
+            for (int j = i + 1; j < n_; j++) acc -= at(i, j) * x[j];
+            x[i] = acc / at(i, i);
+        }
+        return x;
+    }
+
+    /**
+     * Return the x minimizing ||Ax - b||₂.
+     */
+    Vector leastSquares(const Vector &b) const {
+        Vector c = applyQT(b);
+        return solveR(c.data());
+    }
+};
+
+/**
+ * The tall-skinny QR (TSQR) factorization of an M x N matrix with M >> N.
+ *
+ * The rows are split into P blocks of at least N rows, which are factored
+ * independently in parallel as A_p = Q_p R_p. The stacked PN x N matrix of
+ * the R_p factors is then factored once more as Q_s R, so that
+ *
+ *     A = diag(Q_0, ..., Q_{P-1}) Q_s R.
+ *
+ * Only the small R_p factors are communicated between the row blocks,
+ * instead of one reduction per column as in a column-by-column Householder
+ * QR, which makes this much faster for tall-skinny matrices.
+ */
+class TSQR {
+private:
+    int m_ = 0;
+    int n_ = 0;
+    std::vector<int> offsets_;
+    std::vector<HouseholderQR> local_;
+    HouseholderQR top_;
+
+public:
+
+    /**
+     * Factor A using the given number of row blocks, or one block per
+     * thread of the global pool if blocks is zero.
+     */
+    explicit TSQR(const DenseMatrix &A, int blocks = 0):
+        m_{A.nRows()},
+        n_{A.nCols()} {
+        if (m_ < n_) {
+            throw std::runtime_error("matrix must have at least as many rows as columns");
+        }
+        int P = blocks > 0 ? blocks: parallel::threadCount();
+        P = std::max(1, std::min(P, m_ / std::max(n_, 1)));
+        offsets_.resize(P + 1);
+        for (int p = 0; p <= P; p++) {
+            offsets_[p] = (int) ((long) m_ * p / P);
+        }
+
+        std::vector<std::vector<double>> blocksData(P);
+        for (int p = 0; p < P; p++) {
+            int rows = offsets_[p + 1] - offsets_[p];
+            blocksData[p].resize((size_t) rows * n_);
+            for (int i = 0; i < rows; i++) {
+                const Vector &row = A.row(offsets_[p] + i);
+                for (int j = 0; j < n_; j++) {
+                    blocksData[p][i + (size_t) j * rows] = row[j];
+                }
+            }
+        }
+
+        local_.resize(P);
+        parallel::forEachThread([&](int t, int nThreads) {
+            for (int p = t; p < P; p += nThreads) {
+                int rows = offsets_[p + 1] - offsets_[p];
+                local_[p] = HouseholderQR(rows, n_, std::move(blocksData[p]));
+            }
+        });
+
+        std::vector<double> stacked((size_t) P * n_ * n_, 0.0);
+        int S = P * n_;
+        for (int p = 0; p < P; p++) {
+            for (int i = 0; i < n_; i++) {
+                for (int j = i; j < n_; j++) {
+                    stacked[p * n_ + i + (size_t) j * S] = local_[p].rEntry(i, j);
+                }
+            }
+        }
+        top_ = HouseholderQR(S, n_, std::move(stacked));
+    }
+
+    int nRows() const { return m_; }
+    int nCols() const { return n_; }
+    int blockCount() const { return local_.size(); }
+
+    DenseMatrix R() const {
+        return top_.R();
+    }
+
+    /**
+     * Return Qᵀb. The first PN entries are the transformed stacked vector,
+     * so the first N entries are the ones used by a least-squares solve,
+     * followed by the remaining M_p - N entries of every row block.
+     */
+    Vector applyQT(const Vector &b) const {
+        if (b.dim() != m_) throw DimensionMismatchException{};
+        int P = local_.size();
+        std::vector<Vector> parts(P, Vector(0));
+        parallel::forEachThread([&](int t, int nThreads) {
+            for (int p = t; p < P; p += nThreads) {
+                int rows = offsets_[p + 1] - offsets_[p];
+                Vector part(rows);
+                for (int i = 0; i < rows; i++) part[i] = b[offsets_[p] + i];
+                parts[p] = local_[p].applyQT(part);
+            }
+        });
+
+        Vector stacked(P * n_);
+        for (int p = 0; p < P; p++) {
+            for (int i = 0; i < n_; i++) stacked[p * n_ + i] = parts[p][i];
+        }
+        stacked = top_.applyQT(stacked);
+
+        Vector res(m_);
+        int k = 0;
+        for (int i = 0; i < P * n_; i++) res[k++] = stacked[i];
+        for (int p = 0; p < P; p++) {
+            for (int i = n_; i < parts[p].dim(); i++) res[k++] = parts[p][i];
+        }
+        return res;
+    }
+
+    /**
+     * Return the x minimizing ||Ax - b||₂.
+     */
+    Vector leastSquares(const Vector &b) const {
+        Vector c = applyQT(b);
+        return top_.solveR(c.data());
+    }
+};
+
+/**
+ * Return the x minimizing ||Ax - b||₂ for an M x N matrix with M >= N,
+ * without forming the normal equations. Tall-skinny matrices are factored
+ * with TSQR when more than one thread is available, and all others with a
+ * blocked Householder QR.
+ */
+inline Vector leastSquares(const DenseMatrix &A, const Vector &b) {
+    if (A.nRows() >= 4 * A.nCols() && parallel::threadCount() > 1) {
+        return TSQR(A).leastSquares(b);
+    }
+    return HouseholderQR(A).leastSquares(b);
+}
+
+}
+
+#endif /* ZOP_QR_H */
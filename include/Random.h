@@ -1,41 +1,303 @@
 #ifndef ZOP_RANDOM_H
 #define ZOP_RANDOM_H
 
+/**
+ *  \file Random.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains generators of random test matrices. Every entry is
+ *  drawn from a counter-based generator keyed by the seed and indexed by
+ *  its row, so the matrices are built in parallel and are identical for
+ *  any number of threads.
+ */
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <cstdint>
+#include <stdexcept>
+
+#include <Parallel.h>
+#include <DenseMatrix.h>
 #include <SparseMatrix.h>
 
 namespace zop::random {
 
-    DOKSparseMatrix DOKSparseUpperTriangular(int M, int N, double sparsity, long seed=0) {
-        std::srand(seed);
+/**
+ * The Philox4x32-10 counter-based generator (Salmon et al., "Parallel
+ * random numbers: as easy as 1, 2, 3", SC 2011). It maps a 128-bit counter
+ * to 128 random bits under a 64-bit key with ten rounds of multiplications
+ * and xors. There is no state to advance, so any position of any stream
+ * can be generated independently.
+ */
+class Philox {
+public:
+    using Block = std::array<std::uint32_t, 4>;
 
-        DOKSparseMatrix mat{M, N};
-        for (int e = 0; e < (int)(sparsity * M * N); e++) {
-            int i = std::rand() % M;
-            int j = std::rand() % N;
-            double v = (double) std::rand() / RAND_MAX - 0.5;
-            if (j >= i) {
-                mat.setEntry(i, j, v);
-            }
+private:
+    std::uint32_t key_[2];
+
+public:
+
+    explicit Philox(std::uint64_t seed):
+        key_{(std::uint32_t) seed, (std::uint32_t) (seed >> 32)} {}
+
+    Block operator()(Block c) const {
+        std::uint32_t k0 = key_[0], k1 = key_[1];
+        for (int round = 0; round < 10; round++) {
+            std::uint64_t p0 = (std::uint64_t) 0xD2511F53 * c[0];
+            std::uint64_t p1 = (std::uint64_t) 0xCD9E8D57 * c[2];
+            c = {(std::uint32_t) (p1 >> 32) ^ c[1] ^ k0, (std::uint32_t) p1,
+                 (std::uint32_t) (p0 >> 32) ^ c[3] ^ k1, (std::uint32_t) p0};
+            k0 += 0x9E3779B9;
+            k1 += 0xBB67AE85;
         }
-        assert(mat.isUpperTriangular());
-        return mat;
+        return c;
     }
+};
 
-    DOKSparseMatrix DOKSparseLowerTriangular(int M, int N, double sparsity, long seed=0) {
-        std::srand(seed);
+/**
+ * A sequence of uniform doubles in [0, 1) taken from the Philox counters
+ * (k, stream, row) for k = 0, 1, 2, ... Each counter yields two doubles
+ * with 53 random bits.
+ */
+class Stream {
+private:
+    const Philox &gen_;
+    Philox::Block counter_;
+    Philox::Block bits_;
+    int used_ = 4;
 
-        DOKSparseMatrix mat{M, N};
-        for (int e = 0; e < (int)(sparsity * M * N); e++) {
-            int i = std::rand() % M;
-            int j = std::rand() % N;
-            double v =  (double) std::rand() / RAND_MAX - 0.5;
-            if (j <= i) {
-                mat.setEntry(i, j, v);
-            }
+public:
+
+    Stream(const Philox &gen, std::uint64_t row, std::uint32_t stream):
+        gen_{gen}, counter_{0, stream, (std::uint32_t) row, (std::uint32_t) (row >> 32)} {}
+
+    double uniform() {
+        if (used_ == 4) {
+            bits_ = gen_(counter_);
+            counter_[0]++;
+            used_ = 0;
         }
-        assert(mat.isLowerTriangular());
-        return mat;
+        std::uint64_t a = bits_[used_] >> 5, b = bits_[used_ + 1] >> 6;
+        used_ += 2;
+        return (a * 67108864.0 + b) * (1.0 / 9007199254740992.0);
     }
 };
 
-#endif /* ZOP_RANDOM_H */
\ No newline at end of file
+namespace detail {
+
+    // Streams of a row: the positions of its entries and their values.
+    constexpr std::uint32_t positionStream = 0;
+    constexpr std::uint32_t valueStream = 1;
+
+    /**
+     * Call f(j) for the columns j in [lo, hi) that are kept when every
+     * column is kept independently with probability p. The gaps between
+     * kept columns are drawn from the geometric distribution, so this takes
+     * time proportional to the number of kept columns.
+     */
+    template <class F>
+    void bernoulliColumns(Stream &positions, int lo, int hi, double p, F &&f) {
+        if (p <= 0.0 || lo >= hi) return;
+        if (p >= 1.0) {
+            for (int j = lo; j < hi; j++) f(j);
+            return;
+        }
+        double scale = 1.0 / std::log1p(-p);
+        double j = lo - 1;
+        while (true) {
+            j += 1.0 + std::floor(std::log(1.0 - positions.uniform()) * scale);
+            if (j >= hi) return;
+            f((int) j);
+        }
+    }
+
+    /**
+     * Build an M x N CSR matrix in which the entry (i, j) of every
+     * j in range(i) = [lo, hi) is present with probability density(i), with
+     * a value uniform in [-0.5, 0.5).
+     *
+     * The rows are generated twice: once to count their entries and once,
+     * after the row offsets are known, to write them. Both passes draw the
+     * same numbers, so no per-thread buffers are needed.
+     */
+    template <class Range, class Density>
+    CSRSparseMatrix bernoulliRows(int M, int N, long seed, Range &&range, Density &&density) {
+        Philox gen(seed);
+        std::vector<int> offsets(M + 1, 0);
+        std::vector<long> counts(M + 1, 0);
+        parallel::parallelFor(0, M, [&](int i) {
+            auto [lo, hi] = range(i);
+            Stream positions(gen, i, positionStream);
+            long count = 0;
+            bernoulliColumns(positions, lo, hi, density(i), [&](int) { count++; });
+            counts[i + 1] = count;
+        });
+        for (int i = 0; i < M; i++) counts[i + 1] += counts[i];
+        if (counts[M] > std::numeric_limits<int>::max()) {
+            throw std::runtime_error("too many entries for 32-bit indices");
+        }
+        for (int i = 0; i <= M; i++) offsets[i] = counts[i];
+
+        std::vector<int> columns(offsets[M]);
+        std::vector<double> values(offsets[M]);
+        parallel::forEachThread([&](int t, int n) {
+            auto [a, b] = parallel::balancedRange(offsets.data(), M, t, n);
+            for (int i = a; i < b; i++) {
+                auto [lo, hi] = range(i);
+                Stream positions(gen, i, positionStream), draws(gen, i, valueStream);
+                int k = offsets[i];
+                bernoulliColumns(positions, lo, hi, density(i), [&](int j) {
+                    columns[k] = j;
+                    values[k] = draws.uniform() - 0.5;
+                    k++;
+                });
+            }
+        });
+        return CSRSparseMatrix(M, N, std::move(offsets), std::move(columns), std::move(values));
+    }
+
+}
+
+/**
+ * Return an M x N dense matrix with entries uniform in [-0.5, 0.5).
+ */
+inline DenseMatrix dense(int M, int N, long seed = 0) {
+    Philox gen(seed);
+    DenseMatrix res(M, N);
+    parallel::parallelFor(0, M, [&](int i) {
+        Stream draws(gen, i, detail::valueStream);
+        double *row = res.row(i).data();
+        for (int j = 0; j < N; j++) row[j] = draws.uniform() - 0.5;
+    });
+    return res;
+}
+
+/**
+ * Return an M x N sparse matrix in which every entry is present with
+ * probability density, with values uniform in [-0.5, 0.5).
+ */
+inline CSRSparseMatrix sparse(int M, int N, double density, long seed = 0) {
+    return detail::bernoulliRows(M, N, seed,
+                                 [&](int) { return std::make_pair(0, N); },
+                                 [&](int) { return density; });
+}
+
+/**
+ * Return an M x N upper triangular sparse matrix in which every entry on or
+ * above the diagonal is present with probability density.
+ */
+inline CSRSparseMatrix sparseUpperTriangular(int M, int N, double density, long seed = 0) {
+    return detail::bernoulliRows(M, N, seed,
+                                 [&](int i) { return std::make_pair(std::min(i, N), N); },
+                                 [&](int) { return density; });
+}
+
+/**
+ * Return an M x N lower triangular sparse matrix in which every entry on or
+ * below the diagonal is present with probability density.
+ */
+inline CSRSparseMatrix sparseLowerTriangular(int M, int N, double density, long seed = 0) {
+    return detail::bernoulliRows(M, N, seed,
+                                 [&](int i) { return std::make_pair(0, std::min(i + 1, N)); },
+                                 [&](int) { return density; });
+}
+
+/**
+ * Return an N x N matrix with every entry of the band of `lower` diagonals
+ * below and `upper` diagonals above the main diagonal present.
+ */
+inline CSRSparseMatrix banded(int N, int lower, int upper, long seed = 0) {
+    if (lower < 0 || upper < 0) throw std::runtime_error("bandwidth must not be negative");
+    return detail::bernoulliRows(N, N, seed,
+                                 [&](int i) { return std::make_pair(std::max(0, i - lower), std::min(N, i + upper + 1)); },
+                                 [&](int) { return 1.0; });
+}
+
+/**
+ * Return an N x N matrix with a power-law distribution of row lengths, as
+ * in the graph model of Chung and Lu. Row i has an expected length
+ * proportional to (i + 1)^(-1 / (exponent - 1)), scaled to an average of
+ * averageDegree entries per row, so the number of rows of length d falls
+ * off as d^(-exponent). The columns of each row are uniformly distributed.
+ */
+inline CSRSparseMatrix powerLaw(int N, double averageDegree, double exponent, long seed = 0) {
+    if (exponent <= 1.0) throw std::runtime_error("power-law exponent must be greater than 1");
+    double decay = 1.0 / (exponent - 1.0), sum = 0.0;
+    for (int i = 0; i < N; i++) sum += std::pow(i + 1.0, -decay);
+    double scale = averageDegree * N / sum;
+    return detail::bernoulliRows(N, N, seed,
+                                 [&](int) { return std::make_pair(0, N); },
+                                 [&](int i) { return scale * std::pow(i + 1.0, -decay) / N; });
+}
+
+/**
+ * Return a symmetric positive definite N x N matrix in which every entry
+ * off the diagonal is present with probability density. The diagonal
+ * entries are one more than the sum of the magnitudes of the other entries
+ * of their row, which makes the matrix strictly diagonally dominant.
+ */
+inline CSRSparseMatrix symmetricPositiveDefinite(int N, double density, long seed = 0) {
+    CSRSparseMatrix U = detail::bernoulliRows(N, N, seed,
+                                              [&](int i) { return std::make_pair(i + 1, N); },
+                                              [&](int) { return density; });
+    CSRSparseMatrix L = U.transposed();
+
+    // Row i is row i of L, then the diagonal, then row i of U.
+    const std::vector<int> &ur = U.rowIndices(), &lr = L.rowIndices();
+    std::vector<int> offsets(N + 1, 0);
+    for (int i = 0; i < N; i++) offsets[i + 1] = offsets[i] + (ur[i + 1] - ur[i]) + (lr[i + 1] - lr[i]) + 1;
+    std::vector<int> columns(offsets[N]);
+    std::vector<double> values(offsets[N]);
+    parallel::forEachThread([&](int t, int n) {
+        auto [a, b] = parallel::balancedRange(offsets.data(), N, t, n);
+        for (int i = a; i < b; i++) {
+            int k = offsets[i], d = k + (lr[i + 1] - lr[i]);
+            double diagonal = 1.0;
+            for (auto [j, v]: L.row(i)) {
+                columns[k] = j;
+                values[k++] = v;
+                diagonal += std::abs(v);
+            }
+            columns[k++] = i;
+            for (auto [j, v]: U.row(i)) {
+                columns[k] = j;
+                values[k++] = v;
+                diagonal += std::abs(v);
+            }
+            values[d] = diagonal;
+        }
+    });
+    return CSRSparseMatrix(N, N, std::move(offsets), std::move(columns), std::move(values));
+}
+
+/**
+ * Return an M x N upper triangular matrix in which every entry on or above
+ * the diagonal is present with probability sparsity.
+ */
+inline DOKSparseMatrix DOKSparseUpperTriangular(int M, int N, double sparsity, long seed = 0) {
+    CSRSparseMatrix A = sparseUpperTriangular(M, N, sparsity, seed);
+    DOKSparseMatrix mat{M, N};
+    for (int i = 0; i < M; i++) {
+        for (auto [j, v]: A.row(i)) mat.setEntry(i, j, v);
+    }
+    return mat;
+}
+
+/**
+ * Return an M x N lower triangular matrix in which every entry on or below
+ * the diagonal is present with probability sparsity.
+ */
+inline DOKSparseMatrix DOKSparseLowerTriangular(int M, int N, double sparsity, long seed = 0) {
+    CSRSparseMatrix A = sparseLowerTriangular(M, N, sparsity, seed);
+    DOKSparseMatrix mat{M, N};
+    for (int i = 0; i < M; i++) {
+        for (auto [j, v]: A.row(i)) mat.setEntry(i, j, v);
+    }
+    return mat;
+}
+
+}
+
+#endif /* ZOP_RANDOM_H */
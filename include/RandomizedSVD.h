@@ -0,0 +1,497 @@
+#ifndef ZOP_RANDOMIZED_SVD_H
+#define ZOP_RANDOMIZED_SVD_H
+
+/**
+ *  \file RandomizedSVD.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains randomized algorithms for low-rank approximations of
+ *  dense and sparse matrices.
+ */
+
+#include <vector>
+#include <cmath>
+#include <random>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+
+#include <Vector.h>
+#include <DenseMatrix.h>
+#include <SparseMatrix.h>
+#include <Parallel.h>
+#include <QR.h>
+#include <Eigensolver.h>
+
+namespace zop::svd {
+
+struct Options {
+    /**
+     * The number of sample vectors beyond the target rank. A few extra
+     * samples make the captured range much more likely to contain the
+     * dominant singular vectors.
+     */
+    int oversampling = 10;
+
+    /**
+     * The number of power iterations, which improve the accuracy for
+     * matrices whose singular values decay slowly.
+     */
+    int powerIterations = 2;
+
+    /**
+     * With a fixed seed the result is bitwise reproducible, independently
+     * of the number of threads. Otherwise the seed is drawn from
+     * std::random_device.
+     */
+    bool reproducible = true;
+    unsigned seed = 1;
+};
+
+/**
+ * A rank-k approximation A ≈ U diag(σ) Vᵀ, where U and V have orthonormal
+ * columns and the singular values are in decreasing order.
+ */
+struct LowRankApproximation {
+    DenseMatrix U;
+    std::vector<double> singularValues;
+    DenseMatrix V;
+
+    int rank() const {
+        return singularValues.size();
+    }
+
+    /**
+     * Return U diag(σ) Vᵀ x.
+     */
+    Vector operator*(const Vector &x) const {
+        if (x.dim() != V.nRows()) throw DimensionMismatchException{};
+        Vector y(U.nRows());
+        for (int c = 0; c < rank(); c++) {
+            double acc = 0.0;
+            for (int j = 0; j < V.nRows(); j++) acc += V.getEntry(j, c) * x[j];
+            acc *= singularValues[c];
+            for (int i = 0; i < U.nRows(); i++) y[i] += U.getEntry(i, c) * acc;
+        }
+        return y;
+    }
+
+    DenseMatrix toDense() const {
+        DenseMatrix res{U.nRows(), V.nRows()};
+        for (int i = 0; i < U.nRows(); i++) {
+            for (int j = 0; j < V.nRows(); j++) {
+                double acc = 0.0;
+                for (int c = 0; c < rank(); c++) {
+                    acc += U.getEntry(i, c) * singularValues[c] * V.getEntry(j, c);
+                }
+                res.setEntry(i, j, acc);
+            }
+        }
+        return res;
+    }
+};
+
+namespace detail {
+
+    /**
+     * Blocks of vectors are stored column-major in flat arrays, so that
+     * they can be passed to the QR factorization without copies.
+     */
+    using Block = std::vector<double>;
+
+    inline void multiply(const DenseMatrix &A, const double *X, double *Y, int b) {
+        int m = A.nRows(), n = A.nCols();
+        parallel::parallelForRange(0, m, [&](int lo, int hi) {
+            for (int i = lo; i < hi; i++) {
+                const Vector &row = A.row(i);
+                for (int c = 0; c < b; c++) {
+                    const double *x = X + (size_t) c * n;
+                    double acc = 0.0;
+                    for (int j = 0; j < n; j++) acc += row[j] * x[j];
+                    Y[i + (size_t) c * m] = acc;
+                }
+            }
+        });
+    }
+
+    inline void multiplyTransposed(const DenseMatrix &A, const double *X, double *Y, int b) {
+        int m = A.nRows(), n = A.nCols();
+        parallel::parallelForRange(0, n, [&](int lo, int hi) {
+            for (int c = 0; c < b; c++) {
+                double *y = Y + (size_t) c * n;
+                std::fill(y + lo, y + hi, 0.0);
+                for (int i = 0; i < m; i++) {
+                    double x = X[i + (size_t) c * m];
+                    const Vector &row = A.row(i);
+                    for (int j = lo; j < hi; j++) y[j] += row[j] * x;
+                }
+            }
+        });
+    }
+
+    inline void multiply(const CSRSparseMatrix &A, const double *X, double *Y, int b) {
+        eigen::detail::multiply(A, X, Y, b);
+    }
+
+    /**
+     * A sparse matrix together with its transpose. The transpose is formed
+     * once per decomposition, so every product with Aᵀ is a row-parallel
+     * product with Aᵀ instead of a scatter of the rows of A, and the result
+     * does not depend on the number of threads.
+     */
+    struct TransposedPair {
+        const CSRSparseMatrix &A;
+        CSRSparseMatrix At;
+
+        int nRows() const { return A.nRows(); }
+        int nCols() const { return A.nCols(); }
+    };
+
+    inline void multiply(const TransposedPair &P, const double *X, double *Y, int b) {
+        eigen::detail::multiply(P.A, X, Y, b);
+    }
+
+    inline void multiplyTransposed(const TransposedPair &P, const double *X, double *Y, int b) {
+        eigen::detail::multiply(P.At, X, Y, b);
+    }
+
+    /**
+     * Replace the m x r block X by an orthonormal basis of its range,
+     * computed with a Householder QR, which stays orthonormal even if X is
+     * rank deficient.
+     */
+    inline void orthonormalize(Block &X, int m, int r) {
+        HouseholderQR qr(m, r, std::move(X));
+        X.assign((size_t) m * r, 0.0);
+        for (int c = 0; c < r; c++) {
+            Vector e(m);
+            e[c] = 1.0;
+            Vector q = qr.applyQ(e);
+            std::copy_n(q.data(), m, X.data() + (size_t) c * m);
+        }
+    }
+
+    /**
+     * Compute the SVD R = W diag(σ) Jᵀ of a small r x r column-major matrix
+     * with the one-sided Jacobi method: plane rotations J are applied to
+     * the columns of R until they are mutually orthogonal, so that RJ = W
+     * diag(σ). On exit R holds W diag(σ).
+     */
+    inline void jacobiSVD(Block &R, Block &J, int r) {
+        const double eps = std::numeric_limits<double>::epsilon();
+        J.assign((size_t) r * r, 0.0);
+        for (int i = 0; i < r; i++) J[i + (size_t) i * r] = 1.0;
+        for (int sweep = 0; sweep < 60; sweep++) {
+            bool rotated = false;
+            for (int p = 0; p < r; p++) {
+                for (int q = p + 1; q < r; q++) {
+                    double *x = R.data() + (size_t) p * r;
+                    double *y = R.data() + (size_t) q * r;
+                    double alpha = 0.0, beta = 0.0, gamma = 0.0;
+                    for (int i = 0; i < r; i++) {
+                        alpha += x[i] * x[i];
+                        beta += y[i] * y[i];
+                        gamma += x[i] * y[i];
+                    }
+                    if (std::abs(gamma) <= eps * std::sqrt(alpha * beta)) continue;
+                    rotated = true;
+                    double zeta = (beta - alpha) / (2.0 * gamma);
+                    double t = std::copysign(1.0, zeta) / (std::abs(zeta) + std::sqrt(1.0 + zeta * zeta));
+                    double c = 1.0 / std::sqrt(1.0 + t * t);
+                    double s = c * t;
+                    auto rotate = [&](double *u, double *v) {
+                        for (int i = 0; i < r; i++) {
+                            double a = u[i], b = v[i];
+                            u[i] = c * a - s * b;
+                            v[i] = s * a + c * b;
+                        }
+                    };
+                    rotate(x, y);
+                    rotate(J.data() + (size_t) p * r, J.data() + (size_t) q * r);
+                }
+            }
+            if (!rotated) break;
+        }
+    }
+
+    /**
+     * Given the m x r orthonormal basis Q and Z = (QᵀA)ᵀ of size n x r,
+     * compute the SVD QᵀA = Ub diag(σ) Vᵀ and return the leading k
+     * triplets of A ≈ (Q Ub) diag(σ) Vᵀ.
+     */
+    inline LowRankApproximation factor(const Block &Q, int m, Block Z, int n, int r, int k) {
+        // Z = Q₂R, and R = W diag(σ) Jᵀ gives QᵀA = J diag(σ) (Q₂W)ᵀ.
+        HouseholderQR qr(n, r, std::move(Z));
+        Block R((size_t) r * r, 0.0), J;
+        for (int j = 0; j < r; j++) {
+            for (int i = 0; i <= j; i++) R[i + (size_t) j * r] = qr.rEntry(i, j);
+        }
+        jacobiSVD(R, J, r);
+
+        std::vector<double> sigma(r);
+        for (int c = 0; c < r; c++) {
+            double acc = 0.0;
+            for (int i = 0; i < r; i++) acc += R[i + (size_t) c * r] * R[i + (size_t) c * r];
+            sigma[c] = std::sqrt(acc);
+        }
+        std::vector<int> order(r);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return sigma[a] > sigma[b]; });
+
+        LowRankApproximation res{DenseMatrix{m, k}, {}, DenseMatrix{n, k}};
+        for (int c = 0; c < k; c++) {
+            int src = order[c];
+            res.singularValues.push_back(sigma[src]);
+
+            Vector w(n);
+            if (sigma[src] > 0.0) {
+                for (int i = 0; i < r; i++) w[i] = R[i + (size_t) src * r] / sigma[src];
+            }
+            Vector v = qr.applyQ(w);
+            for (int j = 0; j < n; j++) res.V.setEntry(j, c, v[j]);
+
+            const double *u = J.data() + (size_t) src * r;
+            parallel::parallelForRange(0, m, [&](int lo, int hi) {
+                for (int i = lo; i < hi; i++) {
+                    double acc = 0.0;
+                    for (int q = 0; q < r; q++) acc += Q[i + (size_t) q * m] * u[q];
+                    res.U.setEntry(i, c, acc);
+                }
+            });
+        }
+        return res;
+    }
+
+    inline unsigned seed(const Options &opts) {
+        return opts.reproducible ? opts.seed: std::random_device{}();
+    }
+
+    inline Block gaussian(int rows, int cols, unsigned seed) {
+        std::mt19937 gen(seed);
+        std::normal_distribution<double> dist;
+        Block res((size_t) rows * cols);
+        for (double &x: res) x = dist(gen);
+        return res;
+    }
+
+    /**
+     * The randomized range finder of Halko, Martinsson and Tropp with power
+     * iterations, written for any matrix type with the multiply kernels
+     * above.
+     */
+    template <class Matrix>
+    LowRankApproximation randomized(const Matrix &A, int k, const Options &opts) {
+        int m = A.nRows(), n = A.nCols();
+        if (k < 1 || k > std::min(m, n)) {
+            throw std::runtime_error("invalid rank");
+        }
+        int r = std::min({k + std::max(opts.oversampling, 0), m, n});
+
+        Block Omega = gaussian(n, r, seed(opts));
+        Block Y((size_t) m * r), Z((size_t) n * r);
+        multiply(A, Omega.data(), Y.data(), r);
+        orthonormalize(Y, m, r);
+        for (int q = 0; q < opts.powerIterations; q++) {
+            multiplyTransposed(A, Y.data(), Z.data(), r);
+            orthonormalize(Z, n, r);
+            multiply(A, Z.data(), Y.data(), r);
+            orthonormalize(Y, m, r);
+        }
+        multiplyTransposed(A, Y.data(), Z.data(), r);
+        return factor(Y, m, std::move(Z), n, r, k);
+    }
+
+}
+
+/**
+ * Compute a rank-k approximation of a dense matrix with the randomized
+ * SVD: the range of A is sampled with k + oversampling random vectors,
+ * refined with power iterations, and the SVD of the small projected matrix
+ * QᵀA is computed with a dense Jacobi method. A is accessed only through
+ * matrix products with blocks of vectors.
+ */
+inline LowRankApproximation randomized(const DenseMatrix &A, int k, const Options &opts = {}) {
+    return detail::randomized(A, k, opts);
+}
+
+/**
+ * Compute a rank-k approximation of a sparse matrix with the randomized
+ * SVD. A is transposed once up front, which costs one extra copy of the
+ * entries but lets the products with Aᵀ run in parallel over its rows.
+ */
+inline LowRankApproximation randomized(const CSRSparseMatrix &A, int k, const Options &opts = {}) {
+    return detail::randomized(detail::TransposedPair{A, A.transposed()}, k, opts);
+}
+
+/**
+ * A single-pass randomized SVD for matrices that can only be read once,
+ * following Tropp, Yurtsever, Udell and Cevher.
+ *
+ * Two linear sketches are maintained while the rows of A are streamed:
+ * the range sketch Y = AΩ (M x r) and the co-range sketch W = ΨA (s x N),
+ * with r = k + oversampling and s = 2r + 1. Since both are linear in A,
+ * rows may arrive in any order and the same row may be updated several
+ * times. The approximation is then recovered from the sketches alone as
+ * A ≈ Q (ΨQ)⁺W, where Q is an orthonormal basis of the range of Y.
+ *
+ * Ω is a Gaussian matrix and Ψ a random sign matrix whose columns are
+ * generated on demand from a hash of the row index, so Ψ is never stored.
+ */
+class StreamingSVD {
+private:
+    int m_, n_, k_, r_, s_;
+    std::uint64_t seed_;
+    detail::Block omega_;
+    detail::Block Y_;
+    detail::Block W_;
+
+    static std::uint64_t mix(std::uint64_t x) {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    /**
+     * Store column i of the s x M sign matrix Ψ in psi.
+     */
+    void psiColumn(int i, double *psi) const {
+        std::uint64_t bits = 0;
+        for (int t = 0; t < s_; t++) {
+            if (t % 64 == 0) bits = mix(seed_ ^ mix((std::uint64_t) i * 1024 + t / 64));
+            psi[t] = (bits >> (t % 64)) & 1 ? 1.0: -1.0;
+        }
+    }
+
+public:
+
+    StreamingSVD(int nRows, int nCols, int k, const Options &opts = {}):
+        m_{nRows},
+        n_{nCols},
+        k_{k} {
+        if (k < 1 || k > std::min(nRows, nCols)) {
+            throw std::runtime_error("invalid rank");
+        }
+        r_ = std::min({k + std::max(opts.oversampling, 0), nRows, nCols});
+        s_ = std::min(2 * r_ + 1, nRows);
+        unsigned seed = detail::seed(opts);
+        seed_ = mix(seed);
+
+        // Ω is stored row-major, since a row of A is applied to it at once.
+        omega_ = detail::gaussian(n_, r_, seed);
+        Y_.assign((size_t) m_ * r_, 0.0);
+        W_.assign((size_t) s_ * n_, 0.0);
+    }
+
+    int nRows() const { return m_; }
+    int nCols() const { return n_; }
+
+    /**
+     * Perform the update A(i, :) += row.
+     */
+    void addRow(int i, const Vector &row) {
+        if (row.dim() != n_) throw DimensionMismatchException{};
+        assert(0 <= i && i < m_);
+        std::vector<double> psi(s_), acc(r_, 0.0);
+        psiColumn(i, psi.data());
+        for (int j = 0; j < n_; j++) {
+            double v = row[j];
+            if (v == 0.0) continue;
+            const double *omega = omega_.data() + (size_t) j * r_;
+            for (int c = 0; c < r_; c++) acc[c] += v * omega[c];
+            double *w = W_.data() + (size_t) j * s_;
+            for (int t = 0; t < s_; t++) w[t] += psi[t] * v;
+        }
+        for (int c = 0; c < r_; c++) Y_[i + (size_t) c * m_] += acc[c];
+    }
+
+    /**
+     * Perform the update A(first + i, :) += rows(i, :) for a block of rows
+     * stored as a sparse matrix. The range sketch is updated in parallel
+     * over the rows and the co-range sketch in parallel over the columns,
+     * using a transposed copy of the block.
+     */
+    void addRows(int first, const CSRSparseMatrix &rows) {
+        if (rows.nCols() != n_ || first < 0 || first + rows.nRows() > m_) {
+            throw DimensionMismatchException{};
+        }
+        const auto &offsets = rows.rowIndices();
+        const auto &cols = rows.columnIndices();
+        const auto &values = rows.values();
+        int M = rows.nRows();
+
+        parallel::forEachThread([&](int t, int nThreads) {
+            auto [lo, hi] = parallel::balancedRange(offsets.data(), M, t, nThreads);
+            std::vector<double> acc(r_);
+            for (int i = lo; i < hi; i++) {
+                std::fill(acc.begin(), acc.end(), 0.0);
+                for (int k = offsets[i]; k < offsets[i + 1]; k++) {
+                    const double *omega = omega_.data() + (size_t) cols[k] * r_;
+                    for (int c = 0; c < r_; c++) acc[c] += values[k] * omega[c];
+                }
+                for (int c = 0; c < r_; c++) Y_[first + i + (size_t) c * m_] += acc[c];
+            }
+        });
+
+        std::vector<double> psi((size_t) M * s_);
+        parallel::parallelFor(0, M, [&](int i) {
+            psiColumn(first + i, psi.data() + (size_t) i * s_);
+        });
+
+        // Column j of W gathers the entries of column j of the block, which
+        // are the rows of its transpose, so threads own balanced ranges of
+        // columns and every entry is read once.
+        CSRSparseMatrix T = rows.transposed();
+        const auto &tOffsets = T.rowIndices();
+        const auto &tCols = T.columnIndices();
+        const auto &tValues = T.values();
+        parallel::forEachThread([&](int t, int nThreads) {
+            auto [lo, hi] = parallel::balancedRange(tOffsets.data(), n_, t, nThreads);
+            for (int j = lo; j < hi; j++) {
+                double *w = W_.data() + (size_t) j * s_;
+                for (int k = tOffsets[j]; k < tOffsets[j + 1]; k++) {
+                    const double *p = psi.data() + (size_t) tCols[k] * s_;
+                    for (int q = 0; q < s_; q++) w[q] += p[q] * tValues[k];
+                }
+            }
+        });
+    }
+
+    /**
+     * Recover the rank-k approximation from the sketches.
+     */
+    LowRankApproximation approximation() const {
+        detail::Block Q = Y_;
+        detail::orthonormalize(Q, m_, r_);
+
+        // ΨQ, regenerating the columns of Ψ.
+        detail::Block PQ((size_t) s_ * r_, 0.0);
+        std::vector<double> psi(s_);
+        for (int i = 0; i < m_; i++) {
+            psiColumn(i, psi.data());
+            for (int c = 0; c < r_; c++) {
+                double q = Q[i + (size_t) c * m_];
+                for (int t = 0; t < s_; t++) PQ[t + (size_t) c * s_] += psi[t] * q;
+            }
+        }
+
+        // X = (ΨQ)⁺W, stored transposed as an N x r block.
+        HouseholderQR qr(s_, r_, std::move(PQ));
+        detail::Block Z((size_t) n_ * r_);
+        parallel::parallelForRange(0, n_, [&](int lo, int hi) {
+            Vector w(s_);
+            for (int j = lo; j < hi; j++) {
+                std::copy_n(W_.data() + (size_t) j * s_, s_, w.data());
+                Vector x = qr.leastSquares(w);
+                for (int c = 0; c < r_; c++) Z[j + (size_t) c * n_] = x[c];
+            }
+        });
+        return detail::factor(Q, m_, std::move(Z), n_, r_, k_);
+    }
+};
+
+}
+
+#endif /* ZOP_RANDOMIZED_SVD_H */
@@ -0,0 +1,319 @@
+#ifndef ZOP_SELL_SPARSE_MATRIX_H
+#define ZOP_SELL_SPARSE_MATRIX_H
+
+/**
+ *  \file SELLSparseMatrix.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains a sliced ELLPACK (SELL-C-σ) sparse matrix format that
+ *  is optimized for SIMD matrix-vector multiplication.
+ */
+
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+
+#include <Simd.h>
+#include <Matrix.h>
+#include <Vector.h>
+#include <Kernels.h>
+#include <Parallel.h>
+#include <SparseMatrix.h>
+
+namespace zop {
+
+/**
+ * This class represents a sparse matrix in SELL-C-σ format.
+ *
+ * The rows of the matrix are grouped into slices of C consecutive rows. Each
+ * slice is stored as a small ELLPACK matrix in column-major order: every row
+ * of the slice is padded to the length of the longest row in the slice, and
+ * the kth entries of all C rows are stored next to each other. This allows a
+ * SIMD unit to process C rows at once, one row per lane, regardless of how
+ * short the individual rows are.
+ *
+ * To reduce the amount of padding, rows are sorted by decreasing length
+ * within windows of σ rows before they are sliced. The resulting row
+ * permutation is stored with the matrix and undone by the multiplication
+ * kernels, so results are always returned in the original row order.
+ * Setting σ = 1 disables sorting, while setting σ to the number of rows sorts
+ * the entire matrix.
+ */
+class SELLSparseMatrix: public AbstractMatrix<SELLSparseMatrix> {
+private:
+    int nRows_ = 0;
+    int nCols_ = 0;
+    int nnz_ = 0;
+    int C_ = 8;
+    int sigma_ = 1;
+    std::vector<double> values_;
+    std::vector<int> column_indices_;
+    std::vector<int> slice_offsets_;
+    std::vector<int> row_lengths_;
+    std::vector<int> permutation_;
+    std::vector<int> inverse_permutation_;
+
+    /**
+     * Multiply a single slice of width `w` with `C` lanes, writing the result
+     * of each lane to `acc`. The lane count is a template parameter so that
+     * the compiler can fully unroll and vectorize the inner loop.
+     */
+    template <int C>
+    static void sliceKernel(const double *val, const int *col, int w, const double *x, double *acc) {
+        double sum[C] = {};
+        for (int k = 0; k < w; k++) {
+            for (int lane = 0; lane < C; lane++) {
+                sum[lane] += val[k * C + lane] * x[col[k * C + lane]];
+            }
+        }
+        for (int lane = 0; lane < C; lane++) {
+            acc[lane] = sum[lane];
+        }
+    }
+
+    static void sliceKernel(int C, const double *val, const int *col, int w, const double *x, double *acc) {
+        for (int lane = 0; lane < C; lane++) {
+            acc[lane] = 0.0;
+        }
+        for (int k = 0; k < w; k++) {
+            for (int lane = 0; lane < C; lane++) {
+                acc[lane] += val[k * C + lane] * x[col[k * C + lane]];
+            }
+        }
+    }
+
+#if defined(ZOP_SIMD_X86)
+    ZOP_TARGET("avx2,fma")
+    static void sliceKernelAVX2(const double *val, const int *col, int w, const double *x, double *acc) {
+        __m256d sum = _mm256_setzero_pd();
+        __m256d mask = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+        for (int k = 0; k < w; k++) {
+            __m128i idx = _mm_loadu_si128(reinterpret_cast<const __m128i *>(col + 4 * k));
+            __m256d xv = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), x, idx, mask, 8);
+            __m256d av = _mm256_loadu_pd(val + 4 * k);
+            sum = _mm256_fmadd_pd(av, xv, sum);
+        }
+        _mm256_storeu_pd(acc, sum);
+    }
+
+    ZOP_TARGET("avx512f")
+    static void sliceKernelAVX512(const double *val, const int *col, int w, const double *x, double *acc) {
+        __m512d sum = _mm512_setzero_pd();
+        for (int k = 0; k < w; k++) {
+            __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(col + 8 * k));
+            __m512d xv = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xFF, idx, x, 8);
+            __m512d av = _mm512_loadu_pd(val + 8 * k);
+            sum = _mm512_fmadd_pd(av, xv, sum);
+        }
+        _mm512_storeu_pd(acc, sum);
+    }
+#endif
+
+    void multiplySlice(int s, const double *x, double *acc) const {
+        const double *val = values_.data() + slice_offsets_[s];
+        const int *col = column_indices_.data() + slice_offsets_[s];
+        int w = (slice_offsets_[s + 1] - slice_offsets_[s]) / C_;
+        switch (C_) {
+#if defined(ZOP_SIMD_X86)
+        case 4:
+            if (simd::hasAVX2()) {
+                sliceKernelAVX2(val, col, w, x, acc);
+            } else {
+                sliceKernel<4>(val, col, w, x, acc);
+            }
+            break;
+        case 8:
+            if (simd::hasAVX512()) {
+                sliceKernelAVX512(val, col, w, x, acc);
+            } else {
+                sliceKernel<8>(val, col, w, x, acc);
+            }
+            break;
+#else
+        case 4: sliceKernel<4>(val, col, w, x, acc); break;
+        case 8: sliceKernel<8>(val, col, w, x, acc); break;
+#endif
+        case 16: sliceKernel<16>(val, col, w, x, acc); break;
+        default: sliceKernel(C_, val, col, w, x, acc); break;
+        }
+    }
+
+public:
+
+    using Builder = DOKSparseMatrix;
+
+    /**
+     * A summary of the storage overhead introduced by slicing. The padding
+     * ratio is the number of stored entries divided by the number of non-zero
+     * entries, so a value of 1.0 means that no padding was required. The
+     * efficiency (often called β in the literature) is its reciprocal.
+     */
+    struct PaddingStatistics {
+        int nnz = 0;
+        int storedEntries = 0;
+        int paddingEntries = 0;
+        int slices = 0;
+        double paddingRatio = 1.0;
+        double efficiency = 1.0;
+    };
+
+    /**
+     * Construct a SELL-C-σ matrix from a CSR matrix. The chunk height C is the
+     * number of rows processed together by the SIMD kernels and should match
+     * the vector width of the target (4 for AVX2, 8 for AVX-512). The sorting
+     * scope σ should be a multiple of C.
+     */
+    SELLSparseMatrix(const CSRSparseMatrix &A, int C = 8, int sigma = 256):
+        nRows_{A.nRows()},
+        nCols_{A.nCols()},
+        C_{C},
+        sigma_{sigma} {
+
+        if (C <= 0 || sigma <= 0) {
+            throw std::runtime_error("chunk height and sorting scope must be positive");
+        }
+
+        row_lengths_.resize(nRows_);
+        for (int i = 0; i < nRows_; i++) {
+            row_lengths_[i] = A.row(i).count();
+            nnz_ += row_lengths_[i];
+        }
+
+        // Sort rows by decreasing length within each window of σ rows.
+        permutation_.resize(nRows_);
+        std::iota(permutation_.begin(), permutation_.end(), 0);
+        for (int a = 0; a < nRows_; a += sigma_) {
+            int b = std::min(a + sigma_, nRows_);
+            std::stable_sort(permutation_.begin() + a, permutation_.begin() + b, [&](int i, int j) {
+                return row_lengths_[i] > row_lengths_[j];
+            });
+        }
+        inverse_permutation_.resize(nRows_);
+        for (int r = 0; r < nRows_; r++) {
+            inverse_permutation_[permutation_[r]] = r;
+        }
+
+        int nSlices = (nRows_ + C_ - 1) / C_;
+        slice_offsets_.resize(nSlices + 1);
+        slice_offsets_[0] = 0;
+        for (int s = 0; s < nSlices; s++) {
+            int w = 0;
+            for (int lane = 0; lane < C_ && s * C_ + lane < nRows_; lane++) {
+                w = std::max(w, row_lengths_[permutation_[s * C_ + lane]]);
+            }
+            slice_offsets_[s + 1] = slice_offsets_[s] + w * C_;
+        }
+
+        // Padding entries have a value of zero and reference the first
+        // column, which keeps the gathers in bounds without branching.
+        values_.assign(slice_offsets_[nSlices], 0.0);
+        column_indices_.assign(slice_offsets_[nSlices], 0);
+        for (int s = 0; s < nSlices; s++) {
+            for (int lane = 0; lane < C_ && s * C_ + lane < nRows_; lane++) {
+                int k = 0;
+                for (auto [j, e]: A.row(permutation_[s * C_ + lane])) {
+                    values_[slice_offsets_[s] + k * C_ + lane] = e;
+                    column_indices_[slice_offsets_[s] + k * C_ + lane] = j;
+                    k += 1;
+                }
+            }
+        }
+    }
+
+    SELLSparseMatrix(const DOKSparseMatrix &M): SELLSparseMatrix(CSRSparseMatrix(M)) {}
+
+    int nRows() const { return nRows_; }
+    int nCols() const { return nCols_; }
+    int nnz() const { return nnz_; }
+    int chunkHeight() const { return C_; }
+    int sortingScope() const { return sigma_; }
+    int sliceCount() const { return (int) slice_offsets_.size() - 1; }
+
+    /**
+     * Return the row permutation applied by σ-sorting. The rth stored row
+     * corresponds to row `permutation()[r]` of the original matrix.
+     */
+    const std::vector<int>& permutation() const {
+        return permutation_;
+    }
+
+    /**
+     * Return statistics describing the padding overhead of this matrix.
+     */
+    PaddingStatistics paddingStatistics() const {
+        PaddingStatistics stats;
+        stats.nnz = nnz_;
+        stats.storedEntries = (int) values_.size();
+        stats.paddingEntries = stats.storedEntries - nnz_;
+        stats.slices = sliceCount();
+        if (nnz_ > 0) {
+            stats.paddingRatio = (double) stats.storedEntries / nnz_;
+            stats.efficiency = (double) nnz_ / stats.storedEntries;
+        }
+        return stats;
+    }
+
+    /**
+     * Returns the value at the given position. This is a O(w) operation,
+     * where w is the width of the slice containing row i, and thus should
+     * only be used when absolutely necessary.
+     */
+    double getEntry(int i, int j) const {
+        assert(0 <= i && i < nRows_);
+        assert(0 <= j && j < nCols_);
+        int r = inverse_permutation_[i];
+        int s = r / C_;
+        int lane = r % C_;
+        for (int k = 0; k < row_lengths_[i]; k++) {
+            int idx = slice_offsets_[s] + k * C_ + lane;
+            if (column_indices_[idx] == j) return values_[idx];
+            if (column_indices_[idx] > j) break;
+        }
+        return 0.0;
+    }
+
+    /**
+     * Return the product of this matrix and a dense vector. Each slice is
+     * processed by a SIMD kernel, and the row permutation is undone while
+     * storing the results, so the returned vector is in the original row
+     * order. The slices are split across threads in blocks holding roughly
+     * the same number of stored entries, and since every row belongs to a
+     * single slice, no two threads write to the same entry of the result.
+     *
+     * The AVX2 and AVX-512 kernels are chosen at runtime for chunk heights
+     * of 4 and 8 if the CPU supports them. Apart from the result, the
+     * product does not allocate.
+     */
+    Vector operator*(const Vector &v) const {
+        if (v.dim() != nCols()) throw DimensionMismatchException{};
+        ZOP_INSTRUMENT("spmv.sell", 2.0 * nnz_, 12.0 * values_.size() + 8.0 * (nRows_ + nCols_));
+        Vector res(nRows());
+        if (nCols() == 0) return res;
+        parallel::forEachThread([&](int t, int nThreads) {
+            auto [a, b] = parallel::balancedRange(slice_offsets_.data(), sliceCount(), t, nThreads);
+            if (a == b) return;
+            // The lanes of a slice fit on the stack for the usual chunk
+            // heights; larger ones use the scratch space of the thread.
+            constexpr int stackLanes = 16;
+            double stack[stackLanes];
+            double *acc = stack;
+            if (C_ > stackLanes) {
+                std::vector<double> &scratch = detail::Scratch::local().values;
+                scratch.resize(C_);
+                acc = scratch.data();
+            }
+            for (int s = a; s < b; s++) {
+                multiplySlice(s, v.data(), acc);
+                for (int lane = 0; lane < C_ && s * C_ + lane < nRows_; lane++) {
+                    res[permutation_[s * C_ + lane]] = acc[lane];
+                }
+            }
+        });
+        return res;
+    }
+};
+
+}
+
+#endif /* ZOP_SELL_SPARSE_MATRIX_H */
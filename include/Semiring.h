@@ -0,0 +1,218 @@
+#ifndef ZOP_SEMIRING_H
+#define ZOP_SEMIRING_H
+
+/**
+ *  \file Semiring.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains sparse matrix-vector products over arbitrary
+ *  semirings, in which the sum and product of the usual product are
+ *  replaced by the operations ⊕ and ⊗ of the semiring:
+ *
+ *      yᵢ = ⊕ⱼ Aᵢⱼ ⊗ xⱼ
+ *
+ *  Only the stored entries of A take part, so a missing entry acts as the
+ *  zero of the semiring. With (min, +) the product relaxes shortest paths,
+ *  with (or, and) it advances a breadth-first search.
+ */
+
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+#include <Matrix.h>
+#include <SparseMatrix.h>
+#include <Parallel.h>
+#include <Instrumentation.h>
+
+namespace zop {
+
+/**
+ * A semiring provides the type of the vector entries, the identity of ⊕
+ * (zero), the operations add (⊕) and multiply (⊗), where the first operand
+ * of multiply is a stored matrix entry, and terminal, which is true for a
+ * value that no further ⊕ can change. Row reductions stop early at a
+ * terminal value.
+ */
+namespace semiring {
+
+struct PlusTimes {
+    using value_type = double;
+    static value_type zero() { return 0.0; }
+    static value_type add(value_type a, value_type b) { return a + b; }
+    static value_type multiply(double a, value_type x) { return a * x; }
+    static bool terminal(value_type) { return false; }
+};
+
+/**
+ * The tropical semiring, whose product relaxes path lengths.
+ */
+struct MinPlus {
+    using value_type = double;
+    static value_type zero() { return std::numeric_limits<double>::infinity(); }
+    static value_type add(value_type a, value_type b) { return std::min(a, b); }
+    static value_type multiply(double a, value_type x) { return a + x; }
+    static bool terminal(value_type a) { return a == -std::numeric_limits<double>::infinity(); }
+};
+
+/**
+ * The semiring of the most reliable path over non-negative values.
+ */
+struct MaxTimes {
+    using value_type = double;
+    static value_type zero() { return 0.0; }
+    static value_type add(value_type a, value_type b) { return std::max(a, b); }
+    static value_type multiply(double a, value_type x) { return a * x; }
+    static bool terminal(value_type a) { return a == std::numeric_limits<double>::infinity(); }
+};
+
+/**
+ * The boolean semiring, in which every stored entry counts as true.
+ */
+struct OrAnd {
+    using value_type = char;
+    static value_type zero() { return 0; }
+    static value_type add(value_type a, value_type b) { return a | b; }
+    static value_type multiply(double, value_type x) { return x; }
+    static bool terminal(value_type a) { return a != 0; }
+};
+
+}
+
+/**
+ * A sparse vector of dimension dim with the given entries. The indices are
+ * in increasing order.
+ */
+template <class T>
+struct SparseVector {
+    int dim = 0;
+    std::vector<int> indices;
+    std::vector<T> values;
+
+    int nnz() const {
+        return indices.size();
+    }
+};
+
+/**
+ * y = A ⊕.⊗ x over the semiring S, where x and y hold A.nCols() and
+ * A.nRows() values. If a mask is given, only the rows i with mask[i] != 0
+ * are computed and the other entries of y are left unchanged.
+ *
+ * Every row is reduced independently, which pulls the values of x into
+ * the rows that need them. The rows are split across threads by their
+ * number of stored entries.
+ */
+template <class S>
+void multiply(const CSRSparseMatrix &A, const typename S::value_type *x, typename S::value_type *y,
+              const char *mask = nullptr) {
+    ZOP_INSTRUMENT("semiringSpmv", 2.0 * A.nnz(), 12.0 * A.nnz() + 4.0 * A.nRows());
+    const int *rows = A.rowIndices().data();
+    const int *cols = A.columnIndices().data();
+    const double *vals = A.values().data();
+    parallel::forEachThread([&](int t, int n) {
+        auto [a, b] = parallel::balancedRange(rows, A.nRows(), t, n);
+        for (int i = a; i < b; i++) {
+            if (mask && !mask[i]) continue;
+            typename S::value_type acc = S::zero();
+            for (int k = rows[i]; k < rows[i + 1]; k++) {
+                acc = S::add(acc, S::multiply(vals[k], x[cols[k]]));
+                if (S::terminal(acc)) break;
+            }
+            y[i] = acc;
+        }
+    });
+}
+
+template <class S>
+std::vector<typename S::value_type> multiply(const CSRSparseMatrix &A, const std::vector<typename S::value_type> &x) {
+    if ((int) x.size() != A.nCols()) throw DimensionMismatchException{};
+    std::vector<typename S::value_type> y(A.nRows());
+    multiply<S>(A, x.data(), y.data());
+    return y;
+}
+
+/**
+ * A dense scratch vector that gathers the sparse result of a product over
+ * the semiring S. It keeps its storage between products, so that a
+ * sequence of products with small vectors costs time proportional to the
+ * entries touched rather than to the dimension.
+ */
+template <class S>
+class SparseAccumulator {
+private:
+    std::vector<typename S::value_type> values_;
+    std::vector<char> occupied_;
+    std::vector<int> indices_;
+
+public:
+
+    explicit SparseAccumulator(int dim): values_(dim), occupied_(dim, 0) {}
+
+    int dim() const {
+        return values_.size();
+    }
+
+    void add(int i, typename S::value_type v) {
+        if (occupied_[i]) {
+            values_[i] = S::add(values_[i], v);
+        } else {
+            occupied_[i] = 1;
+            values_[i] = v;
+            indices_.push_back(i);
+        }
+    }
+
+    /**
+     * Move the gathered entries to y in increasing order of index and
+     * reset the accumulator.
+     */
+    void gather(SparseVector<typename S::value_type> &y) {
+        std::sort(indices_.begin(), indices_.end());
+        y.dim = dim();
+        y.indices.assign(indices_.begin(), indices_.end());
+        y.values.resize(indices_.size());
+        for (size_t k = 0; k < indices_.size(); k++) {
+            y.values[k] = values_[indices_[k]];
+            occupied_[indices_[k]] = 0;
+        }
+        indices_.clear();
+    }
+};
+
+/**
+ * y = Aᵀ ⊕.⊗ x over the semiring S for a sparse vector x, that is
+ * yⱼ = ⊕ᵢ Aᵢⱼ ⊗ xᵢ. The rows of A selected by the entries of x push their
+ * contributions into the accumulator, so the cost is proportional to the
+ * number of stored entries in those rows. This is the efficient direction
+ * when x has few entries; for a dense x, the pull product with the
+ * transpose of A touches every row once and runs in parallel.
+ */
+template <class S>
+void multiplyTransposed(const CSRSparseMatrix &A, const SparseVector<typename S::value_type> &x,
+                        SparseVector<typename S::value_type> &y, SparseAccumulator<S> &work) {
+    if (x.dim != A.nRows() || work.dim() != A.nCols()) throw DimensionMismatchException{};
+    const int *rows = A.rowIndices().data();
+    const int *cols = A.columnIndices().data();
+    const double *vals = A.values().data();
+    for (int e = 0; e < x.nnz(); e++) {
+        int i = x.indices[e];
+        for (int k = rows[i]; k < rows[i + 1]; k++) {
+            work.add(cols[k], S::multiply(vals[k], x.values[e]));
+        }
+    }
+    work.gather(y);
+}
+
+template <class S>
+SparseVector<typename S::value_type> multiplyTransposed(const CSRSparseMatrix &A,
+                                                        const SparseVector<typename S::value_type> &x) {
+    SparseAccumulator<S> work(A.nCols());
+    SparseVector<typename S::value_type> y;
+    multiplyTransposed<S>(A, x, y, work);
+    return y;
+}
+
+}
+
+#endif /* ZOP_SEMIRING_H */
@@ -0,0 +1,93 @@
+#ifndef ZOP_SIMD_H
+#define ZOP_SIMD_H
+
+/**
+ *  \file Simd.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains the runtime detection of the SIMD instruction sets
+ *  used by the vectorized kernels.
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+/**
+ * Defined when the compiler can build kernels for x86 instruction sets that
+ * are not enabled for the whole translation unit. A kernel is compiled for
+ * an instruction set by marking it with `ZOP_TARGET("avx2,fma")`, and must
+ * only be called after checking the matching function below, so the
+ * library runs on any x86 CPU without `-march` flags.
+ */
+#define ZOP_SIMD_X86 1
+#define ZOP_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace zop::simd {
+
+namespace detail {
+
+    inline bool& enabled() {
+        static bool enabled = true;
+        return enabled;
+    }
+
+}
+
+/**
+ * Enable or disable the vectorized kernels. With the kernels disabled,
+ * every operation takes its portable path, which is mostly useful to
+ * compare the two in tests.
+ */
+inline void setEnabled(bool enabled) {
+    detail::enabled() = enabled;
+}
+
+/**
+ * Return true if the CPU supports AVX2 and FMA.
+ */
+inline bool hasAVX2() {
+#if defined(ZOP_SIMD_X86)
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return supported && detail::enabled();
+#else
+    return false;
+#endif
+}
+
+/**
+ * Return true if the CPU supports AVX-512F.
+ */
+inline bool hasAVX512() {
+#if defined(ZOP_SIMD_X86)
+    static const bool supported = __builtin_cpu_supports("avx512f");
+    return supported && detail::enabled();
+#else
+    return false;
+#endif
+}
+
+/**
+ * Disables the vectorized kernels for the lifetime of the object.
+ */
+class ScopedPortable {
+private:
+    bool previous_;
+
+public:
+
+    ScopedPortable(): previous_{detail::enabled()} {
+        setEnabled(false);
+    }
+
+    ScopedPortable(const ScopedPortable &) = delete;
+    ScopedPortable& operator=(const ScopedPortable &) = delete;
+
+    ~ScopedPortable() {
+        setEnabled(previous_);
+    }
+};
+
+}
+
+#endif /* ZOP_SIMD_H */
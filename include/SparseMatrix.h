@@ -10,13 +10,20 @@
 #include <map>
 #include <cassert>
 #include <vector>
+#include <atomic>
+#include <algorithm>
 #include <exception>
+#include <stdexcept>
 
 #include <Matrix.h>
 #include <Vector.h>
+#include <Parallel.h>
+#include <Permutation.h>
 
 namespace zop {
 
+class CSRSparseMatrix;
+
 /**
  * This class implements a dictionary-of-keys sparse matrix. Generally, this
  * class should only be used to build more optimized sparse matrix
@@ -30,6 +37,8 @@ private:
     int nRows_ = 0;
     int nCols_ = 0;
     std::map<std::pair<int, int>, double> entries_;
+
+    friend class CSRSparseMatrix;
 public:
 
     using Builder = DOKSparseMatrix;
@@ -44,6 +53,7 @@ public:
     int nCols() const { return nCols_; }
 
     DOKSparseMatrix transposed() const {
+        ZOP_INSTRUMENT("transposed", 0, 48.0 * nnz());
         DOKSparseMatrix res{nCols(), nRows()};
         for (auto &[loc, v]: entries_) {
             res.setEntry(loc.second, loc.first, v);
@@ -66,6 +76,91 @@ public:
         return it == entries_.end() ? 0.0: it->second;
     }
 
+    int nnz() const { return entries_.size(); }
+
+    /**
+     * Return true if the matrix is symmetric. This operation looks up the
+     * mirror image of every stored entry, and thus runs in O(nnz log(nnz)).
+     */
+    bool isSymmetric() const {
+        if (nRows_ != nCols_) return false;
+        for (auto &[loc, v]: entries_) {
+            if (loc.first == loc.second) continue;
+            auto it = entries_.find({loc.second, loc.first});
+            if ((it == entries_.end() ? 0.0: it->second) != v) return false;
+        }
+        return true;
+    }
+
+    bool isLowerTriangular() const {
+        for (auto &[loc, v]: entries_) {
+            if (loc.second > loc.first && v != 0.0) return false;
+        }
+        return true;
+    }
+
+    bool isUpperTriangular() const {
+        for (auto &[loc, v]: entries_) {
+            if (loc.second < loc.first && v != 0.0) return false;
+        }
+        return true;
+    }
+
+    int lowerBandwidth() const {
+        int res = 0;
+        for (auto &[loc, v]: entries_) {
+            res = std::max(res, loc.first - loc.second);
+        }
+        return res;
+    }
+
+    int upperBandwidth() const {
+        int res = 0;
+        for (auto &[loc, v]: entries_) {
+            res = std::max(res, loc.second - loc.first);
+        }
+        return res;
+    }
+
+    long profile() const {
+        // Entries are ordered by row and then by column, so the first entry
+        // visited in each row is its leftmost entry.
+        long res = 0;
+        int row = -1;
+        for (auto &[loc, v]: entries_) {
+            if (loc.first == row) continue;
+            row = loc.first;
+            if (loc.second < row) res += row - loc.second;
+        }
+        return res;
+    }
+
+    bool isDiagonallyDominant(bool strict = false) const {
+        if (nRows_ != nCols_) return false;
+        std::vector<double> offDiagonal(nRows_, 0.0);
+        std::vector<double> diagonal(nRows_, 0.0);
+        for (auto &[loc, v]: entries_) {
+            if (loc.first == loc.second) {
+                diagonal[loc.first] = std::abs(v);
+            } else {
+                offDiagonal[loc.first] += std::abs(v);
+            }
+        }
+        for (int i = 0; i < nRows_; i++) {
+            if (strict ? diagonal[i] <= offDiagonal[i]: diagonal[i] < offDiagonal[i]) return false;
+        }
+        return true;
+    }
+
+    /**
+     * Return true if both matrices have the same dimensions and entries.
+     * Since zero entries are never stored, this compares the two maps
+     * directly in O(nnz).
+     */
+    bool equals(const DOKSparseMatrix &B) const {
+        return nRows_ == B.nRows_ && nCols_ == B.nCols_ && entries_ == B.entries_;
+    }
+
     const_iterator begin() const {
         return entries_.begin();
     }
@@ -97,6 +192,123 @@ private:
     std::vector<int> column_indices_;
     std::vector<int> row_indices_;
 
+    /**
+     * Compare row i of this matrix with row i of B. Explicitly stored zeros
+     * are treated the same as missing entries.
+     */
+    bool rowEquals(int i, const CSRSparseMatrix &B) const {
+        int p = row_indices_[i];
+        int q = B.row_indices_[i];
+        int pe = row_indices_[i + 1];
+        int qe = B.row_indices_[i + 1];
+        while (p < pe || q < qe) {
+            int cp = p < pe ? column_indices_[p]: nCols_;
+            int cq = q < qe ? B.column_indices_[q]: nCols_;
+            if (cp == cq) {
+                if (values_[p++] != B.values_[q++]) return false;
+            } else if (cp < cq) {
+                if (values_[p++] != 0.0) return false;
+            } else {
+                if (B.values_[q++] != 0.0) return false;
+            }
+        }
+        return true;
+    }
+
+    int firstNonZero(int i) const {
+        for (int k = row_indices_[i]; k < row_indices_[i + 1]; k++) {
+            if (values_[k] != 0.0) return column_indices_[k];
+        }
+        return -1;
+    }
+
+    int lastNonZero(int i) const {
+        for (int k = row_indices_[i + 1] - 1; k >= row_indices_[i]; k--) {
+            if (values_[k] != 0.0) return column_indices_[k];
+        }
+        return -1;
+    }
+
+    /**
+     * Return the matrix with its rows and columns permuted. Row k of the
+     * result is row `rows[k]` of this matrix, and column j of this matrix
+     * becomes column `cols.inverse(j)` of the result. Either permutation may
+     * be null, in which case it is treated as the identity.
+     */
+    CSRSparseMatrix permutedImpl(const Permutation *rows, const Permutation *cols) const {
+        if ((rows && rows->size() != nRows_) || (cols && cols->size() != nCols_)) {
+            throw DimensionMismatchException{};
+        }
+
+        int M = nRows_;
+        std::vector<int> row_indices(M + 1, 0);
+        for (int k = 0; k < M; k++) {
+            int i = rows ? (*rows)[k]: k;
+            row_indices[k + 1] = row_indices[k] + row_indices_[i + 1] - row_indices_[i];
+        }
+
+        std::vector<int> column_indices(nnz());
+        std::vector<double> values(nnz());
+        parallel::forEachThread([&](int t, int n) {
+            auto [a, b] = parallel::balancedRange(row_indices.data(), M, t, n);
+            std::vector<std::pair<int, double>> buffer;
+            for (int k = a; k < b; k++) {
+                int i = rows ? (*rows)[k]: k;
+                int src = row_indices_[i];
+                int len = row_indices_[i + 1] - src;
+                int dst = row_indices[k];
+                if (!cols) {
+                    std::copy_n(column_indices_.begin() + src, len, column_indices.begin() + dst);
+                    std::copy_n(values_.begin() + src, len, values.begin() + dst);
+                    continue;
+                }
+                buffer.clear();
+                for (int e = src; e < src + len; e++) {
+                    buffer.push_back({cols->inverse(column_indices_[e]), values_[e]});
+                }
+                std::sort(buffer.begin(), buffer.end());
+                for (int e = 0; e < len; e++) {
+                    column_indices[dst + e] = buffer[e].first;
+                    values[dst + e] = buffer[e].second;
+                }
+            }
+        });
+
+        return CSRSparseMatrix(M, nCols_, std::move(row_indices), std::move(column_indices), std::move(values));
+    }
+
+    /**
+     * Explicitly stored zeros are treated the same as missing entries, as
+     * in rowEquals() and the triangular queries.
+     */
+    bool symmetryCheck(bool compareValues) const {
+        if (nRows_ != nCols_) return false;
+        std::vector<int> cursor(row_indices_.begin(), row_indices_.end() - 1);
+        auto skipZeros = [&](int j) {
+            int &c = cursor[j];
+            while (c < row_indices_[j + 1] && values_[c] == 0.0) c++;
+            return c;
+        };
+        for (int i = 0; i < nRows_; i++) {
+            // Every entry of row i below the diagonal should have been
+            // matched while visiting the earlier rows.
+            int first = skipZeros(i);
+            if (first < row_indices_[i + 1] && column_indices_[first] < i) {
+                return false;
+            }
+            for (int k = row_indices_[i]; k < row_indices_[i + 1]; k++) {
+                int j = column_indices_[k];
+                if (j <= i || values_[k] == 0.0) continue;
+                int &c = cursor[j];
+                skipZeros(j);
+                if (c == row_indices_[j + 1] || column_indices_[c] != i) return false;
+                if (compareValues && values_[c] != values_[k]) return false;
+                c += 1;
+            }
+        }
+        return true;
+    }
+
 public:
 
     using Builder = DOKSparseMatrix;
@@ -227,7 +439,10 @@ public:
     };
 
     CSRSparseMatrix(const DOKSparseMatrix &M) {
+        ZOP_INSTRUMENT("CSRSparseMatrix(DOKSparseMatrix)", 0, 24.0 * M.nnz() + 4.0 * M.nRows());
         row_indices_.resize(M.nRows() + 1);
+        values_.reserve(M.nnz());
+        column_indices_.reserve(M.nnz());
         nRows_ = M.nRows();
         nCols_ = M.nCols();
         int row = -1;
@@ -248,11 +463,313 @@ public:
         }
     };
 
+    /**
+     * Construct a CSR matrix by consuming a DOK matrix. The entries of M are
+     * released while the CSR arrays are filled, so the peak memory use is
+     * roughly that of a single copy of the matrix. M is left empty.
+     */
+    CSRSparseMatrix(DOKSparseMatrix &&M):
+        nRows_{M.nRows()},
+        nCols_{M.nCols()},
+        row_indices_(M.nRows() + 1, 0) {
+        ZOP_INSTRUMENT("CSRSparseMatrix(DOKSparseMatrix)", 0, 24.0 * M.nnz() + 4.0 * M.nRows());
+        values_.reserve(M.nnz());
+        column_indices_.reserve(M.nnz());
+        auto &entries = M.entries_;
+        while (!entries.empty()) {
+            auto node = entries.extract(entries.begin());
+            row_indices_[node.key().first + 1] += 1;
+            column_indices_.push_back(node.key().second);
+            values_.push_back(node.mapped());
+        }
+        for (int i = 0; i < nRows_; i++) {
+            row_indices_[i + 1] += row_indices_[i];
+        }
+    }
+
+    /**
+     * Construct a CSR matrix directly from its three arrays. The column
+     * indices within each row must be sorted in increasing order.
+     */
+    CSRSparseMatrix(int nRows, int nCols, std::vector<int> row_indices,
+                    std::vector<int> column_indices, std::vector<double> values):
+        nRows_{nRows},
+        nCols_{nCols},
+        values_{std::move(values)},
+        column_indices_{std::move(column_indices)},
+        row_indices_{std::move(row_indices)} {
+        if ((int) row_indices_.size() != nRows + 1 || column_indices_.size() != values_.size()
+            || row_indices_.front() != 0 || row_indices_.back() != (int) values_.size()) {
+            throw std::runtime_error("inconsistent csr arrays");
+        }
+    }
+
 
     int nRows() const { return nRows_; }
     int nCols() const { return nCols_; }
+    int nnz() const { return values_.size(); }
     double getEntry(int i, int j) const { return row(i)[j]; }
 
+    /**
+     * Return the underlying CSR arrays. These are intended for kernels that
+     * operate on the raw representation.
+     */
+    const std::vector<double>& values() const { return values_; }
+    const std::vector<int>& columnIndices() const { return column_indices_; }
+    const std::vector<int>& rowIndices() const { return row_indices_; }
+
+    /**
+     * Return true if the matrix is symmetric.
+     * 
+     * This operation runs in O(nnz + N). Rows are visited in increasing
+     * order while a cursor per row tracks the next entry below the diagonal
+     * that has not yet been matched with its mirror image above the diagonal.
+     * Since columns are sorted, every mirror image must be found exactly at
+     * the cursor of its row.
+     */
+    bool isSymmetric() const {
+        return symmetryCheck(true);
+    }
+
+    /**
+     * Return true if the non-zero pattern of the matrix is symmetric,
+     * regardless of the values. Explicitly stored zeros are not part of
+     * the pattern. This runs in O(nnz + N).
+     */
+    bool isStructurallySymmetric() const {
+        return symmetryCheck(false);
+    }
+
+    /**
+     * Return true if there are no non-zero entries above the diagonal.
+     * Since columns are sorted, only the tail of each row needs to be
+     * inspected.
+     */
+    bool isLowerTriangular() const {
+        for (int i = 0; i < nRows_; i++) {
+            for (int k = row_indices_[i + 1] - 1; k >= row_indices_[i] && column_indices_[k] > i; k--) {
+                if (values_[k] != 0.0) return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Return true if there are no non-zero entries below the diagonal.
+     * Since columns are sorted, only the head of each row needs to be
+     * inspected.
+     */
+    bool isUpperTriangular() const {
+        for (int i = 0; i < nRows_; i++) {
+            for (int k = row_indices_[i]; k < row_indices_[i + 1] && column_indices_[k] < i; k++) {
+                if (values_[k] != 0.0) return false;
+            }
+        }
+        return true;
+    }
+
+    int lowerBandwidth() const {
+        int res = 0;
+        for (int i = 0; i < nRows_; i++) {
+            int j = firstNonZero(i);
+            if (j != -1 && j < i) res = std::max(res, i - j);
+        }
+        return res;
+    }
+
+    int upperBandwidth() const {
+        int res = 0;
+        for (int i = 0; i < nRows_; i++) {
+            int j = lastNonZero(i);
+            if (j != -1 && j > i) res = std::max(res, j - i);
+        }
+        return res;
+    }
+
+    long profile() const {
+        long res = 0;
+        for (int i = 0; i < nRows_; i++) {
+            int j = firstNonZero(i);
+            if (j != -1 && j < i) res += i - j;
+        }
+        return res;
+    }
+
+    /**
+     * Return true if the matrix is diagonally dominant. This runs in O(nnz).
+     */
+    bool isDiagonallyDominant(bool strict = false) const {
+        if (nRows_ != nCols_) return false;
+        for (int i = 0; i < nRows_; i++) {
+            double d = 0.0;
+            double acc = 0.0;
+            for (int k = row_indices_[i]; k < row_indices_[i + 1]; k++) {
+                if (column_indices_[k] == i) {
+                    d = std::abs(values_[k]);
+                } else {
+                    acc += std::abs(values_[k]);
+                }
+            }
+            if (strict ? d <= acc: d < acc) return false;
+        }
+        return true;
+    }
+
+    /**
+     * Return true if both matrices have the same dimensions and entries.
+     * 
+     * Rows are compared in parallel by merging their sorted columns, which
+     * runs in O(nnz). All threads stop as soon as any of them finds a
+     * mismatch.
+     */
+    bool equals(const CSRSparseMatrix &B) const {
+        if (nRows_ != B.nRows_ || nCols_ != B.nCols_) return false;
+        std::atomic<bool> equal{true};
+        parallel::forEachThread([&](int t, int n) {
+            auto [a, b] = parallel::balancedRange(row_indices_.data(), nRows_, t, n);
+            for (int i = a; i < b && equal.load(std::memory_order_relaxed); i++) {
+                if (!rowEquals(i, B)) equal.store(false, std::memory_order_relaxed);
+            }
+        });
+        return equal.load();
+    }
+
+    /**
+     * Return the linear combination αA + βB of two matrices with the same
+     * dimensions.
+     * 
+     * The rows of both matrices are sorted, so each row of the result is
+     * computed by merging the two rows, which runs in O(nnz(A) + nnz(B)).
+     * A symbolic pass first counts the entries of every row so that the
+     * result can be allocated once, and a numeric pass then fills it in.
+     * Both passes run in parallel over rows. Entries that cancel out are
+     * dropped, so the result never stores explicit zeros.
+     */
+    static CSRSparseMatrix add(double alpha, const CSRSparseMatrix &A, double beta, const CSRSparseMatrix &B) {
+        if (A.nRows_ != B.nRows_ || A.nCols_ != B.nCols_) {
+            throw DimensionMismatchException{};
+        }
+
+        int M = A.nRows_;
+        const int *balance = A.nnz() >= B.nnz() ? A.row_indices_.data(): B.row_indices_.data();
+        auto forEachBlock = [&](auto &&f) {
+            parallel::forEachThread([&](int t, int n) {
+                auto [a, b] = parallel::balancedRange(balance, M, t, n);
+                f(a, b);
+            });
+        };
+
+        // Symbolic pass: count the union of the columns of every row.
+        std::vector<int> row_indices(M + 1, 0);
+        forEachBlock([&](int a, int b) {
+            for (int i = a; i < b; i++) {
+                int p = A.row_indices_[i], pe = A.row_indices_[i + 1];
+                int q = B.row_indices_[i], qe = B.row_indices_[i + 1];
+                int count = 0;
+                while (p < pe && q < qe) {
+                    int cp = A.column_indices_[p];
+                    int cq = B.column_indices_[q];
+                    p += cp <= cq;
+                    q += cq <= cp;
+                    count += 1;
+                }
+                row_indices[i + 1] = count + (pe - p) + (qe - q);
+            }
+        });
+        for (int i = 0; i < M; i++) {
+            row_indices[i + 1] += row_indices[i];
+        }
+
+        // Numeric pass: merge the rows, recording how many entries of each
+        // row survived cancellation.
+        std::vector<int> column_indices(row_indices[M]);
+        std::vector<double> values(row_indices[M]);
+        std::vector<int> kept(M);
+        std::atomic<bool> cancelled{false};
+        forEachBlock([&](int a, int b) {
+            for (int i = a; i < b; i++) {
+                int p = A.row_indices_[i], pe = A.row_indices_[i + 1];
+                int q = B.row_indices_[i], qe = B.row_indices_[i + 1];
+                int k = row_indices[i];
+                while (p < pe || q < qe) {
+                    int cp = p < pe ? A.column_indices_[p]: A.nCols_;
+                    int cq = q < qe ? B.column_indices_[q]: B.nCols_;
+                    int j = std::min(cp, cq);
+                    double v = 0.0;
+                    if (cp == j) v += alpha * A.values_[p++];
+                    if (cq == j) v += beta * B.values_[q++];
+                    if (v != 0.0) {
+                        column_indices[k] = j;
+                        values[k] = v;
+                        k += 1;
+                    }
+                }
+                kept[i] = k - row_indices[i];
+                if (k != row_indices[i + 1]) cancelled.store(true, std::memory_order_relaxed);
+            }
+        });
+
+        if (!cancelled.load()) {
+            return CSRSparseMatrix(M, A.nCols_, std::move(row_indices), std::move(column_indices), std::move(values));
+        }
+
+        // Some entries cancelled out, so compact the rows.
+        std::vector<int> compact_row_indices(M + 1, 0);
+        for (int i = 0; i < M; i++) {
+            compact_row_indices[i + 1] = compact_row_indices[i] + kept[i];
+        }
+        std::vector<int> compact_column_indices(compact_row_indices[M]);
+        std::vector<double> compact_values(compact_row_indices[M]);
+        forEachBlock([&](int a, int b) {
+            for (int i = a; i < b; i++) {
+                std::copy_n(column_indices.begin() + row_indices[i], kept[i], compact_column_indices.begin() + compact_row_indices[i]);
+                std::copy_n(values.begin() + row_indices[i], kept[i], compact_values.begin() + compact_row_indices[i]);
+            }
+        });
+        return CSRSparseMatrix(M, A.nCols_, std::move(compact_row_indices), std::move(compact_column_indices), std::move(compact_values));
+    }
+
+    CSRSparseMatrix operator+(const CSRSparseMatrix &B) const {
+        return add(1.0, *this, 1.0, B);
+    }
+
+    CSRSparseMatrix operator-(const CSRSparseMatrix &B) const {
+        return add(1.0, *this, -1.0, B);
+    }
+
+    /**
+     * Return PA, the matrix whose kth row is row `p[k]` of this matrix. Rows
+     * are copied in parallel without re-sorting, so this runs in O(nnz + N).
+     */
+    CSRSparseMatrix rowPermuted(const Permutation &p) const {
+        return permutedImpl(&p, nullptr);
+    }
+
+    /**
+     * Return AQᵀ, the matrix whose kth column is column `q[k]` of this
+     * matrix. Each row is re-sorted after its columns are renumbered.
+     */
+    CSRSparseMatrix columnPermuted(const Permutation &q) const {
+        return permutedImpl(nullptr, &q);
+    }
+
+    /**
+     * Return PAPᵀ, the matrix whose (k, l) entry is the (p[k], p[l]) entry of
+     * this matrix. This is the permutation that should be applied to a
+     * square matrix when reordering the unknowns of a linear system, since
+     * it preserves symmetry and keeps the diagonal on the diagonal.
+     */
+    CSRSparseMatrix symmetricPermuted(const Permutation &p) const {
+        return permutedImpl(&p, &p);
+    }
+
+    /**
+     * Return PAQᵀ, permuting the rows by p and the columns by q.
+     */
+    CSRSparseMatrix permuted(const Permutation &p, const Permutation &q) const {
+        return permutedImpl(&p, &q);
+    }
+
     /**
      * Return a view to the ith row in the matrix. 
      */
@@ -266,14 +783,24 @@ public:
      * Return the transpose of the original matrix.
      */
     CSRSparseMatrix transposed() const {
-        DOKSparseMatrix mat{nCols(), nRows()};
+        ZOP_INSTRUMENT("transposed", 0, 24.0 * nnz() + 4.0 * (nRows() + nCols()));
+        // A counting sort by column: the entries of each column are visited
+        // in increasing row order, so the rows of the result stay sorted.
+        std::vector<int> rows(nCols() + 1, 0);
+        for (int j: column_indices_) rows[j + 1]++;
+        for (int j = 0; j < nCols(); j++) rows[j + 1] += rows[j];
+        std::vector<int> cols(nnz());
+        std::vector<double> vals(nnz());
+        std::vector<int> fill(rows.begin(), rows.end() - 1);
         for (int i = 0; i < nRows(); i++) {
-            for (auto [j, e]: row(i)) {
-                mat.setEntry(j, i, e);
+            for (int k = row_indices_[i]; k < row_indices_[i + 1]; k++) {
+                int p = fill[column_indices_[k]]++;
+                cols[p] = i;
+                vals[p] = values_[k];
             }
         }
-        return CSRSparseMatrix(mat);
-    } 
+        return CSRSparseMatrix(nCols(), nRows(), std::move(rows), std::move(cols), std::move(vals));
+    }
 
     friend std::ostream& operator<<(std::ostream& str, const CSRSparseMatrix &mat) {
         str << "[";
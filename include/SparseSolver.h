@@ -0,0 +1,664 @@
+#ifndef ZOP_SPARSE_SOLVER_H
+#define ZOP_SPARSE_SOLVER_H
+
+/**
+ *  \file SparseSolver.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains supernodal sparse direct solvers for CSR matrices.
+ */
+
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <cassert>
+
+#include <Vector.h>
+#include <SparseMatrix.h>
+#include <Permutation.h>
+#include <Ordering.h>
+
+namespace zop {
+
+/**
+ * The symbolic analysis of a sparse factorization, which only depends on
+ * the non-zero pattern of the matrix. Computing it once and reusing it for
+ * every matrix with the same pattern avoids repeating the most irregular
+ * part of the work when only the values change.
+ *
+ * The analysis is performed on the pattern of PAPᵀ + (PAPᵀ)ᵀ, where P is a
+ * fill-reducing ordering followed by a postordering of the elimination
+ * tree, and consists of:
+ *
+ * 1. the elimination tree, computed with Liu's algorithm,
+ * 2. the number of entries in every column of the factor, computed by
+ *    traversing the row subtrees of the elimination tree,
+ * 3. the fundamental supernodes: chains of consecutive columns with nested
+ *    patterns, which are stored and factored as dense panels, and
+ * 4. the row pattern of every supernode, and a map from every entry of the
+ *    original matrix to its position in the panels.
+ */
+class SymbolicFactorization {
+public:
+
+    /**
+     * The panel that an entry of the original matrix is scattered to. Lower
+     * entries (including the diagonal) go to the L panel. Upper entries go
+     * to the diagonal block of the L panel if they are in the same
+     * supernode as their mirror image, and to the Uᵀ panel otherwise.
+     */
+    enum class Target: char { Lower, UpperDiagonal, Upper };
+
+private:
+    int n_ = 0;
+    Permutation ordering_;
+    std::vector<int> pattern_rows_;
+    std::vector<int> pattern_cols_;
+    std::vector<int> parent_;
+    std::vector<int> column_counts_;
+    std::vector<int> super_start_;
+    std::vector<int> column_super_;
+    std::vector<int> super_rows_start_;
+    std::vector<int> super_rows_;
+    std::vector<long> panel_offsets_;
+    std::vector<long> value_map_;
+    std::vector<Target> value_target_;
+
+    /**
+     * Return the adjacency lists of the symmetric pattern of A relabelled
+     * by the permutation p.
+     */
+    static std::vector<std::vector<int>> permutedAdjacency(const ordering::Graph &g, const Permutation &p) {
+        int n = g.size();
+        std::vector<std::vector<int>> adj(n);
+        for (int t = 0; t < n; t++) {
+            int i = p[t];
+            for (const int *u = g.begin(i); u != g.end(i); u++) {
+                adj[t].push_back(p.inverse(*u));
+            }
+            std::sort(adj[t].begin(), adj[t].end());
+        }
+        return adj;
+    }
+
+    static std::vector<int> eliminationTree(const std::vector<std::vector<int>> &adj) {
+        int n = adj.size();
+        std::vector<int> parent(n, -1), ancestor(n, -1);
+        for (int i = 0; i < n; i++) {
+            for (int k: adj[i]) {
+                if (k >= i) break;
+                int r = k;
+                while (ancestor[r] != -1 && ancestor[r] != i) {
+                    int t = ancestor[r];
+                    ancestor[r] = i;
+                    r = t;
+                }
+                if (ancestor[r] == -1) {
+                    ancestor[r] = i;
+                    parent[r] = i;
+                }
+            }
+        }
+        return parent;
+    }
+
+    static std::vector<int> postorder(const std::vector<int> &parent) {
+        int n = parent.size();
+        std::vector<int> head(n, -1), next(n, -1), order;
+        order.reserve(n);
+        for (int j = n - 1; j >= 0; j--) {
+            if (parent[j] == -1) continue;
+            next[j] = head[parent[j]];
+            head[parent[j]] = j;
+        }
+        std::vector<int> stack;
+        for (int root = 0; root < n; root++) {
+            if (parent[root] != -1) continue;
+            stack.push_back(root);
+            while (!stack.empty()) {
+                int j = stack.back();
+                if (head[j] != -1) {
+                    int child = head[j];
+                    head[j] = next[child];
+                    stack.push_back(child);
+                } else {
+                    stack.pop_back();
+                    order.push_back(j);
+                }
+            }
+        }
+        return order;
+    }
+
+public:
+
+    /**
+     * Analyze the pattern of a square matrix using the given fill-reducing
+     * ordering.
+     */
+    SymbolicFactorization(const CSRSparseMatrix &A, const Permutation &ordering):
+        n_{A.nRows()},
+        ordering_{ordering},
+        pattern_rows_{A.rowIndices()},
+        pattern_cols_{A.columnIndices()} {
+
+        if (A.nRows() != A.nCols()) {
+            throw std::runtime_error("matrix must be square");
+        }
+        if (ordering.size() != n_) {
+            throw DimensionMismatchException{};
+        }
+
+        // Postorder the elimination tree so that every supernode is a range
+        // of consecutive columns.
+        ordering::Graph g{A};
+        {
+            auto adj = permutedAdjacency(g, ordering_);
+            std::vector<int> post = postorder(eliminationTree(adj));
+            ordering_ = Permutation(post).compose(ordering_);
+        }
+        auto adj = permutedAdjacency(g, ordering_);
+        parent_ = eliminationTree(adj);
+
+        // Column counts: the pattern of row i of L is the subtree of the
+        // elimination tree spanned by the entries of row i of A.
+        column_counts_.assign(n_, 1);
+        std::vector<int> mark(n_, -1), children(n_, 0);
+        for (int i = 0; i < n_; i++) {
+            mark[i] = i;
+            for (int k: adj[i]) {
+                if (k >= i) break;
+                for (int r = k; mark[r] != i; r = parent_[r]) {
+                    column_counts_[r] += 1;
+                    mark[r] = i;
+                }
+            }
+            if (parent_[i] != -1) children[parent_[i]] += 1;
+        }
+
+        // Fundamental supernodes.
+        column_super_.resize(n_);
+        for (int j = 0; j < n_; j++) {
+            bool merge = j > 0 && parent_[j - 1] == j && children[j] == 1
+                && column_counts_[j - 1] == column_counts_[j] + 1;
+            if (!merge) super_start_.push_back(j);
+            column_super_[j] = (int) super_start_.size() - 1;
+        }
+        super_start_.push_back(n_);
+        int S = supernodeCount();
+
+        // Row patterns of the supernodes, built from the pattern of A and the
+        // patterns of the child supernodes.
+        std::vector<std::vector<int>> childSupernodes(S);
+        for (int s = 0; s < S; s++) {
+            int p = parent_[super_start_[s + 1] - 1];
+            if (p != -1) childSupernodes[column_super_[p]].push_back(s);
+        }
+        std::fill(mark.begin(), mark.end(), -1);
+        super_rows_start_.push_back(0);
+        for (int s = 0; s < S; s++) {
+            int f = super_start_[s];
+            int l = super_start_[s + 1];
+            std::vector<int> below;
+            for (int j = f; j < l; j++) {
+                mark[j] = s;
+                for (int k: adj[j]) {
+                    if (k >= l && mark[k] != s) {
+                        mark[k] = s;
+                        below.push_back(k);
+                    }
+                }
+            }
+            for (int c: childSupernodes[s]) {
+                for (int k = super_rows_start_[c]; k < super_rows_start_[c + 1]; k++) {
+                    int r = super_rows_[k];
+                    if (r >= l && mark[r] != s) {
+                        mark[r] = s;
+                        below.push_back(r);
+                    }
+                }
+            }
+            std::sort(below.begin(), below.end());
+            for (int j = f; j < l; j++) super_rows_.push_back(j);
+            super_rows_.insert(super_rows_.end(), below.begin(), below.end());
+            super_rows_start_.push_back(super_rows_.size());
+            assert(rowCount(s) == column_counts_[f]);
+        }
+
+        panel_offsets_.resize(S + 1);
+        panel_offsets_[0] = 0;
+        for (int s = 0; s < S; s++) {
+            panel_offsets_[s + 1] = panel_offsets_[s] + (long) rowCount(s) * columnCount(s);
+        }
+
+        // Map every entry of A to its position in the panels.
+        value_map_.resize(pattern_cols_.size());
+        value_target_.resize(pattern_cols_.size());
+        for (int i = 0; i < n_; i++) {
+            for (int k = pattern_rows_[i]; k < pattern_rows_[i + 1]; k++) {
+                int pi = ordering_.inverse(i);
+                int pj = ordering_.inverse(pattern_cols_[k]);
+                Target target = Target::Lower;
+                if (pi < pj) {
+                    target = column_super_[pi] == column_super_[pj] ? Target::UpperDiagonal: Target::Upper;
+                    std::swap(pi, pj);
+                }
+                // Position (pi, pj) in the panel of the supernode holding
+                // column pj, with pi >= pj.
+                int s = column_super_[pj];
+                int row = relativeRow(s, pi);
+                int col = pj - super_start_[s];
+                if (target == Target::UpperDiagonal) std::swap(row, col);
+                value_map_[k] = panel_offsets_[s] + row + (long) col * rowCount(s);
+                value_target_[k] = target;
+            }
+        }
+    }
+
+    /**
+     * Analyze the pattern of a square matrix using an approximate minimum
+     * degree ordering.
+     */
+    explicit SymbolicFactorization(const CSRSparseMatrix &A):
+        SymbolicFactorization(A, ordering::approximateMinimumDegree(A)) {}
+
+    int size() const { return n_; }
+    int supernodeCount() const { return (int) super_start_.size() - 1; }
+
+    /**
+     * Return the final ordering, including the postordering of the
+     * elimination tree.
+     */
+    const Permutation& ordering() const { return ordering_; }
+    const std::vector<int>& eliminationTree() const { return parent_; }
+    const std::vector<int>& columnCounts() const { return column_counts_; }
+
+    /**
+     * Return the number of entries in L, including the diagonal.
+     */
+    long factorEntries() const {
+        long res = 0;
+        for (int c: column_counts_) res += c;
+        return res;
+    }
+
+    int firstColumn(int s) const { return super_start_[s]; }
+    int columnCount(int s) const { return super_start_[s + 1] - super_start_[s]; }
+    int rowCount(int s) const { return super_rows_start_[s + 1] - super_rows_start_[s]; }
+    int supernodeOf(int j) const { return column_super_[j]; }
+    const int* rows(int s) const { return super_rows_.data() + super_rows_start_[s]; }
+    long panelOffset(int s) const { return panel_offsets_[s]; }
+    long panelSize() const { return panel_offsets_.back(); }
+
+    /**
+     * Return the position of a global row in the row pattern of a
+     * supernode, or -1 if it is not part of the pattern.
+     */
+    int relativeRow(int s, int row) const {
+        const int *begin = rows(s);
+        const int *end = begin + rowCount(s);
+        const int *it = std::lower_bound(begin, end, row);
+        return (it != end && *it == row) ? (int) (it - begin): -1;
+    }
+
+    /**
+     * Return true if A has exactly the pattern that was analyzed.
+     */
+    bool matches(const CSRSparseMatrix &A) const {
+        return A.nRows() == n_ && A.nCols() == n_
+            && A.rowIndices() == pattern_rows_ && A.columnIndices() == pattern_cols_;
+    }
+
+    long valuePosition(int k) const { return value_map_[k]; }
+    Target valueTarget(int k) const { return value_target_[k]; }
+};
+
+namespace detail {
+
+    /**
+     * A left-looking supernodal factorization. Supernodes are factored in
+     * order; before supernode s is factored, every earlier supernode d
+     * whose row pattern intersects the columns of s applies its update to
+     * s as a dense matrix product. Descendants are found through linked
+     * lists keyed by the next row of d that has not been used yet, so only
+     * the supernodes that actually update s are visited.
+     */
+    class SupernodalFactor {
+    protected:
+        std::shared_ptr<const SymbolicFactorization> symbolic_;
+        std::vector<double> L_;
+        std::vector<double> U_;
+        bool unsymmetric_;
+
+        SupernodalFactor(std::shared_ptr<const SymbolicFactorization> symbolic, bool unsymmetric):
+            symbolic_{std::move(symbolic)},
+            unsymmetric_{unsymmetric} {}
+
+        void scatter(const CSRSparseMatrix &A) {
+            if (!symbolic_->matches(A)) {
+                throw std::runtime_error("matrix pattern differs from the analyzed pattern");
+            }
+            const auto &S = *symbolic_;
+            L_.assign(S.panelSize(), 0.0);
+            if (unsymmetric_) U_.assign(S.panelSize(), 0.0);
+            const auto &values = A.values();
+            for (int k = 0; k < (int) values.size(); k++) {
+                switch (S.valueTarget(k)) {
+                case SymbolicFactorization::Target::Lower:
+                case SymbolicFactorization::Target::UpperDiagonal:
+                    if (unsymmetric_ || S.valueTarget(k) == SymbolicFactorization::Target::Lower) {
+                        L_[S.valuePosition(k)] = values[k];
+                    }
+                    break;
+                case SymbolicFactorization::Target::Upper:
+                    if (unsymmetric_) U_[S.valuePosition(k)] = values[k];
+                    break;
+                }
+            }
+        }
+
+        /**
+         * Apply the update of descendant d, whose rows [p, q) lie in the
+         * columns of s, to supernode s.
+         */
+        void update(int d, int p, int q, int s, const std::vector<int> &relative, std::vector<double> &work) {
+            const auto &S = *symbolic_;
+            int md = S.rowCount(d);
+            int nd = S.columnCount(d);
+            int ms = S.rowCount(s);
+            int f = S.firstColumn(s);
+            const int *rows = S.rows(d);
+            const double *Ld = L_.data() + S.panelOffset(d);
+            const double *Ud = unsymmetric_ ? U_.data() + S.panelOffset(d): Ld;
+            double *Ls = L_.data() + S.panelOffset(s);
+            double *Us = unsymmetric_ ? U_.data() + S.panelOffset(s): nullptr;
+
+            // work = Ld[p:md, :] * Ud[p:q, :]ᵀ, stored column-major.
+            int m = md - p;
+            int w = q - p;
+            work.assign((size_t) m * w, 0.0);
+            for (int c = 0; c < w; c++) {
+                double *out = work.data() + (size_t) c * m;
+                for (int k = 0; k < nd; k++) {
+                    double u = Ud[(p + c) + (size_t) k * md];
+                    if (u == 0.0) continue;
+                    const double *col = Ld + p + (size_t) k * md;
+                    for (int r = 0; r < m; r++) {
+                        out[r] += col[r] * u;
+                    }
+                }
+            }
+            for (int c = 0; c < w; c++) {
+                long colOffset = (long) (rows[p + c] - f) * ms;
+                for (int r = 0; r < m; r++) {
+                    Ls[relative[rows[p + r]] + colOffset] -= work[r + (size_t) c * m];
+                }
+            }
+
+            if (!unsymmetric_ || q == md) return;
+
+            // Us[q:md, :] -= Ud[q:md, :] * Ld[p:q, :]ᵀ
+            m = md - q;
+            work.assign((size_t) m * w, 0.0);
+            for (int c = 0; c < w; c++) {
+                double *out = work.data() + (size_t) c * m;
+                for (int k = 0; k < nd; k++) {
+                    double l = Ld[(p + c) + (size_t) k * md];
+                    if (l == 0.0) continue;
+                    const double *col = Ud + q + (size_t) k * md;
+                    for (int r = 0; r < m; r++) {
+                        out[r] += col[r] * l;
+                    }
+                }
+            }
+            for (int c = 0; c < w; c++) {
+                long colOffset = (long) (rows[p + c] - f) * ms;
+                for (int r = 0; r < m; r++) {
+                    Us[relative[rows[q + r]] + colOffset] -= work[r + (size_t) c * m];
+                }
+            }
+        }
+
+        /**
+         * Factor the dense panel of supernode s after all updates have been
+         * applied.
+         */
+        void factorPanel(int s) {
+            const auto &S = *symbolic_;
+            int m = S.rowCount(s);
+            int n = S.columnCount(s);
+            double *L = L_.data() + S.panelOffset(s);
+            auto at = [&](int r, int c) -> double& { return L[r + (size_t) c * m]; };
+
+            if (!unsymmetric_) {
+                // Cholesky of the diagonal block followed by L21 = A21 L11⁻ᵀ,
+                // done column by column.
+                for (int c = 0; c < n; c++) {
+                    double d = at(c, c);
+                    if (!(d > 0.0)) {
+                        throw std::runtime_error("matrix must be positive definite");
+                    }
+                    d = std::sqrt(d);
+                    at(c, c) = d;
+                    for (int r = c + 1; r < m; r++) at(r, c) /= d;
+                    for (int c2 = c + 1; c2 < n; c2++) {
+                        double v = at(c2, c);
+                        if (v == 0.0) continue;
+                        for (int r = c2; r < m; r++) at(r, c2) -= at(r, c) * v;
+                    }
+                }
+                return;
+            }
+
+            // LU without pivoting of the diagonal block together with the
+            // L21 panel, followed by the Uᵀ panel.
+            double *U = U_.data() + S.panelOffset(s);
+            for (int c = 0; c < n; c++) {
+                double d = at(c, c);
+                if (d == 0.0) {
+                    throw std::runtime_error("zero pivot");
+                }
+                for (int r = c + 1; r < m; r++) at(r, c) /= d;
+                for (int c2 = c + 1; c2 < n; c2++) {
+                    double u = at(c, c2);
+                    if (u == 0.0) continue;
+                    for (int r = c + 1; r < m; r++) at(r, c2) -= at(r, c) * u;
+                }
+            }
+            for (int r = n; r < m; r++) {
+                for (int c = 0; c < n; c++) {
+                    double acc = U[r + (size_t) c * m];
+                    for (int k = 0; k < c; k++) {
+                        acc -= at(c, k) * U[r + (size_t) k * m];
+                    }
+                    U[r + (size_t) c * m] = acc;
+                }
+            }
+        }
+
+        void factor(const CSRSparseMatrix &A) {
+            scatter(A);
+            const auto &S = *symbolic_;
+            int N = S.supernodeCount();
+            std::vector<int> head(N, -1), link(N, -1), nextRow(N, 0);
+            std::vector<int> relative(S.size(), -1);
+            std::vector<double> work;
+
+            for (int s = 0; s < N; s++) {
+                const int *rows = S.rows(s);
+                for (int r = 0; r < S.rowCount(s); r++) relative[rows[r]] = r;
+
+                int l = S.firstColumn(s) + S.columnCount(s);
+                for (int d = head[s]; d != -1;) {
+                    int next = link[d];
+                    const int *drows = S.rows(d);
+                    int p = nextRow[d];
+                    int q = p;
+                    while (q < S.rowCount(d) && drows[q] < l) q++;
+                    update(d, p, q, s, relative, work);
+                    nextRow[d] = q;
+                    if (q < S.rowCount(d)) {
+                        int t = S.supernodeOf(drows[q]);
+                        link[d] = head[t];
+                        head[t] = d;
+                    }
+                    d = next;
+                }
+
+                factorPanel(s);
+
+                nextRow[s] = S.columnCount(s);
+                if (S.rowCount(s) > S.columnCount(s)) {
+                    int t = S.supernodeOf(rows[S.columnCount(s)]);
+                    link[s] = head[t];
+                    head[t] = s;
+                }
+            }
+        }
+
+        /**
+         * Solve Ly = b in place, where L has a unit diagonal for LU.
+         */
+        void forward(std::vector<double> &y) const {
+            const auto &S = *symbolic_;
+            for (int s = 0; s < S.supernodeCount(); s++) {
+                int f = S.firstColumn(s);
+                int m = S.rowCount(s);
+                int n = S.columnCount(s);
+                const int *rows = S.rows(s);
+                const double *L = L_.data() + S.panelOffset(s);
+                for (int c = 0; c < n; c++) {
+                    if (!unsymmetric_) y[f + c] /= L[c + (size_t) c * m];
+                    double v = y[f + c];
+                    for (int r = c + 1; r < m; r++) {
+                        y[rows[r]] -= L[r + (size_t) c * m] * v;
+                    }
+                }
+            }
+        }
+
+        /**
+         * Solve Lᵀx = y (Cholesky) or Ux = y (LU) in place.
+         */
+        void backward(std::vector<double> &y) const {
+            const auto &S = *symbolic_;
+            for (int s = S.supernodeCount() - 1; s >= 0; s--) {
+                int f = S.firstColumn(s);
+                int m = S.rowCount(s);
+                int n = S.columnCount(s);
+                const int *rows = S.rows(s);
+                const double *L = L_.data() + S.panelOffset(s);
+                const double *U = unsymmetric_ ? U_.data() + S.panelOffset(s): L;
+                for (int c = n - 1; c >= 0; c--) {
+                    double acc = y[f + c];
+                    for (int r = n; r < m; r++) {
+                        acc -= U[r + (size_t) c * m] * y[rows[r]];
+                    }
+                    for (int c2 = c + 1; c2 < n; c2++) {
+                        acc -= (unsymmetric_ ? L[c + (size_t) c2 * m]: L[c2 + (size_t) c * m]) * y[f + c2];
+                    }
+                    y[f + c] = acc / L[c + (size_t) c * m];
+                }
+            }
+        }
+
+    public:
+
+        const SymbolicFactorization& symbolic() const {
+            return *symbolic_;
+        }
+
+        std::shared_ptr<const SymbolicFactorization> sharedSymbolic() const {
+            return symbolic_;
+        }
+
+        /**
+         * Solve Ax = b using the factorization.
+         */
+        Vector solve(const Vector &b) const {
+            const auto &S = *symbolic_;
+            if (b.dim() != S.size()) throw DimensionMismatchException{};
+            std::vector<double> y(S.size());
+            for (int t = 0; t < S.size(); t++) {
+                y[t] = b[S.ordering()[t]];
+            }
+            forward(y);
+            backward(y);
+            Vector x(S.size());
+            for (int t = 0; t < S.size(); t++) {
+                x[S.ordering()[t]] = y[t];
+            }
+            return x;
+        }
+    };
+
+}
+
+/**
+ * A supernodal sparse Cholesky factorization PAPᵀ = LLᵀ of a symmetric
+ * positive definite matrix.
+ *
+ * Typical usage in a time-stepping loop analyzes the pattern once and then
+ * calls `refactor` whenever the values change:
+ *
+ *     SupernodalCholesky chol{A};
+ *     for (...) {
+ *         chol.refactor(A);
+ *         x = chol.solve(b);
+ *     }
+ */
+class SupernodalCholesky: public detail::SupernodalFactor {
+public:
+
+    explicit SupernodalCholesky(const CSRSparseMatrix &A):
+        SupernodalCholesky(std::make_shared<SymbolicFactorization>(A), A) {}
+
+    SupernodalCholesky(std::shared_ptr<const SymbolicFactorization> symbolic, const CSRSparseMatrix &A):
+        SupernodalFactor(std::move(symbolic), false) {
+        refactor(A);
+    }
+
+    /**
+     * Recompute the numeric factorization for a matrix with the same
+     * pattern, reusing the symbolic analysis.
+     */
+    void refactor(const CSRSparseMatrix &A) {
+        if (!A.isSymmetric()) {
+            throw std::runtime_error("matrix must by symmetric");
+        }
+        factor(A);
+    }
+};
+
+/**
+ * A supernodal sparse LU factorization PAPᵀ = LU without pivoting. The
+ * pattern of A + Aᵀ is used for the symbolic analysis, so the factors
+ * share the supernodal structure of a Cholesky factorization. Since no
+ * pivoting is performed, this is intended for matrices that are diagonally
+ * dominant or otherwise known to factor stably in the chosen ordering.
+ */
+class SupernodalLU: public detail::SupernodalFactor {
+public:
+
+    explicit SupernodalLU(const CSRSparseMatrix &A):
+        SupernodalLU(std::make_shared<SymbolicFactorization>(A), A) {}
+
+    SupernodalLU(std::shared_ptr<const SymbolicFactorization> symbolic, const CSRSparseMatrix &A):
+        SupernodalFactor(std::move(symbolic), true) {
+        refactor(A);
+    }
+
+    /**
+     * Recompute the numeric factorization for a matrix with the same
+     * pattern, reusing the symbolic analysis.
+     */
+    void refactor(const CSRSparseMatrix &A) {
+        factor(A);
+    }
+};
+
+}
+
+#endif /* ZOP_SPARSE_SOLVER_H */
@@ -0,0 +1,304 @@
+#ifndef ZOP_SPATIAL_INDEX_H
+#define ZOP_SPATIAL_INDEX_H
+
+/**
+ *  \file SpatialIndex.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains a packed R-tree over the bounding boxes of a polygon
+ *  collection, used to answer point-in-polygon and box intersection queries
+ *  without scanning every polygon.
+ */
+
+#include <vector>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+
+#include <Polygon.h>
+#include <Parallel.h>
+
+namespace zop {
+
+/**
+ * An axis-aligned box in the plane.
+ */
+struct BoundingBox {
+    double minX = std::numeric_limits<double>::infinity();
+    double minY = std::numeric_limits<double>::infinity();
+    double maxX = -std::numeric_limits<double>::infinity();
+    double maxY = -std::numeric_limits<double>::infinity();
+
+    void expand(double x, double y) {
+        minX = std::min(minX, x);
+        minY = std::min(minY, y);
+        maxX = std::max(maxX, x);
+        maxY = std::max(maxY, y);
+    }
+
+    void expand(const BoundingBox &b) {
+        minX = std::min(minX, b.minX);
+        minY = std::min(minY, b.minY);
+        maxX = std::max(maxX, b.maxX);
+        maxY = std::max(maxY, b.maxY);
+    }
+
+    bool contains(double x, double y) const {
+        return minX <= x && x <= maxX && minY <= y && y <= maxY;
+    }
+
+    bool intersects(const BoundingBox &b) const {
+        return minX <= b.maxX && b.minX <= maxX && minY <= b.maxY && b.minY <= maxY;
+    }
+};
+
+namespace detail {
+
+/**
+ * Return the index of the cell (x, y) of a 2^16 x 2^16 grid along the
+ * Hilbert curve. Consecutive indices are adjacent cells, so sorting by
+ * this index keeps nearby boxes and points together.
+ */
+inline unsigned hilbertIndex(unsigned x, unsigned y) {
+    unsigned d = 0;
+    for (unsigned s = 1u << 15; s > 0; s >>= 1) {
+        unsigned rx = (x & s) > 0;
+        unsigned ry = (y & s) > 0;
+        d += s * s * ((3 * rx) ^ ry);
+        if (ry == 0) {
+            if (rx == 1) {
+                x = s - 1 - (x & (s - 1));
+                y = s - 1 - (y & (s - 1));
+            }
+            std::swap(x, y);
+        }
+        x &= s - 1;
+        y &= s - 1;
+    }
+    return d;
+}
+
+/**
+ * Maps coordinates inside a box to the cells of the Hilbert grid.
+ */
+struct HilbertGrid {
+    double minX, minY, scaleX, scaleY;
+
+    explicit HilbertGrid(const BoundingBox &box) {
+        minX = box.minX;
+        minY = box.minY;
+        double w = box.maxX - box.minX;
+        double h = box.maxY - box.minY;
+        scaleX = w > 0.0 ? 65535.0 / w: 0.0;
+        scaleY = h > 0.0 ? 65535.0 / h: 0.0;
+    }
+
+    unsigned index(double x, double y) const {
+        double cx = std::min(65535.0, std::max(0.0, (x - minX) * scaleX));
+        double cy = std::min(65535.0, std::max(0.0, (y - minY) * scaleY));
+        return hilbertIndex((unsigned) cx, (unsigned) cy);
+    }
+};
+
+}
+
+/**
+ * A static R-tree over the polygons of a PolygonCollection, bulk loaded by
+ * sorting the bounding boxes along a Hilbert curve and packing them into
+ * full nodes level by level.
+ *
+ * All nodes are stored in one flat array of boxes, leaves first and the
+ * root last, so a traversal only touches contiguous memory. The children
+ * of node k of a level are nodes [k B, (k + 1) B) of the level below,
+ * where B is the node capacity, and no child pointers are needed.
+ *
+ * The tree refers to the collection, which must outlive it and must not be
+ * modified.
+ */
+class PackedRTree {
+private:
+    const PolygonCollection *polygons_;
+    int nodeSize_;
+    std::vector<BoundingBox> boxes_;
+    std::vector<int> items_;
+    std::vector<int> levelOffsets_;
+
+    /**
+     * Call f(item, box) for every leaf entry whose box passes the filter,
+     * which is applied to the boxes of the inner nodes as well. Returns
+     * early if f returns false.
+     */
+    template <class Filter, class F>
+    void traverse(Filter &&filter, F &&f) const {
+        if (items_.empty() || !filter(boxes_.back())) return;
+        struct Entry { int level; int node; };
+        std::vector<Entry> stack;
+        stack.reserve(height() * nodeSize_);
+        stack.push_back({height() - 1, 0});
+        while (!stack.empty()) {
+            Entry e = stack.back();
+            stack.pop_back();
+            int first = e.node * nodeSize_;
+            int below = e.level - 1;
+            int count = below < 0 ? 0: levelOffsets_[below + 1] - levelOffsets_[below];
+            if (e.level == 0) {
+                if (!f(items_[e.node], boxes_[e.node])) return;
+                continue;
+            }
+            // Children are pushed in reverse so that they are visited in
+            // order, which makes the traversal order deterministic.
+            for (int c = std::min(count, first + nodeSize_) - 1; c >= first; c--) {
+                if (filter(boxes_[levelOffsets_[below] + c])) stack.push_back({below, c});
+            }
+        }
+    }
+
+public:
+
+    /**
+     * Build the tree over the polygons of P. Every node holds up to
+     * nodeSize children.
+     */
+    explicit PackedRTree(const PolygonCollection &P, int nodeSize = 16):
+        polygons_{&P}, nodeSize_{nodeSize} {
+        if (nodeSize < 2) throw std::runtime_error("node size must be at least 2");
+        int n = P.size();
+        std::vector<BoundingBox> leaves(n);
+        BoundingBox extent;
+        parallel::parallelFor(0, n, [&](int p) {
+            const double *x = P.xs().data();
+            const double *y = P.ys().data();
+            for (int k = P.offsets()[p]; k < P.offsets()[p + 1]; k++) {
+                leaves[p].expand(x[k], y[k]);
+            }
+        });
+        for (const BoundingBox &b: leaves) extent.expand(b);
+
+        std::vector<unsigned> keys(n);
+        detail::HilbertGrid grid(extent);
+        parallel::parallelFor(0, n, [&](int p) {
+            const BoundingBox &b = leaves[p];
+            keys[p] = grid.index(0.5 * (b.minX + b.maxX), 0.5 * (b.minY + b.maxY));
+        });
+        items_.resize(n);
+        std::iota(items_.begin(), items_.end(), 0);
+        std::stable_sort(items_.begin(), items_.end(), [&](int a, int b) { return keys[a] < keys[b]; });
+
+        boxes_.reserve(2 * n + 1);
+        for (int p: items_) boxes_.push_back(leaves[p]);
+        levelOffsets_.push_back(0);
+        levelOffsets_.push_back(n);
+        int count = n;
+        while (count > 1) {
+            int begin = levelOffsets_[levelOffsets_.size() - 2];
+            int parents = (count + nodeSize_ - 1) / nodeSize_;
+            for (int k = 0; k < parents; k++) {
+                BoundingBox b;
+                for (int c = k * nodeSize_; c < std::min(count, (k + 1) * nodeSize_); c++) {
+                    b.expand(boxes_[begin + c]);
+                }
+                boxes_.push_back(b);
+            }
+            levelOffsets_.push_back(levelOffsets_.back() + parents);
+            count = parents;
+        }
+    }
+
+    int size() const {
+        return items_.size();
+    }
+
+    /**
+     * Return the number of levels, including the leaves.
+     */
+    int height() const {
+        return (int) levelOffsets_.size() - 1;
+    }
+
+    /**
+     * Return the box that encloses all polygons.
+     */
+    BoundingBox bounds() const {
+        return boxes_.empty() ? BoundingBox{}: boxes_.back();
+    }
+
+    /**
+     * Return the polygons whose bounding boxes intersect the given box, in
+     * increasing order.
+     */
+    std::vector<int> intersecting(const BoundingBox &box) const {
+        std::vector<int> res;
+        traverse([&](const BoundingBox &b) { return b.intersects(box); },
+                 [&](int p, const BoundingBox &) { res.push_back(p); return true; });
+        std::sort(res.begin(), res.end());
+        return res;
+    }
+
+    /**
+     * Return the polygons that contain the point (x, y), in increasing
+     * order.
+     */
+    std::vector<int> containing(double x, double y) const {
+        std::vector<int> res;
+        traverse([&](const BoundingBox &b) { return b.contains(x, y); },
+                 [&](int p, const BoundingBox &) {
+                     if (polygons_->contains(p, x, y)) res.push_back(p);
+                     return true;
+                 });
+        std::sort(res.begin(), res.end());
+        return res;
+    }
+
+    /**
+     * For each of the n points (px[i], py[i]), write the smallest index of
+     * a polygon that contains it to out[i], or -1 if there is none.
+     *
+     * The points are sorted along the same Hilbert curve as the tree and
+     * split into packets of neighboring points. Each packet traverses the
+     * tree once, pruned by the bounding box of the packet, and the points
+     * inside the box of each leaf reached are tested against its polygon. Packets are
+     * processed in parallel.
+     */
+    void locate(const double *px, const double *py, int n, int *out) const {
+        constexpr int packet = 32;
+        std::vector<unsigned> keys(n);
+        detail::HilbertGrid grid(bounds());
+        parallel::parallelFor(0, n, [&](int i) {
+            keys[i] = grid.index(px[i], py[i]);
+            out[i] = -1;
+        });
+        std::vector<int> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](int a, int b) { return keys[a] < keys[b]; });
+
+        int packets = (n + packet - 1) / packet;
+        parallel::parallelFor(0, packets, [&](int q) {
+            const int *members = order.data() + q * packet;
+            int count = std::min(packet, n - q * packet);
+            BoundingBox span;
+            for (int k = 0; k < count; k++) span.expand(px[members[k]], py[members[k]]);
+            traverse([&](const BoundingBox &b) { return b.intersects(span); },
+                     [&](int p, const BoundingBox &leaf) {
+                         for (int k = 0; k < count; k++) {
+                             int i = members[k];
+                             if (out[i] != -1 && out[i] < p) continue;
+                             if (!leaf.contains(px[i], py[i])) continue;
+                             if (polygons_->contains(p, px[i], py[i])) out[i] = p;
+                         }
+                         return true;
+                     });
+        });
+    }
+
+    std::vector<int> locate(const std::vector<double> &px, const std::vector<double> &py) const {
+        if (px.size() != py.size()) throw DimensionMismatchException{};
+        std::vector<int> res(px.size());
+        locate(px.data(), py.data(), px.size(), res.data());
+        return res;
+    }
+};
+
+}
+
+#endif /* ZOP_SPATIAL_INDEX_H */
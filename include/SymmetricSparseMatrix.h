@@ -0,0 +1,254 @@
+#ifndef ZOP_SYMMETRIC_SPARSE_MATRIX_H
+#define ZOP_SYMMETRIC_SPARSE_MATRIX_H
+
+/**
+ *  \file SymmetricSparseMatrix.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains a sparse matrix format that stores only one triangle
+ *  of a symmetric matrix.
+ */
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include <Matrix.h>
+#include <Vector.h>
+#include <Parallel.h>
+#include <SparseMatrix.h>
+
+namespace zop {
+
+/**
+ * This class represents a symmetric sparse matrix by storing a single
+ * triangle (including the diagonal) in compressed sparse row format. This
+ * roughly halves the memory footprint of the matrix compared to a
+ * CSRSparseMatrix, and since sparse matrix-vector multiplication is memory
+ * bound, it also makes multiplication faster: every stored entry is read
+ * once and applied twice, once for its own position and once for its mirror
+ * image.
+ */
+class SymmetricSparseMatrix: public AbstractMatrix<SymmetricSparseMatrix> {
+public:
+
+    /**
+     * The triangle of the matrix that is stored.
+     */
+    enum class Triangle { Upper, Lower };
+
+    using Builder = DOKSparseMatrix;
+
+private:
+    int n_ = 0;
+    Triangle triangle_ = Triangle::Upper;
+    std::vector<double> values_;
+    std::vector<int> column_indices_;
+    std::vector<int> row_indices_;
+
+    /**
+     * Apply the rows [a, b) to x. The direct contributions of each row are
+     * added to y. The contributions of the mirrored entries are added to y
+     * if their row lies in [a, b), and to `ghost[j - offset]` otherwise.
+     */
+    void multiplyRows(int a, int b, const double *x, double *y, double *ghost, int offset) const {
+        for (int i = a; i < b; i++) {
+            double acc = 0.0;
+            double xi = x[i];
+            for (int k = row_indices_[i]; k < row_indices_[i + 1]; k++) {
+                int j = column_indices_[k];
+                double v = values_[k];
+                acc += v * x[j];
+                if (j == i) continue;
+                if (a <= j && j < b) {
+                    y[j] += v * xi;
+                } else {
+                    ghost[j - offset] += v * xi;
+                }
+            }
+            y[i] += acc;
+        }
+    }
+
+public:
+
+    /**
+     * Construct a symmetric matrix from a CSR matrix, keeping only the
+     * given triangle. Throws if the matrix is not symmetric.
+     */
+    SymmetricSparseMatrix(const CSRSparseMatrix &A, Triangle triangle = Triangle::Upper):
+        n_{A.nRows()},
+        triangle_{triangle} {
+
+        if (!A.isSymmetric()) {
+            throw std::runtime_error("matrix must by symmetric");
+        }
+
+        // A symmetric matrix stores its diagonal once and every other entry
+        // twice, so one triangle holds at most (nnz + N) / 2 entries.
+        int stored = (A.nnz() + n_) / 2;
+        values_.reserve(stored);
+        column_indices_.reserve(stored);
+        row_indices_.resize(n_ + 1);
+        row_indices_[0] = 0;
+        for (int i = 0; i < n_; i++) {
+            for (auto [j, e]: A.row(i)) {
+                if (triangle_ == Triangle::Upper ? j >= i: j <= i) {
+                    values_.push_back(e);
+                    column_indices_.push_back(j);
+                }
+            }
+            row_indices_[i + 1] = values_.size();
+        }
+    }
+
+    SymmetricSparseMatrix(const DOKSparseMatrix &M): SymmetricSparseMatrix(CSRSparseMatrix(M)) {}
+
+    int nRows() const { return n_; }
+    int nCols() const { return n_; }
+    Triangle triangle() const { return triangle_; }
+
+    /**
+     * Return the number of stored entries, which only counts one triangle.
+     */
+    int nnz() const { return values_.size(); }
+
+    bool isSymmetric() const { return true; }
+
+    /**
+     * Returns the value at the given position. This is a O(log(N))
+     * operation in the number of entries of the stored row.
+     */
+    double getEntry(int i, int j) const {
+        assert(0 <= i && i < n_);
+        assert(0 <= j && j < n_);
+        if (triangle_ == Triangle::Upper ? j < i: j > i) std::swap(i, j);
+        auto begin = column_indices_.begin() + row_indices_[i];
+        auto end = column_indices_.begin() + row_indices_[i + 1];
+        auto it = std::lower_bound(begin, end, j);
+        if (it == end || *it != j) return 0.0;
+        return values_[it - column_indices_.begin()];
+    }
+
+    /**
+     * Return the full matrix, with both triangles, in CSR format.
+     */
+    CSRSparseMatrix toCSR() const {
+        std::vector<int> counts(n_ + 1, 0);
+        for (int i = 0; i < n_; i++) {
+            for (int k = row_indices_[i]; k < row_indices_[i + 1]; k++) {
+                int j = column_indices_[k];
+                counts[i + 1] += 1;
+                if (j != i) counts[j + 1] += 1;
+            }
+        }
+        for (int i = 0; i < n_; i++) {
+            counts[i + 1] += counts[i];
+        }
+
+        // Visiting the stored rows in order emits the mirrored entries of
+        // each row in increasing column order as well, so every row of the
+        // result ends up sorted without an explicit sort.
+        std::vector<int> row_indices = counts;
+        std::vector<int> column_indices(counts[n_]);
+        std::vector<double> values(counts[n_]);
+        auto emit = [&](int i, int j, double v) {
+            column_indices[counts[i]] = j;
+            values[counts[i]] = v;
+            counts[i] += 1;
+        };
+        if (triangle_ == Triangle::Upper) {
+            for (int i = 0; i < n_; i++) {
+                for (int k = row_indices_[i]; k < row_indices_[i + 1]; k++) {
+                    int j = column_indices_[k];
+                    if (j != i) emit(j, i, values_[k]);
+                }
+            }
+            for (int i = 0; i < n_; i++) {
+                for (int k = row_indices_[i]; k < row_indices_[i + 1]; k++) {
+                    emit(i, column_indices_[k], values_[k]);
+                }
+            }
+        } else {
+            for (int i = 0; i < n_; i++) {
+                for (int k = row_indices_[i]; k < row_indices_[i + 1]; k++) {
+                    emit(i, column_indices_[k], values_[k]);
+                }
+            }
+            for (int i = 0; i < n_; i++) {
+                for (int k = row_indices_[i]; k < row_indices_[i + 1]; k++) {
+                    int j = column_indices_[k];
+                    if (j != i) emit(j, i, values_[k]);
+                }
+            }
+        }
+        return CSRSparseMatrix(n_, n_, std::move(row_indices), std::move(column_indices), std::move(values));
+    }
+
+    /**
+     * Return the product of this matrix and a dense vector.
+     *
+     * Each thread is assigned a block of rows holding roughly the same
+     * number of stored entries. A thread writes the contributions of its own
+     * rows directly to the result, and accumulates the contributions of
+     * mirrored entries that fall outside of its block into a private buffer.
+     * The buffers are summed into the result in a second pass, so no two
+     * threads ever write to the same location and no atomics are needed.
+     * A buffer only spans the columns the block actually reaches outside of
+     * itself, so for banded matrices the buffers and their reduction stay
+     * small no matter the number of threads.
+     */
+    Vector operator*(const Vector &v) const {
+        if (v.dim() != nCols()) throw DimensionMismatchException{};
+        ZOP_INSTRUMENT("spmv.symmetric", 4.0 * nnz(), 12.0 * nnz() + 4.0 * n_ + 16.0 * n_);
+        Vector res(n_);
+        const double *x = v.data();
+        double *y = res.data();
+
+        int nThreads = parallel::threadCount();
+        if (nThreads == 1 || n_ < 2 * nThreads) {
+            multiplyRows(0, n_, x, y, y, 0);
+            return res;
+        }
+
+        // For the upper triangle, the mirrored entries of the block [a, b)
+        // all lie below it, in [b, c] for the largest column c of its rows,
+        // which is the last entry of a row. For the lower triangle they lie
+        // in [c, a) for the smallest column c, the first entry of a row.
+        std::vector<std::vector<double>> ghosts(nThreads);
+        std::vector<int> offsets(nThreads);
+        parallel::forEachThread([&](int t, int n) {
+            for (int p = t; p < nThreads; p += n) {
+                auto [a, b] = parallel::balancedRange(row_indices_.data(), n_, p, nThreads);
+                int lo = triangle_ == Triangle::Upper ? b: a, hi = lo;
+                for (int i = a; i < b; i++) {
+                    if (row_indices_[i] == row_indices_[i + 1]) continue;
+                    if (triangle_ == Triangle::Upper) {
+                        hi = std::max(hi, column_indices_[row_indices_[i + 1] - 1] + 1);
+                    } else {
+                        lo = std::min(lo, column_indices_[row_indices_[i]]);
+                    }
+                }
+                offsets[p] = lo;
+                ghosts[p].assign(hi - lo, 0.0);
+                multiplyRows(a, b, x, y, ghosts[p].data(), lo);
+            }
+        });
+
+        parallel::parallelForRange(0, n_, [&](int a, int b) {
+            for (int p = 0; p < nThreads; p++) {
+                int lo = std::max(a, offsets[p]);
+                int hi = std::min(b, offsets[p] + (int) ghosts[p].size());
+                for (int j = lo; j < hi; j++) {
+                    y[j] += ghosts[p][j - offsets[p]];
+                }
+            }
+        });
+
+        return res;
+    }
+};
+
+}
+
+#endif /* ZOP_SYMMETRIC_SPARSE_MATRIX_H */
@@ -0,0 +1,399 @@
+#ifndef ZOP_TRIANGULATION_H
+#define ZOP_TRIANGULATION_H
+
+/**
+ *  \file Triangulation.h
+ *  \author Thomas Barrett
+ *
+ *  This file contains an O(n log n) triangulation of simple polygons by
+ *  decomposition into y-monotone pieces.
+ */
+
+#include <set>
+#include <cmath>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+
+#include <Polygon.h>
+#include <Parallel.h>
+
+namespace zop {
+
+/**
+ * Triangulates simple polygons in O(n log n) time.
+ *
+ * A plane sweep from top to bottom inserts diagonals at the split and
+ * merge vertices, which cuts the polygon into y-monotone pieces (de Berg
+ * et al., Computational Geometry, chapter 3). Each piece is then
+ * triangulated in linear time with a stack of its reflex chain. Vertices
+ * are ordered by decreasing y and then increasing x, which handles
+ * horizontal edges as if the plane were rotated by an infinitesimal angle.
+ *
+ * A triangulator keeps its scratch buffers, and the nodes of its sweep
+ * status, between calls, so triangulating many polygons with one instance
+ * allocates only while they grow.
+ * The input must be a simple polygon without repeated vertices, in either
+ * orientation.
+ */
+class Triangulator {
+private:
+    const double *x_ = nullptr;
+    const double *y_ = nullptr;
+    int n_ = 0;
+    bool reversed_ = false;
+    double sweepX_ = 0.0;
+    double sweepY_ = 0.0;
+
+    // The polygon is traversed in counter-clockwise order through these
+    // accessors, which map indices of the traversal to input indices.
+    int input(int k) const { return reversed_ ? n_ - 1 - k: k; }
+    double px(int k) const { return x_[input(k)]; }
+    double py(int k) const { return y_[input(k)]; }
+    int next(int k) const { return k + 1 == n_ ? 0: k + 1; }
+    int prev(int k) const { return k == 0 ? n_ - 1: k - 1; }
+
+    bool above(int a, int b) const {
+        return py(a) > py(b) || (py(a) == py(b) && px(a) < px(b));
+    }
+
+    double cross(int o, int a, int b) const {
+        return (px(a) - px(o)) * (py(b) - py(o)) - (py(a) - py(o)) * (px(b) - px(o));
+    }
+
+    /**
+     * Return the x coordinate of edge e (from vertex e to its successor)
+     * on the current sweep line. Edge -1 stands for the sweep point itself.
+     */
+    double xAt(int e) const {
+        if (e < 0) return sweepX_;
+        int a = e, b = next(e);
+        double ya = py(a), yb = py(b);
+        if (ya == yb) return std::min(std::max(sweepX_, std::min(px(a), px(b))), std::max(px(a), px(b)));
+        double t = (sweepY_ - ya) / (yb - ya);
+        return px(a) + t * (px(b) - px(a));
+    }
+
+    struct EdgeOrder {
+        const Triangulator *t;
+        bool operator()(int a, int b) const {
+            if (a == b) return false;
+            double xa = t->xAt(a), xb = t->xAt(b);
+            if (xa != xb) return xa < xb;
+            // The query point sorts after edges through it.
+            if (a < 0) return false;
+            if (b < 0) return true;
+            return a < b;
+        }
+    };
+
+    enum class Type { Start, End, Split, Merge, Regular };
+
+    std::vector<int> order_;
+    std::vector<int> helper_;
+    std::vector<Type> type_;
+    std::vector<std::pair<int, int>> diagonals_;
+
+    // The sweep status is rebuilt for every polygon, since its order refers
+    // to this instance, but the nodes of edges that leave it are kept here
+    // and reused by later insertions.
+    using Status = std::set<int, EdgeOrder>;
+    std::vector<Status::iterator> where_;
+    std::vector<Status::node_type> spare_;
+
+    // Half-edges of the subdivision into monotone pieces.
+    std::vector<int> outOffsets_;
+    std::vector<int> outTargets_;
+    std::vector<int> fill_;
+    std::vector<char> used_;
+    std::vector<int> piece_;
+    std::vector<int> chain_;
+    std::vector<int> stack_;
+
+    Type classify(int k) const {
+        bool prevBelow = above(k, prev(k));
+        bool nextBelow = above(k, next(k));
+        bool convex = cross(prev(k), k, next(k)) > 0.0;
+        if (prevBelow && nextBelow) return convex ? Type::Start: Type::Split;
+        if (!prevBelow && !nextBelow) return convex ? Type::End: Type::Merge;
+        return Type::Regular;
+    }
+
+    void partition() {
+        order_.resize(n_);
+        std::iota(order_.begin(), order_.end(), 0);
+        std::sort(order_.begin(), order_.end(), [&](int a, int b) { return above(a, b); });
+        helper_.assign(n_, -1);
+        type_.resize(n_);
+        for (int k = 0; k < n_; k++) type_[k] = classify(k);
+        diagonals_.clear();
+
+        Status status(EdgeOrder{this});
+        where_.assign(n_, status.end());
+
+        auto insert = [&](int e, int v) {
+            if (spare_.empty()) {
+                where_[e] = status.insert(e).first;
+            } else {
+                Status::node_type node = std::move(spare_.back());
+                spare_.pop_back();
+                node.value() = e;
+                where_[e] = status.insert(std::move(node)).position;
+            }
+            helper_[e] = v;
+        };
+        auto remove = [&](int e) {
+            spare_.push_back(status.extract(where_[e]));
+            where_[e] = status.end();
+        };
+        auto connectMerge = [&](int e, int v) {
+            if (helper_[e] >= 0 && type_[helper_[e]] == Type::Merge) diagonals_.push_back({v, helper_[e]});
+        };
+        auto leftOf = [&]() {
+            auto it = status.lower_bound(-1);
+            --it;
+            return *it;
+        };
+
+        for (int v: order_) {
+            sweepX_ = px(v);
+            sweepY_ = py(v);
+            int e = v, ePrev = prev(v);
+            switch (type_[v]) {
+            case Type::Start:
+                insert(e, v);
+                break;
+            case Type::End:
+                connectMerge(ePrev, v);
+                remove(ePrev);
+                break;
+            case Type::Split: {
+                int j = leftOf();
+                diagonals_.push_back({v, helper_[j]});
+                helper_[j] = v;
+                insert(e, v);
+                break;
+            }
+            case Type::Merge: {
+                connectMerge(ePrev, v);
+                remove(ePrev);
+                int j = leftOf();
+                connectMerge(j, v);
+                helper_[j] = v;
+                break;
+            }
+            case Type::Regular:
+                if (above(prev(v), v)) {
+                    // The interior lies to the right of v.
+                    connectMerge(ePrev, v);
+                    remove(ePrev);
+                    insert(e, v);
+                } else {
+                    int j = leftOf();
+                    connectMerge(j, v);
+                    helper_[j] = v;
+                }
+                break;
+            }
+        }
+        while (!status.empty()) spare_.push_back(status.extract(status.begin()));
+    }
+
+    double angle(int from, int to) const {
+        return std::atan2(py(to) - py(from), px(to) - px(from));
+    }
+
+    /**
+     * Return the half-edge that follows u → w on the boundary of the piece
+     * to its left: the first outgoing edge of w clockwise from w → u.
+     */
+    int follow(int u, int w) const {
+        double back = angle(w, u);
+        int best = -1;
+        double bestTurn = 0.0;
+        for (int h = outOffsets_[w]; h < outOffsets_[w + 1]; h++) {
+            int t = outTargets_[h];
+            if (t == u) continue;
+            double turn = back - angle(w, t);
+            while (turn <= 0.0) turn += 2 * M_PI;
+            while (turn > 2 * M_PI) turn -= 2 * M_PI;
+            if (best < 0 || turn < bestTurn) {
+                best = h;
+                bestTurn = turn;
+            }
+        }
+        return best;
+    }
+
+    void emit(int a, int b, int c, int *&out) const {
+        if (cross(a, b, c) < 0.0) std::swap(b, c);
+        *out++ = input(a);
+        *out++ = input(b);
+        *out++ = input(c);
+    }
+
+    /**
+     * Triangulate the y-monotone piece given by its vertices in
+     * counter-clockwise order.
+     */
+    void triangulateMonotone(const std::vector<int> &piece, int *&out) {
+        int m = piece.size();
+        if (m < 3) return;
+        int top = 0, bottom = 0;
+        for (int k = 1; k < m; k++) {
+            if (above(piece[k], piece[top])) top = k;
+            if (above(piece[bottom], piece[k])) bottom = k;
+        }
+
+        // Walking forward from the top descends the left chain.
+        for (int k = top; k != bottom; k = (k + 1) % m) chain_[piece[k]] = -1;
+        for (int k = bottom; k != top; k = (k + 1) % m) chain_[piece[k]] = 1;
+        order_.assign(piece.begin(), piece.end());
+        std::sort(order_.begin(), order_.end(), [&](int a, int b) { return above(a, b); });
+
+        stack_.clear();
+        stack_.push_back(order_[0]);
+        stack_.push_back(order_[1]);
+        for (int j = 2; j < m - 1; j++) {
+            int u = order_[j];
+            if (chain_[u] != chain_[stack_.back()]) {
+                for (size_t k = stack_.size() - 1; k > 0; k--) {
+                    emit(u, stack_[k], stack_[k - 1], out);
+                }
+                int last = stack_.back();
+                stack_.clear();
+                stack_.push_back(last);
+                stack_.push_back(u);
+            } else {
+                int last = stack_.back();
+                stack_.pop_back();
+                while (!stack_.empty()) {
+                    double turn = cross(u, last, stack_.back());
+                    bool inside = chain_[u] < 0 ? turn < 0.0: turn > 0.0;
+                    if (!inside) break;
+                    emit(u, last, stack_.back(), out);
+                    last = stack_.back();
+                    stack_.pop_back();
+                }
+                stack_.push_back(last);
+                stack_.push_back(u);
+            }
+        }
+        int u = order_[m - 1];
+        for (size_t k = stack_.size() - 1; k > 0; k--) {
+            emit(u, stack_[k], stack_[k - 1], out);
+        }
+    }
+
+public:
+
+    /**
+     * Triangulate the polygon with the n vertices (x[k], y[k]) and write
+     * the vertex indices of its n - 2 triangles to out, which must hold
+     * 3(n - 2) values. Every triangle is written in counter-clockwise
+     * order. Returns the number of triangles.
+     */
+    int triangulate(const double *x, const double *y, int n, int *out) {
+        if (n < 3) return 0;
+        x_ = x;
+        y_ = y;
+        n_ = n;
+        reversed_ = detail::ringSignedArea(x, y, n) < 0.0;
+        int *begin = out;
+
+        partition();
+
+        // Collect the outgoing half-edges of every vertex: its boundary edge
+        // and both directions of every diagonal.
+        outOffsets_.assign(n_ + 1, 0);
+        for (int k = 0; k < n_; k++) outOffsets_[k + 1] += 1;
+        for (auto [a, b]: diagonals_) {
+            outOffsets_[a + 1] += 1;
+            outOffsets_[b + 1] += 1;
+        }
+        for (int k = 0; k < n_; k++) outOffsets_[k + 1] += outOffsets_[k];
+        outTargets_.resize(outOffsets_[n_]);
+        fill_.assign(outOffsets_.begin(), outOffsets_.end() - 1);
+        for (int k = 0; k < n_; k++) outTargets_[fill_[k]++] = next(k);
+        for (auto [a, b]: diagonals_) {
+            outTargets_[fill_[a]++] = b;
+            outTargets_[fill_[b]++] = a;
+        }
+
+        // Trace the pieces. Every piece lies to the left of its half-edges.
+        used_.assign(outTargets_.size(), 0);
+        chain_.resize(n_);
+        for (int v = 0; v < n_; v++) {
+            for (int h = outOffsets_[v]; h < outOffsets_[v + 1]; h++) {
+                if (used_[h]) continue;
+                piece_.clear();
+                int u = v, e = h;
+                while (!used_[e]) {
+                    used_[e] = 1;
+                    piece_.push_back(u);
+                    int w = outTargets_[e];
+                    e = follow(u, w);
+                    u = w;
+                }
+                triangulateMonotone(piece_, out);
+            }
+        }
+        return (out - begin) / 3;
+    }
+
+    int triangulate(const SimplePolygon &P, int *out) {
+        return triangulate(P.xs().data(), P.ys().data(), P.vertexCount(), out);
+    }
+
+    /**
+     * Return the vertex indices of the triangles of P, three per triangle.
+     */
+    std::vector<int> triangulate(const SimplePolygon &P) {
+        std::vector<int> res(3 * std::max(0, P.vertexCount() - 2));
+        res.resize(3 * triangulate(P, res.data()));
+        return res;
+    }
+};
+
+/**
+ * Return the vertex indices of the triangles of P, three per triangle.
+ */
+inline std::vector<int> triangulate(const SimplePolygon &P) {
+    return Triangulator{}.triangulate(P);
+}
+
+/**
+ * Return the number of triangles of all polygons of P with at least three
+ * vertices.
+ */
+inline int triangleCount(const PolygonCollection &P) {
+    int res = 0;
+    for (int p = 0; p < P.size(); p++) res += std::max(0, P.vertexCount(p) - 2);
+    return res;
+}
+
+/**
+ * Triangulate every polygon of P in parallel. The triangles of polygon p
+ * are written to out in order, after those of the polygons before it, as
+ * indices into the vertex arrays of the collection. out must hold
+ * 3 triangleCount(P) values.
+ */
+inline void triangulate(const PolygonCollection &P, int *out) {
+    std::vector<int> first(P.size() + 1, 0);
+    for (int p = 0; p < P.size(); p++) first[p + 1] = first[p] + 3 * std::max(0, P.vertexCount(p) - 2);
+    parallel::forEachThread([&](int t, int n) {
+        auto [a, b] = parallel::balancedRange(P.offsets().data(), P.size(), t, n);
+        Triangulator triangulator;
+        for (int p = a; p < b; p++) {
+            int offset = P.offsets()[p];
+            int *target = out + first[p];
+            int count = triangulator.triangulate(P.xs().data() + offset, P.ys().data() + offset,
+                                                 P.vertexCount(p), target);
+            for (int k = 0; k < 3 * count; k++) target[k] += offset;
+        }
+    });
+}
+
+}
+
+#endif /* ZOP_TRIANGULATION_H */
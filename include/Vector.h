@@ -42,6 +42,17 @@ public:
         return dim_;
     }
 
+    /**
+     * Return a pointer to the contiguous underlying storage. This is intended
+     * for kernels that need raw access to the elements, such as SIMD gathers.
+     */
+    double* data() {
+        return data_.data();
+    }
+
+    const double* data() const {
+        return data_.data();
+    }
 
     double norm() const {
         return sqrt(this->dot(*this));
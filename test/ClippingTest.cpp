@@ -0,0 +1,205 @@
+#include "gtest/gtest.h"
+
+#include <random>
+#include <Clipping.h>
+
+using namespace zop;
+
+static SimplePolygon Rectangle(double x0, double y0, double x1, double y1) {
+    return SimplePolygon{{x0, y0}, {x1, y0}, {x1, y1}, {x0, y1}};
+}
+
+static SimplePolygon Regular(int n, double radius, double cx, double cy) {
+    std::vector<double> x(n), y(n);
+    for (int k = 0; k < n; k++) {
+        x[k] = cx + radius * std::cos(2 * M_PI * k / n);
+        y[k] = cy + radius * std::sin(2 * M_PI * k / n);
+    }
+    return SimplePolygon(x, y);
+}
+
+/**
+ * Return the total signed area of a list of rings, in which holes count
+ * negatively.
+ */
+static double Area(const std::vector<SimplePolygon> &rings) {
+    double sum = 0.0;
+    for (const SimplePolygon &P: rings) sum += P.signedArea();
+    return sum;
+}
+
+TEST(Clipping, convex) {
+    SimplePolygon window = Rectangle(0, 0, 2, 2);
+    ASSERT_DOUBLE_EQ(clipConvex(Rectangle(1, 1, 3, 3), window).area(), 1.0);
+    ASSERT_DOUBLE_EQ(clipConvex(Rectangle(0.5, 0.5, 1, 1), window).area(), 0.25);
+    ASSERT_EQ(clipConvex(Rectangle(3, 3, 4, 4), window).vertexCount(), 0);
+
+    // The window may be clockwise.
+    SimplePolygon reversed{{0, 0}, {0, 2}, {2, 2}, {2, 0}};
+    ASSERT_DOUBLE_EQ(clipConvex(Rectangle(1, -1, 3, 1), reversed).area(), 1.0);
+
+    // An L shape keeps its notch inside the window.
+    SimplePolygon L{{0, 0}, {4, 0}, {4, 1}, {1, 1}, {1, 4}, {0, 4}};
+    ASSERT_DOUBLE_EQ(clipConvex(L, window).area(), 3.0);
+
+    ASSERT_THROW(clipConvex(window, L), std::runtime_error);
+}
+
+TEST(Clipping, convexCollection) {
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<double> coord(-10, 10);
+    std::uniform_int_distribution<int> sides(3, 30);
+    PolygonCollection C;
+    for (int p = 0; p < 1000; p++) C.add(Regular(sides(gen), 1.5, coord(gen), coord(gen)));
+    SimplePolygon window = Regular(7, 6.0, 0.5, -0.5);
+
+    PolygonCollection clipped = clipConvex(C, window);
+    ASSERT_EQ(clipped.size(), C.size());
+    int empty = 0;
+    for (int p = 0; p < C.size(); p++) {
+        SimplePolygon expected = clipConvex(C.polygon(p), window);
+        ASSERT_EQ(clipped.polygon(p).xs(), expected.xs());
+        ASSERT_EQ(clipped.polygon(p).ys(), expected.ys());
+        empty += expected.vertexCount() == 0;
+    }
+    ASSERT_GT(empty, 100);
+    ASSERT_LT(empty, 900);
+
+    // Clipping into an existing collection replaces its contents and, once
+    // it is large enough, reuses its storage.
+    PolygonCollection reused = clipped;
+    const double *storage = reused.xs().data();
+    clipConvex(C, window, reused);
+    ASSERT_EQ(reused.offsets(), clipped.offsets());
+    ASSERT_EQ(reused.xs(), clipped.xs());
+    ASSERT_EQ(reused.xs().data(), storage);
+}
+
+TEST(Clipping, booleanSquares) {
+    SimplePolygon A = Rectangle(0, 0, 2, 2), B = Rectangle(1, 1, 3, 3);
+    auto I = booleanOperation(A, B, BooleanOperation::Intersection);
+    ASSERT_EQ(I.size(), 1);
+    ASSERT_EQ(I[0].vertexCount(), 4);
+    ASSERT_DOUBLE_EQ(I[0].signedArea(), 1.0);
+
+    auto U = booleanOperation(A, B, BooleanOperation::Union);
+    ASSERT_EQ(U.size(), 1);
+    ASSERT_EQ(U[0].vertexCount(), 8);
+    ASSERT_DOUBLE_EQ(Area(U), 7.0);
+
+    auto D = booleanOperation(A, B, BooleanOperation::Difference);
+    ASSERT_EQ(D.size(), 1);
+    ASSERT_EQ(D[0].vertexCount(), 6);
+    ASSERT_DOUBLE_EQ(Area(D), 3.0);
+
+    auto X = booleanOperation(A, B, BooleanOperation::Xor);
+    ASSERT_EQ(X.size(), 2);
+    ASSERT_DOUBLE_EQ(Area(X), 6.0);
+
+    // The rings can be appended to a collection instead.
+    PolygonCollection rings;
+    booleanOperation(A, B, BooleanOperation::Intersection, rings);
+    booleanOperation(A, B, BooleanOperation::Xor, rings);
+    ASSERT_EQ(rings.size(), 3);
+    ASSERT_EQ(rings.polygon(0).xs(), I[0].xs());
+    ASSERT_DOUBLE_EQ(rings.polygon(1).signedArea() + rings.polygon(2).signedArea(), 6.0);
+
+    // A clockwise input gives the same result.
+    SimplePolygon reversed{{1, 1}, {1, 3}, {3, 3}, {3, 1}};
+    ASSERT_DOUBLE_EQ(Area(booleanOperation(A, reversed, BooleanOperation::Union)), 7.0);
+}
+
+TEST(Clipping, booleanDegenerate) {
+    SimplePolygon A = Rectangle(0, 0, 2, 2);
+
+    // Squares that touch at a corner stay apart.
+    SimplePolygon corner = Rectangle(2, 2, 3, 3);
+    ASSERT_TRUE(booleanOperation(A, corner, BooleanOperation::Intersection).empty());
+    auto U = booleanOperation(A, corner, BooleanOperation::Union);
+    ASSERT_EQ(U.size(), 2);
+    ASSERT_DOUBLE_EQ(Area(U), 5.0);
+
+    // Squares that share part of an edge are merged.
+    SimplePolygon side = Rectangle(2, 1, 3, 3);
+    U = booleanOperation(A, side, BooleanOperation::Union);
+    ASSERT_EQ(U.size(), 1);
+    ASSERT_EQ(U[0].vertexCount(), 8);
+    ASSERT_DOUBLE_EQ(Area(U), 6.0);
+    ASSERT_TRUE(booleanOperation(A, side, BooleanOperation::Intersection).empty());
+    ASSERT_DOUBLE_EQ(Area(booleanOperation(A, side, BooleanOperation::Difference)), 4.0);
+
+    // A square inside another leaves a hole in the difference.
+    SimplePolygon inner = Rectangle(0.5, 0.5, 1.5, 1.5);
+    auto D = booleanOperation(A, inner, BooleanOperation::Difference);
+    ASSERT_EQ(D.size(), 2);
+    ASSERT_DOUBLE_EQ(Area(D), 3.0);
+    ASSERT_DOUBLE_EQ(Area(booleanOperation(A, inner, BooleanOperation::Union)), 4.0);
+    ASSERT_DOUBLE_EQ(Area(booleanOperation(inner, A, BooleanOperation::Intersection)), 1.0);
+    ASSERT_TRUE(booleanOperation(inner, A, BooleanOperation::Difference).empty());
+
+    // A square sharing its bottom edge with A, and A with itself.
+    SimplePolygon bottom = Rectangle(0, 0, 2, 1);
+    ASSERT_DOUBLE_EQ(Area(booleanOperation(A, bottom, BooleanOperation::Intersection)), 2.0);
+    ASSERT_DOUBLE_EQ(Area(booleanOperation(A, bottom, BooleanOperation::Difference)), 2.0);
+    ASSERT_DOUBLE_EQ(Area(booleanOperation(A, A, BooleanOperation::Union)), 4.0);
+    ASSERT_TRUE(booleanOperation(A, A, BooleanOperation::Difference).empty());
+}
+
+TEST(Clipping, booleanConvex) {
+    // For convex polygons the intersection must agree with clipConvex, and
+    // the areas must satisfy inclusion-exclusion.
+    std::mt19937 gen(2);
+    std::uniform_real_distribution<double> coord(-1, 1), radius(0.5, 2.0);
+    std::uniform_int_distribution<int> sides(3, 40);
+    for (int trial = 0; trial < 200; trial++) {
+        SimplePolygon A = Regular(sides(gen), radius(gen), coord(gen), coord(gen));
+        SimplePolygon B = Regular(sides(gen), radius(gen), coord(gen), coord(gen));
+        double i = Area(booleanOperation(A, B, BooleanOperation::Intersection));
+        ASSERT_NEAR(i, clipConvex(A, B).area(), 1e-9);
+        double u = Area(booleanOperation(A, B, BooleanOperation::Union));
+        ASSERT_NEAR(u, A.area() + B.area() - i, 1e-9);
+        ASSERT_NEAR(Area(booleanOperation(A, B, BooleanOperation::Difference)), A.area() - i, 1e-9);
+        ASSERT_NEAR(Area(booleanOperation(A, B, BooleanOperation::Xor)), u - i, 1e-9);
+    }
+}
+
+/**
+ * Return true if the point lies inside an odd number of the rings.
+ */
+static bool Covers(const std::vector<SimplePolygon> &rings, double x, double y) {
+    bool inside = false;
+    for (const SimplePolygon &P: rings) inside ^= P.contains({x, y});
+    return inside;
+}
+
+TEST(Clipping, booleanStars) {
+    // Star-shaped polygons cross each other many times, and the results
+    // must cover exactly the points selected by the operation.
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<double> radius(0.3, 1.0), coord(-1.2, 1.2);
+    auto star = [&](int n, double cx) {
+        std::vector<double> x(n), y(n);
+        for (int k = 0; k < n; k++) {
+            double r = radius(gen);
+            x[k] = cx + r * std::cos(2 * M_PI * k / n);
+            y[k] = r * std::sin(2 * M_PI * k / n);
+        }
+        return SimplePolygon(x, y);
+    };
+    for (int trial = 0; trial < 20; trial++) {
+        SimplePolygon A = star(10 + trial, 0.0), B = star(15 + 2 * trial, 0.3);
+        auto I = booleanOperation(A, B, BooleanOperation::Intersection);
+        auto U = booleanOperation(A, B, BooleanOperation::Union);
+        auto D = booleanOperation(A, B, BooleanOperation::Difference);
+        auto X = booleanOperation(A, B, BooleanOperation::Xor);
+        ASSERT_NEAR(Area(U), A.area() + B.area() - Area(I), 1e-9);
+        for (int s = 0; s < 500; s++) {
+            double x = coord(gen), y = coord(gen);
+            bool a = A.contains({x, y}), b = B.contains({x, y});
+            ASSERT_EQ(Covers(I, x, y), a && b);
+            ASSERT_EQ(Covers(U, x, y), a || b);
+            ASSERT_EQ(Covers(D, x, y), a && !b);
+            ASSERT_EQ(Covers(X, x, y), a != b);
+        }
+    }
+}
@@ -0,0 +1,184 @@
+#define ZOP_DEFINE_ALLOCATION_HOOKS
+#include <Instrumentation.h>
+
+#include "gtest/gtest.h"
+
+#include <Kernels.h>
+#include <MatrixView.h>
+#include <SELLSparseMatrix.h>
+#include <Triangulation.h>
+
+using namespace zop;
+
+/**
+ * These tests guard the asymptotic cost of the hot paths. Instead of timing
+ * operations, which is unreliable on shared machines, they count heap
+ * allocations and calls into the matrix interface, and compare the counts
+ * for problems of different sizes.
+ */
+
+template <class F>
+static uint64_t Allocations(F &&f) {
+    uint64_t before = instrumentation::allocationCount();
+    f();
+    return instrumentation::allocationCount() - before;
+}
+
+static DOKSparseMatrix Banded(int n, int width) {
+    DOKSparseMatrix A{n, n};
+    for (int i = 0; i < n; i++) {
+        for (int j = std::max(0, i - width); j <= std::min(n - 1, i + width); j++) {
+            A.setEntry(i, j, i == j ? 4.0 * width: -1.0);
+        }
+    }
+    return A;
+}
+
+/**
+ * A CSR matrix that counts the calls made through the AbstractMatrix
+ * interface.
+ */
+class Probe: public AbstractMatrix<Probe> {
+private:
+    CSRSparseMatrix mat_;
+
+public:
+    using Builder = DOKSparseMatrix;
+    using Row = CSRSparseMatrix::Row;
+
+    static inline long entryCalls = 0;
+    static inline long rowCalls = 0;
+
+    Probe(DOKSparseMatrix &&M): mat_{std::move(M)} {}
+
+    int nRows() const { return mat_.nRows(); }
+    int nCols() const { return mat_.nCols(); }
+
+    double getEntry(int i, int j) const {
+        entryCalls += 1;
+        return mat_.getEntry(i, j);
+    }
+
+    Row row(int i) const {
+        rowCalls += 1;
+        return mat_.row(i);
+    }
+};
+
+TEST(Complexity, allocationHooks) {
+    ASSERT_TRUE(instrumentation::allocationHooksInstalled());
+    ASSERT_EQ(Allocations([] { Vector v(100); }), 1);
+}
+
+TEST(Complexity, csrConstruction) {
+    DOKSparseMatrix warmup = Banded(10, 1);
+    CSRSparseMatrix{warmup};
+    CSRSparseMatrix{std::move(warmup)};
+
+    // Building CSR arrays from a DOK matrix takes a constant number of
+    // allocations, independent of the number of entries.
+    for (int n: {100, 10000}) {
+        DOKSparseMatrix D = Banded(n, 2);
+        ASSERT_LE(Allocations([&] { CSRSparseMatrix C{D}; }), 3) << n;
+        ASSERT_LE(Allocations([&] { CSRSparseMatrix C{std::move(D)}; }), 3) << n;
+    }
+}
+
+TEST(Complexity, steadyStateKernels) {
+    CSRSparseMatrix A{Banded(2000, 3)};
+    DenseMatrix B{64, 64}, C{64, 64}, X{2000, 16}, Y{2000, 16};
+    Vector x(2000), y(2000), u(64), w(64);
+    for (int i = 0; i < 2000; i++) x[i] = i;
+
+    auto step = [&] {
+        multiply(A, x, y, 1.0, 0.5);
+        multiplyTransposed(A, x, y);
+        multiply(B, u, w);
+        multiplyTransposed(B, u, w, 2.0, 1.0);
+        multiply(B, B, C, 1.0, 1.0);
+        multiply(A, X, Y, 1.0, 1.0);
+    };
+    step();
+    ASSERT_EQ(Allocations([&] { for (int k = 0; k < 10; k++) step(); }), 0);
+}
+
+TEST(Complexity, transposeIsLinear) {
+    CSRSparseMatrix small{Banded(1000, 2)};
+    CSRSparseMatrix large{Banded(4000, 2)};
+    small.transposed();
+
+    // Transposing allocates at most a constant amount per entry.
+    uint64_t a = Allocations([&] { small.transposed(); });
+    uint64_t b = Allocations([&] { large.transposed(); });
+    ASSERT_LE(b, 5 * a);
+
+    // A transpose view allocates only the result, once the per-thread
+    // buffers have grown to the largest problem.
+    Vector xs(1000), xl(4000);
+    transposeView(large) * xl;
+    uint64_t c = Allocations([&] { transposeView(small) * xs; });
+    uint64_t d = Allocations([&] { transposeView(large) * xl; });
+    ASSERT_EQ(c, 1);
+    ASSERT_EQ(d, 1);
+}
+
+TEST(Complexity, sellMultiplyAllocatesResult) {
+    // The lanes of a slice live on the stack, or in reused scratch space
+    // for chunk heights too large for it, so only the result is allocated.
+    CSRSparseMatrix A{Banded(2000, 3)};
+    Vector x(2000);
+    for (int C: {8, 32}) {
+        SELLSparseMatrix S{A, C, 64};
+        S * x;
+        ASSERT_EQ(Allocations([&] { S * x; }), 1) << C;
+    }
+}
+
+TEST(Complexity, warmTriangulatorDoesNotAllocate) {
+    // A star with a reflex vertex between every two convex ones, so that
+    // the sweep status holds many edges at once.
+    const int n = 200;
+    std::vector<double> x(n), y(n);
+    for (int k = 0; k < n; k++) {
+        double r = k % 2 ? 1.0: 2.0 + std::sin(0.1 * k);
+        x[k] = r * std::cos(2 * M_PI * k / n);
+        y[k] = r * std::sin(2 * M_PI * k / n);
+    }
+    std::vector<int> out(3 * (n - 2));
+    Triangulator T;
+    ASSERT_EQ(T.triangulate(x.data(), y.data(), n, out.data()), n - 2);
+    ASSERT_EQ(Allocations([&] { T.triangulate(x.data(), y.data(), n, out.data()); }), 0);
+}
+
+TEST(Complexity, rowDrivenMultiply) {
+    // The generic matrix-vector product visits every row once and never
+    // falls back to random access.
+    Probe P{Banded(500, 2)};
+    Vector x(500);
+    Probe::entryCalls = Probe::rowCalls = 0;
+    P * x;
+    ASSERT_EQ(Probe::rowCalls, 500);
+    ASSERT_EQ(Probe::entryCalls, 0);
+
+    // A block view of the probe reads only the entries of the block.
+    Probe::entryCalls = Probe::rowCalls = 0;
+    Vector z(10);
+    blockView(P, 100, 10, 200, 10) * z;
+    ASSERT_EQ(Probe::entryCalls, 100);
+}
+
+TEST(Complexity, instrumentedOperations) {
+    if (!instrumentation::enabled) GTEST_SKIP();
+
+    // Instrumented SpMV work is proportional to the stored entries.
+    CSRSparseMatrix A{Banded(3000, 1)};
+    CSRSparseMatrix B{Banded(3000, 4)};
+    Vector x(3000), y(3000);
+    instrumentation::reset();
+    multiply(A, x, y);
+    double a = instrumentation::snapshot("spmv.csr").flops;
+    multiply(B, x, y);
+    double b = instrumentation::snapshot("spmv.csr").flops - a;
+    ASSERT_DOUBLE_EQ(b / a, (double) B.nnz() / A.nnz());
+    ASSERT_EQ(instrumentation::snapshot("spmv.csr").allocations, 0);
+}
@@ -0,0 +1,122 @@
+#include "gtest/gtest.h"
+
+#include <CompressedSparseMatrix.h>
+#include <Kernels.h>
+#include <Random.h>
+
+using namespace zop;
+
+/**
+ * Check the entries and the product of C against the CSR matrix A, with a
+ * relative tolerance for the rounding of the stored values.
+ */
+template <class T>
+static void ExpectEqual(const CompressedSparseMatrix<T> &C, const CSRSparseMatrix &A, double tolerance) {
+    ASSERT_EQ(C.nRows(), A.nRows());
+    ASSERT_EQ(C.nCols(), A.nCols());
+    ASSERT_EQ(C.nnz(), A.nnz());
+    for (int i = 0; i < A.nRows(); i++) {
+        auto row = A.row(i);
+        auto it = row.begin();
+        C.forEachInRow(i, [&](int j, double v) {
+            auto [c, a] = *it;
+            ASSERT_EQ(j, c);
+            ASSERT_NEAR(v, a, tolerance * std::abs(a));
+            ++it;
+        });
+    }
+
+    Vector x(A.nCols()), y(A.nRows()), expected(A.nRows());
+    for (int j = 0; j < A.nCols(); j++) x[j] = std::cos(j + 0.5);
+    for (int i = 0; i < A.nRows(); i++) y[i] = expected[i] = i;
+    multiply(A, x, expected, 2.0, -1.0);
+    C.multiply(x, y, 2.0, -1.0);
+    for (int i = 0; i < A.nRows(); i++) {
+        double scale = 0.0;
+        for (auto [j, a]: A.row(i)) scale += std::abs(a * x[j]);
+        ASSERT_NEAR(y[i], expected[i], 2 * tolerance * scale + 1e-12 * (1 + std::abs(expected[i])));
+    }
+}
+
+TEST(CompressedSparseMatrix, encodings) {
+    // Row 0 has small gaps, row 1 a gap past one byte, row 2 gaps past two
+    // bytes, row 3 small gaps after an escaped first column, row 4 a small
+    // gap followed by one past one byte, and row 5 is empty.
+    int n = 200000;
+    DOKSparseMatrix D{6, n};
+    for (int j = 0; j < 100; j += 3) D.setEntry(0, j, j + 1.0);
+    for (int j = 0; j < 30000; j += 300) D.setEntry(1, j, 2.0);
+    for (int j = 70000; j < n; j += 70000) D.setEntry(2, j, 3.0);
+    for (int j = 1000; j < 1020; j++) D.setEntry(3, j, j - 999.0);
+    D.setEntry(4, 4, 4.0);
+    D.setEntry(4, 5, 5.0);
+    D.setEntry(4, 5000, -1.0);
+    CSRSparseMatrix A{D};
+
+    CompressedSparseMatrix<> C{A};
+    ASSERT_EQ(C.encoding(0), CompressedSparseMatrix<>::Delta8);
+    ASSERT_EQ(C.encoding(1), CompressedSparseMatrix<>::Delta16);
+    ASSERT_EQ(C.encoding(2), CompressedSparseMatrix<>::Absolute32);
+    ASSERT_EQ(C.encoding(3), CompressedSparseMatrix<>::Delta8);
+    ASSERT_EQ(C.encoding(4), CompressedSparseMatrix<>::Delta16);
+    ASSERT_EQ(C.getEntry(4, 5000), -1.0);
+    ASSERT_EQ(C.getEntry(0, 99), 100.0);
+    ASSERT_EQ(C.getEntry(0, 98), 0.0);
+    ASSERT_EQ(C.getEntry(2, 140000), 3.0);
+    ASSERT_EQ(C.getEntry(3, 1019), 20.0);
+    ExpectEqual(C, A, 0.0);
+    {
+        simd::ScopedPortable portable;
+        ExpectEqual(C, A, 0.0);
+    }
+
+    auto stats = C.compressionStatistics();
+    ASSERT_EQ(stats.nnz, A.nnz());
+    ASSERT_EQ(stats.rows8, 3);
+    ASSERT_EQ(stats.rows16, 2);
+    ASSERT_EQ(stats.rows32, 1);
+    ASSERT_EQ(stats.indexBytes, (std::size_t) 34 + 2 * 100 + 4 * 2 + 5 + 19 + 2 * 3);
+
+    ASSERT_THROW(C * Vector(4), DimensionMismatchException);
+    DOKSparseMatrix H{1, 1};
+    H.setEntry(0, 0, 1e300);
+    ASSERT_THROW(CompressedSparseMatrix<float>{CSRSparseMatrix(H)}, std::runtime_error);
+}
+
+TEST(CompressedSparseMatrix, multiply) {
+    CSRSparseMatrix R = random::sparse(3000, 2500, 0.01, 5);
+    ExpectEqual(CompressedSparseMatrix<double>{R}, R, 0.0);
+    ExpectEqual(CompressedSparseMatrix<float>{R}, R, 1e-7);
+
+    CSRSparseMatrix B = random::banded(5000, 3, 4);
+    CompressedSparseMatrix<double> Cd{B};
+    CompressedSparseMatrix<float> Cf{B};
+    ExpectEqual(Cd, B, 0.0);
+    ExpectEqual(Cf, B, 1e-7);
+
+    // One byte per index, and four more per value in single precision.
+    CompressionStatistics sd = Cd.compressionStatistics(), sf = Cf.compressionStatistics();
+    ASSERT_EQ(sd.rows8, 5000);
+    ASSERT_EQ(sd.indexBytes, (std::size_t) B.nnz());
+    ASSERT_GT(sd.ratio, 1.25);
+    ASSERT_GT(sf.ratio, 2.0);
+}
+
+TEST(CompressedSparseMatrix, multiplyRuns) {
+    // Rows of 9 to 21 entries, so that products decode several runs of
+    // eight differences and a few more one at a time, in rows of one and
+    // two bytes per difference.
+    CSRSparseMatrix B = random::banded(2000, 10, 10, 6);
+    CSRSparseMatrix R = random::sparse(2000, 100000, 0.0002, 7);
+    for (const CSRSparseMatrix *A: {&B, &R}) {
+        CompressedSparseMatrix<double> Cd{*A};
+        CompressedSparseMatrix<float> Cf{*A};
+        ExpectEqual(Cd, *A, 0.0);
+        ExpectEqual(Cf, *A, 1e-7);
+        simd::ScopedPortable portable;
+        ExpectEqual(Cd, *A, 0.0);
+        ExpectEqual(Cf, *A, 1e-7);
+    }
+    ASSERT_EQ(CompressedSparseMatrix<>{B}.compressionStatistics().rows8, 2000);
+    ASSERT_GT(CompressedSparseMatrix<>{R}.compressionStatistics().rows16, 0);
+}
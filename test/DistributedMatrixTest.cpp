@@ -0,0 +1,244 @@
+#include "gtest/gtest.h"
+
+#include <set>
+#include <sys/wait.h>
+#include <DistributedMatrix.h>
+
+using namespace zop;
+
+static CSRSparseMatrix RandomBandedMatrixFromSeed(int N, int band, int seed) {
+    std::srand(seed);
+
+    DOKSparseMatrix mat{N, N};
+    for (int i = 0; i < N; i++) {
+        for (int e = 0; e < 4; e++) {
+            int j = i + std::rand() % (2 * band + 1) - band;
+            if (j < 0 || j >= N) continue;
+            mat.setEntry(i, j, (double) std::rand() / RAND_MAX - 0.5);
+        }
+    }
+    // a few long range entries
+    mat.setEntry(0, N - 1, 1.0);
+    mat.setEntry(N - 1, 0, 1.0);
+    return CSRSparseMatrix(mat);
+}
+
+TEST(RowPartition, ghosts) {
+    CSRSparseMatrix A = RandomBandedMatrixFromSeed(100, 5, 42);
+    distributed::RowPartition partition{A, 4};
+
+    ASSERT_EQ(partition.begin(0), 0);
+    ASSERT_EQ(partition.end(3), 100);
+    for (int r = 0; r < 4; r++) {
+        for (int j: partition.ghosts(r)) {
+            ASSERT_NE(partition.owner(j), r);
+        }
+        for (int i = partition.begin(r); i < partition.end(r); i++) {
+            ASSERT_EQ(partition.owner(i), r);
+            for (auto [j, e]: A.row(i)) {
+                if (partition.owner(j) == r) continue;
+                const auto &ghosts = partition.ghosts(r);
+                ASSERT_TRUE(std::binary_search(ghosts.begin(), ghosts.end(), j));
+            }
+        }
+        for (int s = 0; s < 4; s++) {
+            auto [a, b] = partition.ghostRange(r, s);
+            for (int k = a; k < b; k++) {
+                ASSERT_EQ(partition.owner(partition.ghosts(r)[k]), s);
+            }
+        }
+    }
+}
+
+TEST(DistributedCSRSparseMatrix, multiply) {
+    const int N = 400;
+    const int P = 3;
+    const int ITERATIONS = 5;
+
+    CSRSparseMatrix A = RandomBandedMatrixFromSeed(N, 20, 7);
+    distributed::RowPartition partition{A, P};
+    std::string name = "/zop-test-" + std::to_string(getpid());
+    distributed::SharedMemorySegment segment{name, partition};
+
+    Vector x(N);
+    for (int i = 0; i < N; i++) {
+        x[i] = (i % 13) - 6.0;
+    }
+
+    // Every worker repeatedly computes x = Ax / 2, writing its
+    // block of the final result to shared memory.
+    double *result = static_cast<double *>(mmap(nullptr, sizeof(double) * N, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+    ASSERT_NE(result, MAP_FAILED);
+
+    std::vector<pid_t> workers;
+    for (int rank = 0; rank < P; rank++) {
+        pid_t pid = fork();
+        ASSERT_NE(pid, -1);
+        if (pid == 0) {
+            distributed::SharedMemoryTransport transport{segment, rank};
+            distributed::DistributedCSRSparseMatrix B{A, partition, transport};
+            Vector xLocal = partition.localSegment(x, rank);
+            for (int it = 0; it < ITERATIONS; it++) {
+                xLocal = (B * xLocal) * 0.5;
+            }
+            std::copy(xLocal.data(), xLocal.data() + xLocal.dim(), result + partition.begin(rank));
+            _exit(0);
+        }
+        workers.push_back(pid);
+    }
+    for (pid_t pid: workers) {
+        int status;
+        waitpid(pid, &status, 0);
+        ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    Vector expected = x;
+    for (int it = 0; it < ITERATIONS; it++) {
+        expected = (A * expected) * 0.5;
+    }
+    for (int i = 0; i < N; i++) {
+        ASSERT_NEAR(result[i], expected[i], 1e-9);
+    }
+    munmap(result, sizeof(double) * N);
+}
+
+TEST(DistributedCSRSparseMatrix, localMatrix) {
+    CSRSparseMatrix A = RandomBandedMatrixFromSeed(60, 3, 3);
+    distributed::RowPartition partition{A, 2};
+    std::string name = "/zop-test-local-" + std::to_string(getpid());
+    distributed::SharedMemorySegment segment{name, partition};
+    distributed::SharedMemoryTransport transport{segment, 1};
+    distributed::DistributedCSRSparseMatrix B{A, partition, transport};
+
+    ASSERT_EQ(B.localRowCount(), partition.end(1) - partition.begin(1));
+    ASSERT_EQ(B.ghostCount(), (int) partition.ghosts(1).size());
+    ASSERT_EQ(B.interiorRowCount() + B.boundaryRowCount(), B.localRowCount());
+    ASSERT_GT(B.interiorRowCount(), 0);
+    ASSERT_GT(B.boundaryRowCount(), 0);
+    ASSERT_EQ(B.localMatrix().nnz(), A.rowIndices()[partition.end(1)] - A.rowIndices()[partition.begin(1)]);
+}
+
+/**
+ * Return the rows [a, b) of an N x N matrix that no process has to hold in
+ * full: a few bands, and an entry coupling the first and last rows.
+ */
+static CSRSparseMatrix GeneratedRows(int N, int a, int b) {
+    std::vector<int> rows{0}, cols;
+    std::vector<double> vals;
+    for (int i = a; i < b; i++) {
+        std::vector<int> js{i - 17, i - 2, i, i + 3, i + 40};
+        if (i == 0) js.push_back(N - 1);
+        if (i == N - 1) js.insert(js.begin(), 0);
+        for (int j: js) {
+            if (j < 0 || j >= N) continue;
+            cols.push_back(j);
+            vals.push_back(std::sin(0.1 * i + j));
+        }
+        rows.push_back(cols.size());
+    }
+    return CSRSparseMatrix(b - a, N, rows, cols, vals);
+}
+
+TEST(DistributedCSRSparseMatrix, fromLocalRows) {
+    const int N = 500;
+    const int P = 3;
+    distributed::RowPartition partition{std::vector<int>{0, 150, 320, N}};
+    ASSERT_FALSE(partition.hasGhosts());
+    ASSERT_THROW(partition.ghosts(0), std::runtime_error);
+    std::string name = "/zop-test-rows-" + std::to_string(getpid());
+    distributed::SharedMemorySegment segment{name, partition};
+
+    Vector x(N);
+    for (int i = 0; i < N; i++) {
+        x[i] = std::cos(i);
+    }
+    double *result = static_cast<double *>(mmap(nullptr, sizeof(double) * N, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+    ASSERT_NE(result, MAP_FAILED);
+
+    // Every worker only ever builds its own rows.
+    std::vector<pid_t> workers;
+    for (int rank = 0; rank < P; rank++) {
+        pid_t pid = fork();
+        ASSERT_NE(pid, -1);
+        if (pid == 0) {
+            distributed::SharedMemoryTransport transport{segment, rank};
+            int a = partition.begin(rank), b = partition.end(rank);
+            CSRSparseMatrix rows = GeneratedRows(N, a, b);
+            auto B = distributed::DistributedCSRSparseMatrix::fromLocalRows(rows, partition, transport);
+            Vector xLocal = partition.localSegment(x, rank);
+            for (int it = 0; it < 3; it++) {
+                xLocal = (B * xLocal) * 0.5;
+            }
+            std::copy(xLocal.data(), xLocal.data() + xLocal.dim(), result + a);
+
+            // The ghosts are exactly the columns of the rows outside of them.
+            std::set<int> ghosts;
+            for (int j: rows.columnIndices()) {
+                if (j < a || j >= b) ghosts.insert(j);
+            }
+            _exit(B.ghosts() == std::vector<int>(ghosts.begin(), ghosts.end()) ? 0: 2);
+        }
+        workers.push_back(pid);
+    }
+    for (pid_t pid: workers) {
+        int status;
+        waitpid(pid, &status, 0);
+        ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    CSRSparseMatrix A = GeneratedRows(N, 0, N);
+    Vector expected = x;
+    for (int it = 0; it < 3; it++) {
+        expected = (A * expected) * 0.5;
+    }
+    for (int i = 0; i < N; i++) {
+        ASSERT_NEAR(result[i], expected[i], 1e-12);
+    }
+    munmap(result, sizeof(double) * N);
+}
+
+TEST(DistributedCSRSparseMatrix, fromLocalRowsWithGhosts) {
+    // A partition built from the matrix sizes the mailboxes by the halo
+    // messages, which must still fit the setup exchange of fromLocalRows.
+    const int N = 300;
+    const int P = 3;
+    CSRSparseMatrix A = GeneratedRows(N, 0, N);
+    distributed::RowPartition partition{A, P};
+    ASSERT_TRUE(partition.hasGhosts());
+    std::string name = "/zop-test-ghost-rows-" + std::to_string(getpid());
+    distributed::SharedMemorySegment segment{name, partition};
+
+    Vector x(N);
+    for (int i = 0; i < N; i++) {
+        x[i] = std::sin(0.5 * i);
+    }
+    double *result = static_cast<double *>(mmap(nullptr, sizeof(double) * N, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+    ASSERT_NE(result, MAP_FAILED);
+
+    std::vector<pid_t> workers;
+    for (int rank = 0; rank < P; rank++) {
+        pid_t pid = fork();
+        ASSERT_NE(pid, -1);
+        if (pid == 0) {
+            distributed::SharedMemoryTransport transport{segment, rank};
+            int a = partition.begin(rank), b = partition.end(rank);
+            auto B = distributed::DistributedCSRSparseMatrix::fromLocalRows(GeneratedRows(N, a, b), partition, transport);
+            Vector xLocal = partition.localSegment(x, rank);
+            xLocal = B * xLocal;
+            std::copy(xLocal.data(), xLocal.data() + xLocal.dim(), result + a);
+            _exit(B.ghosts() == partition.ghosts(rank) ? 0: 2);
+        }
+        workers.push_back(pid);
+    }
+    for (pid_t pid: workers) {
+        int status;
+        waitpid(pid, &status, 0);
+        ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    Vector expected = A * x;
+    for (int i = 0; i < N; i++) {
+        ASSERT_NEAR(result[i], expected[i], 1e-12);
+    }
+    munmap(result, sizeof(double) * N);
+}
@@ -0,0 +1,102 @@
+#include "gtest/gtest.h"
+
+#include <map>
+#include <random>
+#include <DynamicSparseMatrix.h>
+#include <Random.h>
+
+using namespace zop;
+
+using Reference = std::map<std::pair<int, int>, double>;
+
+/**
+ * Check every way of reading A against the reference entries.
+ */
+static void ExpectEqual(const DynamicSparseMatrix &A, const Reference &R) {
+    ASSERT_EQ(A.nnz(), (int) R.size());
+    auto it = R.begin();
+    for (int i = 0; i < A.nRows(); i++) {
+        A.forEachInRow(i, [&](int j, double v) {
+            ASSERT_TRUE(it != R.end());
+            ASSERT_EQ(it->first, std::make_pair(i, j));
+            ASSERT_EQ(it->second, v);
+            ++it;
+        });
+    }
+    ASSERT_TRUE(it == R.end());
+
+    Vector x(A.nCols()), expected(A.nRows());
+    for (int j = 0; j < A.nCols(); j++) x[j] = std::sin(j + 1.0);
+    for (auto &[loc, v]: R) expected[loc.first] += v * x[loc.second];
+    Vector y = A * x;
+    for (int i = 0; i < A.nRows(); i++) ASSERT_NEAR(y[i], expected[i], 1e-12 * (1 + std::abs(expected[i])));
+
+    CSRSparseMatrix C = A.toCSR();
+    ASSERT_EQ(C.nnz(), (int) R.size());
+    for (auto &[loc, v]: R) ASSERT_EQ(C.getEntry(loc.first, loc.second), v);
+}
+
+TEST(DynamicSparseMatrix, updates) {
+    DynamicSparseMatrix A{4, 5};
+    A.setEntry(1, 2, 3.0);
+    A.setEntry(3, 4, -1.0);
+    A.setEntry(1, 0, 2.0);
+    ASSERT_EQ(A.nnz(), 3);
+    ASSERT_EQ(A.getEntry(1, 2), 3.0);
+    A.setEntry(1, 2, 5.0);
+    A.removeEntry(3, 4);
+    A.removeEntry(0, 0);
+    A.setEntry(2, 2, 0.0);
+    ASSERT_EQ(A.nnz(), 2);
+    ExpectEqual(A, {{{1, 0}, 2.0}, {{1, 2}, 5.0}});
+
+    A.compact();
+    ASSERT_EQ(A.pendingUpdates(), 0);
+    ASSERT_EQ(A.merges(), 1);
+    ExpectEqual(A, {{{1, 0}, 2.0}, {{1, 2}, 5.0}});
+    ASSERT_THROW(A * Vector(4), DimensionMismatchException);
+
+    // A removed entry contributes nothing, even against an infinite x.
+    A.removeEntry(1, 2);
+    Vector x{1.0, 0.0, INFINITY, 0.0, 0.0};
+    Vector y = A * x;
+    ASSERT_EQ(y[1], 2.0);
+}
+
+TEST(DynamicSparseMatrix, streaming) {
+    int n = 500;
+    CSRSparseMatrix base = random::sparse(n, n, 0.02, 1);
+    Reference R;
+    for (int i = 0; i < n; i++) {
+        for (auto [j, v]: base.row(i)) R[{i, j}] = v;
+    }
+    DynamicSparseMatrix A{base};
+    A.setMergeThreshold(300);
+
+    // Inserts, updates and removals, with background merges in between.
+    std::mt19937 gen(2);
+    std::uniform_int_distribution<int> index(0, n - 1), action(0, 3);
+    for (int step = 0; step < 5000; step++) {
+        int i = index(gen), j = index(gen);
+        if (action(gen) == 0) {
+            if (!R.empty()) {
+                auto it = R.lower_bound({i, j});
+                if (it == R.end()) it = R.begin();
+                A.removeEntry(it->first.first, it->first.second);
+                R.erase(it);
+            }
+        } else {
+            double v = step + 1.0;
+            A.setEntry(i, j, v);
+            R[{i, j}] = v;
+        }
+        if (step % 1000 == 999) ExpectEqual(A, R);
+    }
+    ASSERT_GT(A.merges(), 0);
+    ASSERT_LT(A.pendingUpdates(), 5000);
+    ExpectEqual(A, R);
+
+    A.compact();
+    ASSERT_EQ(A.pendingUpdates(), 0);
+    ExpectEqual(A, R);
+}
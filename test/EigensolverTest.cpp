@@ -0,0 +1,173 @@
+#include "gtest/gtest.h"
+
+#include <random>
+#include <Eigensolver.h>
+
+using namespace zop;
+
+static CSRSparseMatrix GridGraphLaplacian(int w, int h) {
+    DOKSparseMatrix A{w * h, w * h};
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int i = y * w + x;
+            A.setEntry(i, i, 4.0);
+            if (x > 0) A.setEntry(i, i - 1, -1.0);
+            if (x < w - 1) A.setEntry(i, i + 1, -1.0);
+            if (y > 0) A.setEntry(i, i - w, -1.0);
+            if (y < h - 1) A.setEntry(i, i + w, -1.0);
+        }
+    }
+    return CSRSparseMatrix(A);
+}
+
+/**
+ * Return the eigenvalues of the Dirichlet grid Laplacian in decreasing
+ * order.
+ */
+static std::vector<double> GridEigenvalues(int w, int h) {
+    std::vector<double> res;
+    for (int i = 1; i <= w; i++) {
+        for (int j = 1; j <= h; j++) {
+            res.push_back(4.0 - 2.0 * std::cos(M_PI * i / (w + 1)) - 2.0 * std::cos(M_PI * j / (h + 1)));
+        }
+    }
+    std::sort(res.rbegin(), res.rend());
+    return res;
+}
+
+static double EigenResidual(const CSRSparseMatrix &A, double lambda, const Vector &x) {
+    Vector r = A * x;
+    double res = 0.0;
+    for (int i = 0; i < x.dim(); i++) res += std::pow(r[i] - lambda * x[i], 2);
+    return std::sqrt(res) / x.norm();
+}
+
+TEST(Eigensolver, lanczos) {
+    CSRSparseMatrix A = GridGraphLaplacian(20, 13);
+    std::vector<double> expected = GridEigenvalues(20, 13);
+
+    for (int threads: {1, 4}) {
+        parallel::ScopedThreadCount scope{threads};
+        for (int blockSize: {1, 3}) {
+            eigen::Options opts;
+            opts.blockSize = blockSize;
+            auto res = eigen::lanczos(A, 6, opts);
+            ASSERT_EQ(res.values.size(), 6);
+            for (int i = 0; i < 6; i++) {
+                ASSERT_NEAR(res.values[i], expected[i], 1e-8);
+                ASSERT_LT(EigenResidual(A, res.values[i], res.vectors[i]), 1e-7);
+                ASSERT_NEAR(res.vectors[i].norm(), 1.0, 1e-10);
+            }
+            ASSERT_NEAR(res.vectors[0].dot(res.vectors[1]), 0.0, 1e-8);
+        }
+    }
+
+    // The square grid has double eigenvalues, which the block method finds.
+    CSRSparseMatrix B = GridGraphLaplacian(12, 12);
+    std::vector<double> squared = GridEigenvalues(12, 12);
+    eigen::Options opts;
+    opts.blockSize = 2;
+    opts.which = eigen::Spectrum::SmallestAlgebraic;
+    auto res = eigen::lanczos(B, 3, opts);
+    for (int i = 0; i < 3; i++) {
+        ASSERT_NEAR(res.values[i], squared[143 - i], 1e-8);
+    }
+}
+
+TEST(Eigensolver, lanczosSmall) {
+    // The Krylov space spans the whole space and the result is exact.
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    DOKSparseMatrix A{8, 8};
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j <= i; j++) {
+            double v = dist(gen);
+            A.setEntry(i, j, v);
+            A.setEntry(j, i, v);
+        }
+    }
+    CSRSparseMatrix B{A};
+    eigen::Options opts;
+    opts.which = eigen::Spectrum::LargestMagnitude;
+    auto res = eigen::lanczos(B, 8, opts);
+    for (int i = 0; i < 8; i++) {
+        ASSERT_LT(EigenResidual(B, res.values[i], res.vectors[i]), 1e-10);
+        if (i > 0) {
+            ASSERT_GE(std::abs(res.values[i - 1]), std::abs(res.values[i]));
+        }
+    }
+
+    DOKSparseMatrix C{3, 3};
+    C.setEntry(0, 1, 1.0);
+    ASSERT_ANY_THROW(eigen::lanczos(CSRSparseMatrix(C), 1));
+}
+
+TEST(Eigensolver, arnoldi) {
+    // A block upper triangular matrix with 2 x 2 rotation blocks and real
+    // diagonal entries, hidden by a symmetric permutation.
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<double> dist(-0.05, 0.05);
+    int pairs = 50, reals = 100, n = 2 * pairs + reals;
+    DOKSparseMatrix A{n, n};
+    std::vector<std::complex<double>> expected;
+    for (int p = 0; p < pairs; p++) {
+        double r = 0.5 + 0.01 * p, s = 0.3;
+        A.setEntry(2 * p, 2 * p, r);
+        A.setEntry(2 * p, 2 * p + 1, s);
+        A.setEntry(2 * p + 1, 2 * p, -s);
+        A.setEntry(2 * p + 1, 2 * p + 1, r);
+        expected.push_back({r, s});
+    }
+    for (int i = 0; i < reals; i++) {
+        A.setEntry(2 * pairs + i, 2 * pairs + i, 0.01 * i);
+    }
+    for (int e = 0; e < 300; e++) {
+        int i = gen() % n, j = gen() % n;
+        int bi = i < 2 * pairs ? i / 2: i - pairs;
+        int bj = j < 2 * pairs ? j / 2: j - pairs;
+        if (bi < bj) A.setEntry(i, j, dist(gen));
+    }
+    std::vector<int> perm(n);
+    std::iota(perm.begin(), perm.end(), 0);
+    std::shuffle(perm.begin(), perm.end(), gen);
+    CSRSparseMatrix B = CSRSparseMatrix(A).symmetricPermuted(Permutation(perm));
+
+    eigen::Options opts;
+    opts.which = eigen::Spectrum::LargestMagnitude;
+    auto res = eigen::arnoldi(B, 4, opts);
+    ASSERT_EQ(res.values.size(), 4);
+    for (int i = 0; i < 4; i++) {
+        std::complex<double> lambda = expected[pairs - 1 - i / 2];
+        if (i % 2 == 1) lambda = std::conj(lambda);
+        ASSERT_NEAR(std::abs(res.values[i] - lambda), 0.0, 1e-8);
+    }
+
+    // A(x + iy) = λ(x + iy)
+    for (int i = 0; i < 4; i += 2) {
+        const Vector &x = res.vectors[i], &y = res.vectors[i + 1];
+        Vector ax = B * x, ay = B * y;
+        double re = res.values[i].real(), im = res.values[i].imag();
+        for (int j = 0; j < n; j++) {
+            ASSERT_NEAR(ax[j], re * x[j] - im * y[j], 1e-7);
+            ASSERT_NEAR(ay[j], im * x[j] + re * y[j], 1e-7);
+        }
+    }
+
+    // A conjugate pair is not split.
+    ASSERT_EQ(eigen::arnoldi(B, 3, opts).values.size(), 4);
+
+    // There is no block Arnoldi, and a block size is not silently ignored.
+    opts.blockSize = 2;
+    ASSERT_THROW(eigen::arnoldi(B, 4, opts), std::runtime_error);
+}
+
+TEST(Eigensolver, arnoldiSymmetric) {
+    CSRSparseMatrix A = GridGraphLaplacian(15, 9);
+    std::vector<double> expected = GridEigenvalues(15, 9);
+    auto res = eigen::arnoldi(A, 5);
+    for (int i = 0; i < 5; i++) {
+        ASSERT_NEAR(res.values[i].real(), expected[i], 1e-8);
+        ASSERT_EQ(res.values[i].imag(), 0.0);
+        ASSERT_LT(EigenResidual(A, expected[i], res.vectors[i]), 1e-7);
+    }
+}
@@ -0,0 +1,168 @@
+#include "gtest/gtest.h"
+
+#include <queue>
+#include <Graph.h>
+#include <Random.h>
+
+using namespace zop;
+
+/**
+ * Return a random directed graph with n vertices and about degree edges
+ * per vertex, with weights in [0.5, 1.5).
+ */
+static CSRSparseMatrix RandomGraph(int n, double degree, long seed) {
+    CSRSparseMatrix A = random::sparse(n, n, degree / n, seed);
+    std::vector<double> weights = A.values();
+    for (double &w: weights) w += 1.0;
+    return CSRSparseMatrix(n, n, A.rowIndices(), A.columnIndices(), weights);
+}
+
+TEST(Semiring, products) {
+    DOKSparseMatrix D{3, 3};
+    D.setEntry(0, 1, 2.0);
+    D.setEntry(0, 2, 5.0);
+    D.setEntry(1, 2, 1.0);
+    D.setEntry(2, 0, 3.0);
+    CSRSparseMatrix A{D};
+
+    auto y = multiply<semiring::PlusTimes>(A, std::vector<double>{1, 2, 3});
+    ASSERT_EQ(y, (std::vector<double>{19, 3, 3}));
+
+    double inf = std::numeric_limits<double>::infinity();
+    auto d = multiply<semiring::MinPlus>(A, std::vector<double>{inf, 0, 4});
+    ASSERT_EQ(d, (std::vector<double>{2, 5, inf}));
+
+    auto r = multiply<semiring::MaxTimes>(A, std::vector<double>{0.5, 0.5, 0.1});
+    ASSERT_EQ(r, (std::vector<double>{1.0, 0.1, 1.5}));
+
+    auto b = multiply<semiring::OrAnd>(A, std::vector<char>{0, 0, 1});
+    ASSERT_EQ(b, (std::vector<char>{1, 1, 0}));
+
+    // The masked product leaves the other rows alone.
+    std::vector<char> out{7, 7, 7}, mask{0, 1, 1}, x{1, 0, 0};
+    multiply<semiring::OrAnd>(A, x.data(), out.data(), mask.data());
+    ASSERT_EQ(out, (std::vector<char>{7, 0, 1}));
+}
+
+TEST(Semiring, pushMatchesPull) {
+    CSRSparseMatrix A = RandomGraph(2000, 6.0, 1);
+    CSRSparseMatrix T = A.transposed();
+    SparseAccumulator<semiring::MinPlus> work(2000);
+    SparseVector<double> x{2000, {3, 17, 500, 1999}, {0.0, 1.0, -2.0, 0.5}}, y;
+    for (int trial = 0; trial < 2; trial++) {
+        multiplyTransposed<semiring::MinPlus>(A, x, y, work);
+        std::vector<double> dense(2000, semiring::MinPlus::zero());
+        for (int e = 0; e < x.nnz(); e++) dense[x.indices[e]] = x.values[e];
+        std::vector<double> pulled = multiply<semiring::MinPlus>(T, dense);
+
+        int e = 0;
+        for (int j = 0; j < 2000; j++) {
+            if (e < y.nnz() && y.indices[e] == j) {
+                ASSERT_EQ(y.values[e++], pulled[j]);
+            } else {
+                ASSERT_EQ(pulled[j], semiring::MinPlus::zero());
+            }
+        }
+        ASSERT_EQ(e, y.nnz());
+        ASSERT_GT(y.nnz(), 10);
+    }
+}
+
+TEST(Graph, breadthFirstSearch) {
+    int n = 20000;
+    Graph G{RandomGraph(n, 4.0, 2)};
+    std::vector<int> levels = breadthFirstSearch(G, 0);
+
+    std::vector<int> expected(n, -1);
+    std::queue<int> queue;
+    expected[0] = 0;
+    queue.push(0);
+    while (!queue.empty()) {
+        int u = queue.front();
+        queue.pop();
+        for (auto [v, w]: G.out().row(u)) {
+            if (expected[v] < 0) {
+                expected[v] = expected[u] + 1;
+                queue.push(v);
+            }
+        }
+    }
+    ASSERT_EQ(levels, expected);
+    ASSERT_GT(*std::max_element(levels.begin(), levels.end()), 4);
+    ASSERT_GT(std::count_if(levels.begin(), levels.end(), [](int l) { return l >= 0; }), n / 2);
+    ASSERT_THROW(breadthFirstSearch(G, n), std::runtime_error);
+}
+
+TEST(Graph, shortestPaths) {
+    int n = 5000;
+    Graph G{RandomGraph(n, 5.0, 3)};
+    std::vector<double> dist = shortestPaths(G, 7);
+
+    // Dijkstra's algorithm, since all lengths are positive.
+    std::vector<double> expected(n, std::numeric_limits<double>::infinity());
+    using Entry = std::pair<double, int>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+    expected[7] = 0.0;
+    heap.push({0.0, 7});
+    while (!heap.empty()) {
+        auto [d, u] = heap.top();
+        heap.pop();
+        if (d > expected[u]) continue;
+        for (auto [v, w]: G.out().row(u)) {
+            if (d + w < expected[v]) {
+                expected[v] = d + w;
+                heap.push({expected[v], v});
+            }
+        }
+    }
+    for (int v = 0; v < n; v++) {
+        if (std::isinf(expected[v])) {
+            ASSERT_EQ(dist[v], expected[v]);
+        } else {
+            ASSERT_NEAR(dist[v], expected[v], 1e-12);
+        }
+    }
+    ASSERT_GT(std::count_if(dist.begin(), dist.end(), [](double d) { return std::isfinite(d); }), n / 2);
+
+    // Negative lengths are fine without a negative cycle.
+    DOKSparseMatrix D{3, 3};
+    D.setEntry(0, 1, 4.0);
+    D.setEntry(0, 2, 1.0);
+    D.setEntry(1, 2, -5.0);
+    ASSERT_EQ(shortestPaths(Graph{CSRSparseMatrix(D)}, 0), (std::vector<double>{0, 4, -1}));
+    D.setEntry(2, 1, 1.0);
+    ASSERT_THROW(shortestPaths(Graph{CSRSparseMatrix(D)}, 0), std::runtime_error);
+}
+
+TEST(Graph, pageRank) {
+    // On a directed cycle every vertex has the same rank.
+    DOKSparseMatrix C{4, 4};
+    for (int k = 0; k < 4; k++) C.setEntry(k, (k + 1) % 4, 1.0);
+    for (double r: pageRank(Graph{CSRSparseMatrix(C)})) ASSERT_NEAR(r, 0.25, 1e-12);
+
+    // Compare with the dense power iteration of the Google matrix.
+    int n = 300;
+    CSRSparseMatrix A = RandomGraph(n, 3.0, 4);
+    std::vector<double> rank = pageRank(Graph{A}, 0.85, 1e-14, 1000);
+    std::vector<double> expected(n, 1.0 / n), next(n);
+    for (int iteration = 0; iteration < 1000; iteration++) {
+        std::fill(next.begin(), next.end(), 0.0);
+        for (int u = 0; u < n; u++) {
+            double w = 0.0;
+            for (auto [v, a]: A.row(u)) w += a;
+            if (w == 0.0) {
+                for (int v = 0; v < n; v++) next[v] += expected[u] / n;
+                continue;
+            }
+            for (auto [v, a]: A.row(u)) next[v] += 0.85 * expected[u] * a / w;
+            for (int v = 0; v < n; v++) next[v] += 0.15 * expected[u] / n;
+        }
+        std::swap(expected, next);
+    }
+    double sum = 0.0;
+    for (int v = 0; v < n; v++) {
+        ASSERT_NEAR(rank[v], expected[v], 1e-12);
+        sum += rank[v];
+    }
+    ASSERT_NEAR(sum, 1.0, 1e-12);
+}
@@ -0,0 +1,76 @@
+#include "gtest/gtest.h"
+
+#include <Kernels.h>
+#include <SELLSparseMatrix.h>
+#include <SymmetricSparseMatrix.h>
+#include <Instrumentation.h>
+
+using namespace zop;
+
+static CSRSparseMatrix Tridiagonal(int n) {
+    DOKSparseMatrix A{n, n};
+    for (int i = 0; i < n; i++) {
+        A.setEntry(i, i, 2.0);
+        if (i > 0) A.setEntry(i, i - 1, -1.0);
+        if (i < n - 1) A.setEntry(i, i + 1, -1.0);
+    }
+    return CSRSparseMatrix(A);
+}
+
+TEST(Instrumentation, counters) {
+    if (!instrumentation::enabled) GTEST_SKIP();
+    instrumentation::reset();
+
+    CSRSparseMatrix A = Tridiagonal(100);
+    Vector x(100), y(100);
+    for (int k = 0; k < 5; k++) multiply(A, x, y);
+    A.transposed();
+
+    auto spmv = instrumentation::snapshot("spmv.csr");
+    ASSERT_EQ(spmv.calls, 5);
+    ASSERT_DOUBLE_EQ(spmv.flops, 5 * 2.0 * A.nnz());
+    ASSERT_GT(spmv.bytes, 5 * 12.0 * A.nnz());
+    uint64_t total = 0;
+    for (auto h: spmv.histogram) total += h;
+    ASSERT_EQ(total, 5);
+
+    ASSERT_EQ(instrumentation::snapshot("transposed").calls, 1);
+    // Only Tridiagonal goes through a DOK matrix; the transpose is built
+    // directly.
+    ASSERT_EQ(instrumentation::snapshot("CSRSparseMatrix(DOKSparseMatrix)").calls, 1);
+    ASSERT_EQ(instrumentation::snapshot("unknown").calls, 0);
+
+    DenseMatrix B{{4, 1}, {1, 3}};
+    B.cholesky();
+    B.LU();
+    B * B;
+    B * Vector{1, 1};
+    for (const char *name: {"cholesky", "LU", "operator*(Matrix)", "operator*(Vector)"}) {
+        ASSERT_EQ(instrumentation::snapshot(name).calls, 1) << name;
+    }
+
+    // Every storage format records its products under its own name.
+    instrumentation::reset();
+    SELLSparseMatrix(A) * x;
+    SymmetricSparseMatrix(A) * x;
+    ASSERT_EQ(instrumentation::snapshot("spmv.sell").calls, 1);
+    ASSERT_EQ(instrumentation::snapshot("spmv.symmetric").calls, 1);
+    ASSERT_EQ(instrumentation::snapshot("spmv.csr").calls, 0);
+
+    instrumentation::reset();
+    ASSERT_EQ(instrumentation::snapshot("spmv.csr").calls, 0);
+    ASSERT_TRUE(instrumentation::snapshot().empty());
+}
+
+TEST(Instrumentation, json) {
+    instrumentation::OperationStats s;
+    s.name = "spmv";
+    s.calls = 3;
+    s.nanoseconds = 1500000000;
+    s.flops = 12;
+    s.histogram[2] = 3;
+    std::string json = instrumentation::toJSON({s});
+    ASSERT_EQ(json.find("{\"operations\": [{\"name\": \"spmv\", \"calls\": 3, \"seconds\": 1.5, \"flops\": 12"), 0);
+    ASSERT_NE(json.find("\"histogram\": [0, 0, 3, 0"), std::string::npos);
+    ASSERT_EQ(instrumentation::toJSON({}), "{\"operations\": []}");
+}
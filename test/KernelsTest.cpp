@@ -0,0 +1,229 @@
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <random>
+#include <Kernels.h>
+#include <MatrixView.h>
+
+using namespace zop;
+
+static DOKSparseMatrix RandomSparse(int m, int n, int seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> value(-1.0, 1.0);
+    std::uniform_int_distribution<int> row(0, m - 1), column(0, n - 1);
+    DOKSparseMatrix A{m, n};
+    for (int e = 0; e < 5 * m; e++) {
+        A.setEntry(row(gen), column(gen), value(gen));
+    }
+    return A;
+}
+
+static DenseMatrix ToDense(const DOKSparseMatrix &D) {
+    DenseMatrix A{D.nRows(), D.nCols()};
+    for (auto &[loc, v]: D) A.setEntry(loc.first, loc.second, v);
+    return A;
+}
+
+static Vector Sequence(int n, double scale) {
+    Vector v(n);
+    for (int i = 0; i < n; i++) v[i] = std::sin(scale * (i + 1));
+    return v;
+}
+
+TEST(Kernels, gemv) {
+    DOKSparseMatrix D = RandomSparse(70, 50, 1);
+    DenseMatrix A = ToDense(D);
+    CSRSparseMatrix C{D};
+    Vector x = Sequence(50, 0.3);
+    Vector y0 = Sequence(70, 0.7);
+    Vector Ax = A * x;
+
+    Vector y = y0;
+    const double *storage = y.data();
+    multiply(A, x, y, 2.0, -0.5);
+    ASSERT_EQ(y.data(), storage);
+    for (int i = 0; i < 70; i++) ASSERT_NEAR(y[i], 2.0 * Ax[i] - 0.5 * y0[i], 1e-12);
+
+    y = y0;
+    multiply(C, x, y, 2.0, -0.5);
+    for (int i = 0; i < 70; i++) ASSERT_NEAR(y[i], 2.0 * Ax[i] - 0.5 * y0[i], 1e-12);
+
+    y = y0;
+    multiply(D, x, y, 2.0, -0.5);
+    for (int i = 0; i < 70; i++) ASSERT_NEAR(y[i], 2.0 * Ax[i] - 0.5 * y0[i], 1e-12);
+
+    // The generic fallback.
+    y = y0;
+    multiply(blockView(A, 0, 70, 0, 50), x, y, 2.0, -0.5);
+    for (int i = 0; i < 70; i++) ASSERT_NEAR(y[i], 2.0 * Ax[i] - 0.5 * y0[i], 1e-12);
+
+    // With β = 0 the previous contents are ignored.
+    for (int i = 0; i < 70; i++) y[i] = NAN;
+    multiply(C, x, y);
+    for (int i = 0; i < 70; i++) ASSERT_NEAR(y[i], Ax[i], 1e-12);
+
+    Vector wrong(69);
+    ASSERT_THROW(multiply(C, x, wrong), DimensionMismatchException);
+    DenseMatrix S{{1, 2}, {3, 4}};
+    Vector z{1, 1};
+    ASSERT_ANY_THROW(multiply(S, z, z));
+}
+
+TEST(Kernels, gemvTransposed) {
+    DOKSparseMatrix D = RandomSparse(70, 50, 2);
+    DenseMatrix A = ToDense(D);
+    CSRSparseMatrix C{D};
+    Vector x = Sequence(70, 0.3);
+    Vector y0 = Sequence(50, 0.7);
+    Vector ATx = A.transposed() * x;
+
+    Vector y = y0;
+    multiplyTransposed(A, x, y, -1.0, 3.0);
+    for (int j = 0; j < 50; j++) ASSERT_NEAR(y[j], -ATx[j] + 3.0 * y0[j], 1e-12);
+
+    y = y0;
+    multiplyTransposed(C, x, y, -1.0, 3.0);
+    for (int j = 0; j < 50; j++) ASSERT_NEAR(y[j], -ATx[j] + 3.0 * y0[j], 1e-12);
+
+    // The CSR kernel scatters rows into per-thread buffers, which must give
+    // the same result for every number of threads and on repeated calls.
+    for (int threads: {1, 3, 8}) {
+        parallel::ScopedThreadCount scope{threads};
+        y = y0;
+        multiplyTransposed(C, x, y, 2.0, 0.0);
+        for (int j = 0; j < 50; j++) ASSERT_NEAR(y[j], 2.0 * ATx[j], 1e-12) << threads;
+        Vector again = y0;
+        multiplyTransposed(C, x, again, 2.0, 0.0);
+        ASSERT_EQ(again, y);
+    }
+}
+
+TEST(Kernels, gemm) {
+    DenseMatrix A = ToDense(RandomSparse(30, 40, 3));
+    DenseMatrix B = ToDense(RandomSparse(40, 25, 4));
+    DenseMatrix C0 = ToDense(RandomSparse(30, 25, 5));
+    DenseMatrix AB = A * B;
+
+    DenseMatrix C = C0;
+    multiply(A, B, C, 0.5, 2.0);
+    for (int i = 0; i < 30; i++) {
+        for (int j = 0; j < 25; j++) {
+            ASSERT_NEAR(C.getEntry(i, j), 0.5 * AB.getEntry(i, j) + 2.0 * C0.getEntry(i, j), 1e-12);
+        }
+    }
+
+    ASSERT_THROW(multiply(A, A, C), DimensionMismatchException);
+    DenseMatrix S{{1, 2}, {3, 4}};
+    ASSERT_ANY_THROW(multiply(S, S, S));
+}
+
+TEST(Kernels, spmm) {
+    CSRSparseMatrix A{RandomSparse(300, 200, 6)};
+    for (int width: {1, 3, 8, 37, 600}) {
+        DenseMatrix X{200, width}, Y0{300, width};
+        for (int c = 0; c < width; c++) {
+            Vector x = Sequence(200, 0.1 + 0.01 * c), y = Sequence(300, 0.2 + 0.03 * c);
+            for (int i = 0; i < 200; i++) X.setEntry(i, c, x[i]);
+            for (int i = 0; i < 300; i++) Y0.setEntry(i, c, y[i]);
+        }
+        DenseMatrix Y = Y0;
+        multiply(A, X, Y, 0.5, -1.0);
+
+        // Every column matches the product with the single vector.
+        for (int c = 0; c < width; c += 1 + width / 10) {
+            Vector x(200), y(300);
+            for (int i = 0; i < 200; i++) x[i] = X.getEntry(i, c);
+            for (int i = 0; i < 300; i++) y[i] = Y0.getEntry(i, c);
+            multiply(A, x, y, 0.5, -1.0);
+            for (int i = 0; i < 300; i++) ASSERT_NEAR(Y.getEntry(i, c), y[i], 1e-12);
+        }
+    }
+
+    DenseMatrix X{200, 4}, Y{300, 4};
+    ASSERT_THROW(multiply(A, Y, Y), DimensionMismatchException);
+    ASSERT_THROW(multiply(A, X, X), DimensionMismatchException);
+    CSRSparseMatrix S{RandomSparse(4, 4, 7)};
+    DenseMatrix Z{4, 4};
+    ASSERT_ANY_THROW(multiply(S, Z, Z));
+}
+
+TEST(Kernels, sampled) {
+    CSRSparseMatrix M{RandomSparse(80, 60, 8)};
+    for (int inner: {1, 7, 64}) {
+        DenseMatrix A{80, inner}, B{60, inner};
+        for (int k = 0; k < inner; k++) {
+            Vector a = Sequence(80, 0.3 + 0.1 * k), b = Sequence(60, 0.7 - 0.05 * k);
+            for (int i = 0; i < 80; i++) A.setEntry(i, k, a[i]);
+            for (int j = 0; j < 60; j++) B.setEntry(j, k, b[j]);
+        }
+        CSRSparseMatrix C = sampledMultiply(M, A, B);
+        ASSERT_EQ(C.rowIndices(), M.rowIndices());
+        ASSERT_EQ(C.columnIndices(), M.columnIndices());
+        for (int i = 0; i < 80; i++) {
+            for (auto [j, m]: M.row(i)) {
+                double expected = 0.0;
+                for (int k = 0; k < inner; k++) expected += A.getEntry(i, k) * B.getEntry(j, k);
+                ASSERT_NEAR(C.getEntry(i, j), m * expected, 1e-12);
+            }
+        }
+
+        // The portable dot product agrees with the AVX2 one.
+        simd::ScopedPortable portable;
+        CSRSparseMatrix P = sampledMultiply(M, A, B);
+        for (int k = 0; k < M.nnz(); k++) ASSERT_NEAR(P.values()[k], C.values()[k], 1e-12);
+    }
+    DenseMatrix A{80, 3}, B{60, 4};
+    ASSERT_THROW(sampledMultiply(M, A, B), DimensionMismatchException);
+}
+
+TEST(Kernels, maskedSpgemm) {
+    DOKSparseMatrix DA = RandomSparse(90, 70, 9), DB = RandomSparse(70, 50, 10);
+    CSRSparseMatrix A{DA}, B{DB}, M{RandomSparse(90, 50, 11)};
+    DenseMatrix AB = ToDense(DA) * ToDense(DB);
+
+    CSRSparseMatrix C = maskedMultiply(M, A, B);
+    ASSERT_EQ(C.rowIndices(), M.rowIndices());
+    ASSERT_EQ(C.columnIndices(), M.columnIndices());
+    int nonzero = 0;
+    for (int i = 0; i < 90; i++) {
+        for (int k = C.rowIndices()[i]; k < C.rowIndices()[i + 1]; k++) {
+            int j = C.columnIndices()[k];
+            ASSERT_NEAR(C.values()[k], AB.getEntry(i, j), 1e-12);
+            nonzero += C.values()[k] != 0.0;
+        }
+    }
+    ASSERT_GT(nonzero, 0);
+    ASSERT_THROW(maskedMultiply(M, B, A), DimensionMismatchException);
+
+    // Two FLOPs are counted for every product that falls inside the mask.
+    if (instrumentation::enabled) {
+        long products = 0;
+        for (int i = 0; i < 90; i++) {
+            for (auto [p, a]: A.row(i)) {
+                for (auto [j, b]: B.row(p)) products += M.getEntry(i, j) != 0.0;
+            }
+        }
+        instrumentation::reset();
+        maskedMultiply(M, A, B);
+        ASSERT_EQ(instrumentation::snapshot("maskedSpgemm").flops, 2.0 * products);
+    }
+}
+
+TEST(CSRSparseMatrix, consumeDOK) {
+    DOKSparseMatrix D = RandomSparse(40, 30, 6);
+    DOKSparseMatrix copy = D;
+    CSRSparseMatrix expected{D};
+    CSRSparseMatrix C{std::move(copy)};
+    ASSERT_EQ(copy.nnz(), 0);
+    ASSERT_EQ(C.nRows(), 40);
+    ASSERT_EQ(C.nCols(), 30);
+    ASSERT_EQ(C.rowIndices(), expected.rowIndices());
+    ASSERT_EQ(C.columnIndices(), expected.columnIndices());
+    ASSERT_EQ(C.values(), expected.values());
+
+    // Trailing empty rows.
+    DOKSparseMatrix E{5, 5};
+    E.setEntry(1, 2, 3.0);
+    CSRSparseMatrix F{std::move(E)};
+    ASSERT_EQ(F.rowIndices(), (std::vector<int>{0, 0, 1, 1, 1, 1}));
+}
@@ -0,0 +1,158 @@
+#include "gtest/gtest.h"
+
+#include <random>
+#include <MatrixView.h>
+
+using namespace zop;
+
+static DOKSparseMatrix RandomSparse(int m, int n, int seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> value(-1.0, 1.0);
+    std::uniform_int_distribution<int> row(0, m - 1), column(0, n - 1);
+    DOKSparseMatrix A{m, n};
+    for (int e = 0; e < 4 * m; e++) {
+        A.setEntry(row(gen), column(gen), value(gen));
+    }
+    return A;
+}
+
+static Vector RandomVector(int n, int seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> value(-1.0, 1.0);
+    Vector v(n);
+    for (int i = 0; i < n; i++) v[i] = value(gen);
+    return v;
+}
+
+template <class M>
+static void ExpectNear(const Vector &a, const M &B, const Vector &x) {
+    ASSERT_EQ(a.dim(), B.nRows());
+    for (int i = 0; i < B.nRows(); i++) {
+        double expected = 0.0;
+        for (int j = 0; j < B.nCols(); j++) expected += B.getEntry(i, j) * x[j];
+        ASSERT_NEAR(a[i], expected, 1e-12);
+    }
+}
+
+TEST(TransposeView, multiply) {
+    DOKSparseMatrix D = RandomSparse(60, 45, 1);
+    CSRSparseMatrix C{D};
+    DenseMatrix A{60, 45};
+    for (int i = 0; i < 60; i++) {
+        for (int j = 0; j < 45; j++) A.setEntry(i, j, D.getEntry(i, j));
+    }
+    Vector x = RandomVector(60, 2);
+
+    auto AT = transposeView(A);
+    auto CT = transposeView(C);
+    auto DT = transposeView(D);
+    ASSERT_EQ(AT.nRows(), 45);
+    ASSERT_EQ(AT.nCols(), 60);
+    ASSERT_EQ(AT.getEntry(3, 7), A.getEntry(7, 3));
+
+    Vector y = A.transposed() * x;
+    ExpectNear(AT * x, A.transposed(), x);
+    ExpectNear(CT * x, A.transposed(), x);
+    ExpectNear(DT * x, A.transposed(), x);
+    for (int i = 0; i < 45; i++) {
+        ASSERT_NEAR(AT.row(i).dot(x), y[i], 1e-12);
+        ASSERT_NEAR(CT.row(i).dot(x), y[i], 1e-12);
+        ASSERT_NEAR(DT.row(i).dot(x), y[i], 1e-12);
+    }
+    ASSERT_ANY_THROW(CT * Vector(45));
+
+    // The transpose of the view is the matrix itself.
+    ASSERT_EQ(&AT.transposed(), &A);
+
+    // Writes go through to the matrix.
+    AT.setEntry(1, 2, 5.0);
+    ASSERT_EQ(A.getEntry(2, 1), 5.0);
+}
+
+TEST(BlockView, multiply) {
+    DOKSparseMatrix D = RandomSparse(50, 40, 3);
+    CSRSparseMatrix C{D};
+    DenseMatrix A{50, 40};
+    for (int i = 0; i < 50; i++) {
+        for (int j = 0; j < 40; j++) A.setEntry(i, j, D.getEntry(i, j));
+    }
+    Vector x = RandomVector(15, 4);
+
+    auto AB = blockView(A, 10, 20, 5, 15);
+    auto CB = blockView(C, 10, 20, 5, 15);
+    ASSERT_EQ(AB.nRows(), 20);
+    ASSERT_EQ(AB.nCols(), 15);
+    ASSERT_EQ(CB.getEntry(4, 6), C.getEntry(14, 11));
+    ExpectNear(AB * x, AB, x);
+    ExpectNear(CB * x, AB, x);
+    ExpectNear(blockView(D, 10, 20, 5, 15) * x, AB, x);
+
+    // Views compose.
+    auto T = transposeView(CB);
+    Vector z = RandomVector(20, 5);
+    ExpectNear(T * z, T, z);
+    ASSERT_EQ(T.getEntry(6, 4), C.getEntry(14, 11));
+
+    ASSERT_ANY_THROW(blockView(A, 40, 20, 0, 1));
+    ASSERT_ANY_THROW(blockView(A, 0, 1, -1, 2));
+}
+
+TEST(StridedView, multiply) {
+    DOKSparseMatrix D = RandomSparse(40, 40, 6);
+    CSRSparseMatrix C{D};
+    DenseMatrix A{40, 40};
+    for (int i = 0; i < 40; i++) {
+        for (int j = 0; j < 40; j++) A.setEntry(i, j, D.getEntry(i, j));
+    }
+    Vector x = RandomVector(13, 7);
+
+    // Odd rows and every third column starting from column 1.
+    auto AS = stridedView(A, 1, 20, 2, 1, 13, 3);
+    auto CS = stridedView(C, 1, 20, 2, 1, 13, 3);
+    ASSERT_EQ(AS.getEntry(2, 3), A.getEntry(5, 10));
+    ASSERT_EQ(CS.getEntry(2, 3), A.getEntry(5, 10));
+    ExpectNear(AS * x, AS, x);
+    ExpectNear(CS * x, AS, x);
+
+    ASSERT_ANY_THROW(stridedView(A, 1, 21, 2, 0, 1, 1));
+    ASSERT_ANY_THROW(stridedView(A, 0, 1, 0, 0, 1, 1));
+}
+
+TEST(MatrixView, symmetric) {
+    DenseMatrix A{{1, 2, 3}, {2, 4, 5}, {0, 5, 6}};
+    const DenseMatrix &B = A;
+    ASSERT_FALSE(A.isSymmetric());
+    ASSERT_TRUE(blockView(B, 0, 2, 0, 2).isSymmetric());
+    ASSERT_TRUE(blockView(B, 1, 2, 1, 2).isSymmetric());
+    ASSERT_FALSE(stridedView(B, 0, 2, 2, 0, 2, 2).isSymmetric());
+}
+
+TEST(MatrixView, arithmetic) {
+    // Operations that build a new matrix return the type of the underlying
+    // matrix.
+    DenseMatrix A{{4, 2, 0}, {1, 5, 1}, {0, 1, 3}};
+    DenseMatrix AT = A.transposed();
+    auto V = transposeView(A);
+    DenseMatrix sum = V + V, difference = V - transposeView(AT), product = V * V;
+    ASSERT_EQ(sum, AT + AT);
+    ASSERT_EQ(difference, AT - A);
+    ASSERT_EQ(product, AT * AT);
+    ASSERT_EQ(V.materialized(), AT);
+
+    CSRSparseMatrix C{RandomSparse(20, 20, 5)};
+    auto CT = transposeView(C);
+    CSRSparseMatrix sparseSum = CT + CT;
+    ASSERT_EQ(sparseSum, C.transposed() + C.transposed());
+
+    auto L = blockView(A, 0, 2, 0, 2), R = blockView(A, 1, 2, 1, 2);
+    ASSERT_EQ(L + R, (DenseMatrix{{9, 3}, {2, 8}}));
+    ASSERT_EQ(L * R, (DenseMatrix{{22, 10}, {10, 16}}));
+    auto [lower, upper] = L.LU();
+    ASSERT_EQ(lower * upper, L.materialized());
+
+    DenseMatrix S{{4, 1, 0, 0}, {1, 9, 0, 2}, {0, 0, 1, 0}, {0, 2, 0, 8}};
+    auto Odd = stridedView(S, 1, 2, 2, 1, 2, 2);
+    DenseMatrix F = Odd.cholesky();
+    ASSERT_EQ(F * F.transposed(), (DenseMatrix{{9, 2}, {2, 8}}));
+    ASSERT_THROW(L - blockView(A, 0, 3, 0, 3), DimensionMismatchException);
+}
@@ -0,0 +1,87 @@
+#include "gtest/gtest.h"
+
+#include <random>
+#include <MixedPrecision.h>
+
+using namespace zop;
+
+static DenseMatrix DiagonallyDominantMatrix(int n, int seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    DenseMatrix A{n, n};
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) A.setEntry(i, j, dist(gen));
+        A.setEntry(i, i, A.getEntry(i, i) + 0.5 * n);
+    }
+    return A;
+}
+
+static double RelativeResidual(const DenseMatrix &A, const Vector &x, const Vector &b) {
+    Vector r = A * x;
+    double res = 0.0, scale = 0.0;
+    for (int i = 0; i < b.dim(); i++) {
+        res = std::max(res, std::abs(r[i] - b[i]));
+        scale = std::max(scale, std::abs(b[i]));
+    }
+    return res / scale;
+}
+
+TEST(DenseLU, solve) {
+    DenseMatrix A{{0.0, 2.0, 1.0}, {1.0, 1.0, 0.0}, {3.0, 0.0, 1.0}};
+    Vector b{3.0, 2.0, 4.0};
+    Vector x = DenseLU<double>(A).solve(b);
+    for (int i = 0; i < 3; i++) {
+        ASSERT_NEAR(x[i], 1.0, 1e-14);
+    }
+    ASSERT_ANY_THROW(DenseLU<double>(DenseMatrix{{1.0, 2.0}, {2.0, 4.0}}));
+    ASSERT_ANY_THROW(DenseLU<float>(DenseMatrix{{1e300, 0.0}, {0.0, 1.0}}));
+}
+
+TEST(MixedPrecisionSolver, refinement) {
+    DenseMatrix A = DiagonallyDominantMatrix(120, 1);
+    Vector b(120);
+    for (int i = 0; i < 120; i++) b[i] = std::cos(i);
+
+    for (int threads: {1, 4}) {
+        parallel::ScopedThreadCount scope{threads};
+        MixedPrecisionSolver solver{A};
+        Vector x = solver.solve(b);
+        const auto &diagnostics = solver.diagnostics();
+        ASSERT_TRUE(diagnostics.converged);
+        ASSERT_FALSE(diagnostics.usedDoubleFactorization);
+        ASSERT_GT(diagnostics.iterations, 0);
+        ASSERT_EQ(diagnostics.backwardErrors.size(), diagnostics.iterations + 1);
+        ASSERT_LT(RelativeResidual(A, x, b), 1e-14);
+
+        // The single precision solution alone is much less accurate.
+        Vector y = DenseLU<float>(A).solve(b);
+        ASSERT_GT(RelativeResidual(A, y, b), 1e-12);
+    }
+}
+
+TEST(MixedPrecisionSolver, fallback) {
+    // The Hilbert matrix is too ill-conditioned for refinement from a
+    // single precision factorization.
+    int n = 10;
+    DenseMatrix H{n, n};
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) H.setEntry(i, j, 1.0 / (i + j + 1));
+    }
+    Vector b(n);
+    for (int i = 0; i < n; i++) b[i] = 1.0;
+
+    MixedPrecisionSolver solver{H};
+    Vector x = solver.solve(b);
+    ASSERT_TRUE(solver.diagnostics().usedDoubleFactorization);
+    ASSERT_TRUE(solver.usesDoubleFactorization());
+    ASSERT_LT(RelativeResidual(H, x, b), 1e-8);
+
+    // Entries outside the range of float.
+    DenseMatrix A{{1e200, 1.0}, {1.0, 1.0}};
+    MixedPrecisionSolver large{A};
+    ASSERT_TRUE(large.usesDoubleFactorization());
+    Vector y = large.solve(Vector{1.0, 2.0});
+    ASSERT_LT(RelativeResidual(A, y, Vector{1.0, 2.0}), 1e-15);
+
+    ASSERT_ANY_THROW(MixedPrecisionSolver(DenseMatrix{{1.0, 2.0}, {2.0, 4.0}}));
+}
@@ -0,0 +1,97 @@
+#include "gtest/gtest.h"
+
+#include <set>
+#include <Numa.h>
+#include <Random.h>
+
+using namespace zop;
+
+TEST(Numa, topology) {
+    ASSERT_EQ(numa::detail::parseCpuList("0-3,8,10-11\n"), (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+    ASSERT_EQ(numa::detail::parseCpuList(""), std::vector<int>{});
+
+    const numa::Topology &T = numa::topology();
+    ASSERT_GE(T.nNodes(), 1);
+    ASSERT_EQ(T.ids.size(), T.nodes.size());
+    std::set<int> seen;
+    for (int k = 0; k < T.nNodes(); k++) {
+        ASSERT_FALSE(T.nodes[k].empty());
+        for (int c: T.nodes[k]) {
+            ASSERT_TRUE(seen.insert(c).second);
+            ASSERT_EQ(T.nodeOf(c), k);
+        }
+    }
+    int node = numa::currentNode();
+    ASSERT_TRUE(0 <= node && node < T.nNodes());
+}
+
+TEST(Numa, pinning) {
+    // Scatter visits every node before using a second CPU of any.
+    const numa::Topology &T = numa::topology();
+    std::set<int> nodes;
+    for (int t = 0; t < T.nNodes(); t++) nodes.insert(T.nodeOf(numa::pinnedCpu(t, numa::Placement::Scatter)));
+    ASSERT_EQ((int) nodes.size(), T.nNodes());
+    ASSERT_EQ(numa::pinnedCpu(0, numa::Placement::Compact), T.nodes[0][0]);
+
+    if (!numa::pinThreads(numa::Placement::Compact)) {
+        numa::unpinThreads();
+        GTEST_SKIP() << "thread affinity is not available";
+    }
+    std::vector<int> cpus(parallel::threadCount(), -1);
+    parallel::forEachThread([&](int t, int) { cpus[t] = numa::currentCpu(); });
+    ASSERT_TRUE(numa::unpinThreads());
+    for (int t = 0; t < (int) cpus.size(); t++) {
+        if (cpus[t] >= 0) {
+            ASSERT_EQ(cpus[t], numa::pinnedCpu(t, numa::Placement::Compact));
+        }
+    }
+
+    // Unpinning restores every CPU the process started with, on the pool
+    // threads and on the calling thread.
+    std::vector<int> allowed(parallel::threadCount());
+    parallel::forEachThread([&](int t, int) { allowed[t] = numa::detail::allowedCpus().size(); });
+    for (int count: allowed) ASSERT_EQ(count, (int) numa::detail::initialCpus().size());
+
+    // From inside a task the pool falls back to the calling thread alone,
+    // which must neither be pinned nor move any storage.
+    parallel::ScopedThreadCount scope{2};
+    CSRSparseMatrix A = random::sparse(50, 50, 0.1, 1);
+    bool nestedPin = true, nestedPlace = true;
+    parallel::forEachThread([&](int t, int) {
+        if (t != 0) return;
+        nestedPin = numa::pinThreads();
+        nestedPlace = numa::place(A);
+    });
+    ASSERT_FALSE(nestedPin);
+    ASSERT_FALSE(nestedPlace);
+    ASSERT_EQ(numa::detail::allowedCpus(), numa::detail::initialCpus());
+}
+
+TEST(Numa, replicatedMultiply) {
+    CSRSparseMatrix A = random::sparse(3000, 2000, 0.005, 6);
+    Vector x(2000), y(3000), expected(3000);
+    for (int j = 0; j < 2000; j++) x[j] = std::sin(0.3 * j);
+    for (int i = 0; i < 3000; i++) y[i] = expected[i] = 1.0;
+
+    numa::ScopedPinning pinning;
+    if (!pinning.pinned()) GTEST_SKIP() << "thread affinity is not available";
+    ASSERT_TRUE(numa::place(A));
+    ASSERT_TRUE(numa::place(y, A));
+    ASSERT_TRUE(numa::place(x));
+    numa::ReplicatedVector r{x};
+    ASSERT_EQ(r.nCopies(), numa::topology().nNodes());
+    ASSERT_EQ(r.dim(), 2000);
+
+    // The same partition and order of summation as the CSR kernel.
+    numa::multiply(A, r, y, 2.0, 0.5);
+    multiply(A, x, expected, 2.0, 0.5);
+    ASSERT_EQ(y, expected);
+
+    for (int j = 0; j < 2000; j++) x[j] = j;
+    r.assign(x);
+    for (int k = 0; k < r.nCopies(); k++) ASSERT_EQ(r.data(k)[1999], 1999.0);
+    numa::multiply(A, r, y);
+    multiply(A, x, expected);
+    ASSERT_EQ(y, expected);
+    ASSERT_THROW(numa::multiply(A, r, x), DimensionMismatchException);
+}
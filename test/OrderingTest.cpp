@@ -0,0 +1,155 @@
+#include "gtest/gtest.h"
+
+#include <set>
+#include <random>
+#include <Ordering.h>
+
+using namespace zop;
+
+static Permutation RandomPermutationFromSeed(int n, int seed) {
+    std::vector<int> perm(n);
+    std::iota(perm.begin(), perm.end(), 0);
+    std::shuffle(perm.begin(), perm.end(), std::mt19937(seed));
+    return Permutation(perm);
+}
+
+static CSRSparseMatrix GridLaplacian(int w, int h) {
+    DOKSparseMatrix A{w * h, w * h};
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int i = y * w + x;
+            A.setEntry(i, i, 4.0);
+            if (x > 0) A.setEntry(i, i - 1, -1.0);
+            if (x < w - 1) A.setEntry(i, i + 1, -1.0);
+            if (y > 0) A.setEntry(i, i - w, -1.0);
+            if (y < h - 1) A.setEntry(i, i + w, -1.0);
+        }
+    }
+    return CSRSparseMatrix(A);
+}
+
+/**
+ * Count the entries of the Cholesky factor of a matrix with a symmetric
+ * pattern by simulating the elimination.
+ */
+static long CholeskyFill(const CSRSparseMatrix &A) {
+    int n = A.nRows();
+    std::vector<std::set<int>> pattern(n);
+    for (int i = 0; i < n; i++) {
+        for (auto [j, e]: A.row(i)) {
+            if (j > i) pattern[i].insert(j);
+        }
+    }
+    long count = 0;
+    for (int i = 0; i < n; i++) {
+        count += pattern[i].size() + 1;
+        if (pattern[i].empty()) continue;
+        int parent = *pattern[i].begin();
+        for (int j: pattern[i]) {
+            if (j != parent) pattern[parent].insert(j);
+        }
+    }
+    return count;
+}
+
+TEST(Permutation, apply) {
+    Permutation p(std::vector<int>{2, 0, 1});
+    Vector x{1.0, 2.0, 3.0};
+
+    ASSERT_EQ(p.apply(x), (Vector{3.0, 1.0, 2.0}));
+    ASSERT_EQ(p.applyInverse(p.apply(x)), x);
+    ASSERT_EQ(p.inverted().apply(x), p.applyInverse(x));
+    ASSERT_EQ(p.compose(p.inverted()), Permutation::Identity(3));
+
+    Permutation q(std::vector<int>{1, 0, 2});
+    ASSERT_EQ(p.compose(q).apply(x), p.apply(q.apply(x)));
+
+    ASSERT_ANY_THROW(Permutation(std::vector<int>{0, 0, 1}));
+    ASSERT_ANY_THROW(Permutation(std::vector<int>{0, 3, 1}));
+}
+
+TEST(Permutation, CSRSparseMatrix) {
+    std::srand(5);
+    DOKSparseMatrix A{20, 15};
+    for (int e = 0; e < 60; e++) {
+        A.setEntry(std::rand() % 20, std::rand() % 15, (double) std::rand() / RAND_MAX);
+    }
+    CSRSparseMatrix B{A};
+    Permutation p = RandomPermutationFromSeed(20, 1);
+    Permutation q = RandomPermutationFromSeed(15, 2);
+
+    for (int threads: {1, 4}) {
+        parallel::ScopedThreadCount scope{threads};
+        CSRSparseMatrix C = B.rowPermuted(p);
+        CSRSparseMatrix D = B.columnPermuted(q);
+        CSRSparseMatrix E = B.permuted(p, q);
+        for (int i = 0; i < 20; i++) {
+            for (int j = 0; j < 15; j++) {
+                ASSERT_EQ(C.getEntry(i, j), B.getEntry(p[i], j));
+                ASSERT_EQ(D.getEntry(i, j), B.getEntry(i, q[j]));
+                ASSERT_EQ(E.getEntry(i, j), B.getEntry(p[i], q[j]));
+            }
+        }
+
+        // (PAQᵀ)(Qx) = P(Ax)
+        Vector x(15);
+        for (int j = 0; j < 15; j++) x[j] = j - 7.0;
+        Vector y = E * q.apply(x);
+        Vector z = p.apply(B * x);
+        for (int i = 0; i < 20; i++) {
+            ASSERT_NEAR(y[i], z[i], 1e-12);
+        }
+    }
+
+    ASSERT_THROW(B.symmetricPermuted(p), DimensionMismatchException);
+}
+
+TEST(Ordering, reverseCuthillMcKee) {
+    // A shuffled path graph is restored to a tridiagonal matrix.
+    DOKSparseMatrix A{50, 50};
+    for (int i = 0; i < 50; i++) {
+        A.setEntry(i, i, 2.0);
+        if (i > 0) A.setEntry(i, i - 1, -1.0);
+        if (i < 49) A.setEntry(i, i + 1, -1.0);
+    }
+    CSRSparseMatrix B = CSRSparseMatrix(A).symmetricPermuted(RandomPermutationFromSeed(50, 3));
+    ASSERT_GT(B.bandwidth(), 1);
+
+    Permutation p = ordering::reverseCuthillMcKee(B);
+    ASSERT_EQ(B.symmetricPermuted(p).bandwidth(), 1);
+
+    // A shuffled grid regains a bandwidth close to its width.
+    CSRSparseMatrix C = GridLaplacian(10, 30).symmetricPermuted(RandomPermutationFromSeed(300, 4));
+    CSRSparseMatrix D = C.symmetricPermuted(ordering::reverseCuthillMcKee(C));
+    ASSERT_LE(D.bandwidth(), 11);
+    ASSERT_LT(D.profile(), C.profile());
+    ASSERT_TRUE(D.isSymmetric());
+
+    // Disconnected components are all ordered.
+    DOKSparseMatrix E{4, 4};
+    E.setEntry(0, 2, 1.0);
+    E.setEntry(2, 0, 1.0);
+    ASSERT_EQ(ordering::reverseCuthillMcKee(CSRSparseMatrix(E)).size(), 4);
+}
+
+TEST(Ordering, approximateMinimumDegree) {
+    // Eliminating the hub of an arrow matrix last (it ties with the final
+    // leaf) produces no fill.
+    DOKSparseMatrix A{30, 30};
+    for (int i = 0; i < 30; i++) {
+        A.setEntry(i, i, 4.0);
+        A.setEntry(0, i, 1.0);
+        A.setEntry(i, 0, 1.0);
+    }
+    CSRSparseMatrix B{A};
+    Permutation p = ordering::approximateMinimumDegree(B);
+    ASSERT_TRUE(p[29] == 0 || p[28] == 0);
+    ASSERT_EQ(CholeskyFill(B.symmetricPermuted(p)), 59);
+
+    CSRSparseMatrix C = GridLaplacian(15, 15).symmetricPermuted(RandomPermutationFromSeed(225, 6));
+    Permutation q = ordering::approximateMinimumDegree(C);
+    Permutation r = ordering::reverseCuthillMcKee(C);
+    long amd = CholeskyFill(C.symmetricPermuted(q));
+    ASSERT_LT(amd, CholeskyFill(C));
+    ASSERT_LT(amd, CholeskyFill(C.symmetricPermuted(r)));
+}
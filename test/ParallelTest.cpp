@@ -0,0 +1,24 @@
+#include "gtest/gtest.h"
+
+#include <thread>
+#include <stdexcept>
+#include <Parallel.h>
+
+using namespace zop;
+
+TEST(Parallel, scopedThreadCount) {
+    int before = parallel::threadCount();
+    try {
+        parallel::ScopedThreadCount scope{before + 2};
+        ASSERT_EQ(parallel::threadCount(), before + 2);
+        throw std::runtime_error("leaving the scope");
+    } catch (const std::runtime_error &) {}
+    ASSERT_EQ(parallel::threadCount(), before);
+
+    // Application threads may reach their first kernel at the same time.
+    std::vector<std::thread> threads;
+    std::vector<int> counts(4);
+    for (int t = 0; t < 4; t++) threads.emplace_back([&, t] { counts[t] = parallel::pool().size(); });
+    for (auto &thread: threads) thread.join();
+    for (int c: counts) ASSERT_EQ(c, before);
+}
@@ -1,6 +1,176 @@
 #include <Polygon.h>
 #include <gtest/gtest.h>
 
+#include <random>
+#include <algorithm>
+
+using namespace zop;
+
+/**
+ * Return a regular polygon with n vertices in counter-clockwise order.
+ */
+static SimplePolygon Regular(int n, double radius, double cx, double cy) {
+    std::vector<double> x(n), y(n);
+    for (int k = 0; k < n; k++) {
+        x[k] = cx + radius * std::cos(2 * M_PI * k / n);
+        y[k] = cy + radius * std::sin(2 * M_PI * k / n);
+    }
+    return SimplePolygon(x, y);
+}
+
 TEST(Polygon, Constructor) {
-    
-}
\ No newline at end of file
+    SimplePolygon P{{0, 0}, {2, 0}, {2, 1}, {0, 1}};
+    ASSERT_EQ(P.vertexCount(), 4);
+    ASSERT_EQ(P.vertex(2), (Vector{2, 1}));
+    ASSERT_EQ(P.vertex(-1), (Vector{0, 1}));
+    ASSERT_EQ(P.vertex(5), (Vector{2, 0}));
+    ASSERT_THROW(SimplePolygon({Vector{0, 0, 0}}), DimensionMismatchException);
+    ASSERT_THROW(SimplePolygon({1, 2}, {1}), DimensionMismatchException);
+}
+
+TEST(Polygon, measures) {
+    SimplePolygon P{{0, 0}, {2, 0}, {2, 1}, {0, 1}};
+    ASSERT_DOUBLE_EQ(P.edgeLength(1), 1.0);
+    ASSERT_DOUBLE_EQ(P.perimeter(), 6.0);
+    ASSERT_DOUBLE_EQ(P.signedArea(), 2.0);
+    ASSERT_EQ(P.orientation(), 1);
+    ASSERT_NEAR(P.centroid()[0], 1.0, 1e-12);
+    ASSERT_NEAR(P.centroid()[1], 0.5, 1e-12);
+    for (int i = 0; i < 4; i++) ASSERT_NEAR(P.interiorAngle(i), M_PI / 2, 1e-12);
+
+    SimplePolygon Q{{0, 1}, {2, 1}, {2, 0}, {0, 0}};
+    ASSERT_DOUBLE_EQ(Q.signedArea(), -2.0);
+    ASSERT_DOUBLE_EQ(Q.area(), 2.0);
+    ASSERT_EQ(Q.orientation(), -1);
+    ASSERT_NEAR(Q.interiorAngle(0), M_PI / 2, 1e-12);
+
+    // Far from the origin, and with enough vertices for the SIMD kernels.
+    SimplePolygon R = Regular(101, 2.0, 1e6, -3e6);
+    ASSERT_NEAR(R.area(), 0.5 * 101 * 4.0 * std::sin(2 * M_PI / 101), 1e-6);
+    ASSERT_NEAR(R.perimeter(), 101 * 2 * 2.0 * std::sin(M_PI / 101), 1e-9);
+    ASSERT_NEAR(R.centroid()[0], 1e6, 1e-6);
+    ASSERT_NEAR(R.centroid()[1], -3e6, 1e-6);
+
+    // The portable path agrees with the vectorized one, which is taken if
+    // the CPU supports AVX2.
+    double area = R.area(), perimeter = R.perimeter();
+    simd::ScopedPortable portable;
+    ASSERT_NEAR(R.area(), area, 1e-9);
+    ASSERT_NEAR(R.perimeter(), perimeter, 1e-9);
+
+    // A polygon without vertices has no measure and no vertices to access.
+    SimplePolygon E;
+    ASSERT_EQ(E.perimeter(), 0.0);
+    ASSERT_EQ(E.area(), 0.0);
+    ASSERT_THROW(E.vertex(0), std::runtime_error);
+    ASSERT_THROW(E.edgeLength(0), std::runtime_error);
+}
+
+TEST(Polygon, convexity) {
+    ASSERT_TRUE((SimplePolygon{{0, 0}, {2, 0}, {2, 1}, {0, 1}}.isConvex()));
+    ASSERT_TRUE(Regular(50, 1.0, 0, 0).isConvex());
+
+    // A collinear vertex does not break convexity.
+    ASSERT_TRUE((SimplePolygon{{0, 0}, {1, 0}, {2, 0}, {2, 1}, {0, 1}}.isConvex()));
+
+    // An L shape has a reflex vertex.
+    SimplePolygon L{{0, 0}, {2, 0}, {2, 1}, {1, 1}, {1, 2}, {0, 2}};
+    ASSERT_FALSE(L.isConvex());
+    ASSERT_NEAR(L.interiorAngle(3), 1.5 * M_PI, 1e-12);
+    double sum = 0.0;
+    for (int i = 0; i < 6; i++) sum += L.interiorAngle(i);
+    ASSERT_NEAR(sum, 4 * M_PI, 1e-12);
+
+    // A pentagram turns the same way at every vertex but winds twice.
+    std::vector<Vector> star;
+    for (int k = 0; k < 5; k++) {
+        star.push_back(Vector{std::cos(4 * M_PI * k / 5), std::sin(4 * M_PI * k / 5)});
+    }
+    ASSERT_FALSE(SimplePolygon(star).isConvex());
+
+    // A spike that doubles back turns the same way at every other vertex.
+    ASSERT_FALSE((SimplePolygon{{0, 0}, {1, 0}, {1, 1}, {1, 0}, {2, 0}, {2, 2}, {0, 2}}.isConvex()));
+
+    ASSERT_FALSE((SimplePolygon{{0, 0}, {1, 1}, {2, 2}}.isConvex()));
+}
+
+TEST(Polygon, contains) {
+    SimplePolygon L{{0, 0}, {2, 0}, {2, 1}, {1, 1}, {1, 2}, {0, 2}};
+    ASSERT_TRUE(L.contains({0.5, 0.5}));
+    ASSERT_TRUE(L.contains({0.5, 1.5}));
+    ASSERT_FALSE(L.contains({1.5, 1.5}));
+    ASSERT_FALSE(L.contains({-1, 0.5}));
+
+    // The ray through (2, 1) passes through a vertex and must count once.
+    ASSERT_TRUE(L.contains({0.5, 1.0}));
+    SimplePolygon D{{0, -1}, {1, 0}, {0, 1}, {-1, 0}};
+    ASSERT_TRUE(D.contains({-0.5, 0.0}));
+    ASSERT_FALSE(D.contains({-1.5, 0.0}));
+}
+
+TEST(PolygonCollection, batch) {
+    std::mt19937 gen(1);
+    std::uniform_int_distribution<int> sides(3, 40);
+    std::uniform_real_distribution<double> coord(-100, 100);
+
+    // Regular polygons, some of them clockwise, and some with their first
+    // vertex pulled into the center, which leaves a fan of n - 2 of the n
+    // triangles and a reflex vertex. Their measures are known in closed
+    // form.
+    struct Expected {
+        double perimeter, area, cx, cy;
+        int orientation;
+        bool convex;
+    };
+    PolygonCollection C;
+    std::vector<Expected> expected;
+    SimplePolygon first;
+    for (int p = 0; p < 2000; p++) {
+        int n = sides(gen);
+        double r = 1.0 + p % 7, cx = coord(gen), cy = coord(gen);
+        SimplePolygon P = Regular(n, r, cx, cy);
+        std::vector<double> x = P.xs(), y = P.ys();
+        bool clockwise = p % 3 == 0;
+        if (clockwise) {
+            std::reverse(x.begin(), x.end());
+            std::reverse(y.begin(), y.end());
+        }
+        double theta = 2 * M_PI / n;
+        double side = 2 * r * std::sin(theta / 2);
+        double triangle = 0.5 * r * r * std::sin(theta);
+        Expected e{n * side, n * triangle, cx, cy, clockwise ? -1: 1, true};
+        if (p % 5 == 0 && n >= 5) {
+            // The two missing triangles share the pulled vertex, so the
+            // centroid moves away from it along its axis of symmetry.
+            double shift = 2 * (1 + std::cos(theta)) / (3 * (n - 2));
+            e.cx -= shift * (x[0] - cx);
+            e.cy -= shift * (y[0] - cy);
+            x[0] = cx;
+            y[0] = cy;
+            e.perimeter = (n - 2) * side + 2 * r;
+            e.area = (n - 2) * triangle;
+            e.convex = false;
+        }
+        e.area *= e.orientation;
+        C.add(SimplePolygon(x, y));
+        expected.push_back(e);
+        if (p == 17) first = SimplePolygon(x, y);
+    }
+    ASSERT_EQ(C.size(), 2000);
+    ASSERT_EQ(C.polygon(17).xs(), first.xs());
+
+    auto perimeters = C.perimeters();
+    auto areas = C.signedAreas();
+    auto orientations = C.orientations();
+    auto convex = C.convexity();
+    auto [cx, cy] = C.centroids();
+    for (int p = 0; p < 2000; p++) {
+        const Expected &e = expected[p];
+        ASSERT_NEAR(perimeters[p], e.perimeter, 1e-9) << p;
+        ASSERT_NEAR(areas[p], e.area, 1e-9) << p;
+        ASSERT_EQ(orientations[p], e.orientation) << p;
+        ASSERT_EQ((bool) convex[p], e.convex) << p;
+        ASSERT_NEAR(cx[p], e.cx, 1e-9) << p;
+        ASSERT_NEAR(cy[p], e.cy, 1e-9) << p;
+    }
+}
@@ -0,0 +1,118 @@
+#include "gtest/gtest.h"
+
+#include <random>
+#include <QR.h>
+
+using namespace zop;
+
+static DenseMatrix GaussianMatrix(int m, int n, int seed) {
+    std::mt19937 gen(seed);
+    std::normal_distribution<double> dist;
+    DenseMatrix A{m, n};
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < n; j++) {
+            A.setEntry(i, j, dist(gen));
+        }
+    }
+    return A;
+}
+
+/**
+ * Return the gradient Aᵀ(Ax - b) of the least-squares objective, which
+ * vanishes at the minimizer.
+ */
+static double NormalResidual(const DenseMatrix &A, const Vector &x, const Vector &b) {
+    Vector r = A * x;
+    for (int i = 0; i < b.dim(); i++) r[i] -= b[i];
+    double res = 0.0;
+    for (int j = 0; j < A.nCols(); j++) {
+        double acc = 0.0;
+        for (int i = 0; i < A.nRows(); i++) acc += A.getEntry(i, j) * r[i];
+        res = std::max(res, std::abs(acc));
+    }
+    return res;
+}
+
+TEST(HouseholderQR, factor) {
+    for (int blockSize: {1, 3, 32}) {
+        DenseMatrix A = GaussianMatrix(40, 10, blockSize);
+        HouseholderQR qr{A, blockSize};
+        DenseMatrix R = qr.R();
+
+        // Q(R; 0) reproduces every column of A.
+        for (int j = 0; j < 10; j++) {
+            Vector r(40);
+            for (int i = 0; i < 10; i++) r[i] = R.getEntry(i, j);
+            Vector a = qr.applyQ(r);
+            for (int i = 0; i < 40; i++) {
+                ASSERT_NEAR(a[i], A.getEntry(i, j), 1e-12);
+            }
+        }
+
+        // Q is orthogonal.
+        Vector b(40);
+        for (int i = 0; i < 40; i++) b[i] = std::sin(i);
+        Vector c = qr.applyQT(b);
+        ASSERT_NEAR(c.norm(), b.norm(), 1e-12);
+        Vector d = qr.applyQ(c);
+        for (int i = 0; i < 40; i++) {
+            ASSERT_NEAR(d[i], b[i], 1e-12);
+        }
+    }
+
+    ASSERT_ANY_THROW(HouseholderQR(GaussianMatrix(3, 5, 0)));
+}
+
+TEST(HouseholderQR, leastSquares) {
+    // An exactly solvable system is solved exactly.
+    DenseMatrix A = GaussianMatrix(30, 6, 1);
+    Vector x{1.0, -2.0, 3.0, -4.0, 5.0, -6.0};
+    Vector b = A * x;
+    Vector y = HouseholderQR(A, 4).leastSquares(b);
+    for (int j = 0; j < 6; j++) {
+        ASSERT_NEAR(y[j], x[j], 1e-10);
+    }
+
+    // An inconsistent system is solved in the least-squares sense.
+    for (int i = 0; i < 30; i++) b[i] += std::cos(i);
+    ASSERT_LT(NormalResidual(A, HouseholderQR(A, 4).leastSquares(b), b), 1e-10);
+
+    // Rank-deficient matrices are rejected.
+    DenseMatrix B{5, 2};
+    for (int i = 0; i < 5; i++) {
+        B.setEntry(i, 0, i);
+        B.setEntry(i, 1, 2.0 * i);
+    }
+    ASSERT_ANY_THROW(HouseholderQR(B).leastSquares(Vector(5)));
+}
+
+TEST(TSQR, leastSquares) {
+    DenseMatrix A = GaussianMatrix(1000, 8, 2);
+    Vector b(1000);
+    for (int i = 0; i < 1000; i++) b[i] = std::cos(0.1 * i);
+
+    Vector reference = HouseholderQR(A).leastSquares(b);
+    for (int blocks: {1, 3, 16}) {
+        TSQR tsqr{A, blocks};
+        ASSERT_EQ(tsqr.blockCount(), blocks);
+
+        // R is unique up to the signs of its rows.
+        DenseMatrix R = tsqr.R();
+        DenseMatrix S = HouseholderQR(A).R();
+        for (int i = 0; i < 8; i++) {
+            double sign = R.getEntry(i, i) * S.getEntry(i, i) > 0 ? 1.0: -1.0;
+            for (int j = 0; j < 8; j++) {
+                ASSERT_NEAR(R.getEntry(i, j), sign * S.getEntry(i, j), 1e-10);
+            }
+        }
+
+        ASSERT_NEAR(tsqr.applyQT(b).norm(), b.norm(), 1e-10);
+        Vector x = tsqr.leastSquares(b);
+        for (int j = 0; j < 8; j++) {
+            ASSERT_NEAR(x[j], reference[j], 1e-10);
+        }
+    }
+
+    Vector x = leastSquares(A, b);
+    ASSERT_LT(NormalResidual(A, x, b), 1e-9);
+}
@@ -0,0 +1,92 @@
+#include "gtest/gtest.h"
+
+#include <Random.h>
+
+using namespace zop;
+
+TEST(Random, philox) {
+    // Known answers of the reference implementation.
+    random::Philox zero(0);
+    ASSERT_EQ(zero({0, 0, 0, 0}), (random::Philox::Block{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}));
+    random::Philox ones(0xffffffffffffffff);
+    ASSERT_EQ(ones({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}),
+              (random::Philox::Block{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}));
+    random::Philox pi(0x299f31d0a4093822);
+    ASSERT_EQ(pi({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}),
+              (random::Philox::Block{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}));
+
+    random::Stream s(zero, 3, 0);
+    double sum = 0.0;
+    for (int k = 0; k < 100000; k++) {
+        double u = s.uniform();
+        ASSERT_GE(u, 0.0);
+        ASSERT_LT(u, 1.0);
+        sum += u;
+    }
+    ASSERT_NEAR(sum / 100000, 0.5, 0.01);
+}
+
+TEST(Random, reproducible) {
+    // The matrices depend on the seed only, not on the number of threads.
+    auto generate = [] {
+        return std::make_tuple(random::sparse(3000, 2000, 0.01, 5),
+                               random::powerLaw(3000, 8.0, 2.5, 5),
+                               random::symmetricPositiveDefinite(500, 0.02, 5),
+                               random::dense(40, 30, 5));
+    };
+    auto serial = [&] {
+        parallel::ScopedThreadCount scope{1};
+        return generate();
+    }();
+    auto threaded = [&] {
+        parallel::ScopedThreadCount scope{4};
+        return generate();
+    }();
+    ASSERT_EQ(std::get<0>(serial), std::get<0>(threaded));
+    ASSERT_EQ(std::get<1>(serial), std::get<1>(threaded));
+    ASSERT_EQ(std::get<2>(serial), std::get<2>(threaded));
+    ASSERT_EQ(std::get<3>(serial), std::get<3>(threaded));
+
+    ASSERT_NE(random::sparse(3000, 2000, 0.01, 6), std::get<0>(serial));
+}
+
+TEST(Random, families) {
+    CSRSparseMatrix A = random::sparse(2000, 1000, 0.05);
+    ASSERT_NEAR(A.nnz(), 0.05 * 2000 * 1000, 1000);
+    for (int i = 0; i < A.nRows(); i++) {
+        for (int k = A.rowIndices()[i]; k < A.rowIndices()[i + 1]; k++) {
+            ASSERT_GE(A.values()[k], -0.5);
+            ASSERT_LT(A.values()[k], 0.5);
+            if (k > A.rowIndices()[i]) {
+                ASSERT_LT(A.columnIndices()[k - 1], A.columnIndices()[k]);
+            }
+        }
+    }
+
+    CSRSparseMatrix U = random::sparseUpperTriangular(300, 400, 0.3, 1);
+    CSRSparseMatrix L = random::sparseLowerTriangular(400, 300, 0.3, 1);
+    for (int i = 0; i < 300; i++) {
+        for (auto [j, v]: U.row(i)) ASSERT_GE(j, i);
+    }
+    for (int i = 0; i < 400; i++) {
+        for (auto [j, v]: L.row(i)) ASSERT_LE(j, i);
+    }
+    ASSERT_TRUE(random::DOKSparseUpperTriangular(50, 50, 0.5, 2).isUpperTriangular());
+    ASSERT_TRUE(random::DOKSparseLowerTriangular(50, 50, 0.5, 2).isLowerTriangular());
+    ASSERT_EQ(random::sparseUpperTriangular(10, 10, 1.0).nnz(), 55);
+
+    CSRSparseMatrix B = random::banded(100, 2, 1);
+    ASSERT_EQ(B.nnz(), 100 * 4 - 3 - 1);
+
+    CSRSparseMatrix S = random::symmetricPositiveDefinite(200, 0.05, 3);
+    ASSERT_EQ(S, S.transposed());
+    ASSERT_GT(S.nnz(), 200 + 0.05 * 200 * 199 * 0.8);
+    ASSERT_NO_THROW(S.cholesky());
+
+    CSRSparseMatrix P = random::powerLaw(20000, 10.0, 2.2, 4);
+    ASSERT_NEAR(P.nnz(), 10.0 * 20000, 0.05 * 10.0 * 20000);
+    int head = P.rowIndices()[20], tail = P.nnz() - P.rowIndices()[20000 - 20];
+    ASSERT_GT(head, 100 * tail);
+
+    ASSERT_THROW(random::powerLaw(10, 2.0, 1.0), std::runtime_error);
+}
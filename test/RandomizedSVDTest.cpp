@@ -0,0 +1,175 @@
+#include "gtest/gtest.h"
+
+#include <random>
+#include <RandomizedSVD.h>
+
+using namespace zop;
+
+/**
+ * Return U diag(σ) Vᵀ with random orthonormal U and V.
+ */
+static DenseMatrix MatrixWithSpectrum(int m, int n, const std::vector<double> &sigma, int seed) {
+    std::mt19937 gen(seed);
+    std::normal_distribution<double> dist;
+    int r = sigma.size();
+    auto orthonormal = [&](int rows) {
+        std::vector<double> X((size_t) rows * r);
+        for (double &x: X) x = dist(gen);
+        HouseholderQR qr(rows, r, X);
+        std::vector<Vector> cols;
+        for (int c = 0; c < r; c++) {
+            Vector e(rows);
+            e[c] = 1.0;
+            cols.push_back(qr.applyQ(e));
+        }
+        return cols;
+    };
+    auto U = orthonormal(m);
+    auto V = orthonormal(n);
+    DenseMatrix A{m, n};
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < n; j++) {
+            double acc = 0.0;
+            for (int c = 0; c < r; c++) acc += U[c][i] * sigma[c] * V[c][j];
+            A.setEntry(i, j, acc);
+        }
+    }
+    return A;
+}
+
+static double MaxDifference(const DenseMatrix &A, const DenseMatrix &B) {
+    double res = 0.0;
+    for (int i = 0; i < A.nRows(); i++) {
+        for (int j = 0; j < A.nCols(); j++) {
+            res = std::max(res, std::abs(A.getEntry(i, j) - B.getEntry(i, j)));
+        }
+    }
+    return res;
+}
+
+TEST(RandomizedSVD, dense) {
+    // An exactly low-rank matrix is recovered exactly.
+    std::vector<double> sigma{10.0, 5.0, 2.0, 1.0, 0.5};
+    DenseMatrix A = MatrixWithSpectrum(60, 40, sigma, 1);
+    auto res = svd::randomized(A, 5);
+    ASSERT_EQ(res.rank(), 5);
+    for (int c = 0; c < 5; c++) {
+        ASSERT_NEAR(res.singularValues[c], sigma[c], 1e-10);
+    }
+    ASSERT_LT(MaxDifference(res.toDense(), A), 1e-10);
+
+    // U and V have orthonormal columns.
+    for (int p = 0; p < 5; p++) {
+        for (int q = 0; q < 5; q++) {
+            double u = 0.0, v = 0.0;
+            for (int i = 0; i < 60; i++) u += res.U.getEntry(i, p) * res.U.getEntry(i, q);
+            for (int j = 0; j < 40; j++) v += res.V.getEntry(j, p) * res.V.getEntry(j, q);
+            ASSERT_NEAR(u, p == q, 1e-10);
+            ASSERT_NEAR(v, p == q, 1e-10);
+        }
+    }
+
+    // The leading singular values of a matrix with a decaying spectrum.
+    std::vector<double> decay;
+    for (int c = 0; c < 30; c++) decay.push_back(std::pow(0.5, c));
+    DenseMatrix B = MatrixWithSpectrum(80, 50, decay, 2);
+    auto approx = svd::randomized(B, 4);
+    for (int c = 0; c < 4; c++) {
+        ASSERT_NEAR(approx.singularValues[c], decay[c], 1e-8);
+    }
+
+    Vector x(50);
+    for (int j = 0; j < 50; j++) x[j] = std::sin(j);
+    Vector y = approx * x, z = approx.toDense() * x;
+    for (int i = 0; i < 80; i++) {
+        ASSERT_NEAR(y[i], z[i], 1e-12);
+    }
+
+    ASSERT_ANY_THROW(svd::randomized(A, 41));
+}
+
+TEST(RandomizedSVD, sparse) {
+    DOKSparseMatrix A{70, 45};
+    std::mt19937 gen(3);
+    for (int e = 0; e < 300; e++) {
+        A.setEntry(gen() % 70, gen() % 45, std::normal_distribution<double>()(gen));
+    }
+    CSRSparseMatrix B{A};
+    DenseMatrix D{70, 45};
+    for (int i = 0; i < 70; i++) {
+        for (auto [j, v]: B.row(i)) D.setEntry(i, j, v);
+    }
+
+    // The sparse and dense kernels compute the same approximation, and a
+    // fixed seed gives the same result for any number of threads.
+    svd::Options opts;
+    opts.powerIterations = 4;
+    auto dense = svd::randomized(D, 6, opts);
+    for (int threads: {1, 4}) {
+        parallel::ScopedThreadCount scope{threads};
+        auto sparse = svd::randomized(B, 6, opts);
+        auto again = svd::randomized(B, 6, opts);
+        for (int c = 0; c < 6; c++) {
+            ASSERT_NEAR(sparse.singularValues[c], dense.singularValues[c], 1e-10);
+        }
+        ASSERT_EQ(sparse.singularValues, again.singularValues);
+    }
+
+    // Another seed draws a different sample.
+    svd::Options other = opts;
+    other.seed = 7;
+    auto res = svd::randomized(B, 6, other);
+    ASSERT_NE(res.singularValues, dense.singularValues);
+    ASSERT_NEAR(res.singularValues[0], dense.singularValues[0], 1e-3 * dense.singularValues[0]);
+}
+
+TEST(RandomizedSVD, streaming) {
+    std::vector<double> sigma{3.0, 2.0, 1.0};
+    DenseMatrix A = MatrixWithSpectrum(50, 30, sigma, 4);
+
+    // Rows arrive in random order, some of them split into two updates.
+    svd::StreamingSVD sketch{50, 30, 3};
+    std::vector<int> order(50);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937(5));
+    for (int i: order) {
+        if (i % 3 == 0) {
+            Vector half = A.row(i) * 0.5;
+            sketch.addRow(i, half);
+            sketch.addRow(i, half);
+        } else {
+            sketch.addRow(i, A.row(i));
+        }
+    }
+    auto res = sketch.approximation();
+    for (int c = 0; c < 3; c++) {
+        ASSERT_NEAR(res.singularValues[c], sigma[c], 1e-10);
+    }
+    ASSERT_LT(MaxDifference(res.toDense(), A), 1e-10);
+
+    // Blocks of sparse rows of a rank 3 matrix, streamed out of order.
+    DOKSparseMatrix S{40, 20};
+    for (int i = 0; i < 40; i++) {
+        int p = i % 3;
+        S.setEntry(i, p, 1.0 + i);
+        S.setEntry(i, 5 + 4 * p, -2.0 * (1.0 + i));
+        S.setEntry(i, 6 + 4 * p, 0.5 * (1.0 + i));
+    }
+    CSRSparseMatrix B{S};
+    DenseMatrix D{40, 20};
+    DOKSparseMatrix first{25, 20}, second{15, 20};
+    for (int i = 0; i < 40; i++) {
+        for (auto [j, v]: B.row(i)) {
+            D.setEntry(i, j, v);
+            if (i < 25) first.setEntry(i, j, v);
+            else second.setEntry(i - 25, j, v);
+        }
+    }
+    for (int threads: {1, 4}) {
+        parallel::ScopedThreadCount scope{threads};
+        svd::StreamingSVD sketched{40, 20, 3};
+        sketched.addRows(25, CSRSparseMatrix(second));
+        sketched.addRows(0, CSRSparseMatrix(first));
+        ASSERT_LT(MaxDifference(sketched.approximation().toDense(), D), 1e-9);
+    }
+}
@@ -0,0 +1,101 @@
+#include "gtest/gtest.h"
+
+#include <SELLSparseMatrix.h>
+
+using namespace zop;
+
+static DOKSparseMatrix RandomRaggedMatrixFromSeed(int M, int N, int seed) {
+    std::srand(seed);
+
+    DOKSparseMatrix mat{M, N};
+    for (int i = 0; i < M; i++) {
+        int count = std::rand() % 12;
+        for (int e = 0; e < count; e++) {
+            int j = std::rand() % N;
+            double v = (double) std::rand() / RAND_MAX - 0.5;
+            mat.setEntry(i, j, v);
+        }
+    }
+    return mat;
+}
+
+TEST(SELLSparseMatrix, Constructor) {
+    DOKSparseMatrix A = RandomRaggedMatrixFromSeed(37, 23, 42);
+    CSRSparseMatrix B{A};
+    SELLSparseMatrix C{B, 4, 8};
+
+    ASSERT_EQ(C.nRows(), 37);
+    ASSERT_EQ(C.nCols(), 23);
+    ASSERT_EQ(C.sliceCount(), 10);
+
+    for (int i = 0; i < A.nRows(); i++) {
+        for (int j = 0; j < A.nCols(); j++) {
+            ASSERT_EQ(A.getEntry(i, j), C.getEntry(i, j));
+        }
+    }
+}
+
+TEST(SELLSparseMatrix, multiply) {
+    DOKSparseMatrix A = RandomRaggedMatrixFromSeed(101, 57, 69);
+    CSRSparseMatrix B{A};
+
+    Vector x(57);
+    for (int i = 0; i < x.dim(); i++) {
+        x[i] = i % 7 - 3.0;
+    }
+    Vector y = B * x;
+
+    for (int C: {1, 3, 4, 8, 16, 32}) {
+        for (int sigma: {1, 8, 32, 101}) {
+            SELLSparseMatrix S{B, C, sigma};
+            Vector z = S * x;
+            ASSERT_EQ(z.dim(), 101);
+            for (int i = 0; i < z.dim(); i++) {
+                ASSERT_NEAR(y[i], z[i], 1e-12);
+            }
+
+            // The portable kernels, and any split of the slices across
+            // threads, give the same result as the vectorized kernels.
+            simd::ScopedPortable portable;
+            for (int threads: {1, 3}) {
+                parallel::ScopedThreadCount scope{threads};
+                Vector w = S * x;
+                for (int i = 0; i < w.dim(); i++) {
+                    ASSERT_NEAR(z[i], w[i], 1e-12);
+                }
+            }
+        }
+    }
+
+    ASSERT_THROW(SELLSparseMatrix(B) * Vector(3), DimensionMismatchException);
+}
+
+TEST(SELLSparseMatrix, paddingStatistics) {
+    // Two full rows in different slices of height 2, and a diagonal
+    // everywhere else.
+    DOKSparseMatrix A{8, 8};
+    for (int i = 0; i < 8; i++) {
+        A.setEntry(i, i, 1.0);
+    }
+    for (int j = 0; j < 8; j++) {
+        A.setEntry(1, j, 1.0);
+        A.setEntry(4, j, 1.0);
+    }
+    CSRSparseMatrix B{A};
+
+    auto unsorted = SELLSparseMatrix(B, 2, 1).paddingStatistics();
+    ASSERT_EQ(unsorted.nnz, 22);
+    ASSERT_EQ(unsorted.storedEntries, 16 + 2 + 16 + 2);
+    ASSERT_EQ(unsorted.paddingEntries, 14);
+
+    // Sorting moves both long rows into one slice, which removes all the
+    // padding.
+    auto sorted = SELLSparseMatrix(B, 2, 8).paddingStatistics();
+    ASSERT_EQ(sorted.storedEntries, 16 + 2 + 2 + 2);
+    ASSERT_EQ(sorted.paddingEntries, 0);
+    ASSERT_LT(sorted.paddingRatio, unsorted.paddingRatio);
+
+    auto wide = SELLSparseMatrix(B, 1, 8).paddingStatistics();
+    ASSERT_EQ(wide.paddingEntries, 0);
+    ASSERT_DOUBLE_EQ(wide.efficiency, 1.0);
+}
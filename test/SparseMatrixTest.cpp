@@ -126,7 +126,33 @@ TEST(CSRSparseMatrix, isSymmetric) {
     B.setEntry(2, 2, 98.0);
 
     ASSERT_TRUE(!CSRSparseMatrix(B).isSymmetric());
+    ASSERT_TRUE(!CSRSparseMatrix(B).isStructurallySymmetric());
 
+    B.setEntry(1, 0, 12.0);
+    B.setEntry(2, 0, -16.0);
+    B.setEntry(2, 1, 43.0);
+
+    ASSERT_TRUE(!CSRSparseMatrix(B).isSymmetric());
+    ASSERT_TRUE(CSRSparseMatrix(B).isStructurallySymmetric());
+
+    DOKSparseMatrix C = RandomDOKSparseMatrixFromSeed(50, 50, 0.1, 7);
+    DOKSparseMatrix D = C + C.transposed();
+    ASSERT_TRUE(CSRSparseMatrix(D).isSymmetric());
+    ASSERT_EQ(CSRSparseMatrix(C).isSymmetric(), C.isSymmetric());
+
+    // Explicitly stored zeros are not part of the structure: zeros at
+    // (0, 2) and (2, 1), neither with a mirror, compare equal to the
+    // symmetric matrix without them and are symmetric like it.
+    CSRSparseMatrix S{3, 3, {0, 3, 5, 7}, {0, 1, 2, 0, 1, 1, 2}, {4.0, 1.0, 0.0, 1.0, 5.0, 0.0, 6.0}};
+    CSRSparseMatrix T{3, 3, {0, 2, 4, 5}, {0, 1, 0, 1, 2}, {4.0, 1.0, 1.0, 5.0, 6.0}};
+    ASSERT_TRUE(S.equals(T));
+    ASSERT_TRUE(S.isStructurallySymmetric());
+    ASSERT_TRUE(S.isSymmetric());
+    ASSERT_FALSE(S.isUpperTriangular());
+    CSRSparseMatrix U{3, 3, {0, 2, 4, 5}, {0, 2, 1, 2, 2}, {4.0, 0.0, 5.0, 0.0, 6.0}};
+    ASSERT_TRUE(U.isStructurallySymmetric());
+    ASSERT_TRUE(U.isLowerTriangular());
+    ASSERT_TRUE(U.isUpperTriangular());
 }
 
 TEST(CSRSparseMatrix, isLowerTriangular) {
@@ -238,3 +264,94 @@ TEST(CSRSparseMatrix, LU) {
     ASSERT_EQ(U2, U);
 }
 
+
+TEST(SparseMatrix, StructuralQueries) {
+    for (int seed = 0; seed < 10; seed++) {
+        DOKSparseMatrix A = RandomDOKSparseMatrixFromSeed(30, 25, 0.05, seed);
+        CSRSparseMatrix B{A};
+        using Generic = AbstractMatrix<DOKSparseMatrix>;
+
+        ASSERT_EQ(A.lowerBandwidth(), A.Generic::lowerBandwidth());
+        ASSERT_EQ(A.upperBandwidth(), A.Generic::upperBandwidth());
+        ASSERT_EQ(A.profile(), A.Generic::profile());
+        ASSERT_EQ(A.isLowerTriangular(), A.Generic::isLowerTriangular());
+        ASSERT_EQ(A.isUpperTriangular(), A.Generic::isUpperTriangular());
+
+        ASSERT_EQ(B.lowerBandwidth(), A.lowerBandwidth());
+        ASSERT_EQ(B.upperBandwidth(), A.upperBandwidth());
+        ASSERT_EQ(B.bandwidth(), A.bandwidth());
+        ASSERT_EQ(B.profile(), A.profile());
+    }
+
+    DOKSparseMatrix C{4, 4};
+    C.setEntry(0, 0, 4.0);
+    C.setEntry(0, 3, -1.0);
+    C.setEntry(1, 1, 2.0);
+    C.setEntry(1, 0, 2.0);
+    C.setEntry(2, 2, -3.0);
+    C.setEntry(3, 1, 1.0);
+    C.setEntry(3, 3, 1.5);
+
+    ASSERT_EQ(CSRSparseMatrix(C).lowerBandwidth(), 2);
+    ASSERT_EQ(CSRSparseMatrix(C).upperBandwidth(), 3);
+    ASSERT_EQ(CSRSparseMatrix(C).profile(), 3);
+    ASSERT_TRUE(C.isDiagonallyDominant());
+    ASSERT_TRUE(!C.isDiagonallyDominant(true));
+    ASSERT_TRUE(CSRSparseMatrix(C).isDiagonallyDominant());
+    ASSERT_TRUE(!CSRSparseMatrix(C).isDiagonallyDominant(true));
+    ASSERT_EQ(C.isDiagonallyDominant(), C.AbstractMatrix<DOKSparseMatrix>::isDiagonallyDominant());
+
+    C.setEntry(3, 2, 1.0);
+    ASSERT_TRUE(!C.isDiagonallyDominant());
+    ASSERT_TRUE(!CSRSparseMatrix(C).isDiagonallyDominant());
+}
+
+TEST(SparseMatrix, Equality) {
+    DOKSparseMatrix A = RandomDOKSparseMatrixFromSeed(200, 150, 0.05, 3);
+    DOKSparseMatrix B = RandomDOKSparseMatrixFromSeed(200, 150, 0.05, 3);
+    DOKSparseMatrix C = RandomDOKSparseMatrixFromSeed(200, 150, 0.05, 4);
+
+    ASSERT_EQ(A, B);
+    ASSERT_NE(A, C);
+    ASSERT_NE(A, DOKSparseMatrix(150, 200));
+
+    for (int threads: {1, 4}) {
+        parallel::ScopedThreadCount scope{threads};
+        ASSERT_EQ(CSRSparseMatrix(A), CSRSparseMatrix(B));
+        ASSERT_NE(CSRSparseMatrix(A), CSRSparseMatrix(C));
+    }
+
+    // explicitly stored zeros compare equal to missing entries
+    CSRSparseMatrix D(2, 3, {0, 2, 3}, {0, 2, 1}, {1.0, 0.0, 2.0});
+    CSRSparseMatrix E(2, 3, {0, 1, 3}, {0, 0, 1}, {1.0, 0.0, 2.0});
+    ASSERT_EQ(D, E);
+    ASSERT_TRUE(D.isUpperTriangular());
+}
+
+TEST(CSRSparseMatrix, add) {
+    DOKSparseMatrix A = RandomDOKSparseMatrixFromSeed(60, 40, 0.1, 11);
+    DOKSparseMatrix B = RandomDOKSparseMatrixFromSeed(60, 40, 0.1, 12);
+    CSRSparseMatrix C{A};
+    CSRSparseMatrix D{B};
+
+    for (int threads: {1, 4}) {
+        parallel::ScopedThreadCount scope{threads};
+
+        ASSERT_EQ(C + D, CSRSparseMatrix(A + B));
+        ASSERT_EQ(C - D, CSRSparseMatrix(A - B));
+
+        CSRSparseMatrix E = CSRSparseMatrix::add(2.0, C, -0.5, D);
+        for (int i = 0; i < E.nRows(); i++) {
+            for (int j = 0; j < E.nCols(); j++) {
+                ASSERT_EQ(E.getEntry(i, j), 2.0 * A.getEntry(i, j) - 0.5 * B.getEntry(i, j));
+            }
+        }
+
+        CSRSparseMatrix F = C - C;
+        ASSERT_EQ(F.nnz(), 0);
+        ASSERT_EQ(F, CSRSparseMatrix(DOKSparseMatrix(60, 40)));
+    }
+
+    ASSERT_THROW(C + CSRSparseMatrix(A.transposed()), DimensionMismatchException);
+    ASSERT_THROW(A + A.transposed(), DimensionMismatchException);
+}
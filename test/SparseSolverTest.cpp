@@ -0,0 +1,141 @@
+#include "gtest/gtest.h"
+
+#include <random>
+#include <SparseSolver.h>
+
+using namespace zop;
+
+static CSRSparseMatrix PoissonMatrix(int w, int h, double shift) {
+    DOKSparseMatrix A{w * h, w * h};
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int i = y * w + x;
+            A.setEntry(i, i, 4.0 + shift);
+            if (x > 0) A.setEntry(i, i - 1, -1.0);
+            if (x < w - 1) A.setEntry(i, i + 1, -1.0);
+            if (y > 0) A.setEntry(i, i - w, -1.0);
+            if (y < h - 1) A.setEntry(i, i + w, -1.0);
+        }
+    }
+    return CSRSparseMatrix(A);
+}
+
+/**
+ * Return a diagonally dominant matrix with a non-symmetric pattern and
+ * non-symmetric values.
+ */
+static CSRSparseMatrix UnsymmetricMatrix(int n, int seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> value(-1.0, 1.0);
+    std::uniform_int_distribution<int> column(0, n - 1);
+    DOKSparseMatrix A{n, n};
+    for (int i = 0; i < n; i++) {
+        for (int e = 0; e < 3; e++) {
+            A.setEntry(i, column(gen), value(gen));
+        }
+        A.setEntry(i, i, 8.0);
+    }
+    return CSRSparseMatrix(A);
+}
+
+static double ResidualNorm(const CSRSparseMatrix &A, const Vector &x, const Vector &b) {
+    Vector r = A * x;
+    double res = 0.0;
+    for (int i = 0; i < b.dim(); i++) {
+        res = std::max(res, std::abs(r[i] - b[i]));
+    }
+    return res;
+}
+
+TEST(SymbolicFactorization, Supernodes) {
+    CSRSparseMatrix A = PoissonMatrix(12, 12, 0.0);
+    SymbolicFactorization S{A};
+
+    // The supernodes partition the columns, and every supernode is a chain
+    // of the elimination tree.
+    int n = 0;
+    for (int s = 0; s < S.supernodeCount(); s++) {
+        ASSERT_EQ(S.firstColumn(s), n);
+        for (int j = n; j < n + S.columnCount(s) - 1; j++) {
+            ASSERT_EQ(S.eliminationTree()[j], j + 1);
+        }
+        ASSERT_EQ(S.rowCount(s), S.columnCounts()[n]);
+        n += S.columnCount(s);
+    }
+    ASSERT_EQ(n, 144);
+    ASSERT_LT(S.supernodeCount(), 144);
+
+    // The last column of a connected matrix is the root of the tree.
+    ASSERT_EQ(S.eliminationTree()[143], -1);
+
+    // The fill-reducing ordering stores far fewer entries than the natural
+    // banded ordering.
+    SymbolicFactorization natural{A, Permutation::Identity(144)};
+    ASSERT_LT(S.factorEntries(), natural.factorEntries());
+}
+
+TEST(SupernodalCholesky, solve) {
+    CSRSparseMatrix A = PoissonMatrix(15, 11, 0.1);
+    Vector b(A.nRows());
+    for (int i = 0; i < b.dim(); i++) b[i] = std::sin(i);
+
+    SupernodalCholesky chol{A};
+    ASSERT_LT(ResidualNorm(A, chol.solve(b), b), 1e-10);
+
+    // A dense matrix consists of a single supernode.
+    DOKSparseMatrix D{4, 4};
+    double values[4][4] = {{4, 12, -16, 1}, {12, 37, -43, 2}, {-16, -43, 98, 3}, {1, 2, 3, 30}};
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) D.setEntry(i, j, values[i][j]);
+    }
+    SupernodalCholesky dense{CSRSparseMatrix(D)};
+    ASSERT_EQ(dense.symbolic().supernodeCount(), 1);
+    Vector c{1.0, 2.0, 3.0, 4.0};
+    ASSERT_LT(ResidualNorm(CSRSparseMatrix(D), dense.solve(c), c), 1e-10);
+
+    // non-symmetric and indefinite matrices
+    CSRSparseMatrix U = UnsymmetricMatrix(20, 1);
+    ASSERT_ANY_THROW(SupernodalCholesky{U});
+    ASSERT_ANY_THROW(SupernodalCholesky{PoissonMatrix(5, 5, -8.0)});
+}
+
+TEST(SupernodalCholesky, refactor) {
+    CSRSparseMatrix A = PoissonMatrix(10, 10, 0.0);
+    SupernodalCholesky chol{A};
+    Vector b(100);
+    for (int i = 0; i < 100; i++) b[i] = 1.0;
+
+    // The same analysis is reused for every shift.
+    for (double shift: {0.5, 1.0, 10.0}) {
+        CSRSparseMatrix B = PoissonMatrix(10, 10, shift);
+        chol.refactor(B);
+        ASSERT_LT(ResidualNorm(B, chol.solve(b), b), 1e-10);
+    }
+
+    // A different pattern is rejected.
+    ASSERT_ANY_THROW(chol.refactor(PoissonMatrix(10, 9, 0.0)));
+}
+
+TEST(SupernodalLU, solve) {
+    for (int seed = 0; seed < 5; seed++) {
+        CSRSparseMatrix A = UnsymmetricMatrix(200, seed);
+        Vector b(200);
+        for (int i = 0; i < 200; i++) b[i] = std::cos(i);
+
+        SupernodalLU lu{A};
+        ASSERT_LT(ResidualNorm(A, lu.solve(b), b), 1e-10);
+
+        // A shared analysis can be used by several factorizations.
+        SupernodalLU other{lu.sharedSymbolic(), A};
+        ASSERT_LT(ResidualNorm(A, other.solve(b), b), 1e-10);
+
+        // Natural ordering.
+        auto natural = std::make_shared<SymbolicFactorization>(A, Permutation::Identity(200));
+        ASSERT_LT(ResidualNorm(A, SupernodalLU(natural, A).solve(b), b), 1e-10);
+    }
+
+    DOKSparseMatrix Z{2, 2};
+    Z.setEntry(0, 1, 1.0);
+    Z.setEntry(1, 0, 1.0);
+    ASSERT_ANY_THROW(SupernodalLU{CSRSparseMatrix(Z)});
+}
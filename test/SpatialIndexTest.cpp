@@ -0,0 +1,84 @@
+#include "gtest/gtest.h"
+
+#include <random>
+#include <SpatialIndex.h>
+
+using namespace zop;
+
+/**
+ * Return a collection of star-shaped, mostly non-convex polygons scattered
+ * over [0, 100]², many of which overlap.
+ */
+static PolygonCollection RandomPolygons(int count, int seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> center(0, 100), radius(0.5, 4.0);
+    std::uniform_int_distribution<int> sides(3, 12);
+    PolygonCollection C;
+    for (int p = 0; p < count; p++) {
+        int n = sides(gen);
+        double cx = center(gen), cy = center(gen);
+        std::vector<double> x(n), y(n);
+        for (int k = 0; k < n; k++) {
+            double r = radius(gen);
+            x[k] = cx + r * std::cos(2 * M_PI * k / n);
+            y[k] = cy + r * std::sin(2 * M_PI * k / n);
+        }
+        C.add(x.data(), y.data(), n);
+    }
+    return C;
+}
+
+TEST(PackedRTree, structure) {
+    PolygonCollection C = RandomPolygons(1000, 1);
+    PackedRTree T{C, 8};
+    ASSERT_EQ(T.size(), 1000);
+    ASSERT_EQ(T.height(), 5);
+
+    BoundingBox all;
+    for (int k = 0; k < C.vertexCount(); k++) all.expand(C.xs()[k], C.ys()[k]);
+    ASSERT_EQ(T.bounds().minX, all.minX);
+    ASSERT_EQ(T.bounds().maxY, all.maxY);
+
+    PolygonCollection empty;
+    PackedRTree E{empty};
+    ASSERT_TRUE(E.containing(1, 1).empty());
+    ASSERT_EQ(E.locate({1.0}, {1.0}), std::vector<int>{-1});
+
+    ASSERT_ANY_THROW(PackedRTree(C, 1));
+}
+
+TEST(PackedRTree, queries) {
+    PolygonCollection C = RandomPolygons(3000, 2);
+    PackedRTree T{C};
+
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<double> coord(-5, 105);
+    std::vector<double> px(5000), py(5000);
+    for (int i = 0; i < 5000; i++) {
+        px[i] = coord(gen);
+        py[i] = coord(gen);
+    }
+
+    std::vector<int> located = T.locate(px, py);
+    int hits = 0;
+    for (int i = 0; i < 5000; i++) {
+        std::vector<int> expected;
+        for (int p = 0; p < C.size(); p++) {
+            if (C.contains(p, px[i], py[i])) expected.push_back(p);
+        }
+        ASSERT_EQ(T.containing(px[i], py[i]), expected);
+        ASSERT_EQ(located[i], expected.empty() ? -1: expected.front());
+        hits += !expected.empty();
+    }
+    ASSERT_GT(hits, 500);
+
+    BoundingBox box{20, 30, 25, 50};
+    std::vector<int> expected;
+    for (int p = 0; p < C.size(); p++) {
+        BoundingBox b;
+        for (int k = C.offsets()[p]; k < C.offsets()[p + 1]; k++) b.expand(C.xs()[k], C.ys()[k]);
+        if (b.intersects(box)) expected.push_back(p);
+    }
+    ASSERT_EQ(T.intersecting(box), expected);
+    ASSERT_FALSE(expected.empty());
+}
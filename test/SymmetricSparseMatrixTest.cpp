@@ -0,0 +1,66 @@
+#include "gtest/gtest.h"
+
+#include <SymmetricSparseMatrix.h>
+
+using namespace zop;
+
+static DOKSparseMatrix RandomSymmetricMatrixFromSeed(int N, double sparsity, int seed) {
+    std::srand(seed);
+
+    DOKSparseMatrix mat{N, N};
+    for (int e = 0; e < (int)(sparsity * N * N / 2); e++) {
+        int i = std::rand() % N;
+        int j = std::rand() % N;
+        double v = (double) std::rand() / RAND_MAX - 0.5;
+        if (mat.getEntry(i, j) == 0.0) {
+            mat.setEntry(i, j, v);
+            mat.setEntry(j, i, v);
+        }
+    }
+    return mat;
+}
+
+TEST(SymmetricSparseMatrix, Constructor) {
+    DOKSparseMatrix A = RandomSymmetricMatrixFromSeed(20, 0.3, 42);
+    CSRSparseMatrix B{A};
+
+    for (auto triangle: {SymmetricSparseMatrix::Triangle::Upper, SymmetricSparseMatrix::Triangle::Lower}) {
+        SymmetricSparseMatrix C{B, triangle};
+        ASSERT_EQ(C.nRows(), 20);
+        ASSERT_EQ(C.nCols(), 20);
+        ASSERT_LT(C.nnz(), B.nnz());
+
+        for (int i = 0; i < A.nRows(); i++) {
+            for (int j = 0; j < A.nCols(); j++) {
+                ASSERT_EQ(A.getEntry(i, j), C.getEntry(i, j));
+            }
+        }
+
+        ASSERT_EQ(C.toCSR(), B);
+    }
+
+    DOKSparseMatrix D{3, 3};
+    D.setEntry(0, 1, 1.0);
+    ASSERT_ANY_THROW(SymmetricSparseMatrix{D});
+}
+
+TEST(SymmetricSparseMatrix, multiply) {
+    DOKSparseMatrix A = RandomSymmetricMatrixFromSeed(500, 0.02, 69);
+    CSRSparseMatrix B{A};
+
+    Vector x(500);
+    for (int i = 0; i < x.dim(); i++) {
+        x[i] = i % 11 - 5.0;
+    }
+    Vector y = B * x;
+
+    for (auto triangle: {SymmetricSparseMatrix::Triangle::Upper, SymmetricSparseMatrix::Triangle::Lower}) {
+        for (int threads: {1, 3, 8}) {
+            parallel::ScopedThreadCount scope{threads};
+            Vector z = SymmetricSparseMatrix(B, triangle) * x;
+            for (int i = 0; i < z.dim(); i++) {
+                ASSERT_NEAR(y[i], z[i], 1e-12);
+            }
+        }
+    }
+}
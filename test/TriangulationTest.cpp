@@ -0,0 +1,136 @@
+#include "gtest/gtest.h"
+
+#include <random>
+#include <Triangulation.h>
+
+using namespace zop;
+
+static double TriangleArea(const double *x, const double *y, const int *t) {
+    return 0.5 * ((x[t[1]] - x[t[0]]) * (y[t[2]] - y[t[0]]) - (y[t[1]] - y[t[0]]) * (x[t[2]] - x[t[0]]));
+}
+
+/**
+ * Check that the triangles cover P: there are n - 2 of them, each one is
+ * counter-clockwise with its centroid inside P, and their areas add up to
+ * the area of P.
+ */
+static void ExpectTriangulation(const SimplePolygon &P, const std::vector<int> &T) {
+    int n = P.vertexCount();
+    ASSERT_EQ(T.size(), 3 * (n - 2));
+    const double *x = P.xs().data(), *y = P.ys().data();
+    double sum = 0.0;
+    for (size_t k = 0; k < T.size(); k += 3) {
+        double a = TriangleArea(x, y, &T[k]);
+        ASSERT_GT(a, 0.0);
+        sum += a;
+        double cx = (x[T[k]] + x[T[k + 1]] + x[T[k + 2]]) / 3;
+        double cy = (y[T[k]] + y[T[k + 1]] + y[T[k + 2]]) / 3;
+        ASSERT_TRUE(P.contains({cx, cy}));
+    }
+    ASSERT_NEAR(sum, P.area(), 1e-9 * P.area());
+}
+
+static SimplePolygon Reversed(const SimplePolygon &P) {
+    return SimplePolygon({P.xs().rbegin(), P.xs().rend()}, {P.ys().rbegin(), P.ys().rend()});
+}
+
+/**
+ * Return a star-shaped polygon with n vertices at random radii, which has
+ * split and merge vertices on all sides.
+ */
+static SimplePolygon RandomStar(int n, std::mt19937 &gen) {
+    std::uniform_real_distribution<double> radius(0.2, 1.0);
+    std::vector<double> x(n), y(n);
+    for (int k = 0; k < n; k++) {
+        double r = radius(gen);
+        x[k] = r * std::cos(2 * M_PI * k / n);
+        y[k] = r * std::sin(2 * M_PI * k / n);
+    }
+    return SimplePolygon(x, y);
+}
+
+/**
+ * Return an orthogonal polygon under a skyline of n steps with distinct
+ * heights, so that half of the edges are horizontal and many vertices share
+ * their y coordinate. If sideways, the skyline is rotated by 90 degrees.
+ */
+static SimplePolygon Skyline(int n, bool sideways, std::mt19937 &gen) {
+    std::vector<double> heights(n);
+    for (int k = 0; k < n; k++) heights[k] = k + 1;
+    std::shuffle(heights.begin(), heights.end(), gen);
+    std::vector<double> x{(double) n, 0.0}, y{0.0, 0.0};
+    for (int k = 0; k < n; k++) {
+        x.push_back(k);
+        y.push_back(heights[k]);
+        x.push_back(k + 1);
+        y.push_back(heights[k]);
+    }
+    if (sideways) std::swap(x, y);
+    return SimplePolygon(x, y);
+}
+
+TEST(Triangulator, simple) {
+    SimplePolygon square{{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+    ExpectTriangulation(square, triangulate(square));
+    ExpectTriangulation(Reversed(square), triangulate(Reversed(square)));
+
+    SimplePolygon L{{0, 0}, {2, 0}, {2, 1}, {1, 1}, {1, 2}, {0, 2}};
+    ExpectTriangulation(L, triangulate(L));
+    ExpectTriangulation(Reversed(L), triangulate(Reversed(L)));
+
+    SimplePolygon triangle{{0, 0}, {1, 0}, {0, 1}};
+    ExpectTriangulation(triangle, triangulate(triangle));
+    ExpectTriangulation(Reversed(triangle), triangulate(Reversed(triangle)));
+    ASSERT_TRUE(triangulate(SimplePolygon({1.0, 2.0}, {1.0, 2.0})).empty());
+
+    // A comb with teeth pointing up and down has split and merge vertices.
+    std::vector<Vector> comb;
+    for (int k = 0; k < 10; k++) {
+        comb.push_back(Vector{2.0 * k, 0.0});
+        comb.push_back(Vector{2.0 * k + 1, -3.0});
+    }
+    comb.push_back(Vector{20.0, 0.0});
+    comb.push_back(Vector{20.0, 1.0});
+    for (int k = 9; k >= 0; k--) {
+        comb.push_back(Vector{2.0 * k + 1, 4.0});
+        comb.push_back(Vector{2.0 * k, 1.0});
+    }
+    SimplePolygon C(comb);
+    ExpectTriangulation(C, triangulate(C));
+    ExpectTriangulation(Reversed(C), triangulate(Reversed(C)));
+}
+
+TEST(Triangulator, random) {
+    std::mt19937 gen(1);
+    Triangulator T;
+    for (int trial = 0; trial < 50; trial++) {
+        int n = 5 + trial * 20;
+        SimplePolygon S = RandomStar(n, gen);
+        ExpectTriangulation(S, T.triangulate(S));
+        ExpectTriangulation(Reversed(S), T.triangulate(Reversed(S)));
+        SimplePolygon K = Skyline(n, trial % 2, gen);
+        ExpectTriangulation(K, T.triangulate(K));
+        ExpectTriangulation(Reversed(K), T.triangulate(Reversed(K)));
+    }
+}
+
+TEST(Triangulator, collection) {
+    std::mt19937 gen(2);
+    PolygonCollection C;
+    std::vector<SimplePolygon> polygons;
+    for (int p = 0; p < 500; p++) {
+        SimplePolygon P = p % 2 ? RandomStar(3 + p % 40, gen): Skyline(1 + p % 30, p % 4 == 0, gen);
+        if (p % 3 == 0) P = Reversed(P);
+        C.add(P);
+        polygons.push_back(P);
+    }
+    std::vector<int> out(3 * triangleCount(C));
+    triangulate(C, out.data());
+
+    int k = 0;
+    for (int p = 0; p < 500; p++) {
+        std::vector<int> expected = triangulate(polygons[p]);
+        for (int i: expected) ASSERT_EQ(out[k++], i + C.offsets()[p]);
+    }
+    ASSERT_EQ(k, out.size());
+}